@@ -0,0 +1,30 @@
+#version 310 es
+
+// Depth prepass. Only positions are fetched, the main pass then shades each
+// pixel once with an equal depth test.
+layout(location = 0) in vec3 vertex_position;
+
+// The frame set of triangle.vert, declared the same so both share a pipeline layout.
+layout(std140, set = 0, binding = 0) uniform frame_block
+{
+	mat4 view_projection;
+	mat4 view;
+	mat4 projection;
+	vec4 camera_position;
+	vec4 light_position;
+	float time;
+} frame;
+
+layout(std430, set = 0, binding = 1) readonly buffer transform_block
+{
+	mat4 models[];
+} transforms;
+
+// Has to match triangle.vert exactly for the equal depth test.
+invariant gl_Position;
+
+void main()
+{
+	vec4 world_pos = transforms.models[gl_InstanceIndex] * vec4(vertex_position, 1.0f);
+	gl_Position = frame.view_projection * world_pos;
+}
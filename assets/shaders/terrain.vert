@@ -0,0 +1,81 @@
+#version 310 es
+
+// Terrain chunks, see Terrain.hpp. A vertex only stores its height and normal,
+// the position in the chunk follows from the vertex index.
+layout(location = 0) in float vertex_height;
+layout(location = 1) in vec2 vertex_normal_xz;
+
+// Per chunk, see TerrainChunkData.
+layout(location = 2) in vec4 chunk_origin;
+layout(location = 3) in vec4 chunk_scale;
+
+// Constants of the frame, see ShaderDataBlock.hpp.
+layout(std140, set = 0, binding = 0) uniform frame_block
+{
+	mat4 view_projection;
+	mat4 view;
+	mat4 projection;
+	vec4 camera_position;
+	vec4 light_position;
+	float time;
+} frame;
+
+layout(location = 0) out mediump vec4 color;
+
+// Has to match between the depth prepass and the main pass for the equal depth test.
+invariant gl_Position;
+
+const int chunk_quads = 64;
+const int chunk_samples = chunk_quads + 1;
+const int skirt_first_vertex = chunk_samples * chunk_samples;
+
+const vec3 sun_direction = vec3(0.37139068f, 0.74278135f, 0.55708601f);
+const vec3 grass_colour = vec3(0.24f, 0.42f, 0.16f);
+const vec3 rock_colour = vec3(0.45f, 0.40f, 0.36f);
+const vec3 snow_colour = vec3(0.92f, 0.93f, 0.95f);
+
+void main()
+{
+	// The grid row by row, then one row of skirt vertices per edge.
+	ivec2 grid;
+	bool skirt = gl_VertexIndex >= skirt_first_vertex;
+	if (skirt)
+	{
+		int edge = (gl_VertexIndex - skirt_first_vertex) / chunk_samples;
+		int t = gl_VertexIndex - skirt_first_vertex - edge * chunk_samples;
+		if (edge == 0)
+			grid = ivec2(t, 0);
+		else if (edge == 1)
+			grid = ivec2(t, chunk_quads);
+		else if (edge == 2)
+			grid = ivec2(0, t);
+		else
+			grid = ivec2(chunk_quads, t);
+	}
+	else
+	{
+		grid = ivec2(gl_VertexIndex % chunk_samples, gl_VertexIndex / chunk_samples);
+	}
+
+	float height = chunk_origin.z + vertex_height * chunk_origin.w;
+	if (skirt)
+		height -= chunk_scale.y;
+
+	vec3 world_pos = vec3(chunk_origin.x + float(grid.x) * chunk_scale.x,
+	                      height,
+	                      chunk_origin.y + float(grid.y) * chunk_scale.x);
+	gl_Position = frame.view_projection * vec4(world_pos, 1.0f);
+
+	vec3 normal = vec3(vertex_normal_xz.x,
+	                   sqrt(max(1.0f - dot(vertex_normal_xz, vertex_normal_xz), 0.0f)),
+	                   vertex_normal_xz.y);
+
+	// Rock on steep slopes, snow high up.
+	float slope = 1.0f - normal.y;
+	vec3 base_colour = mix(grass_colour, rock_colour, smoothstep(0.15f, 0.35f, slope));
+	float relative_height = (height - chunk_scale.w) / max(chunk_scale.z, 1e-6f);
+	base_colour = mix(base_colour, snow_colour, smoothstep(0.7f, 0.78f, relative_height) * (1.0f - smoothstep(0.3f, 0.5f, slope)));
+
+	float brightness = 0.25f + 0.75f * max(dot(normal, sun_direction), 0.0f);
+	color = vec4(base_colour * brightness, 1.0f);
+}
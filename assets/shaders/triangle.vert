@@ -4,29 +4,53 @@ layout(location = 0) in vec3 vertex_position;
 layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec3 vertex_colour;
 
-
-layout(std140, push_constant) uniform param_block 
+// Constants of the frame, see ShaderDataBlock.hpp.
+layout(std140, set = 0, binding = 0) uniform frame_block
 {
-	mat4 model;
 	mat4 view_projection;
-} params;
+	mat4 view;
+	mat4 projection;
+	vec4 camera_position;
+	vec4 light_position;
+	float time;
+} frame;
+
+// Model matrices of the frame's instances, each draw starts at its firstInstance.
+layout(std430, set = 0, binding = 1) readonly buffer transform_block
+{
+	mat4 models[];
+} transforms;
 
 layout(location = 0) out mediump vec4 color;
 
+// Shader features of the material, see ShaderFeatures.hpp.
+layout(constant_id = 0) const bool feature_vertex_colour = true;
+layout(constant_id = 1) const bool feature_two_sided_lighting = true;
+layout(constant_id = 2) const bool feature_unlit = false;
+
+// Has to match depth.vert exactly for the equal depth test after the depth prepass.
+invariant gl_Position;
+
 void main()
 {	
 
-    vec3 light_pos = vec3(-3.f, 3.f, -5.f);
-	vec3 world_light = (params.model * vec4(light_pos, 1.0f)).xyz; // use light pos
-	vec4 world_pos = params.model * vec4(vertex_position, 1.0f);
-	vec3 world_normal = (params.model * vec4(vertex_normal, 0.0f)).xyz;
+	mat4 instance_model = transforms.models[gl_InstanceIndex];
+	vec3 world_light = frame.light_position.xyz;
+	vec4 world_pos = instance_model * vec4(vertex_position, 1.0f);
+	vec3 world_normal = (instance_model * vec4(vertex_normal, 0.0f)).xyz;
 	
 	vec3 light_dir = world_light - world_pos.xyz;
 	float brightness = dot(light_dir, world_normal) / length(light_dir) / length(world_normal);
-	brightness = abs(brightness);
+	if (feature_two_sided_lighting)
+		brightness = abs(brightness);
+	else
+		brightness = max(brightness, 0.0f);
+	if (feature_unlit)
+		brightness = 1.0f;
 	
-    gl_Position = params.view_projection * world_pos;
-    vec3 col = vertex_colour * brightness;
+    gl_Position = frame.view_projection * world_pos;
+    vec3 base_colour = feature_vertex_colour ? vertex_colour : vec3(0.8f);
+    vec3 col = base_colour * brightness;
     color = vec4(col, 1.f);
 }
 
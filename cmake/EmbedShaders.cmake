@@ -0,0 +1,50 @@
+# Writes the SPIR-V files into a source file for EmbeddedShaders.hpp.
+# Run with cmake -P and the variables:
+#   OUTPUT_FILE  The source file to write.
+#   PATH_PREFIX  Prepended to the file names to form the asset paths.
+#   SPIRV_FILES  The SPIR-V files, separated by |.
+
+string(REPLACE "|" ";" SPIRV_FILES "${SPIRV_FILES}")
+get_filename_component(HEADER_DIR "${CMAKE_CURRENT_LIST_DIR}/../src/framework/rendering" ABSOLUTE)
+
+# CMake regular expressions have no repetition counts.
+set(LINE_PATTERN "")
+foreach(BYTE RANGE 15)
+    set(LINE_PATTERN "${LINE_PATTERN}0x[0-9a-f][0-9a-f],")
+endforeach()
+
+set(DATA "")
+set(ENTRIES "")
+set(INDEX 0)
+foreach(SPIRV_FILE ${SPIRV_FILES})
+    get_filename_component(SPIRV_NAME ${SPIRV_FILE} NAME)
+    file(READ ${SPIRV_FILE} HEX HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+    # Keep the lines short, 16 bytes each.
+    string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n    " BYTES "${BYTES}")
+    string(REGEX REPLACE "\n    $" "" BYTES "${BYTES}")
+
+    set(DATA "${DATA}const unsigned char shader${INDEX}[] = {\n    ${BYTES}\n};\n\n")
+    set(ENTRIES "${ENTRIES}    {\"${PATH_PREFIX}${SPIRV_NAME}\", shader${INDEX}, sizeof(shader${INDEX})},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+file(WRITE ${OUTPUT_FILE}
+"// Generated by cmake/EmbedShaders.cmake, do not edit.
+
+#include \"${HEADER_DIR}/EmbeddedShaders.hpp\"
+
+namespace Tobi
+{
+namespace
+{
+
+${DATA}} // namespace
+
+const EmbeddedShader embeddedShaders[] = {
+${ENTRIES}};
+
+const size_t embeddedShaderCount = ${INDEX};
+
+} // namespace Tobi
+")
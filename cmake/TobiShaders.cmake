@@ -0,0 +1,133 @@
+# Compiles the GLSL shaders to SPIR-V at build time.
+#
+# tobi_compile_shaders(<target> <source dir> <output dir> <output variable>
+#                      [COPY_TO <dir>...])
+#
+# Every .vert, .frag and .comp file in the source directory is compiled with
+# glslangValidator into <output dir>/<name>.spv. spirv-opt runs its
+# performance passes over the result when it is installed. The SPIR-V is also
+# copied into every COPY_TO directory, the asset directories executables in
+# the build tree load their shaders from. The custom target <target> builds
+# all of them, the list of SPIR-V files in the output directory is returned
+# in the output variable.
+#
+# glslangValidator is required, the GLSL is the only form of the shaders in
+# the repository.
+
+include(CMakeParseArguments)
+
+# The depfiles glslangValidator writes hold absolute paths, Ninja reads them
+# as they are.
+if(POLICY CMP0116)
+    cmake_policy(SET CMP0116 NEW)
+endif()
+
+set(TOBI_SHADERS_MODULE_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+find_program(GLSLANG_VALIDATOR glslangValidator HINTS "$ENV{VULKAN_SDK}/bin")
+find_program(SPIRV_OPT spirv-opt HINTS "$ENV{VULKAN_SDK}/bin")
+
+function(tobi_compile_shaders TARGET_NAME SOURCE_DIR OUTPUT_DIR OUTPUT_VARIABLE)
+    cmake_parse_arguments(ARG "" "" "COPY_TO" ${ARGN})
+
+    if(NOT GLSLANG_VALIDATOR)
+        message(FATAL_ERROR "glslangValidator was not found, install the Vulkan SDK or set VULKAN_SDK to compile the shaders")
+    endif()
+
+    if(NOT SPIRV_OPT)
+        message("Install spirv-opt to optimize the compiled shaders")
+    endif()
+
+    # Ninja reads depfiles since CMake 3.7, the minimum version, Makefile
+    # generators only since CMake 3.20.
+    set(USE_DEPFILE OFF)
+    if(CMAKE_GENERATOR MATCHES "Ninja" OR NOT CMAKE_VERSION VERSION_LESS 3.20)
+        set(USE_DEPFILE ON)
+    endif()
+
+    file(GLOB SHADER_SOURCES
+        "${SOURCE_DIR}/*.vert"
+        "${SOURCE_DIR}/*.frag"
+        "${SOURCE_DIR}/*.comp")
+
+    set(SPIRV_FILES "")
+    set(COPIED_FILES "")
+    foreach(SHADER_SOURCE ${SHADER_SOURCES})
+        get_filename_component(SHADER_NAME ${SHADER_SOURCE} NAME)
+        set(SPIRV_FILE "${OUTPUT_DIR}/${SHADER_NAME}.spv")
+
+        # glslangValidator writes the unoptimized module, which is the output
+        # its depfile names.
+        if(SPIRV_OPT)
+            set(GLSLANG_OUTPUT "${CMAKE_CURRENT_BINARY_DIR}/glsl/${SHADER_NAME}.spv")
+        else()
+            set(GLSLANG_OUTPUT ${SPIRV_FILE})
+        endif()
+
+        get_filename_component(GLSLANG_OUTPUT_DIR ${GLSLANG_OUTPUT} DIRECTORY)
+        set(DEPFILE_ARGS "")
+        set(GLSLANG_DEPFILE_ARGS "")
+        if(USE_DEPFILE)
+            set(DEPFILE_ARGS DEPFILE "${GLSLANG_OUTPUT}.d")
+            set(GLSLANG_DEPFILE_ARGS --depfile "${GLSLANG_OUTPUT}.d")
+        endif()
+
+        add_custom_command(
+            OUTPUT ${GLSLANG_OUTPUT}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${GLSLANG_OUTPUT_DIR}
+            COMMAND ${GLSLANG_VALIDATOR} -V --target-env vulkan1.0 -I${SOURCE_DIR}
+                    ${GLSLANG_DEPFILE_ARGS} -o ${GLSLANG_OUTPUT} ${SHADER_SOURCE}
+            MAIN_DEPENDENCY ${SHADER_SOURCE}
+            ${DEPFILE_ARGS}
+            COMMENT "Compiling shader ${SHADER_NAME}"
+            VERBATIM)
+
+        if(SPIRV_OPT)
+            # Specialization constants are kept, they are only set when the
+            # pipelines are created.
+            add_custom_command(
+                OUTPUT ${SPIRV_FILE}
+                COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTPUT_DIR}
+                COMMAND ${SPIRV_OPT} -O --target-env=vulkan1.0 -o ${SPIRV_FILE} ${GLSLANG_OUTPUT}
+                DEPENDS ${GLSLANG_OUTPUT}
+                COMMENT "Optimizing shader ${SHADER_NAME}"
+                VERBATIM)
+        endif()
+
+        list(APPEND SPIRV_FILES ${SPIRV_FILE})
+
+        foreach(COPY_DIR ${ARG_COPY_TO})
+            add_custom_command(
+                OUTPUT "${COPY_DIR}/${SHADER_NAME}.spv"
+                COMMAND ${CMAKE_COMMAND} -E make_directory ${COPY_DIR}
+                COMMAND ${CMAKE_COMMAND} -E copy ${SPIRV_FILE} ${COPY_DIR}
+                DEPENDS ${SPIRV_FILE}
+                COMMENT "Copying shader ${SHADER_NAME} to ${COPY_DIR}"
+                VERBATIM)
+            list(APPEND COPIED_FILES "${COPY_DIR}/${SHADER_NAME}.spv")
+        endforeach()
+    endforeach()
+
+    add_custom_target(${TARGET_NAME} ALL DEPENDS ${SPIRV_FILES} ${COPIED_FILES})
+    set(${OUTPUT_VARIABLE} ${SPIRV_FILES} PARENT_SCOPE)
+endfunction()
+
+# tobi_embed_shaders(<output file> <path prefix> <SPIR-V files>...)
+#
+# Generates a source file holding the SPIR-V files as arrays for
+# EmbeddedShaders.hpp, each registered under the path prefix followed by its
+# file name, the path it would be loaded from in the assets directory.
+function(tobi_embed_shaders OUTPUT_FILE PATH_PREFIX)
+    # Semicolons don't survive as part of a custom command argument.
+    string(REPLACE ";" "|" SPIRV_FILES "${ARGN}")
+    add_custom_command(
+        OUTPUT ${OUTPUT_FILE}
+        COMMAND ${CMAKE_COMMAND}
+                -DOUTPUT_FILE=${OUTPUT_FILE}
+                -DPATH_PREFIX=${PATH_PREFIX}
+                -DSPIRV_FILES=${SPIRV_FILES}
+                -P ${TOBI_SHADERS_MODULE_DIR}/EmbedShaders.cmake
+        DEPENDS ${ARGN} ${TOBI_SHADERS_MODULE_DIR}/EmbedShaders.cmake
+        COMMENT "Embedding shaders"
+        VERBATIM)
+endfunction()
@@ -14,11 +14,22 @@ namespace Tobi
 class ApplicationStart
 {
   public:
-    ApplicationStart()
+    ApplicationStart(const char *sceneFilename, uint32_t terrainSize)
     {
         context = IContext::create();
 
         context->initialize();
+
+        if (FAILED(context->loadScene(sceneFilename)))
+        {
+            LOGE("Failed to load scene %s\n", sceneFilename);
+        }
+
+        // Hills a few units below the camera, one sample per unit.
+        if (terrainSize && FAILED(context->generateTerrain(terrainSize, 1.f, 24.f, -18.f, 1)))
+        {
+            LOGE("Failed to generate a terrain of %ux%u samples\n", terrainSize, terrainSize);
+        }
     }
     ApplicationStart(const ApplicationStart &) = delete;
     ApplicationStart(ApplicationStart &&) = delete;
@@ -67,6 +78,36 @@ class ApplicationStart
             if (fpsReportTime >= 1.0)
             {
                 LOGI("FPS: %.3f\n", frameCount / fpsReportTime);
+
+                const auto &statistics = context->getFrameStatistics();
+                LOGI("Objects: %u visible of %u, %s culling: %.3f ms\n",
+                     statistics.visibleObjectCount,
+                     statistics.totalObjectCount,
+                     statistics.gpuCulling ? "GPU" : "frustum",
+                     statistics.frustumCullingTime * 1000.0);
+                LOGI("Occlusion: %u occluders, %u of %u tested objects hidden, raster: %.3f ms, test: %.3f ms\n",
+                     statistics.occluderCount,
+                     statistics.occludedObjectCount,
+                     statistics.occludeeCount,
+                     statistics.occlusionRasterizationTime * 1000.0,
+                     statistics.occlusionTestTime * 1000.0);
+                LOGI("Draw calls: %u, pipeline binds: %u, buffer binds: %u\n",
+                     statistics.drawCallCount,
+                     statistics.pipelineBindCount,
+                     statistics.bufferBindCount);
+                LOGI("Command recording: %.3f ms in %u secondary command buffers\n",
+                     statistics.commandRecordingTime * 1000.0,
+                     statistics.secondaryCommandBufferCount);
+                LOGI("Terrain chunks: %u visible, %u drawn, %u resident\n",
+                     statistics.terrainVisibleChunkCount,
+                     statistics.terrainDrawnChunkCount,
+                     statistics.terrainResidentChunkCount);
+                LOGI("Descriptor sets: %u written, %u reused\n",
+                     statistics.descriptorSetAllocationCount,
+                     statistics.descriptorSetReuseCount);
+                LOGI("Fragment shader invocations: %llu, depth prepass %s\n",
+                     static_cast<unsigned long long>(statistics.fragmentShaderInvocations),
+                     statistics.depthPrepass ? "on" : "off");
                 frameCount = 0;
                 fpsReportTime = 0.0;
                 startTime = endTime;
@@ -83,9 +124,14 @@ class ApplicationStart
 
 } // namespace Tobi
 
-int main()
+int main(int argc, char **argv)
 {
-    Tobi::ApplicationStart *applicationStart = new Tobi::ApplicationStart();
+    // Scenes are looked up in the assets directory, either form can be passed.
+    auto sceneFilename = argc > 1 ? argv[1] : "scenes/default.tscene";
+    // Samples along each side of a generated terrain, e.g. 16385. No terrain by default.
+    auto terrainSize = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 0u;
+
+    Tobi::ApplicationStart *applicationStart = new Tobi::ApplicationStart(sceneFilename, terrainSize);
 
     applicationStart->run();
 
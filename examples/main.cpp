@@ -3,7 +3,7 @@
 #include <iostream>
 
 
-int main(int argc, char** argv)
+int main()
 {
     tobi::Tobi t = tobi::createTobi();
     
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+
+#include <vector>
+
+#include "../src/framework/scene/SceneFile.hpp"
+
+namespace Tobi
+{
+
+/// @brief Converts a scene in either form into the binary form used for large scenes.
+static Result convertScene(const char *pInputPath, const char *pOutputPath)
+{
+    SceneReader reader;
+    auto result = reader.open(pInputPath);
+    if (FAILED(result))
+        return result;
+
+    std::vector<SceneObject> objects(reader.getObjectCount());
+    if (reader.readObjects(objects.data(), reader.getObjectCount()) != reader.getObjectCount())
+    {
+        LOGE("Failed to read the objects of %s\n", pInputPath);
+        return RESULT_ERROR_IO;
+    }
+
+    result = writeBinaryScene(pOutputPath, reader.getModels(), objects);
+    if (FAILED(result))
+        return result;
+
+    LOGI("Wrote %u models and %u objects to %s\n",
+         static_cast<uint32_t>(reader.getModels().size()),
+         reader.getObjectCount(),
+         pOutputPath);
+
+    return RESULT_SUCCESS;
+}
+
+} // namespace Tobi
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        LOGE("Usage: %s <input scene> <output binary scene>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return Tobi::convertScene(argv[1], argv[2]) == Tobi::RESULT_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
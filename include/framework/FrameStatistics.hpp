@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Tobi
+{
+
+/// @brief Counters and timings collected by the context for the last rendered frame.
+struct FrameStatistics
+{
+    /// Whether culling ran on the GPU. The visible object count then comes from
+    /// an earlier frame and no occlusion culling is done.
+    bool gpuCulling;
+
+    /// Number of objects considered for rendering.
+    uint32_t totalObjectCount;
+    /// Number of objects which passed frustum culling.
+    uint32_t visibleObjectCount;
+    /// Time spent on frustum culling, in seconds.
+    double frustumCullingTime;
+
+    /// Number of occluders rasterized into the CPU depth buffer, objects and terrain chunks.
+    uint32_t occluderCount;
+    /// Number of objects tested against the CPU depth buffer.
+    uint32_t occludeeCount;
+    /// Number of objects which passed frustum culling but were found to be occluded.
+    uint32_t occludedObjectCount;
+    /// Time spent rasterizing occluders, in seconds.
+    double occlusionRasterizationTime;
+    /// Time spent testing occludees against the depth buffer, in seconds.
+    double occlusionTestTime;
+
+    /// Number of instanced draw calls recorded, one per visible mesh.
+    uint32_t drawCallCount;
+    /// Number of pipeline binds recorded by the render queue.
+    uint32_t pipelineBindCount;
+    /// Number of vertex and index buffer binds recorded by the render queue.
+    uint32_t bufferBindCount;
+    /// Number of secondary command buffers recorded in parallel, 0 when recording inline.
+    uint32_t secondaryCommandBufferCount;
+    /// Time spent recording draw commands, in seconds.
+    double commandRecordingTime;
+    /// Number of descriptor sets allocated and written during the frame.
+    uint32_t descriptorSetAllocationCount;
+    /// Number of descriptor set requests answered with a set already written in the frame.
+    uint32_t descriptorSetReuseCount;
+
+    /// Number of terrain chunks inside the frustum, 0 without a terrain.
+    uint32_t terrainVisibleChunkCount;
+    /// Number of terrain chunks drawn, visible chunks still streaming in are not.
+    uint32_t terrainDrawnChunkCount;
+    /// Number of terrain chunks whose vertices are in GPU memory.
+    uint32_t terrainResidentChunkCount;
+
+    /// Whether the depth prepass ran before the main pass.
+    bool depthPrepass;
+    /// Fragment shader invocations of the frame, read back once the GPU has
+    /// finished it, so it lags a few frames. 0 when the device cannot count them.
+    uint64_t fragmentShaderInvocations;
+};
+
+} // namespace Tobi
@@ -4,6 +4,8 @@
 #include <vector>
 
 #include "Common.hpp"
+#include "FrameStatistics.hpp"
+#include "ShaderFeatures.hpp"
 #include "TobiStatus.hpp"
 
 namespace Tobi
@@ -25,11 +27,58 @@ class IContext
 
     virtual uint32_t loadModel(const char *filename) = 0;
 
+    /// @brief Loads a binary or text scene from the assets directory and adds its objects.
+    virtual Result loadScene(const char *filename) = 0;
+
+    /// @brief Replaces the terrain with a heightfield from the assets directory,
+    /// a raw file of width * depth unsigned 16-bit samples. The terrain is
+    /// centred on the world origin.
+    /// @param spacing Distance between samples in world units.
+    /// @param heightScale Height between the lowest and the highest sample value.
+    /// @param baseHeight Height of the lowest sample value.
+    virtual Result loadTerrain(const char *filename,
+                               uint32_t width,
+                               uint32_t depth,
+                               float spacing,
+                               float heightScale,
+                               float baseHeight) = 0;
+
+    /// @brief Replaces the terrain with a generated one of size x size samples,
+    /// placed like @ref loadTerrain. size - 1 has to be a power of two, 16385
+    /// for a terrain of 16k x 16k quads.
+    virtual Result generateTerrain(uint32_t size, float spacing, float heightScale, float baseHeight, uint32_t seed) = 0;
+
     virtual Result acquireNextImage(uint32_t &swapChainIndex) = 0;
 
     virtual double getCurrentTime() = 0;
 
     virtual TobiStatus getWindowStatus() = 0;
+
+    /// @brief Sets how many frames the CPU may record ahead of the GPU, 2 by default.
+    /// Independent of the number of swapchain images. Must be called before @ref initialize.
+    virtual Result setFramesInFlightCount(uint32_t count) = 0;
+
+    virtual const FrameStatistics &getFrameStatistics() const = 0;
+
+    /// @brief Turns the depth-only pass before the main pass on or off, off by default.
+    /// Pays off when many surfaces overlap. Also toggled with the P key.
+    virtual void setDepthPrepassEnabled(bool enabled) = 0;
+
+    /// @brief Moves culling to a compute shader, off by default. Ignored when
+    /// the device cannot run it. The GPU only does frustum and small object
+    /// culling, objects hidden behind occluders or terrain are still drawn
+    /// while it is on. Also toggled with the G key.
+    virtual void setGpuCullingEnabled(bool enabled) = 0;
+
+    /// @brief Creates a material drawing with the given variant of the shaders.
+    /// Materials with the same features share their pipeline.
+    /// @param shaderFeatures A combination of @ref ShaderFeature.
+    /// @returns The material, 0 is the default material.
+    virtual uint32_t createMaterial(uint32_t shaderFeatures) = 0;
+
+    /// @brief Draws all objects of a model with a material.
+    /// The pipeline of a variant is compiled when it is first drawn.
+    virtual void setModelMaterial(uint32_t model, uint32_t material) = 0;
 };
 
 } // namespace Tobi
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Tobi
+{
+
+/// @brief Optional features of the main shaders, combined into the variant key of a material.
+///
+/// Every feature is a boolean specialization constant whose constant_id is the
+/// index of its bit. The driver removes the branches of turned off features
+/// when it compiles the pipeline, so a variant costs nothing at runtime.
+enum ShaderFeature
+{
+    /// Shades with the vertex colours, with a plain grey otherwise.
+    SHADER_FEATURE_VERTEX_COLOUR = 1 << 0,
+    /// Lights back faces as if they faced the light.
+    SHADER_FEATURE_TWO_SIDED_LIGHTING = 1 << 1,
+    /// Skips lighting.
+    SHADER_FEATURE_UNLIT = 1 << 2
+};
+
+/// Number of specialization constants set from the variant key.
+static const uint32_t shaderFeatureCount = 3;
+
+/// The variant of the default material, which all models use until they are given another one.
+static const uint32_t defaultShaderFeatures = SHADER_FEATURE_VERTEX_COLOUR | SHADER_FEATURE_TWO_SIDED_LIGHTING;
+
+} // namespace Tobi
@@ -0,0 +1,157 @@
+#include "ComputeScheduler.hpp"
+
+#include "../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+ComputeScheduler::ComputeScheduler(std::shared_ptr<Platform> platform)
+    : platform(platform),
+      queue(platform->getComputeQueue()),
+      queueFamilyIndex(static_cast<uint32_t>(platform->getComputeQueueFamilyIndex())),
+      graphicsQueueFamilyIndex(static_cast<uint32_t>(platform->getGraphicsQueueFamilyIndex())),
+      commandManagers(std::vector<std::unique_ptr<CommandBufferManager>>()),
+      timeline(nullptr),
+      serial(0),
+      semaphores(std::vector<VkSemaphore>())
+{
+    LOGI("CONSTRUCTING ComputeScheduler\n");
+
+    if (platform->supportsTimelineSemaphores())
+        timeline = std::make_unique<TimelineSemaphore>(platform->getDevice());
+
+    LOGI("Compute work is submitted to the %s queue.\n", needsOwnershipTransfer() ? "compute" : "graphics");
+}
+
+ComputeScheduler::~ComputeScheduler()
+{
+    LOGI("DECONSTRUCTING ComputeScheduler\n");
+    destroySemaphores();
+}
+
+void ComputeScheduler::destroySemaphores()
+{
+    for (auto semaphore : semaphores)
+        vkDestroySemaphore(platform->getDevice(), semaphore, nullptr);
+    semaphores.clear();
+}
+
+void ComputeScheduler::setFrameCount(uint32_t frameCount)
+{
+    auto device = platform->getDevice();
+
+    commandManagers.clear();
+    destroySemaphores();
+
+    for (uint32_t i = 0; i < frameCount; i++)
+    {
+        commandManagers.emplace_back(
+            new CommandBufferManager(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, queueFamilyIndex));
+
+        if (!timeline)
+        {
+            VkSemaphore semaphore;
+            VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+            VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore));
+            semaphores.push_back(semaphore);
+        }
+    }
+}
+
+void ComputeScheduler::beginFrame(uint32_t frameIndex)
+{
+    commandManagers[frameIndex]->beginFrame();
+}
+
+VkCommandBuffer ComputeScheduler::requestCommandBuffer(uint32_t frameIndex)
+{
+    auto commandBuffer = commandManagers[frameIndex]->requestCommandBuffer();
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    return commandBuffer;
+}
+
+SemaphoreWait ComputeScheduler::submit(uint32_t frameIndex, VkCommandBuffer commandBuffer, VkPipelineStageFlags graphicsStage)
+{
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    SemaphoreWait wait = {};
+    wait.stage = graphicsStage;
+
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    if (timeline)
+    {
+        wait.semaphore = timeline->getSemaphore();
+        wait.value = ++serial;
+
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &wait.value;
+        submitInfo.pNext = &timelineInfo;
+    }
+    else
+    {
+        wait.semaphore = semaphores[frameIndex];
+        wait.value = 0;
+    }
+    submitInfo.pSignalSemaphores = &wait.semaphore;
+
+    // No fence, the graphics submission waiting on this one is tracked instead.
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    return wait;
+}
+
+void ComputeScheduler::recordOwnershipTransfer(VkCommandBuffer commandBuffer,
+                                               const VkBuffer *pBuffers,
+                                               uint32_t bufferCount,
+                                               uint32_t srcQueueFamilyIndex,
+                                               uint32_t dstQueueFamilyIndex,
+                                               bool release,
+                                               VkPipelineStageFlags stage,
+                                               VkAccessFlags access)
+{
+    if (bufferCount == 0)
+        return;
+
+    std::vector<VkBufferMemoryBarrier> barriers(bufferCount);
+    for (uint32_t i = 0; i < bufferCount; i++)
+    {
+        auto &barrier = barriers[i];
+        barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        // The release makes the writes available, the acquire makes them visible.
+        barrier.srcAccessMask = release ? access : 0;
+        barrier.dstAccessMask = release ? 0 : access;
+        barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+        barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+        barrier.buffer = pBuffers[i];
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+    }
+
+    // A semaphore or a host wait for the releasing submission orders the release
+    // before the acquire, so the acquire does not wait on any earlier stage.
+    VkPipelineStageFlags srcStage = stage;
+    VkPipelineStageFlags dstStage = stage;
+    if (release)
+        dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    else
+        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStage,
+                         dstStage,
+                         0,
+                         0, nullptr,
+                         bufferCount, barriers.data(),
+                         0, nullptr);
+}
+
+} // namespace Tobi
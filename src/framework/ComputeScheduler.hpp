@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "VkCommon.hpp"
+#include "CommandBufferManager.hpp"
+#include "TimelineSemaphore.hpp"
+
+namespace Tobi
+{
+class Platform;
+
+/// @brief A semaphore a queue submission has to wait on before the given stages.
+struct SemaphoreWait
+{
+    VkSemaphore semaphore;
+    /// Ignored for binary semaphores.
+    uint64_t value;
+    VkPipelineStageFlags stage;
+};
+
+/// @brief Submits compute work to the compute queue, so it overlaps with the
+/// graphics work of other frames.
+///
+/// When the device has a single queue family the work is submitted to the
+/// graphics queue instead, with the same semaphore dependencies, so callers do
+/// not need a separate path.
+/// Every submission has to be waited on by a graphics submission of the same
+/// frame, which is what keeps the command pools and semaphores safe to reuse.
+class ComputeScheduler
+{
+  public:
+    /// @brief Constructor
+    /// @param platform The platform, has to be initialized.
+    ComputeScheduler(std::shared_ptr<Platform> platform);
+
+    ComputeScheduler(const ComputeScheduler &) = delete;
+    ComputeScheduler(ComputeScheduler &&) = delete;
+    ComputeScheduler &operator=(const ComputeScheduler &) & = delete;
+    ComputeScheduler &operator=(ComputeScheduler &&) & = delete;
+
+    /// @brief Destructor
+    ~ComputeScheduler();
+
+    /// @brief Recreates the per frame command pools and semaphores. The GPU must be idle.
+    void setFrameCount(uint32_t frameCount);
+
+    /// @brief Recycles the command buffers of a frame. The frame's graphics
+    /// submission must have completed.
+    void beginFrame(uint32_t frameIndex);
+
+    /// @brief Requests a command buffer of the compute queue family, ready for recording.
+    VkCommandBuffer requestCommandBuffer(uint32_t frameIndex);
+
+    /// @brief Ends and submits a command buffer from @ref requestCommandBuffer.
+    /// @param graphicsStage The stages of the graphics work consuming the results.
+    /// @returns The wait to add to the graphics submission of this frame.
+    SemaphoreWait submit(uint32_t frameIndex, VkCommandBuffer commandBuffer, VkPipelineStageFlags graphicsStage);
+
+    /// @brief True when compute runs on another queue family than graphics.
+    /// Exclusive resources shared with graphics then need ownership transfers.
+    bool needsOwnershipTransfer() const { return queueFamilyIndex != graphicsQueueFamilyIndex; }
+
+    uint32_t getQueueFamilyIndex() const { return queueFamilyIndex; }
+
+    uint32_t getGraphicsQueueFamilyIndex() const { return graphicsQueueFamilyIndex; }
+
+    /// @brief Records barriers transferring the ownership of buffers between queue families.
+    /// The same call has to be recorded on the releasing queue and then on the acquiring queue.
+    /// @param release True on the queue giving up the buffers, false on the queue acquiring them.
+    /// @param stage The stages writing the buffers before the release, or reading them after the acquire.
+    /// @param access The accesses matching stage.
+    static void recordOwnershipTransfer(VkCommandBuffer commandBuffer,
+                                        const VkBuffer *pBuffers,
+                                        uint32_t bufferCount,
+                                        uint32_t srcQueueFamilyIndex,
+                                        uint32_t dstQueueFamilyIndex,
+                                        bool release,
+                                        VkPipelineStageFlags stage,
+                                        VkAccessFlags access);
+
+  private:
+    std::shared_ptr<Platform> platform;
+
+    VkQueue queue;
+    uint32_t queueFamilyIndex;
+    uint32_t graphicsQueueFamilyIndex;
+
+    std::vector<std::unique_ptr<CommandBufferManager>> commandManagers;
+
+    // Signaled by every submission when timeline semaphores are supported.
+    std::unique_ptr<TimelineSemaphore> timeline;
+    uint64_t serial;
+
+    // Binary semaphores, one per frame, used without timeline semaphores.
+    std::vector<VkSemaphore> semaphores;
+
+    void destroySemaphores();
+};
+
+} // namespace Tobi
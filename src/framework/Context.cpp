@@ -20,12 +20,24 @@
 
 #include "Context.hpp"
 
+#include <algorithm>
+
 #include "../platform/Platform.hpp"
 #include "PerFrame.hpp"
+#include "PipelineCache.hpp"
+#include "rendering/BindlessResources.hpp"
+#include "rendering/DescriptorAllocator.hpp"
+#include "rendering/ShaderWatcher.hpp"
+#include "TimelineSemaphore.hpp"
 #include "buffers/VertexBufferManager.hpp"
 #include "buffers/IndexBufferManager.hpp"
 #include "buffers/UniformBufferManager.hpp"
+#include "buffers/InstanceBufferManager.hpp"
+#include "buffers/StorageBufferManager.hpp"
 #include "model/Model.hpp"
+#include "jobs/JobSystem.hpp"
+#include "scene/SceneLoader.hpp"
+#include "terrain/Terrain.hpp"
 
 #include "../platform/AssetManager.hpp"
 
@@ -34,24 +46,112 @@
 namespace Tobi
 {
 
+// Number of frames the CPU may record ahead of the GPU unless configured otherwise.
+static const uint32_t defaultFramesInFlight = 2;
+
+// Fewer packets than this per thread are recorded inline into the primary command buffer.
+static const uint32_t minPacketsPerCommandBuffer = 256;
+
+static const char *pipelineCachePath = "pipeline_cache.bin";
+// Seconds between writes of the pipeline cache while running.
+static const double pipelineCacheSaveInterval = 30.0;
+
+// Passes of the render queue sort keys.
+static const uint32_t depthPrepassQueuePass = 0;
+static const uint32_t mainQueuePass = 1;
+
+// Set 0 of the graphics pipelines holds the frame constants and the transforms
+// of the frame's instances.
+static const uint32_t frameSetIndex = 0;
+static const uint32_t frameUniformBinding = 0;
+static const uint32_t transformBinding = 1;
+
+// Counted per frame by the statistics query, also by the secondary command
+// buffers recorded within it.
+static const VkQueryPipelineStatisticFlags statisticsQueryFlags = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+// World space position of the light.
+static const glm::vec4 lightPosition = glm::vec4(-3.f, 3.f, -5.f, 1.f);
+
+// Displacement kept per level of generated terrain.
+static const float terrainRoughness = 0.5f;
+
+// Occluders of the CPU occlusion culler while there is no terrain.
+static const std::vector<OccluderMesh> noOccluders;
+
 Context::Context()
     : platform(Platform::create()),
-      depthBufferFormat(VK_FORMAT_D16_UNORM),
       backBuffers(std::vector<BackBuffer>()),
-      renderPass(VK_NULL_HANDLE),
-      pipelineCache(VK_NULL_HANDLE),
-      pipeline(VK_NULL_HANDLE),
+      depthBufferFormat(VK_FORMAT_D16_UNORM),
+      renderGraph(std::make_unique<RenderGraph>(platform)),
+      depthPrepass(RenderGraph::invalidHandle),
+      mainPass(RenderGraph::invalidHandle),
+      backBufferImage(RenderGraph::invalidHandle),
+      pipelineCache(nullptr),
+      pipelineCacheSaveTime(0.0),
+      pipelineManager(nullptr),
+      shaderWatcher(nullptr),
+      descriptorAllocator(nullptr),
+      bindlessResources(nullptr),
       pipelineLayout(VK_NULL_HANDLE),
+      mainPipeline(PipelineManager::invalidHandle),
+      depthPrepassPipeline(PipelineManager::invalidHandle),
+      mainPipelineDesc({}),
+      terrainPipeline(PipelineManager::invalidHandle),
+      terrainPrepassPipeline(PipelineManager::invalidHandle),
+      materialFeatures(std::vector<uint32_t>(1, defaultShaderFeatures)),
+      materialPipelines(std::vector<uint32_t>()),
+      modelMaterials(std::vector<uint32_t>()),
+      depthPrepassEnabled(false),
+      depthPrepassAvailable(false),
+      depthPrepassKeyDown(false),
+      renderGraphDirty(false),
+      hizBuilder(std::make_unique<HiZBuilder>(platform)),
+      statisticsQueryPool(VK_NULL_HANDLE),
+      statisticsQueryIssued(std::vector<bool>()),
       perFrame(std::vector<std::unique_ptr<PerFrame>>()),
       vertexBufferManager(std::make_shared<VertexBufferManager>(platform)),
       indexBufferManager(std::make_shared<IndexBufferManager>(platform)),
       uniformBufferManager(std::make_shared<UniformBufferManager>(platform)),
-      swapChainIndex(0),
-      camera(nullptr),
-      keyStates(std::make_shared<KeyStates>()),
+      instanceBufferManager(std::make_shared<InstanceBufferManager>(platform)),
+      frameUniformBufferIds(std::vector<uint32_t>()),
+      instanceBufferIds(std::vector<uint32_t>()),
+      storageBufferManager(std::make_shared<StorageBufferManager>(platform)),
+      jobSystem(std::make_shared<JobSystem>(OS::getNumberOfCpuThreads() - 1)),
       modelManager(std::make_unique<ModelManager>(vertexBufferManager,
                                                   indexBufferManager)),
-      objectManager(std::make_unique<ObjectManager>())
+      objectManager(std::make_unique<ObjectManager>(jobSystem)),
+      terrain(nullptr),
+      releasedTerrainBufferIds(std::vector<uint32_t>()),
+      frustumCuller(std::make_unique<FrustumCuller>()),
+      occlusionCuller(std::make_unique<OcclusionCuller>(jobSystem)),
+      gpuCuller(std::make_unique<GpuCuller>(platform, storageBufferManager)),
+      computeScheduler(nullptr),
+      uploadScheduler(nullptr),
+      gpuCullingEnabled(false),
+      gpuCullingAvailable(false),
+      gpuCullingKeyDown(false),
+      visibleObjects(std::vector<uint32_t>()),
+      instanceBatches(std::vector<InstanceBatch>()),
+      meshInstanceCounts(std::vector<uint32_t>()),
+      renderQueue(std::make_unique<RenderQueue>()),
+      secondaryCommandBuffers(std::vector<VkCommandBuffer>()),
+      recordingStatistics(std::vector<RenderQueueStatistics>()),
+      depthPrepassStatistics({}),
+      frameDescriptorSet(VK_NULL_HANDLE),
+      frameRangeCount(0),
+      frameStatistics({}),
+      camera(nullptr),
+      keyStates(std::make_shared<KeyStates>()),
+      shaderDataBlock({}),
+      swapChainIndex(0),
+      framesInFlight(defaultFramesInFlight),
+      frameIndex(0),
+      graphicsTimeline(nullptr),
+      submissionSerial(0),
+      completedSerial(0),
+      pendingReleases(std::deque<PendingRelease>()),
+      graphicsWaits(std::vector<SemaphoreWait>())
 {
     LOGI("CONSTRUCTING Context\n");
     EventDispatchersStruct::keyPressDispatcher->Reg(keyStates);
@@ -67,16 +167,24 @@ Context::~Context()
 
     waitIdle();
 
+    // Cancels its uploads, so it goes before the upload scheduler.
+    terrain.reset();
+
     perFrame.clear();
 
     terminateBackBuffers();
 
-    if (pipelineCache)
-    {
-        auto device = platform->getDevice();
-        vkDestroyPipelineCache(device, pipelineCache, nullptr);
-        pipelineCache = VK_NULL_HANDLE;
-    }
+    // Waits for the pipelines still being compiled, they end up in the cache.
+    shaderWatcher.reset();
+    pipelineManager.reset();
+    descriptorAllocator.reset();
+    bindlessResources.reset();
+
+    // Saves the pipelines created during the run.
+    pipelineCache.reset();
+
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(platform->getDevice(), statisticsQueryPool, nullptr);
 }
 
 void Context::terminateBackBuffers()
@@ -91,21 +199,16 @@ void Context::terminateBackBuffers()
         vkQueueWaitIdle(platform->getGraphicsQueue());
         for (auto &backBuffer : backBuffers)
         {
-            vkDestroyFramebuffer(device, backBuffer.frameBuffer, nullptr);
             vkDestroyImageView(device, backBuffer.view, nullptr);
+            vkDestroySemaphore(device, backBuffer.releaseSemaphore, nullptr);
         }
         backBuffers.clear();
 
-        vkDestroyRenderPass(device, renderPass, nullptr);
-        vkDestroyPipeline(device, pipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        renderPass = VK_NULL_HANDLE;
-        pipeline = VK_NULL_HANDLE;
-        pipelineLayout = VK_NULL_HANDLE;
-
-        vkDestroyImageView(device, depthBufferView, nullptr);
-        vkDestroyImage(device, depthBufferImage, nullptr);
-        vkFreeMemory(device, depthBufferMemory, nullptr);
+        // Destroys the depth buffer and framebuffers. The render passes are
+        // cached by the graph and the pipelines are kept, a resize only
+        // recreates what depends on the size.
+        hizBuilder->releaseImages();
+        renderGraph->reset(0, 0);
     }
 }
 
@@ -124,6 +227,16 @@ Result Context::initialize()
         return RESULT_ERROR_GENERIC;
     }
 
+    if (platform->supportsTimelineSemaphores())
+        graphicsTimeline = std::make_unique<TimelineSemaphore>(platform->getDevice());
+
+    computeScheduler = std::make_unique<ComputeScheduler>(platform);
+    gpuCuller->setQueueFamilies(computeScheduler->getQueueFamilyIndex(),
+                                computeScheduler->getGraphicsQueueFamilyIndex());
+
+    uploadScheduler = std::make_shared<UploadScheduler>(platform);
+    modelManager->setUploadScheduler(uploadScheduler);
+
     // attach context to the platform ?? does it need the context in any way?
 
     if (FAILED(onPlatformUpdate()))
@@ -132,19 +245,29 @@ Result Context::initialize()
         return RESULT_ERROR_GENERIC;
     }
 
+    // Both decide which passes the render graph has.
+    auto depthShaderModule = PipelineManager::loadShaderModule(platform->getDevice(), "shaders/depth.vert.spv");
+    depthPrepassAvailable = depthShaderModule != VK_NULL_HANDLE;
+    if (depthShaderModule != VK_NULL_HANDLE)
+        vkDestroyShaderModule(platform->getDevice(), depthShaderModule, nullptr);
+
+    auto hizShaderModule = PipelineManager::loadShaderModule(platform->getDevice(), "shaders/hiz.comp.spv");
+    hizBuilder->initialize(hizShaderModule, pipelineCache->getCache());
+    if (hizShaderModule != VK_NULL_HANDLE)
+        vkDestroyShaderModule(platform->getDevice(), hizShaderModule, nullptr);
+
     updateSwapChain();
 
-    camera = std::make_shared<Camera>(platform->getSwapChainDimensions());
+    auto cullShaderModule = PipelineManager::loadShaderModule(platform->getDevice(), "shaders/cull.comp.spv");
+    gpuCullingAvailable = SUCCEEDED(gpuCuller->initialize(cullShaderModule, pipelineCache->getCache()));
+    if (cullShaderModule != VK_NULL_HANDLE)
+        vkDestroyShaderModule(platform->getDevice(), cullShaderModule, nullptr);
+    gpuCuller->setFrameCount(static_cast<uint32_t>(perFrame.size()));
+    LOGI("GPU culling %s\n", gpuCullingAvailable ? "available, toggled with G" : "not supported");
 
-    auto triangleModelId = loadModel("triangle");
-    auto cubeModelId = loadModel("cube");
-    auto spiderModelId = loadModel("assets/models/spider.fbx");
-    auto cube2ModelId = loadModel("assets/models/BindPose.fbx");
+    camera = std::make_shared<Camera>(platform->getSwapChainDimensions());
 
-    triangleId = objectManager->addObject(triangleModelId, {0, 1, 0}, {0, 0, 0}, {1.5, 1.5, 1.5});
-    cubeId = objectManager->addObject(cubeModelId, {1, 0, 0}, {0, 0, 0}, {0.5, 0.5, 0.5});
-    spiderId = objectManager->addObject(spiderModelId, {1.0, 1.0, -5}, {0, M_PI, 0}, {0.0001f, 0.0001f, 0.0001f});
-    cube2Id = objectManager->addObject(cube2ModelId, {0.0, -0.5, 2.5}, {0, M_PI, 0}, {0.1f, 0.1f, 0.1f});
+    shaderWatcher = std::make_unique<ShaderWatcher>(jobSystem, "shaders");
 
     LOGI("FINISHED INITIALIZING Context\n");
     return RESULT_SUCCESS;
@@ -155,7 +278,7 @@ Result Context::initialize()
 /// @returns FenceManager
 std::shared_ptr<FenceManager> &Context::getFenceManager()
 {
-    return perFrame[swapChainIndex]->fenceManager;
+    return perFrame[frameIndex]->fenceManager;
 }
 
 /// @brief Gets the acquire semaphore for the swapchain.
@@ -163,7 +286,7 @@ std::shared_ptr<FenceManager> &Context::getFenceManager()
 /// @returns Semaphore.
 const VkSemaphore &Context::getSwapChainAcquireSemaphore() const
 {
-    return perFrame[swapChainIndex]->swapchainAcquireSemaphore;
+    return perFrame[frameIndex]->swapchainAcquireSemaphore;
 }
 
 /// @brief Gets the release semaphore for the swapchain.
@@ -171,7 +294,7 @@ const VkSemaphore &Context::getSwapChainAcquireSemaphore() const
 /// @returns Semaphore.
 const VkSemaphore &Context::getSwapChainReleaseSemaphore() const
 {
-    return perFrame[swapChainIndex]->swapchainReleaseSemaphore;
+    return backBuffers[swapChainIndex].releaseSemaphore;
 }
 
 void Context::submit(VkCommandBuffer cmd)
@@ -181,38 +304,74 @@ void Context::submit(VkCommandBuffer cmd)
 
 void Context::submitSwapChain(VkCommandBuffer cmd)
 {
-    // For the first frames, we will create a release semaphore.
-    // This can be reused every frame. Semaphores are reset when they have been
-    // successfully been waited on.
-    // If we aren't using acquire semaphores, we aren't using release semaphores
-    // either.
-    if (getSwapChainReleaseSemaphore() == VK_NULL_HANDLE && getSwapChainAcquireSemaphore() != VK_NULL_HANDLE)
-    {
-        VkSemaphore releaseSemaphore;
-        VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-        VK_CHECK(vkCreateSemaphore(platform->getDevice(), &semaphoreInfo, nullptr, &releaseSemaphore));
-        perFrame[swapChainIndex]->setSwapchainReleaseSemaphore(releaseSemaphore);
-    }
-
+    // The release semaphore belongs to the swapchain image, the presentation
+    // engine has waited on it once the image has been acquired again.
     submitCommandBuffer(cmd, getSwapChainAcquireSemaphore(), getSwapChainReleaseSemaphore());
 }
 
 void Context::submitCommandBuffer(VkCommandBuffer cmd, VkSemaphore acquireSemaphore, VkSemaphore releaseSemaphore)
 {
-    // All queue submissions get a fence that CPU will wait
-    // on for synchronization purposes.
-    VkFence fence = getFenceManager()->requestClearedFence();
+    auto serial = ++submissionSerial;
+    perFrame[frameIndex]->submittedSerial = serial;
 
     VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &cmd;
 
-    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    submitInfo.waitSemaphoreCount = acquireSemaphore != VK_NULL_HANDLE ? 1 : 0;
-    submitInfo.pWaitSemaphores = &acquireSemaphore;
-    submitInfo.pWaitDstStageMask = &waitStage;
-    submitInfo.signalSemaphoreCount = releaseSemaphore != VK_NULL_HANDLE ? 1 : 0;
-    submitInfo.pSignalSemaphores = &releaseSemaphore;
+    // The swapchain image followed by the work of other queues this submission depends on.
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    if (acquireSemaphore != VK_NULL_HANDLE)
+    {
+        waitSemaphores.push_back(acquireSemaphore);
+        waitValues.push_back(0);
+        waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+    for (const auto &wait : graphicsWaits)
+    {
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStages.push_back(wait.stage);
+    }
+    graphicsWaits.clear();
+
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+
+    VkSemaphore signalSemaphores[2];
+    uint64_t signalValues[2];
+    uint32_t signalSemaphoreCount = 0;
+    if (releaseSemaphore != VK_NULL_HANDLE)
+    {
+        signalSemaphores[signalSemaphoreCount] = releaseSemaphore;
+        signalValues[signalSemaphoreCount++] = 0;
+    }
+
+    VkFence fence = VK_NULL_HANDLE;
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    if (graphicsTimeline)
+    {
+        // Values of binary semaphores are ignored, the timeline is signaled with the serial.
+        signalSemaphores[signalSemaphoreCount] = graphicsTimeline->getSemaphore();
+        signalValues[signalSemaphoreCount++] = serial;
+
+        timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = signalSemaphoreCount;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+    }
+    else
+    {
+        // All queue submissions get a fence that CPU will wait
+        // on for synchronization purposes.
+        fence = getFenceManager()->requestClearedFence();
+    }
+
+    submitInfo.signalSemaphoreCount = signalSemaphoreCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
 
     VK_CHECK(vkQueueSubmit(platform->getGraphicsQueue(), 1, &submitInfo, fence));
 }
@@ -230,9 +389,67 @@ uint32_t Context::loadModel(const char *filename)
     return modelId;
 }
 
+Result Context::loadScene(const char *filename)
+{
+    LOGI("LOADING scene %s\n", filename);
+
+    SceneLoader loader(*modelManager, *objectManager);
+    return loader.load(OS::getAssetManager().getAssetPath(filename).c_str());
+}
+
+Result Context::loadTerrain(const char *filename,
+                             uint32_t width,
+                             uint32_t depth,
+                             float spacing,
+                             float heightScale,
+                             float baseHeight)
+{
+    LOGI("LOADING terrain %s\n", filename);
+
+    auto heightfield = std::make_unique<Heightfield>(width, depth, spacing, heightScale);
+    auto result = heightfield->loadRaw(OS::getAssetManager().getAssetPath(filename).c_str());
+    if (FAILED(result))
+        return result;
+
+    setTerrain(std::move(heightfield), baseHeight);
+    return RESULT_SUCCESS;
+}
+
+Result Context::generateTerrain(uint32_t size, float spacing, float heightScale, float baseHeight, uint32_t seed)
+{
+    LOGI("GENERATING terrain of %ux%u samples\n", size, size);
+
+    auto startTime = OS::getCurrentTime();
+    auto heightfield = std::make_unique<Heightfield>(size, size, spacing, heightScale);
+    auto result = heightfield->generate(seed, terrainRoughness, *jobSystem);
+    if (FAILED(result))
+        return result;
+    LOGI("Generated the heightfield in %.2f ms.\n", (OS::getCurrentTime() - startTime) * 1000.0);
+
+    setTerrain(std::move(heightfield), baseHeight);
+    return RESULT_SUCCESS;
+}
+
+void Context::setTerrain(std::unique_ptr<Heightfield> heightfield, float baseHeight)
+{
+    // Frames in flight may still draw the old chunks.
+    waitIdle();
+    terrain.reset();
+
+    glm::vec3 origin(-0.5f * (heightfield->getWidth() - 1) * heightfield->getSpacing(),
+                     baseHeight,
+                     -0.5f * (heightfield->getDepth() - 1) * heightfield->getSpacing());
+    terrain = std::make_unique<Terrain>(std::move(heightfield),
+                                        origin,
+                                        vertexBufferManager,
+                                        indexBufferManager,
+                                        uploadScheduler,
+                                        jobSystem);
+}
+
 const VkCommandBuffer &Context::requestPrimaryCommandBuffer() const
 {
-    return perFrame[swapChainIndex]->commandManager->requestCommandBuffer();
+    return perFrame[frameIndex]->commandManager->requestCommandBuffer();
 }
 
 const SwapChainDimensions &Context::getSwapChainDimensions() const
@@ -242,6 +459,12 @@ const SwapChainDimensions &Context::getSwapChainDimensions() const
 
 Result Context::acquireNextImage(uint32_t &swapChainIndex)
 {
+    // Move on to the next slot of the frame ring and wait for the GPU to finish
+    // the frame which used it last, independent of which image the presentation
+    // engine hands out.
+    frameIndex = (frameIndex + 1) % framesInFlight;
+    waitForFrame(*perFrame[frameIndex]);
+
     VkSemaphore acquireSemaphore = VK_NULL_HANDLE;
     auto result = platform->acquireNextImage(swapChainIndex, acquireSemaphore);
 
@@ -254,8 +477,6 @@ Result Context::acquireNextImage(uint32_t &swapChainIndex)
     if (SUCCEEDED(result))
     {
         // Signal the underlying context that we're using this backbuffer now.
-        // This will also wait for all fences associated with this swapchain image
-        // to complete first.
         // When submitting command buffer that writes to swapchain, we need to wait
         // for this semaphore first.
         // Also, delete the older semaphore.
@@ -276,8 +497,25 @@ Result Context::acquireNextImage(uint32_t &swapChainIndex)
 VkSemaphore Context::beginFrame(uint32_t index, VkSemaphore acquireSemaphore)
 {
     swapChainIndex = index;
-    perFrame[swapChainIndex]->beginFrame();
-    return perFrame[swapChainIndex]->setSwapchainAcquireSemaphore(acquireSemaphore);
+    return perFrame[frameIndex]->setSwapchainAcquireSemaphore(acquireSemaphore);
+}
+
+Result Context::setFramesInFlightCount(uint32_t count)
+{
+    if (!perFrame.empty())
+    {
+        LOGE("The number of frames in flight has to be set before initializing the context.\n");
+        return RESULT_ERROR_GENERIC;
+    }
+
+    if (count == 0)
+    {
+        LOGE("At least one frame has to be in flight.\n");
+        return RESULT_ERROR_GENERIC;
+    }
+
+    framesInFlight = count;
+    return RESULT_SUCCESS;
 }
 
 TobiStatus Context::getWindowStatus()
@@ -292,20 +530,87 @@ Result Context::onPlatformUpdate()
     waitIdle();
 
     // Initialize per-frame resources.
-    // Every swapchain image has its own command pool and fence manager.
+    // Every frame in flight has its own command pool and fence manager.
     // This makes it very easy to keep track of when we can reset command buffers
-    // and such.
+    // and such. Resources tied to a swapchain image live in the back buffers.
     perFrame.clear();
-    for (uint32_t i = 0; i < platform->getSwapChainImageCount(); i++)
+    frameIndex = 0;
+    for (uint32_t i = 0; i < framesInFlight; i++)
     {
         perFrame.emplace_back(new PerFrame(device, platform->getGraphicsQueueFamilyIndex()));
     }
 
-    /* setRenderingThreadCount(renderingThreadCount); */
+    // The instance buffers follow the per-frame data and are created on first use.
+    for (auto id : instanceBufferIds)
+    {
+        if (id)
+            instanceBufferManager->destroyBuffer(id);
+    }
+    instanceBufferIds.assign(perFrame.size(), 0);
+
+    for (auto id : frameUniformBufferIds)
+        uniformBufferManager->destroyBuffer(id);
+    frameUniformBufferIds.clear();
+    for (uint32_t i = 0; i < perFrame.size(); i++)
+        frameUniformBufferIds.push_back(uniformBufferManager->createBuffer(nullptr, sizeof(ShaderDataBlock)));
+    gpuCuller->setFrameCount(static_cast<uint32_t>(perFrame.size()));
+    if (computeScheduler)
+        computeScheduler->setFrameCount(static_cast<uint32_t>(perFrame.size()));
+
+    // Descriptor sets written during a frame live in the pools of its frame in flight.
+    descriptorAllocator = std::make_unique<DescriptorAllocator>(device);
+    descriptorAllocator->setFrameCount(static_cast<uint32_t>(perFrame.size()));
+
+    // One secondary command manager per thread taking part in recording.
+    for (auto &frame : perFrame)
+    {
+        frame->setSecondaryCommandManagersCount(jobSystem->getWorkerCount() + 1);
+    }
 
-    // Create a pipeline cache (although we'll only create one pipeline).
-    VkPipelineCacheCreateInfo pipelineCacheInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
-    VK_CHECK(vkCreatePipelineCache(device, &pipelineCacheInfo, nullptr, &pipelineCache));
+    // Fragment shader invocations are counted per frame in flight.
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(device, statisticsQueryPool, nullptr);
+        statisticsQueryPool = VK_NULL_HANDLE;
+    }
+    if (platform->getEnabledFeatures().pipelineStatisticsQuery)
+    {
+        VkQueryPoolCreateInfo queryPoolInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        queryPoolInfo.queryCount = framesInFlight;
+        queryPoolInfo.pipelineStatistics = statisticsQueryFlags;
+        VK_CHECK(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statisticsQueryPool));
+    }
+    statisticsQueryIssued.assign(framesInFlight, false);
+
+    // Pipelines compiled by earlier runs are loaded from disk.
+    pipelineCache = std::make_unique<PipelineCache>(platform, pipelineCachePath);
+    pipelineCacheSaveTime = OS::getCurrentTime();
+
+    pipelineManager = std::make_unique<PipelineManager>(platform, jobSystem, pipelineCache->getCache());
+
+    // All graphics pipelines get the whole frame set, also those whose shaders
+    // only read part of it, so the set stays bound when the pipeline changes.
+    std::vector<VkDescriptorSetLayoutBinding> frameBindings(2);
+    frameBindings[0].binding = frameUniformBinding;
+    frameBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    frameBindings[0].descriptorCount = 1;
+    frameBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    frameBindings[1].binding = transformBinding;
+    frameBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    frameBindings[1].descriptorCount = 1;
+    frameBindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    auto &layoutCache = pipelineManager->getLayoutCache();
+    layoutCache.setExternalSetLayout(frameSetIndex, layoutCache.getDescriptorSetLayout(frameBindings));
+
+    // Textures and storage buffers are selected by slot in the draws, the
+    // shaders declaring them get the update after bind layout.
+    if (platform->supportsDescriptorIndexing())
+    {
+        if (!bindlessResources)
+            bindlessResources = std::make_unique<BindlessResources>(platform);
+        layoutCache.setExternalSetLayout(BindlessResources::setIndex, bindlessResources->getDescriptorSetLayout());
+    }
 
     return RESULT_SUCCESS;
 }
@@ -313,6 +618,7 @@ Result Context::onPlatformUpdate()
 void Context::updateSwapChain()
 {
     LOGI("UPDATING swap chain\n");
+    auto startTime = OS::getCurrentTime();
     auto dimensions = platform->getSwapChainDimensions();
     auto newBackBufferImages = platform->getSwapChainImages();
     auto device = platform->getDevice();
@@ -320,12 +626,12 @@ void Context::updateSwapChain()
     // In case we're reinitializing the swapchain, terminate the old one first.
     terminateBackBuffers();
 
-    initDepthBuffer(dimensions.width, dimensions.height);
-
-    // We can't initialize the renderpass until we know the swapchain format.
-    initRenderPass(dimensions.format);
-    // We can't initialize the pipeline until we know the render pass.
+    // We can't initialize the render passes until we know the swapchain format.
+    initRenderGraph(dimensions);
 
+    // Viewport and scissor are dynamic, so the pipelines only depend on the
+    // render pass. It is the same one unless the swapchain format changed, and
+    // the pipelines are found in the pipeline manager.
     initPipeline();
 
     // For all backbuffers in the swapchain ...
@@ -349,316 +655,386 @@ void Context::updateSwapChain()
         view.components.b = VK_COMPONENT_SWIZZLE_B;
         view.components.a = VK_COMPONENT_SWIZZLE_A;
 
+        // The render graph creates the framebuffers when the image is first rendered to.
         VK_CHECK(vkCreateImageView(device, &view, nullptr, &backBuffer.view));
 
-        // Build the framebuffer.
-        VkImageView attachments[2] = {backBuffer.view, depthBufferView};
-        VkFramebufferCreateInfo fbInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
-        fbInfo.renderPass = renderPass;
-        fbInfo.attachmentCount = 2;
-        fbInfo.pAttachments = attachments;
-        fbInfo.width = dimensions.width;
-        fbInfo.height = dimensions.height;
-        fbInfo.layers = 1;
-
-        VK_CHECK(vkCreateFramebuffer(device, &fbInfo, nullptr, &backBuffer.frameBuffer));
+        VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &backBuffer.releaseSemaphore));
 
         backBuffers.push_back(backBuffer);
     }
+
+    LOGI("Swap chain updated in %.2f ms\n", (OS::getCurrentTime() - startTime) * 1000.0);
 }
 
-void Context::initDepthBuffer(uint32_t width, uint32_t height)
+double Context::getCurrentTime()
 {
-    VkDevice device = platform->getDevice();
+    return OS::getCurrentTime();
+}
 
+void Context::initRenderGraph(const SwapChainDimensions &dimensions)
+{
     if (!platform->getSupportedDepthFormat(&depthBufferFormat))
     {
         LOGE("Could not find supported depth format!");
         throw std::runtime_error("Could not find supported depth format!");
     }
 
-    // Create the image for the depth buffer. Note that imageInfo.usage includes the
-    // VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT flag. This flag allows lazy allocation of the depth buffer.
-    // For Mali GPU this flag will allow the driver to never allocate memory for the depth buffer and use the
-    // on-chip tile buffer instead.
-    VkImageCreateInfo imageInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.format = depthBufferFormat;
-    imageInfo.extent.width = width;
-    imageInfo.extent.height = height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-    VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &depthBufferImage));
-
-    // Allocate memory for the depth image. Prefer a memory type with lazily allocation support.
-    VkMemoryRequirements memoryRequirements = {0};
-    vkGetImageMemoryRequirements(device, depthBufferImage, &memoryRequirements);
-    uint32_t memoryTypeIndex = platform->findMemoryTypeFromRequirementsWithFallback(memoryRequirements.memoryTypeBits,
-                                                                                    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
-
-    VkMemoryAllocateInfo memInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    memInfo.allocationSize = memoryRequirements.size;
-    memInfo.memoryTypeIndex = memoryTypeIndex;
-
-    VK_CHECK(vkAllocateMemory(device, &memInfo, nullptr, &depthBufferMemory));
-    VK_CHECK(vkBindImageMemory(device, depthBufferImage, depthBufferMemory, 0));
-
-    // Create the depth buffer image.
-    VkImageViewCreateInfo viewInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
-    viewInfo.image = depthBufferImage;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = depthBufferFormat;
-    viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
-    viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
-    viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
-    viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &depthBufferView));
+    if (depthPrepassEnabled && !depthPrepassAvailable)
+    {
+        LOGW("The depth prepass shader is not available, the depth prepass stays off.\n");
+        depthPrepassEnabled = false;
+    }
+
+    hizBuilder->releaseImages();
+    renderGraph->reset(dimensions.width, dimensions.height);
+
+    // The image is acquired before rendering starts, the submission waits for
+    // it at the color attachment stage.
+    backBufferImage = renderGraph->importImage("backbuffer",
+                                               dimensions.format,
+                                               dimensions.width,
+                                               dimensions.height,
+                                               VK_IMAGE_LAYOUT_UNDEFINED,
+                                               VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                               VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    renderGraph->markOutput(backBufferImage);
+
+    VkClearValue colorClearValue = {};
+    colorClearValue.color.float32[0] = 0.1f;
+    colorClearValue.color.float32[1] = 0.1f;
+    colorClearValue.color.float32[2] = 0.2f;
+    colorClearValue.color.float32[3] = 1.0f;
+    renderGraph->setClearValue(backBufferImage, colorClearValue);
+
+    // When only used inside one render pass, the graph keeps it in lazily
+    // allocated memory where available and never stores it. For Mali GPUs this
+    // means the depth buffer lives in the on-chip tile buffer.
+    auto depthImage = renderGraph->createImage("depth", {depthBufferFormat, 0, 0, 1, 0});
+
+    VkClearValue depthClearValue = {};
+    depthClearValue.depthStencil.depth = 1.0f;
+    renderGraph->setClearValue(depthImage, depthClearValue);
+
+    // The prepass lays down the depth, the main pass then only shades the
+    // visible surface. Both end up as subpasses of one render pass.
+    depthPrepass = RenderGraph::invalidHandle;
+    if (depthPrepassEnabled)
+    {
+        depthPrepass = renderGraph->addPass("depth prepass", false, [this](VkCommandBuffer cmd, const RenderGraphPassContext &) {
+            recordDepthPrepass(cmd);
+        });
+        renderGraph->use(depthPrepass, depthImage, RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT);
+    }
+
+    mainPass = renderGraph->addPass("main", false, [this](VkCommandBuffer cmd, const RenderGraphPassContext &) {
+        recordMainPass(cmd);
+    });
+    renderGraph->setPrepareFunction(mainPass, [this](const RenderGraphPassContext &context) {
+        return prepareMainPass(context);
+    });
+    renderGraph->use(mainPass, backBufferImage, RENDER_GRAPH_USAGE_COLOR_ATTACHMENT);
+    renderGraph->use(mainPass,
+                     depthImage,
+                     depthPrepassEnabled ? RENDER_GRAPH_USAGE_DEPTH_READ : RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT);
+
+    // Nothing samples the pyramid yet, so it is not an output and the graph
+    // culls the pass. A culler reading it in the next frame has to mark it.
+    auto hizImage = RenderGraph::invalidHandle;
+    auto hizPass = RenderGraph::invalidHandle;
+    auto hizBaseExtent = HiZBuilder::getBaseExtent(dimensions.width, dimensions.height);
+    auto hizMipLevels = HiZBuilder::getMipLevelCount(hizBaseExtent);
+    if (hizBuilder->isInitialized())
+    {
+        hizImage = renderGraph->createImage("hiz", {HiZBuilder::format,
+                                                    hizBaseExtent.width,
+                                                    hizBaseExtent.height,
+                                                    hizMipLevels,
+                                                    VK_IMAGE_USAGE_SAMPLED_BIT});
+
+        hizPass = renderGraph->addPass("hiz", true, [this](VkCommandBuffer cmd, const RenderGraphPassContext &) {
+            hizBuilder->record(cmd);
+        });
+        renderGraph->use(hizPass, depthImage, RENDER_GRAPH_USAGE_SAMPLED_COMPUTE);
+        renderGraph->use(hizPass, hizImage, RENDER_GRAPH_USAGE_STORAGE_COMPUTE);
+    }
+
+    if (FAILED(renderGraph->compile()))
+    {
+        LOGE("Failed to compile the render graph.\n");
+        throw std::runtime_error("Failed to compile the render graph.");
+    }
+
+    if (hizPass != RenderGraph::invalidHandle && !renderGraph->isPassCulled(hizPass))
+    {
+        hizBuilder->setImages(renderGraph->getImageView(depthImage),
+                              {dimensions.width, dimensions.height},
+                              renderGraph->getImage(hizImage),
+                              renderGraph->getImageView(hizImage),
+                              hizBaseExtent,
+                              hizMipLevels);
+    }
+
+    LOGI("%s", renderGraph->dump().c_str());
 }
 
-double Context::getCurrentTime()
+void Context::initPipeline()
 {
-    return OS::getCurrentTime();
+    // After a depth prepass only the nearest surface passes, and the depth is already written.
+    auto prepass = depthPrepass != RenderGraph::invalidHandle;
+
+    PipelineDesc desc = {};
+    desc.vertexShader = "shaders/triangle.vert.spv";
+    desc.fragmentShader = "shaders/triangle.frag.spv";
+    desc.shaderFeatures = materialFeatures[0];
+    desc.vertexLayout = PIPELINE_VERTEX_LAYOUT_VERTEX;
+    desc.cullMode = VK_CULL_MODE_NONE;
+    desc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    desc.colorAttachmentCount = 1;
+    desc.blendEnable = false;
+    desc.depthTestEnable = true;
+    desc.depthWriteEnable = !prepass;
+    desc.depthCompareOp = prepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+    desc.renderPass = renderGraph->getRenderPass(mainPass);
+    desc.subpass = renderGraph->getSubpass(mainPass);
+
+    auto startTime = OS::getCurrentTime();
+    mainPipelineDesc = desc;
+    mainPipeline = pipelineManager->requestPipeline(desc);
+
+    // The other materials request theirs when they are drawn, so does the terrain.
+    materialPipelines.assign(materialFeatures.size(), PipelineManager::invalidHandle);
+    materialPipelines[0] = mainPipeline;
+    terrainPipeline = PipelineManager::invalidHandle;
+    terrainPrepassPipeline = PipelineManager::invalidHandle;
+
+    // The depth prepass reads the positions from their own buffer and has no
+    // fragment shader and no color attachment.
+    depthPrepassPipeline = PipelineManager::invalidHandle;
+    if (prepass)
+    {
+        desc.vertexShader = "shaders/depth.vert.spv";
+        desc.fragmentShader = nullptr;
+        desc.shaderFeatures = 0;
+        desc.vertexLayout = PIPELINE_VERTEX_LAYOUT_POSITION;
+        desc.colorAttachmentCount = 0;
+        desc.depthWriteEnable = true;
+        desc.depthCompareOp = VK_COMPARE_OP_LESS;
+        desc.renderPass = renderGraph->getRenderPass(depthPrepass);
+        desc.subpass = renderGraph->getSubpass(depthPrepass);
+        depthPrepassPipeline = pipelineManager->requestPipeline(desc);
+    }
+
+    // Nothing of the frame can be drawn without them, so the first frame of a
+    // new render graph waits. Both compile in parallel.
+    pipelineManager->wait(mainPipeline);
+    if (depthPrepassPipeline != PipelineManager::invalidHandle)
+        pipelineManager->wait(depthPrepassPipeline);
+
+    // The layout comes from the shaders, the depth prepass declares the same
+    // frame set and shares it.
+    pipelineLayout = pipelineManager->getPipelineLayout(mainPipeline);
+    if (pipelineLayout == VK_NULL_HANDLE)
+    {
+        LOGE("The main pipeline failed to compile.\n");
+        throw std::runtime_error("The main pipeline failed to compile.");
+    }
+
+    auto &layoutCache = pipelineManager->getLayoutCache();
+    if (layoutCache.getSetLayout(pipelineLayout, frameSetIndex) == VK_NULL_HANDLE)
+    {
+        LOGE("The main pipeline does not declare the frame set.\n");
+        throw std::runtime_error("The main pipeline does not declare the frame set.");
+    }
+
+    LOGI("Pipelines ready after %.2f ms, %s pipeline cache, %u pipeline layouts and %u set layouts.\n",
+         (OS::getCurrentTime() - startTime) * 1000.0,
+         pipelineCache->isWarm() ? "warm" : "cold",
+         layoutCache.getPipelineLayoutCount(),
+         layoutCache.getDescriptorSetLayoutCount());
+}
+
+uint32_t Context::getMaterialPipeline(uint32_t material)
+{
+    auto &handle = materialPipelines[material];
+    if (handle == PipelineManager::invalidHandle)
+    {
+        // Materials with the same features get the same pipeline from the manager.
+        auto desc = mainPipelineDesc;
+        desc.shaderFeatures = materialFeatures[material];
+        handle = pipelineManager->requestPipeline(desc, mainPipeline);
+    }
+
+    return handle;
 }
 
-void Context::initRenderPass(VkFormat format)
-{
-    std::array<VkAttachmentDescription, 2> attachments = {};
-    // Setup the color attachment.
-    attachments[0].format = format;
-    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    // Setup the depth attachment.
-    attachments[1].format = depthBufferFormat;
-    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference colorAttachmentRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-    VkAttachmentReference depthAttachmentRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
-
-    VkSubpassDescription subpassDescription = {0};
-    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpassDescription.colorAttachmentCount = 1;
-    subpassDescription.pColorAttachments = &colorAttachmentRef;
-    subpassDescription.pDepthStencilAttachment = &depthAttachmentRef;
-    subpassDescription.inputAttachmentCount = 0;
-    subpassDescription.pInputAttachments = nullptr;
-    subpassDescription.preserveAttachmentCount = 0;
-    subpassDescription.pPreserveAttachments = nullptr;
-    subpassDescription.pResolveAttachments = nullptr;
-
-    // Create a dependency to external events.
-    std::array<VkSubpassDependency, 2> dependencies;
-
-    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-    dependencies[1].srcSubpass = 0;
-    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-    // Finally, create the renderpass.
-    VkRenderPassCreateInfo renderPassInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
-    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpassDescription;
-    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
-    renderPassInfo.pDependencies = dependencies.data();
-
-    VK_CHECK(vkCreateRenderPass(platform->getDevice(), &renderPassInfo, nullptr, &renderPass));
+uint32_t Context::getModelMaterial(uint32_t model) const
+{
+    return model < modelMaterials.size() ? modelMaterials[model] : 0;
 }
 
-void Context::initPipeline()
+uint32_t Context::createMaterial(uint32_t shaderFeatures)
 {
-    auto device = platform->getDevice();
+    // The material has to fit into the sort key.
+    if (materialFeatures.size() >= (1u << RenderQueue::materialBits))
+    {
+        LOGE("Too many materials, using the default material.\n");
+        return 0;
+    }
+
+    materialFeatures.push_back(shaderFeatures);
+    materialPipelines.push_back(PipelineManager::invalidHandle);
+    return static_cast<uint32_t>(materialFeatures.size() - 1);
+}
+
+void Context::setModelMaterial(uint32_t model, uint32_t material)
+{
+    if (material >= materialFeatures.size())
+    {
+        LOGE("Material %u does not exist.\n", material);
+        return;
+    }
+
+    if (model >= modelMaterials.size())
+        modelMaterials.resize(model + 1, 0);
+    modelMaterials[model] = material;
+}
+
+void Context::rebuildRenderGraph()
+{
+    waitIdle();
+
+    initRenderGraph(getSwapChainDimensions());
+    initPipeline();
+}
+
+void Context::setDepthPrepassEnabled(bool enabled)
+{
+    if (enabled == depthPrepassEnabled)
+        return;
+
+    depthPrepassEnabled = enabled;
+    renderGraphDirty = true;
+    LOGI("Depth prepass %s\n", enabled ? "on" : "off");
+}
+
+void Context::setGpuCullingEnabled(bool enabled)
+{
+    if (enabled == gpuCullingEnabled)
+        return;
 
-    VkPushConstantRange pushConstantRange = {};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(ShaderDataBlock);
-
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-
-    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
-
-    // Specify we will use triangle lists to draw geometry.
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
-        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-    // Specify our two attributes, Position, Normal, and Color.
-    VkVertexInputAttributeDescription attributes[3] = {{0}};
-    attributes[0].location = 0; // Position in shader specifies layout(location =
-    // 0) to link with this attribute.
-    attributes[0].binding = 0; // Uses vertex buffer #0.
-    attributes[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    attributes[0].offset = 0;
-    attributes[1].location = 1; // Normal in shader specifies layout(location = 1)
-    // to link with this attribute.
-    attributes[1].binding = 0; // Uses vertex buffer #0.
-    attributes[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    attributes[1].offset = 3 * sizeof(float);
-    attributes[2].location = 2; // Color in shader specifies layout(location = 1)
-    // to link with this attribute.
-    attributes[2].binding = 0; // Uses vertex buffer #0.
-    attributes[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    attributes[2].offset = 6 * sizeof(float);
-
-    // We have one vertex buffer, with stride 12 floats (vec4 + vec4 + vec4).
-    VkVertexInputBindingDescription binding = {0};
-    binding.binding = 0;
-    binding.stride = sizeof(Vertex); // We specify the buffer stride up front here.
-    // The vertex buffer will step for every vertex (rather than per instance).
-    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    VkPipelineVertexInputStateCreateInfo vertexInput = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vertexInput.vertexBindingDescriptionCount = 1;
-    vertexInput.pVertexBindingDescriptions = &binding;
-    vertexInput.vertexAttributeDescriptionCount = 3;
-    vertexInput.pVertexAttributeDescriptions = attributes;
-
-    // Specify rasterization state.
-    VkPipelineRasterizationStateCreateInfo raster = {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
-    raster.polygonMode = VK_POLYGON_MODE_FILL;
-    raster.cullMode = VK_CULL_MODE_NONE;
-    raster.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    raster.depthClampEnable = false;
-    raster.rasterizerDiscardEnable = false;
-    raster.depthBiasEnable = false;
-    raster.lineWidth = 1.0f;
-
-    // Our attachment will write to all color channels, but no blending is
-    // enabled.
-    VkPipelineColorBlendAttachmentState blendAttachment = {0};
-    blendAttachment.blendEnable = false;
-    blendAttachment.colorWriteMask = 0xf;
-
-    VkPipelineColorBlendStateCreateInfo blend = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
-    blend.attachmentCount = 1;
-    blend.pAttachments = &blendAttachment;
-
-    // We will have one viewport and scissor box.
-    VkPipelineViewportStateCreateInfo viewport = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
-    viewport.viewportCount = 1;
-    viewport.scissorCount = 1;
-
-    // Disable all depth testing.
-    VkPipelineDepthStencilStateCreateInfo depthStencil = {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
-    depthStencil.depthTestEnable = true;
-    depthStencil.depthWriteEnable = true;
-    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-    depthStencil.depthBoundsTestEnable = false;
-    depthStencil.stencilTestEnable = false;
-
-    // No multisampling.
-    VkPipelineMultisampleStateCreateInfo multisample = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
-    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-    // Specify that these states will be dynamic, i.e. not part of pipeline state
-    // object.
-    static const VkDynamicState dynamics[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR,
-    };
-    VkPipelineDynamicStateCreateInfo dynamic = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
-    dynamic.pDynamicStates = dynamics;
-    dynamic.dynamicStateCount = sizeof(dynamics) / sizeof(dynamics[0]);
-
-    // Load our SPIR-V shaders.
-    VkPipelineShaderStageCreateInfo shaderStages[2] = {
-        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO},
-        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO},
-    };
-
-    // We have two pipeline stages, vertex and fragment.
-    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = loadShaderModule(device, "shaders/triangle.vert.spv");
-    shaderStages[0].pName = "main";
-    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = loadShaderModule(device, "shaders/triangle.frag.spv");
-    shaderStages[1].pName = "main";
-
-    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
-    graphicsPipelineCreateInfo.stageCount = 2;
-    graphicsPipelineCreateInfo.pStages = shaderStages;
-    graphicsPipelineCreateInfo.pVertexInputState = &vertexInput;
-    graphicsPipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-    graphicsPipelineCreateInfo.pRasterizationState = &raster;
-    graphicsPipelineCreateInfo.pColorBlendState = &blend;
-    graphicsPipelineCreateInfo.pMultisampleState = &multisample;
-    graphicsPipelineCreateInfo.pViewportState = &viewport;
-    graphicsPipelineCreateInfo.pDepthStencilState = &depthStencil;
-    graphicsPipelineCreateInfo.pDynamicState = &dynamic;
-
-    // We need to specify the pipeline layout and the render pass description up
-    // front as well.
-    graphicsPipelineCreateInfo.renderPass = renderPass;
-    graphicsPipelineCreateInfo.layout = pipelineLayout;
-
-    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline));
-
-    // Pipeline is baked, we can delete the shader modules now.
-    vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
-    vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
+    // Takes effect with the next frame, each frame hands its GPU culling
+    // buffers back to compute after drawing them.
+    gpuCullingEnabled = enabled;
+    LOGI("Culling on the %s\n", enabled ? "GPU" : "CPU");
 }
 
 void Context::waitIdle()
 {
     platform->waitIdle();
+
+    completedSerial = submissionSerial;
+    processPendingReleases();
 }
 
-VkShaderModule Context::loadShaderModule(VkDevice device, const char *pPath)
+void Context::waitForFrame(PerFrame &frame)
 {
-    std::vector<uint32_t> buffer;
-    if (FAILED(OS::getAssetManager().readBinaryFile(&buffer, pPath)))
+    if (graphicsTimeline)
+    {
+        // One wait on the timeline replaces the frame's fences, the fence
+        // manager has none outstanding in this case.
+        graphicsTimeline->wait(frame.submittedSerial);
+        completedSerial = graphicsTimeline->getCompletedValue();
+    }
+
+    frame.beginFrame();
+    descriptorAllocator->beginFrame(frameIndex);
+    // The compute work of the frame was waited on by its graphics submission.
+    computeScheduler->beginFrame(frameIndex);
+
+    // The frame is complete, so its query result is available.
+    if (statisticsQueryPool != VK_NULL_HANDLE && statisticsQueryIssued[frameIndex])
     {
-        LOGE("Failed to read SPIR-V file: %s.\n", pPath);
-        return VK_NULL_HANDLE;
+        uint64_t fragmentShaderInvocations = 0;
+        if (vkGetQueryPoolResults(platform->getDevice(),
+                                  statisticsQueryPool,
+                                  frameIndex,
+                                  1,
+                                  sizeof(fragmentShaderInvocations),
+                                  &fragmentShaderInvocations,
+                                  sizeof(fragmentShaderInvocations),
+                                  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            frameStatistics.fragmentShaderInvocations = fragmentShaderInvocations;
+        }
     }
 
-    VkShaderModuleCreateInfo moduleInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-    moduleInfo.codeSize = buffer.size() * sizeof(uint32_t);
-    moduleInfo.pCode = buffer.data();
+    // Without timeline semaphores only the serial of the frame just waited on is known to be complete.
+    completedSerial = std::max(completedSerial, frame.submittedSerial);
 
-    VkShaderModule shaderModule;
-    VK_CHECK(vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule));
-    return shaderModule;
+    processPendingReleases();
+}
+
+void Context::releaseWhenComplete(std::function<void()> release)
+{
+    // The commands being recorded go out with the next submission.
+    pendingReleases.push_back({submissionSerial + 1, std::move(release)});
+}
+
+void Context::processPendingReleases()
+{
+    while (!pendingReleases.empty() && pendingReleases.front().serial <= completedSerial)
+    {
+        pendingReleases.front().release();
+        pendingReleases.pop_front();
+    }
+}
+
+void Context::reloadShaders()
+{
+    shaderWatcher->poll();
+    for (const auto &shader : shaderWatcher->takeCompiledShaders())
+        pipelineManager->reloadShader(shader.c_str());
+
+    // Frames in flight keep drawing with the replaced pipelines.
+    std::vector<VkPipeline> retiredPipelines;
+    auto reloadedCount = pipelineManager->applyReloads(retiredPipelines);
+    if (reloadedCount == 0)
+        return;
+
+    auto device = platform->getDevice();
+    releaseWhenComplete([device, retiredPipelines]() {
+        for (auto pipeline : retiredPipelines)
+            vkDestroyPipeline(device, pipeline, nullptr);
+    });
+
+    // A shader can change its descriptors, and so the layout.
+    pipelineLayout = pipelineManager->getPipelineLayout(mainPipeline);
+    LOGI("Reloaded %u pipelines.\n", reloadedCount);
 }
 
 Result Context::update(float time)
 {
+    auto depthPrepassKey = KeyStates::keyStates[TobiKeyCodes::TOBI_KEY_P];
+    if (depthPrepassKey && !depthPrepassKeyDown)
+        setDepthPrepassEnabled(!depthPrepassEnabled);
+    depthPrepassKeyDown = depthPrepassKey;
+
+    auto gpuCullingKey = KeyStates::keyStates[TobiKeyCodes::TOBI_KEY_G];
+    if (gpuCullingKey && !gpuCullingKeyDown)
+        setGpuCullingEnabled(!gpuCullingEnabled);
+    gpuCullingKeyDown = gpuCullingKey;
+
+    reloadShaders();
+
+    // Keeps pipelines compiled during the run even if the application does not exit cleanly.
+    auto currentTime = OS::getCurrentTime();
+    if (currentTime - pipelineCacheSaveTime > pipelineCacheSaveInterval)
+    {
+        pipelineCache->save();
+        pipelineCacheSaveTime = currentTime;
+    }
+
     // TODO:change to within epsilon
     if (time == 0.0)
         return RESULT_SUCCESS;
@@ -666,45 +1042,319 @@ Result Context::update(float time)
     camera->update(time);
 
     shaderDataBlock.viewProjectionMatrix = camera->getViewProjectionMatrix();
+    shaderDataBlock.viewMatrix = camera->getViewMatrix();
+    shaderDataBlock.projectionMatrix = camera->getProjectionMatrix();
+    shaderDataBlock.cameraPosition = glm::vec4(camera->getPosition(), 1.f);
+    shaderDataBlock.lightPosition = lightPosition;
+    shaderDataBlock.time += time;
 
     return RESULT_SUCCESS;
 }
 
-Result Context::render()
+void Context::cullObjects()
 {
-    // Request a fresh command buffer.
-    auto cmd = requestPrimaryCommandBuffer();
+    auto startTime = OS::getCurrentTime();
 
-    // We will only submit this once before it's recycled.
-    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(cmd, &beginInfo);
+    const auto &viewProjectionMatrix = camera->getViewProjectionMatrix();
 
-    // Set clear color values.
-    VkClearValue clearValues[2] = {0};
-    clearValues[0].color.float32[0] = 0.1f;
-    clearValues[0].color.float32[1] = 0.1f;
-    clearValues[0].color.float32[2] = 0.2f;
-    clearValues[0].color.float32[3] = 1.0f;
-    clearValues[1].depthStencil.depth = 1.0f;
+    frustumCuller->updateBounds(*objectManager, *modelManager);
+    frustumCuller->cull(Frustum(viewProjectionMatrix), visibleObjects);
 
-    // Begin the render pass.
-    auto dim = getSwapChainDimensions();
-    VkRenderPassBeginInfo rpBegin = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-    rpBegin.renderPass = renderPass;
-    rpBegin.framebuffer = getBackBuffer(swapChainIndex).frameBuffer;
-    rpBegin.renderArea.extent.width = dim.width;
-    rpBegin.renderArea.extent.height = dim.height;
-    rpBegin.clearValueCount = 2;
-    rpBegin.pClearValues = clearValues;
+    frameStatistics.gpuCulling = false;
+    frameStatistics.totalObjectCount = frustumCuller->getObjectCount();
+    frameStatistics.visibleObjectCount = static_cast<uint32_t>(visibleObjects.size());
+    frameStatistics.frustumCullingTime = OS::getCurrentTime() - startTime;
+
+    // Hills hide the objects behind them.
+    const auto &terrainOccluders = terrain ? terrain->getOccluders() : noOccluders;
+    occlusionCuller->cull(viewProjectionMatrix, *objectManager, *modelManager, terrainOccluders, visibleObjects);
+
+    frameStatistics.occluderCount = occlusionCuller->getOccluderCount();
+    frameStatistics.occludeeCount = occlusionCuller->getOccludeeCount();
+    frameStatistics.occludedObjectCount = occlusionCuller->getOccludedCount();
+    frameStatistics.occlusionRasterizationTime = occlusionCuller->getRasterizationTime();
+    frameStatistics.occlusionTestTime = occlusionCuller->getTestTime();
+}
+
+void Context::cullObjectsOnGpu(VkCommandBuffer cmd)
+{
+    auto startTime = OS::getCurrentTime();
+
+    gpuCuller->cull(cmd,
+                    frameIndex,
+                    camera->getViewProjectionMatrix(),
+                    camera->getPosition(),
+                    *objectManager,
+                    *modelManager);
+
+    frameStatistics.gpuCulling = true;
+    frameStatistics.totalObjectCount = objectManager->getObjectCount();
+    frameStatistics.visibleObjectCount = gpuCuller->getVisibleObjectCount();
+    frameStatistics.frustumCullingTime = OS::getCurrentTime() - startTime;
+
+    frameStatistics.occluderCount = 0;
+    frameStatistics.occludeeCount = 0;
+    frameStatistics.occludedObjectCount = 0;
+    frameStatistics.occlusionRasterizationTime = 0.0;
+    frameStatistics.occlusionTestTime = 0.0;
+}
+
+uint32_t Context::writeInstanceData()
+{
+    auto &instanceBufferId = instanceBufferIds[frameIndex];
+    auto instanceCount = static_cast<uint32_t>(visibleObjects.size());
+
+    // Grow the buffer geometrically.
+    auto capacity = instanceBufferId ? instanceBufferManager->getBufferInfo(instanceBufferId).range / sizeof(glm::mat4) : 0;
+    if (instanceCount > capacity || !instanceBufferId)
+    {
+        if (instanceBufferId)
+        {
+            auto manager = instanceBufferManager;
+            auto oldInstanceBufferId = instanceBufferId;
+            releaseWhenComplete([manager, oldInstanceBufferId]() { manager->destroyBuffer(oldInstanceBufferId); });
+        }
+
+        auto newCapacity = std::max<VkDeviceSize>(std::max<VkDeviceSize>(instanceCount, capacity * 2), 64);
+        instanceBufferId = instanceBufferManager->createBuffer(nullptr, static_cast<uint32_t>(newCapacity * sizeof(glm::mat4)));
+    }
+
+    // Counting sort of the visible objects by mesh index.
+    meshInstanceCounts.assign(modelManager->getModelCount(), 0);
+    for (auto objectId : visibleObjects)
+    {
+        meshInstanceCounts[objectManager->getMeshIndex(objectId)]++;
+    }
+
+    instanceBatches.clear();
+    uint32_t firstInstance = 0;
+    for (uint32_t meshIndex = 0; meshIndex < meshInstanceCounts.size(); meshIndex++)
+    {
+        auto count = meshInstanceCounts[meshIndex];
+        if (count == 0)
+            continue;
+
+        instanceBatches.push_back({meshIndex, firstInstance, 0, 1.f});
+        // From here on the counts hold the index of the batch for each mesh.
+        meshInstanceCounts[meshIndex] = static_cast<uint32_t>(instanceBatches.size() - 1);
+        firstInstance += count;
+    }
 
-    // We will add draw commands in the same command buffer.
-    vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+    auto *pInstances = static_cast<glm::mat4 *>(instanceBufferManager->mapBuffer(instanceBufferId));
+    for (auto objectId : visibleObjects)
+    {
+        auto &batch = instanceBatches[meshInstanceCounts[objectManager->getMeshIndex(objectId)]];
+        const auto &modelMatrix = objectManager->getModelMatrix(objectId);
+        pInstances[batch.firstInstance + batch.instanceCount++] = modelMatrix;
+
+        // Depth of the object origin, the nearest one is used to order the batch.
+        auto clip = shaderDataBlock.viewProjectionMatrix * modelMatrix[3];
+        auto depth = clip.w > 0.f ? clip.z / clip.w : 0.f;
+        batch.minDepth = std::min(batch.minDepth, depth);
+    }
 
-    // Bind the graphics pipeline.
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    return instanceBufferId;
+}
+
+VkDescriptorSet Context::writeFrameData(VkBuffer transformBuffer)
+{
+    // The frame's previous use is complete, its uniform buffer can be overwritten.
+    auto uniformBufferId = frameUniformBufferIds[frameIndex];
+    memcpy(uniformBufferManager->mapBuffer(uniformBufferId), &shaderDataBlock, sizeof(ShaderDataBlock));
+
+    DescriptorWrite writes[2] = {
+        DescriptorAllocator::bufferWrite(frameUniformBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, *uniformBufferManager, uniformBufferId),
+        DescriptorAllocator::bufferWrite(transformBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, transformBuffer, 0, VK_WHOLE_SIZE)};
+
+    auto setLayout = pipelineManager->getLayoutCache().getSetLayout(pipelineLayout, frameSetIndex);
+    return descriptorAllocator->getDescriptorSet(setLayout, writes, 2);
+}
+
+void Context::submitDraws()
+{
+    renderQueue->clear();
+
+    auto prepassPipeline = pipelineManager->getPipeline(depthPrepassPipeline);
+
+    for (const auto &batch : instanceBatches)
+    {
+        if (!modelManager->isModelResident(batch.meshIndex))
+            continue;
+
+        // Draws are skipped while their pipeline and its fallback are being compiled.
+        auto material = getModelMaterial(batch.meshIndex);
+        auto pipelineHandle = getMaterialPipeline(material);
+        auto pipeline = pipelineManager->getPipeline(pipelineHandle);
+        if (pipeline == VK_NULL_HANDLE)
+            continue;
+
+        auto vbId = modelManager->getVertexBufferIndex(batch.meshIndex);
+        auto ibId = modelManager->getIndexBufferIndex(batch.meshIndex);
+
+        DrawPacket packet = {};
+        packet.sortKey = RenderQueue::makeSortKey(mainQueuePass, pipelineHandle, batch.meshIndex, material, batch.minDepth);
+        packet.pipeline = pipeline;
+        packet.vertexBuffer = vertexBufferManager->getBuffer(vbId).buffer;
+        packet.indexBuffer = indexBufferManager->getBuffer(ibId).buffer;
+        packet.indexCount = modelManager->getModel(batch.meshIndex)->getIndexCount();
+        packet.instanceCount = batch.instanceCount;
+        packet.firstInstance = batch.firstInstance;
+        renderQueue->submit(packet);
+
+        if (prepassPipeline != VK_NULL_HANDLE)
+        {
+            // Front to back, so the prepass itself rejects most hidden fragments.
+            auto pbId = modelManager->getPositionBufferIndex(batch.meshIndex);
+            packet.sortKey = RenderQueue::makeSortKey(depthPrepassQueuePass, 0, 0, 0, batch.minDepth);
+            packet.pipeline = prepassPipeline;
+            packet.vertexBuffer = vertexBufferManager->getBuffer(pbId).buffer;
+            renderQueue->submit(packet);
+        }
+    }
+
+    submitTerrainDraws();
+    renderQueue->sort();
+}
+
+void Context::submitIndirectDraws()
+{
+    renderQueue->clear();
+
+    auto prepassPipeline = pipelineManager->getPipeline(depthPrepassPipeline);
+
+    auto drawBuffer = gpuCuller->getDrawBuffer(frameIndex);
+    for (uint32_t meshIndex = 0; meshIndex < gpuCuller->getMeshCount(frameIndex); meshIndex++)
+    {
+        if (!modelManager->isModelResident(meshIndex))
+            continue;
+
+        auto material = getModelMaterial(meshIndex);
+        auto pipelineHandle = getMaterialPipeline(material);
+        auto pipeline = pipelineManager->getPipeline(pipelineHandle);
+        if (pipeline == VK_NULL_HANDLE)
+            continue;
+
+        auto vbId = modelManager->getVertexBufferIndex(meshIndex);
+        auto ibId = modelManager->getIndexBufferIndex(meshIndex);
+
+        DrawPacket packet = {};
+        packet.sortKey = RenderQueue::makeSortKey(mainQueuePass, pipelineHandle, meshIndex, material, 0.f);
+        packet.pipeline = pipeline;
+        packet.vertexBuffer = vertexBufferManager->getBuffer(vbId).buffer;
+        packet.indexBuffer = indexBufferManager->getBuffer(ibId).buffer;
+        packet.indirectBuffer = drawBuffer;
+        packet.indirectOffset = GpuCuller::getDrawCommandOffset(meshIndex);
+        renderQueue->submit(packet);
+
+        if (prepassPipeline != VK_NULL_HANDLE)
+        {
+            auto pbId = modelManager->getPositionBufferIndex(meshIndex);
+            packet.sortKey = RenderQueue::makeSortKey(depthPrepassQueuePass, 0, meshIndex, 0, 0.f);
+            packet.pipeline = prepassPipeline;
+            packet.vertexBuffer = vertexBufferManager->getBuffer(pbId).buffer;
+            renderQueue->submit(packet);
+        }
+    }
+
+    submitTerrainDraws();
+    renderQueue->sort();
+}
+
+void Context::updateTerrain(bool occluders)
+{
+    if (!terrain)
+    {
+        frameStatistics.terrainVisibleChunkCount = 0;
+        frameStatistics.terrainDrawnChunkCount = 0;
+        frameStatistics.terrainResidentChunkCount = 0;
+        return;
+    }
+
+    terrain->update(camera->getViewProjectionMatrix(), camera->getPosition(), occluders, releasedTerrainBufferIds);
+
+    // Frames in flight may still draw the evicted chunks.
+    if (!releasedTerrainBufferIds.empty())
+    {
+        auto manager = vertexBufferManager;
+        auto bufferIds = releasedTerrainBufferIds;
+        releaseWhenComplete([manager, bufferIds]() {
+            for (auto id : bufferIds)
+                manager->destroyBuffer(id);
+        });
+        releasedTerrainBufferIds.clear();
+    }
+
+    frameStatistics.terrainVisibleChunkCount = terrain->getVisibleChunkCount();
+    frameStatistics.terrainDrawnChunkCount = static_cast<uint32_t>(terrain->getDraws().size());
+    frameStatistics.terrainResidentChunkCount = terrain->getResidentChunkCount();
+}
+
+void Context::submitTerrainDraws()
+{
+    if (!terrain)
+        return;
+
+    auto prepass = depthPrepass != RenderGraph::invalidHandle;
+    if (terrainPipeline == PipelineManager::invalidHandle)
+    {
+        // Same state as the default material, with the vertices and shading of the terrain.
+        auto desc = mainPipelineDesc;
+        desc.vertexShader = "shaders/terrain.vert.spv";
+        desc.shaderFeatures = 0;
+        desc.vertexLayout = PIPELINE_VERTEX_LAYOUT_TERRAIN;
+        terrainPipeline = pipelineManager->requestPipeline(desc);
+
+        if (prepass)
+        {
+            desc.fragmentShader = nullptr;
+            desc.colorAttachmentCount = 0;
+            desc.depthWriteEnable = true;
+            desc.depthCompareOp = VK_COMPARE_OP_LESS;
+            desc.renderPass = renderGraph->getRenderPass(depthPrepass);
+            desc.subpass = renderGraph->getSubpass(depthPrepass);
+            terrainPrepassPipeline = pipelineManager->requestPipeline(desc);
+        }
+    }
+
+    // The main pass tests for equal depth after the prepass, so the terrain
+    // waits for both of its pipelines.
+    auto pipeline = pipelineManager->getPipeline(terrainPipeline);
+    auto prepassPipeline = pipelineManager->getPipeline(terrainPrepassPipeline);
+    if (pipeline == VK_NULL_HANDLE || (prepass && prepassPipeline == VK_NULL_HANDLE))
+        return;
+
+    auto indexBuffer = terrain->getIndexBuffer();
+    auto chunkDataBuffer = terrain->getChunkDataBuffer();
+    for (const auto &draw : terrain->getDraws())
+    {
+        // All chunks share the pipeline and the index buffer, so they are only
+        // ordered front to back.
+        DrawPacket packet = {};
+        packet.sortKey = RenderQueue::makeSortKey(mainQueuePass, terrainPipeline, 0, 0, draw.depth);
+        packet.pipeline = pipeline;
+        packet.vertexBuffer = draw.vertexBuffer;
+        packet.indexBuffer = indexBuffer;
+        packet.instanceBuffer = chunkDataBuffer;
+        packet.indexCount = draw.indexCount;
+        packet.instanceCount = 1;
+        packet.firstIndex = draw.firstIndex;
+        packet.firstInstance = draw.chunk;
+        renderQueue->submit(packet);
+
+        if (prepass)
+        {
+            packet.sortKey = RenderQueue::makeSortKey(depthPrepassQueuePass, terrainPrepassPipeline, 0, 0, draw.depth);
+            packet.pipeline = prepassPipeline;
+            renderQueue->submit(packet);
+        }
+    }
+}
+
+RenderQueueStatistics Context::recordDraws(VkCommandBuffer cmd, uint32_t firstPacket, uint32_t packetCount)
+{
+    // Set up dynamic state, secondary command buffers do not inherit it.
+    auto dim = getSwapChainDimensions();
 
-    // Set up dynamic state.
     // Viewport
     VkViewport vp = {0};
     vp.x = 0.0f;
@@ -722,72 +1372,188 @@ Result Context::render()
     scissor.extent.height = dim.height;
     vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-    // draw triangle
+    // Bound once for all packets, all pipelines share this layout. Each draw
+    // selects its transforms with firstInstance, so nothing is pushed per draw.
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, frameSetIndex, 1, &frameDescriptorSet, 0, nullptr);
 
-    // Bind vertex buffer.
-    VkDeviceSize offset = 0;
-    auto triangleModelId = objectManager->getMeshIndex(triangleId);
-    auto vbId = modelManager->getVertexBufferIndex(triangleModelId);
+    // The bindless set stays bound for the whole pass, whatever the draws read from it.
+    if (bindlessResources && pipelineManager->getLayoutCache().getSetCount(pipelineLayout) > BindlessResources::setIndex)
+        bindlessResources->bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
 
-    shaderDataBlock.modelMatrix = objectManager->getModelMatrix(triangleId);
+    return renderQueue->execute(cmd, firstPacket, packetCount);
+}
 
-    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShaderDataBlock), &shaderDataBlock);
+VkSubpassContents Context::prepareMainPass(const RenderGraphPassContext &context)
+{
+    // Split the queue across threads only when every command buffer gets enough
+    // packets to pay for its overhead.
+    uint32_t mainFirstPacket = 0;
+    uint32_t packetCount = 0;
+    renderQueue->getPassRange(mainQueuePass, mainFirstPacket, packetCount);
+    auto &secondaryCommandManagers = perFrame[frameIndex]->secondaryCommandManagers;
+    auto rangeCount = std::min(static_cast<uint32_t>(secondaryCommandManagers.size()),
+                               packetCount / minPacketsPerCommandBuffer);
+
+    // Secondary command buffers can only run within the statistics query when
+    // they inherit it.
+    auto inheritQuery = statisticsQueryPool != VK_NULL_HANDLE;
+    if (inheritQuery && !platform->getEnabledFeatures().inheritedQueries)
+        rangeCount = 0;
+
+    if (rangeCount <= 1)
+    {
+        frameRangeCount = 0;
+        return VK_SUBPASS_CONTENTS_INLINE;
+    }
 
-    vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBufferManager->getBuffer(vbId).buffer, &offset);
-    vkCmdBindIndexBuffer(cmd, indexBufferManager->getBuffer(vbId).buffer, offset, VK_INDEX_TYPE_UINT32);
+    frameRangeCount = rangeCount;
+    secondaryCommandBuffers.resize(rangeCount);
+    recordingStatistics.resize(rangeCount);
+    auto packetsPerRange = (packetCount + rangeCount - 1) / rangeCount;
 
-    // Draw three vertices with one instance.
-    vkCmdDrawIndexed(cmd, modelManager->getModel(triangleModelId)->getIndexCount(), 1, 0, 0, 0);
+    // Every range has its own command manager, so no command pool is used by
+    // two threads at once.
+    jobSystem->parallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (auto range = begin; range < end; range++)
+        {
+            auto secondaryCmd = secondaryCommandManagers[range]->requestCommandBuffer();
+
+            VkCommandBufferInheritanceInfo inheritanceInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+            inheritanceInfo.renderPass = context.renderPass;
+            inheritanceInfo.subpass = context.subpass;
+            inheritanceInfo.framebuffer = context.framebuffer;
+            if (inheritQuery)
+                inheritanceInfo.pipelineStatistics = statisticsQueryFlags;
+
+            VkCommandBufferBeginInfo secondaryBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+            secondaryBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                                       VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+            VK_CHECK(vkBeginCommandBuffer(secondaryCmd, &secondaryBeginInfo));
+
+            auto firstPacket = std::min(range * packetsPerRange, packetCount);
+            auto rangePacketCount = std::min(packetsPerRange, packetCount - firstPacket);
+            recordingStatistics[range] = recordDraws(secondaryCmd, mainFirstPacket + firstPacket, rangePacketCount);
+
+            VK_CHECK(vkEndCommandBuffer(secondaryCmd));
+            secondaryCommandBuffers[range] = secondaryCmd;
+        }
+    });
 
-    // draw cube
+    return VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+}
 
-    // Bind vertex buffer.
-    auto cubeModelId = objectManager->getMeshIndex(cubeId);
-    vbId = modelManager->getVertexBufferIndex(cubeModelId);
-    shaderDataBlock.modelMatrix = objectManager->getModelMatrix(cubeId);
+void Context::recordMainPass(VkCommandBuffer cmd)
+{
+    if (frameRangeCount > 0)
+    {
+        vkCmdExecuteCommands(cmd, frameRangeCount, secondaryCommandBuffers.data());
+        return;
+    }
+
+    uint32_t firstPacket = 0;
+    uint32_t packetCount = 0;
+    renderQueue->getPassRange(mainQueuePass, firstPacket, packetCount);
+    recordingStatistics.assign(1, recordDraws(cmd, firstPacket, packetCount));
+}
 
-    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShaderDataBlock), &shaderDataBlock);
+void Context::recordDepthPrepass(VkCommandBuffer cmd)
+{
+    uint32_t firstPacket = 0;
+    uint32_t packetCount = 0;
+    renderQueue->getPassRange(depthPrepassQueuePass, firstPacket, packetCount);
+    depthPrepassStatistics = recordDraws(cmd, firstPacket, packetCount);
+}
+
+Result Context::render()
+{
+    if (renderGraphDirty)
+    {
+        renderGraphDirty = false;
+        rebuildRenderGraph();
+    }
 
-    vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBufferManager->getBuffer(vbId).buffer, &offset);
-    vkCmdBindIndexBuffer(cmd, indexBufferManager->getBuffer(vbId).buffer, offset, VK_INDEX_TYPE_UINT32);
+    // Request a fresh command buffer.
+    auto cmd = requestPrimaryCommandBuffer();
 
-    // Draw three vertices with one instance.
-    vkCmdDrawIndexed(cmd, modelManager->getModel(cubeModelId)->getIndexCount(), 1, 0, 0, 0);
+    // We will only submit this once before it's recycled.
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &beginInfo);
 
-    // draw spider
+    // Hand the uploads finished since the last frame to graphics and queue the
+    // next ones, models become visible once their upload is complete.
+    uploadScheduler->flush();
+    uploadScheduler->acquireCompleted(cmd);
 
-    // Bind vertex buffer.
-    auto spiderModelId = objectManager->getMeshIndex(spiderId);
-    vbId = modelManager->getVertexBufferIndex(spiderModelId);
-    shaderDataBlock.modelMatrix = objectManager->getModelMatrix(spiderId);
+    // Only the CPU culling tests occlusion, the terrain occluders are built for it alone.
+    auto gpuCulling = gpuCullingEnabled && gpuCullingAvailable;
 
-    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShaderDataBlock), &shaderDataBlock);
+    // Chunks whose upload was acquired above can be drawn, new ones are queued.
+    updateTerrain(!gpuCulling);
 
-    vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBufferManager->getBuffer(vbId).buffer, &offset);
-    vkCmdBindIndexBuffer(cmd, indexBufferManager->getBuffer(vbId).buffer, offset, VK_INDEX_TYPE_UINT32);
+    VkBuffer instanceBuffer = VK_NULL_HANDLE;
+    if (gpuCulling)
+    {
+        // The culling overlaps with the graphics work still in flight, only the
+        // draws of this frame wait for it.
+        auto computeCmd = computeScheduler->requestCommandBuffer(frameIndex);
+        cullObjectsOnGpu(computeCmd);
+        graphicsWaits.push_back(computeScheduler->submit(frameIndex,
+                                                         computeCmd,
+                                                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT));
+        gpuCuller->acquireForGraphics(cmd, frameIndex);
+        submitIndirectDraws();
+        instanceBuffer = gpuCuller->getInstanceBuffer(frameIndex);
+    }
+    else
+    {
+        cullObjects();
+        auto instanceBufferId = writeInstanceData();
+        submitDraws();
+        instanceBuffer = instanceBufferManager->getBuffer(instanceBufferId).buffer;
+    }
 
-    auto howmany = modelManager->getModel(spiderModelId)->getIndexCount();
-    // Draw three vertices with one instance.
-    vkCmdDrawIndexed(cmd, howmany, 1, 0, 0, 0);
+    frameDescriptorSet = writeFrameData(instanceBuffer);
+    depthPrepassStatistics = {};
 
-    // draw cube 2
+    auto recordingStartTime = OS::getCurrentTime();
 
-    // Bind vertex buffer.
-    auto cube2ModelId = objectManager->getMeshIndex(cube2Id);
-    vbId = modelManager->getVertexBufferIndex(cube2ModelId);
-    shaderDataBlock.modelMatrix = objectManager->getModelMatrix(cube2Id);
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(cmd, statisticsQueryPool, frameIndex, 1);
+        vkCmdBeginQuery(cmd, statisticsQueryPool, frameIndex, 0);
+    }
 
-    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShaderDataBlock), &shaderDataBlock);
+    // Transitions the images and records the passes, the main pass through
+    // prepareMainPass and recordMainPass.
+    const auto &backBuffer = getBackBuffer(swapChainIndex);
+    renderGraph->setImportedImage(backBufferImage, backBuffer.image, backBuffer.view);
+    renderGraph->execute(cmd);
 
-    vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBufferManager->getBuffer(vbId).buffer, &offset);
-    vkCmdBindIndexBuffer(cmd, indexBufferManager->getBuffer(vbId).buffer, offset, VK_INDEX_TYPE_UINT32);
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdEndQuery(cmd, statisticsQueryPool, frameIndex);
+        statisticsQueryIssued[frameIndex] = true;
+    }
 
-    howmany = modelManager->getModel(cube2ModelId)->getIndexCount();
-    // Draw three vertices with one instance.
-    vkCmdDrawIndexed(cmd, howmany, 1, 0, 0, 0);
+    frameStatistics.depthPrepass = depthPrepass != RenderGraph::invalidHandle;
+    frameStatistics.drawCallCount = depthPrepassStatistics.drawCount;
+    frameStatistics.pipelineBindCount = depthPrepassStatistics.pipelineBindCount;
+    frameStatistics.bufferBindCount = depthPrepassStatistics.vertexBufferBindCount + depthPrepassStatistics.indexBufferBindCount;
+    for (const auto &statistics : recordingStatistics)
+    {
+        frameStatistics.drawCallCount += statistics.drawCount;
+        frameStatistics.pipelineBindCount += statistics.pipelineBindCount;
+        frameStatistics.bufferBindCount += statistics.vertexBufferBindCount + statistics.indexBufferBindCount;
+    }
+    frameStatistics.secondaryCommandBufferCount = frameRangeCount;
+    frameStatistics.descriptorSetAllocationCount = descriptorAllocator->getAllocatedCount();
+    frameStatistics.descriptorSetReuseCount = descriptorAllocator->getReusedCount();
+    frameStatistics.commandRecordingTime = OS::getCurrentTime() - recordingStartTime;
 
-    // Complete render pass.
-    vkCmdEndRenderPass(cmd);
+    if (gpuCulling)
+        gpuCuller->releaseFromGraphics(cmd, frameIndex);
 
     // Complete the command buffer.
     VK_CHECK(vkEndCommandBuffer(cmd));
@@ -22,15 +22,26 @@
 
 #include "framework/IContext.hpp"
 
+#include <deque>
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include "VkCommon.hpp"
+#include "ComputeScheduler.hpp"
+#include "UploadScheduler.hpp"
 #include "ShaderDataBlock.hpp"
 #include "ShaderDataBlock.hpp"
 #include "buffers/Buffer.hpp"
 #include "model/ModelManager.hpp"
 #include "model/ObjectManager.hpp"
+#include "culling/FrustumCuller.hpp"
+#include "culling/OcclusionCuller.hpp"
+#include "culling/GpuCuller.hpp"
+#include "culling/HiZBuilder.hpp"
+#include "rendering/PipelineManager.hpp"
+#include "rendering/RenderGraph.hpp"
+#include "rendering/RenderQueue.hpp"
 #include "../game/Camera.hpp"
 #include "../game/KeyState.hpp"
 #include "../platform/SwapChainDimensions.hpp"
@@ -38,11 +49,21 @@
 namespace Tobi
 {
 class Platform;
+class PipelineCache;
+class ShaderWatcher;
+class DescriptorAllocator;
+class BindlessResources;
 class PerFrame;
 class VertexBufferManager;
 class IndexBufferManager;
 class UniformBufferManager;
+class InstanceBufferManager;
+class StorageBufferManager;
 class FenceManager;
+class TimelineSemaphore;
+class JobSystem;
+class Heightfield;
+class Terrain;
 
 struct BackBuffer
 {
@@ -53,7 +74,8 @@ struct BackBuffer
     // We need an image view to be able to access the image as a framebuffer.
     VkImageView view;
 
-    VkFramebuffer frameBuffer;
+    // Signaled when rendering to the image is done, waited on by the presentation.
+    VkSemaphore releaseSemaphore;
 };
 
 /// @brief The Context is the primary way for samples to interact
@@ -75,6 +97,16 @@ class Context : public IContext
 
     virtual uint32_t loadModel(const char *filename);
 
+    virtual Result loadScene(const char *filename);
+
+    virtual Result loadTerrain(const char *filename,
+                               uint32_t width,
+                               uint32_t depth,
+                               float spacing,
+                               float heightScale,
+                               float baseHeight);
+    virtual Result generateTerrain(uint32_t size, float spacing, float heightScale, float baseHeight, uint32_t seed);
+
     virtual Result acquireNextImage(uint32_t &swapChainIndex);
 
     virtual Result presentImage(uint32_t index);
@@ -84,50 +116,178 @@ class Context : public IContext
 
     virtual TobiStatus getWindowStatus();
 
+    virtual Result setFramesInFlightCount(uint32_t count);
+
+    virtual const FrameStatistics &getFrameStatistics() const { return frameStatistics; }
+
+    virtual void setDepthPrepassEnabled(bool enabled);
+
+    virtual void setGpuCullingEnabled(bool enabled);
+
+    virtual uint32_t createMaterial(uint32_t shaderFeatures);
+    virtual void setModelMaterial(uint32_t model, uint32_t material);
+
   private:
     std::shared_ptr<Platform> platform;
 
     std::vector<BackBuffer> backBuffers;
 
-    VkRenderPass renderPass;
-
     VkFormat depthBufferFormat;
-    // Memory for the depth buffer.
-    VkDeviceMemory depthBufferMemory;
-    // Image for the depth buffer.
-    VkImage depthBufferImage;
-    // Image view for the depth buffer.
-    VkImageView depthBufferView;
-
-    // TODO: move to pipeline class
-    VkPipelineCache pipelineCache;
-    VkPipeline pipeline;
-    VkPipelineLayout pipelineLayout;
 
+    // Describes the passes of a frame, owns the depth buffer and the render passes.
+    std::unique_ptr<RenderGraph> renderGraph;
+    // Invalid while the depth prepass is off.
+    uint32_t depthPrepass;
+    uint32_t mainPass;
+    // The swapchain image, set before the graph is executed.
+    uint32_t backBufferImage;
+
+    // Kept on disk between runs.
+    std::unique_ptr<PipelineCache> pipelineCache;
+    // When the pipeline cache was last written.
+    double pipelineCacheSaveTime;
+    // Owns the pipelines, keeps them across render graph rebuilds.
+    std::unique_ptr<PipelineManager> pipelineManager;
+    // Recompiles the shaders saved while running.
+    std::unique_ptr<ShaderWatcher> shaderWatcher;
+    // Descriptor sets which live for one frame, shared by all passes.
+    std::unique_ptr<DescriptorAllocator> descriptorAllocator;
+    // Every texture and storage buffer, null without descriptor indexing.
+    std::unique_ptr<BindlessResources> bindlessResources;
+    // Reflected from the shaders and owned by the pipeline manager.
+    VkPipelineLayout pipelineLayout;
+    // Handles of the pipeline manager.
+    uint32_t mainPipeline;
+    // Only writes depth, invalid while the depth prepass is off.
+    uint32_t depthPrepassPipeline;
+    // The main pipeline of the default material, other materials only change the shader features.
+    PipelineDesc mainPipelineDesc;
+    // Requested when the terrain is first drawn, the prepass one only with the depth prepass.
+    uint32_t terrainPipeline;
+    uint32_t terrainPrepassPipeline;
+
+    // Shader features of every material, indexed by material.
+    std::vector<uint32_t> materialFeatures;
+    // Pipeline of every material, requested when the material is first drawn.
+    std::vector<uint32_t> materialPipelines;
+    // Material of every model, models without one use the default material.
+    std::vector<uint32_t> modelMaterials;
+
+    bool depthPrepassEnabled;
+    // Set when depth.vert could be loaded.
+    bool depthPrepassAvailable;
+    bool depthPrepassKeyDown;
+    // The passes changed, the graph and pipelines are rebuilt before the next frame.
+    bool renderGraphDirty;
+
+    // Builds the depth pyramid after the main pass when hiz.comp could be loaded
+    // and something samples the pyramid.
+    std::unique_ptr<HiZBuilder> hizBuilder;
+
+    // One fragment shader invocation query per frame in flight, null when the
+    // device cannot count them.
+    VkQueryPool statisticsQueryPool;
+    std::vector<bool> statisticsQueryIssued;
+
+    // Ring of per-frame resources, one entry per frame in flight.
     std::vector<std::unique_ptr<PerFrame>> perFrame;
 
     std::shared_ptr<VertexBufferManager> vertexBufferManager;
     std::shared_ptr<IndexBufferManager> indexBufferManager;
     std::shared_ptr<UniformBufferManager> uniformBufferManager;
+    std::shared_ptr<InstanceBufferManager> instanceBufferManager;
+
+    // One uniform buffer holding the shaderDataBlock per frame in flight, indexed like perFrame.
+    std::vector<uint32_t> frameUniformBufferIds;
+
+    // One instance buffer per frame in flight, indexed like perFrame. 0 until first used.
+    std::vector<uint32_t> instanceBufferIds;
+
+    std::shared_ptr<StorageBufferManager> storageBufferManager;
+
+    std::shared_ptr<JobSystem> jobSystem;
 
     std::unique_ptr<ModelManager> modelManager;
     std::unique_ptr<ObjectManager> objectManager;
 
+    // Null until a terrain is loaded or generated.
+    std::unique_ptr<Terrain> terrain;
+    // Vertex buffers of terrain chunks evicted this frame.
+    std::vector<uint32_t> releasedTerrainBufferIds;
+
+    std::unique_ptr<FrustumCuller> frustumCuller;
+    std::unique_ptr<OcclusionCuller> occlusionCuller;
+    std::unique_ptr<GpuCuller> gpuCuller;
+    // Runs the GPU culling on the compute queue. Created once the platform is initialized.
+    std::unique_ptr<ComputeScheduler> computeScheduler;
+    // Streams model data on the transfer queue. Created once the platform is initialized.
+    std::shared_ptr<UploadScheduler> uploadScheduler;
+    // Only used when gpuCullingAvailable is set too.
+    bool gpuCullingEnabled;
+    // Set when the GPU culling pipeline could be created, culling stays on the CPU otherwise.
+    bool gpuCullingAvailable;
+    bool gpuCullingKeyDown;
+    // Ids of the objects which survived culling this frame.
+    std::vector<uint32_t> visibleObjects;
+
+    /// @brief A run of instances in the instance buffer sharing one mesh.
+    struct InstanceBatch
+    {
+        uint32_t meshIndex;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+        // Depth of the nearest instance, used for the sort key.
+        float minDepth;
+    };
+
+    std::vector<InstanceBatch> instanceBatches;
+    std::vector<uint32_t> meshInstanceCounts;
+
+    std::unique_ptr<RenderQueue> renderQueue;
+    // Secondary command buffers recorded this frame and the statistics of each of them.
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
+    std::vector<RenderQueueStatistics> recordingStatistics;
+    RenderQueueStatistics depthPrepassStatistics;
+    // Frame constants and transforms, and number of secondary command buffers
+    // of the frame being recorded.
+    VkDescriptorSet frameDescriptorSet;
+    uint32_t frameRangeCount;
+
+    FrameStatistics frameStatistics;
+
     std::shared_ptr<Camera> camera;
 
     std::shared_ptr<KeyStates> keyStates;
 
     ShaderDataBlock shaderDataBlock;
 
-    // change to have these in a container?
-    uint32_t triangleId;
-    uint32_t cubeId;
-    uint32_t spiderId;
-    uint32_t cube2Id;
-
     uint32_t swapChainIndex;
-    
-    /// @brief Called by the platform, begins a frame
+
+    uint32_t framesInFlight;
+    // Index into perFrame of the frame being recorded.
+    uint32_t frameIndex;
+
+    // Signaled with the submission serial by every graphics submission. Null when
+    // timeline semaphores are not supported, fences are used instead.
+    std::unique_ptr<TimelineSemaphore> graphicsTimeline;
+    // Serial of the last submission and the largest serial known to be complete on the GPU.
+    uint64_t submissionSerial;
+    uint64_t completedSerial;
+
+    struct PendingRelease
+    {
+        uint64_t serial;
+        std::function<void()> release;
+    };
+
+    // Ordered by serial.
+    std::deque<PendingRelease> pendingReleases;
+
+    // Semaphores the next graphics submission waits on, cleared by the submission.
+    std::vector<SemaphoreWait> graphicsWaits;
+
+    /// @brief Called once the swapchain image for the current frame has been acquired.
+    /// The frame's fences have already been waited on by @ref acquireNextImage.
     ///
     /// @param index The swapchain index which will be rendered into this frame.
     ///
@@ -167,8 +327,18 @@ class Context : public IContext
     Result onPlatformUpdate();
 
     void updateSwapChain();
-    void initRenderPass(VkFormat format);
+    /// @brief Declares the passes of a frame and compiles them for the swapchain.
+    void initRenderGraph(const SwapChainDimensions &dimensions);
+    /// @brief Requests the pipelines of the passes from the pipeline manager
+    /// and waits until they are compiled.
     void initPipeline();
+    /// @brief The pipeline of a material, requested from the pipeline manager on first use.
+    uint32_t getMaterialPipeline(uint32_t material);
+    uint32_t getModelMaterial(uint32_t model) const;
+
+    /// @brief Waits for the GPU, then recreates the graph and the pipelines
+    /// depending on its render passes.
+    void rebuildRenderGraph();
 
     std::shared_ptr<FenceManager> &getFenceManager();
 
@@ -183,10 +353,70 @@ class Context : public IContext
     const VkSemaphore &getSwapChainReleaseSemaphore() const;
 
     void waitIdle();
+
+    /// @brief Waits until the GPU is done with the last submission of a frame and
+    /// recycles its resources. Waits on the timeline if available, otherwise on
+    /// the frame's fences.
+    void waitForFrame(PerFrame &frame);
+
+    /// @brief Calls release once the GPU has finished the commands being recorded now.
+    void releaseWhenComplete(std::function<void()> release);
+
+    void processPendingReleases();
+
+    /// @brief Swaps in the pipelines of shaders recompiled since the last frame.
+    void reloadShaders();
     void submitCommandBuffer(VkCommandBuffer commandBuffer, VkSemaphore acquireSemaphore, VkSemaphore releaseSemaphore);
 
-    VkShaderModule loadShaderModule(VkDevice device, const char *pPath);
-    void initDepthBuffer(uint32_t width, uint32_t height);
+    /// @brief Fills visibleObjects with the objects inside the camera frustum
+    /// which are not hidden behind occluders.
+    void cullObjects();
+
+    /// @brief Records the GPU culling dispatch which fills the indirect draw
+    /// commands and the instance buffer for this frame.
+    void cullObjectsOnGpu(VkCommandBuffer cmd);
+
+    /// @brief Groups the visible objects by mesh and writes their model matrices
+    /// into this frame's instance buffer, filling instanceBatches.
+    /// @returns The instance buffer id for this frame.
+    uint32_t writeInstanceData();
+
+    /// @brief Writes the shaderDataBlock into this frame's uniform buffer.
+    /// @param transformBuffer Holds the model matrices of this frame's instances.
+    /// @returns The descriptor set of the frame constants and transforms.
+    VkDescriptorSet writeFrameData(VkBuffer transformBuffer);
+
+    /// @brief Waits for the GPU and replaces the terrain, centred on the world origin.
+    void setTerrain(std::unique_ptr<Heightfield> heightfield, float baseHeight);
+
+    /// @brief Culls the terrain chunks and streams the visible ones in.
+    /// @param occluders Also builds the terrain occluders for the CPU occlusion culler.
+    void updateTerrain(bool occluders);
+
+    /// @brief Submits one draw packet per visible terrain chunk, before the queue is sorted.
+    void submitTerrainDraws();
+
+    /// @brief Submits one draw packet per instance batch to the render queue and sorts it.
+    void submitDraws();
+
+    /// @brief Submits one indirect draw packet per mesh, reading the draw commands written by the GPU culling.
+    void submitIndirectDraws();
+
+    /// @brief Records dynamic state, the frame's descriptor sets and a range of the render queue.
+    /// Safe to call from several threads with different command buffers.
+    RenderQueueStatistics recordDraws(VkCommandBuffer cmd, uint32_t firstPacket, uint32_t packetCount);
+
+    /// @brief Records the render queue into secondary command buffers when it is
+    /// large enough to split across threads. Records inline while the statistics
+    /// query is active and the device cannot inherit it.
+    /// @returns How the main pass is recorded.
+    VkSubpassContents prepareMainPass(const RenderGraphPassContext &context);
+
+    /// @brief Records the main pass inside its subpass.
+    void recordMainPass(VkCommandBuffer cmd);
+
+    /// @brief Records the depth only draws of the depth prepass.
+    void recordDepthPrepass(VkCommandBuffer cmd);
 };
 
 } // namespace Tobi
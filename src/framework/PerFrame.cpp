@@ -9,7 +9,7 @@ PerFrame::PerFrame(VkDevice device, uint32_t queueFamilyIndex)
       commandManager(std::make_unique<CommandBufferManager>(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, queueFamilyIndex)),
       secondaryCommandManagers(std::vector<std::unique_ptr<CommandBufferManager>>()),
       swapchainAcquireSemaphore(VK_NULL_HANDLE),
-      swapchainReleaseSemaphore(VK_NULL_HANDLE),
+      submittedSerial(0),
       queueIndex(queueFamilyIndex)
 {
 }
@@ -18,8 +18,6 @@ PerFrame::~PerFrame()
 {
     if (swapchainAcquireSemaphore != VK_NULL_HANDLE)
         vkDestroySemaphore(device, swapchainAcquireSemaphore, nullptr);
-    if (swapchainReleaseSemaphore != VK_NULL_HANDLE)
-        vkDestroySemaphore(device, swapchainReleaseSemaphore, nullptr);
 }
 
 void PerFrame::beginFrame()
@@ -47,11 +45,4 @@ VkSemaphore PerFrame::setSwapchainAcquireSemaphore(VkSemaphore acquireSemaphore)
     return ret;
 }
 
-void PerFrame::setSwapchainReleaseSemaphore(VkSemaphore releaseSemaphore)
-{
-    if (swapchainReleaseSemaphore != VK_NULL_HANDLE)
-        vkDestroySemaphore(device, swapchainReleaseSemaphore, nullptr);
-    swapchainReleaseSemaphore = releaseSemaphore;
-}
-
 }
\ No newline at end of file
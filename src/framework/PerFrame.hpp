@@ -21,7 +21,6 @@ struct PerFrame
 
     void beginFrame();
     VkSemaphore setSwapchainAcquireSemaphore(VkSemaphore acquireSemaphore);
-    void setSwapchainReleaseSemaphore(VkSemaphore releaseSemaphore);
     void setSecondaryCommandManagersCount(uint32_t count);
 
     VkDevice device;
@@ -29,7 +28,8 @@ struct PerFrame
     std::unique_ptr<CommandBufferManager> commandManager;
     std::vector<std::unique_ptr<CommandBufferManager>> secondaryCommandManagers;
     VkSemaphore swapchainAcquireSemaphore;
-    VkSemaphore swapchainReleaseSemaphore;
+    // Serial of the last submission made for this frame.
+    uint64_t submittedSerial;
     uint32_t queueIndex;
 };
 
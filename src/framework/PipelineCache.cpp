@@ -0,0 +1,103 @@
+#include "PipelineCache.hpp"
+
+#include <cstring>
+
+#include "../platform/AssetManager.hpp"
+#include "../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+// The header every pipeline cache starts with, VkPipelineCacheHeaderVersionOne:
+// header size, header version, vendor ID and device ID, then the cache UUID.
+static const size_t cacheHeaderSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+
+PipelineCache::PipelineCache(std::shared_ptr<Platform> platform, const char *pPath)
+    : platform(platform),
+      path(pPath),
+      cache(VK_NULL_HANDLE),
+      warm(false),
+      savedSize(0)
+{
+    LOGI("CONSTRUCTING PipelineCache\n");
+
+    std::vector<uint8_t> data;
+    if (SUCCEEDED(OS::getAssetManager().readCacheFile(pPath, &data)))
+    {
+        if (validateHeader(data))
+        {
+            warm = true;
+            savedSize = data.size();
+            LOGI("Loaded %zu bytes of pipeline cache from %s\n", data.size(), pPath);
+        }
+        else
+        {
+            LOGW("Pipeline cache %s was written by another driver or device, starting cold.\n", pPath);
+            data.clear();
+        }
+    }
+    else
+    {
+        LOGI("No pipeline cache found at %s, starting cold.\n", pPath);
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    pipelineCacheInfo.initialDataSize = data.size();
+    pipelineCacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    VK_CHECK(vkCreatePipelineCache(platform->getDevice(), &pipelineCacheInfo, nullptr, &cache));
+}
+
+PipelineCache::~PipelineCache()
+{
+    LOGI("DECONSTRUCTING PipelineCache\n");
+
+    save();
+    vkDestroyPipelineCache(platform->getDevice(), cache, nullptr);
+}
+
+bool PipelineCache::validateHeader(const std::vector<uint8_t> &data) const
+{
+    if (data.size() < cacheHeaderSize)
+        return false;
+
+    uint32_t header[4];
+    memcpy(header, data.data(), sizeof(header));
+
+    const auto &properties = platform->getPhysicalDeviceProperties();
+    return header[0] >= cacheHeaderSize &&
+           header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header[2] == properties.vendorID &&
+           header[3] == properties.deviceID &&
+           memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+Result PipelineCache::save()
+{
+    auto device = platform->getDevice();
+
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr));
+
+    // The cache only ever grows, the same size means nothing was added.
+    if (size == savedSize)
+        return RESULT_SUCCESS;
+
+    std::vector<uint8_t> data(size);
+    auto result = vkGetPipelineCacheData(device, cache, &size, data.data());
+    if (result != VK_SUCCESS && result != VK_INCOMPLETE)
+    {
+        LOGE("Failed to get the pipeline cache data: %d\n", int(result));
+        return RESULT_ERROR_GENERIC;
+    }
+    data.resize(size);
+
+    auto error = OS::getAssetManager().writeCacheFile(path.c_str(), data.data(), data.size());
+    if (FAILED(error))
+        return error;
+
+    savedSize = size;
+    LOGI("Saved %zu bytes of pipeline cache to %s\n", size, path.c_str());
+    return RESULT_SUCCESS;
+}
+
+} // namespace Tobi
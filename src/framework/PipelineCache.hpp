@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "VkCommon.hpp"
+
+namespace Tobi
+{
+
+class Platform;
+
+/// @brief A VkPipelineCache which is kept on disk between runs.
+///
+/// The cache is loaded from the cache directory when it is created and written
+/// back by @ref save. Data written by another driver or device is discarded, a
+/// driver may otherwise reject it or, worse, misbehave on it. With a warm cache
+/// the driver skips compiling the pipelines it has seen before.
+class PipelineCache
+{
+  public:
+    /// @brief Constructor
+    /// @param pPath The file, relative to the cache directory.
+    PipelineCache(std::shared_ptr<Platform> platform, const char *pPath);
+    PipelineCache(const PipelineCache &) = delete;
+    PipelineCache(PipelineCache &&) = delete;
+    PipelineCache &operator=(const PipelineCache &) & = delete;
+    PipelineCache &operator=(PipelineCache &&) & = delete;
+
+    /// @brief Destructor, saves the cache.
+    ~PipelineCache();
+
+    VkPipelineCache getCache() const { return cache; }
+
+    /// @brief True when valid data was loaded from disk.
+    bool isWarm() const { return warm; }
+
+    /// @brief Writes the cache to disk when it has grown since it was last written.
+    /// Cheap when nothing changed, so it can be called periodically.
+    /// @returns Error code
+    Result save();
+
+  private:
+    std::shared_ptr<Platform> platform;
+    std::string path;
+    VkPipelineCache cache;
+    bool warm;
+    size_t savedSize;
+
+    /// @brief Checks that the data was written by this driver for this device.
+    bool validateHeader(const std::vector<uint8_t> &data) const;
+};
+
+} // namespace Tobi
@@ -4,10 +4,21 @@
 namespace Tobi
 {
 
+// Written once per frame into the frame's uniform buffer, set 0 binding 0 of
+// the graphics pipelines. Laid out like the std140 frame_block of the shaders.
+// The model matrices are in the transform buffer, indexed by instance.
 struct ShaderDataBlock
 {
-    glm::mat4x4 modelMatrix;
     glm::mat4x4 viewProjectionMatrix;
+    glm::mat4x4 viewMatrix;
+    glm::mat4x4 projectionMatrix;
+    // w is unused.
+    glm::vec4 cameraPosition;
+    // World space, w is unused.
+    glm::vec4 lightPosition;
+    // Seconds since the start.
+    float time;
+    float padding[3];
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,43 @@
+#include "TimelineSemaphore.hpp"
+
+namespace Tobi
+{
+
+TimelineSemaphore::TimelineSemaphore(VkDevice device)
+    : device(device),
+      semaphore(VK_NULL_HANDLE)
+{
+    LOGI("CONSTRUCTING TimelineSemaphore\n");
+
+    VkSemaphoreTypeCreateInfo typeInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semaphoreInfo.pNext = &typeInfo;
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore));
+}
+
+TimelineSemaphore::~TimelineSemaphore()
+{
+    LOGI("DECONSTRUCTING TimelineSemaphore\n");
+    vkDestroySemaphore(device, semaphore, nullptr);
+}
+
+uint64_t TimelineSemaphore::getCompletedValue() const
+{
+    uint64_t value = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, semaphore, &value));
+    return value;
+}
+
+void TimelineSemaphore::wait(uint64_t value) const
+{
+    VkSemaphoreWaitInfo waitInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &value;
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
+
+} // namespace Tobi
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "framework/Common.hpp"
+#include "VkCommon.hpp"
+
+namespace Tobi
+{
+/// @brief A semaphore whose payload is a monotonically increasing 64 bit value.
+///
+/// Every submission signals a larger value than the one before, so the progress
+/// of a queue is a single number. The CPU can wait for or poll a value instead
+/// of keeping a fence per submission, and other queues can wait for a value in
+/// their own submissions.
+///
+/// Requires Vulkan 1.2, see @ref Platform::supportsTimelineSemaphores.
+class TimelineSemaphore
+{
+  public:
+    /// @brief Constructor
+    /// @param device The Vulkan device
+    TimelineSemaphore(VkDevice device);
+
+    TimelineSemaphore(const TimelineSemaphore &) = delete;
+    TimelineSemaphore(TimelineSemaphore &&) = delete;
+    TimelineSemaphore &operator=(const TimelineSemaphore &) & = delete;
+    TimelineSemaphore &operator=(TimelineSemaphore &&) & = delete;
+
+    /// @brief Destructor
+    ~TimelineSemaphore();
+
+    const VkSemaphore &getSemaphore() const { return semaphore; }
+
+    /// @brief Gets the largest value signaled on the device, without blocking.
+    uint64_t getCompletedValue() const;
+
+    /// @brief Blocks until the device has signaled at least value.
+    void wait(uint64_t value) const;
+
+  private:
+    VkDevice device;
+    VkSemaphore semaphore;
+};
+
+} // namespace Tobi
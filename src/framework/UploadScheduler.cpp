@@ -0,0 +1,374 @@
+#include "UploadScheduler.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ComputeScheduler.hpp"
+#include "../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+// A batch is recorded per frame, this many can be in flight on the transfer queue.
+static const uint32_t maxBatchesInFlight = 4;
+static const VkDeviceSize stagingAlignment = 16;
+// Space left at the end of the ring smaller than this is skipped instead of
+// splitting a copy into a small piece.
+static const VkDeviceSize minStagingChunk = 64 * 1024;
+
+static VkDeviceSize alignStaging(VkDeviceSize size)
+{
+    return (size + stagingAlignment - 1) & ~(stagingAlignment - 1);
+}
+
+UploadScheduler::UploadScheduler(std::shared_ptr<Platform> platform,
+                                 VkDeviceSize stagingSize,
+                                 VkDeviceSize frameBudget)
+    : platform(platform),
+      queue(platform->getTransferQueue()),
+      queueFamilyIndex(static_cast<uint32_t>(platform->getTransferQueueFamilyIndex())),
+      graphicsQueueFamilyIndex(static_cast<uint32_t>(platform->getGraphicsQueueFamilyIndex())),
+      stagingBufferManager(platform),
+      stagingBufferId(0),
+      pStagingData(nullptr),
+      stagingSize(alignStaging(stagingSize)),
+      stagingHead(0),
+      stagingTail(0),
+      stagingUsed(0),
+      frameBudget(frameBudget),
+      batches(std::vector<Batch>()),
+      submittedBatches(std::deque<uint32_t>()),
+      freeBatches(std::vector<uint32_t>()),
+      timeline(nullptr),
+      serial(0),
+      requests(std::deque<Request>()),
+      pendingBytes(0),
+      ticketCounter(0),
+      completedHandoffs(std::vector<Handoff>()),
+      completedTicket(0),
+      acquiredTicket(0)
+{
+    LOGI("CONSTRUCTING UploadScheduler\n");
+
+    auto device = platform->getDevice();
+
+    if (platform->supportsTimelineSemaphores())
+        timeline = std::make_unique<TimelineSemaphore>(device);
+
+    stagingBufferId = stagingBufferManager.createBuffer(nullptr,
+                                                        static_cast<uint32_t>(this->stagingSize),
+                                                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    pStagingData = static_cast<uint8_t *>(stagingBufferManager.mapBuffer(stagingBufferId));
+
+    for (uint32_t i = 0; i < maxBatchesInFlight; i++)
+    {
+        Batch batch = {};
+        batch.commandManager = std::make_unique<CommandBufferManager>(device,
+                                                                      VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                                                      queueFamilyIndex);
+        if (!timeline)
+        {
+            VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+            VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &batch.fence));
+        }
+
+        batches.push_back(std::move(batch));
+        freeBatches.push_back(i);
+    }
+
+    LOGI("Uploads are submitted to the %s queue.\n",
+         queueFamilyIndex != graphicsQueueFamilyIndex ? "transfer" : "graphics");
+}
+
+UploadScheduler::~UploadScheduler()
+{
+    LOGI("DECONSTRUCTING UploadScheduler\n");
+
+    for (auto &batch : batches)
+    {
+        if (batch.fence != VK_NULL_HANDLE)
+            vkDestroyFence(platform->getDevice(), batch.fence, nullptr);
+    }
+}
+
+uint64_t UploadScheduler::enqueue(VkBuffer buffer,
+                                  const void *pData,
+                                  VkDeviceSize size,
+                                  VkPipelineStageFlags stage,
+                                  VkAccessFlags access)
+{
+    // Nothing to wait for, ticket 0 is always complete.
+    if (size == 0)
+        return 0;
+
+    Request request = {};
+    request.ticket = ++ticketCounter;
+    request.buffer = buffer;
+    request.pData = static_cast<const uint8_t *>(pData);
+    request.size = size;
+    request.copied = 0;
+    request.stage = stage;
+    request.access = access;
+    requests.push_back(request);
+
+    pendingBytes += size;
+
+    return request.ticket;
+}
+
+void UploadScheduler::cancel(VkBuffer buffer)
+{
+    for (auto request = requests.begin(); request != requests.end();)
+    {
+        if (request->buffer == buffer)
+        {
+            pendingBytes -= request->size - request->copied;
+            request = requests.erase(request);
+        }
+        else
+        {
+            request++;
+        }
+    }
+
+    // The buffer is never handed to graphics.
+    auto isCancelled = [buffer](const Handoff &handoff) { return handoff.buffer == buffer; };
+    completedHandoffs.erase(std::remove_if(completedHandoffs.begin(), completedHandoffs.end(), isCancelled),
+                            completedHandoffs.end());
+    for (auto batchIndex : submittedBatches)
+    {
+        auto &handoffs = batches[batchIndex].handoffs;
+        handoffs.erase(std::remove_if(handoffs.begin(), handoffs.end(), isCancelled), handoffs.end());
+    }
+}
+
+bool UploadScheduler::isBatchComplete(const Batch &batch) const
+{
+    if (timeline)
+        return timeline->getCompletedValue() >= batch.serial;
+
+    return vkGetFenceStatus(platform->getDevice(), batch.fence) == VK_SUCCESS;
+}
+
+void UploadScheduler::retireBatches()
+{
+    // Batches complete in submission order, so do their staging ranges.
+    while (!submittedBatches.empty())
+    {
+        auto batchIndex = submittedBatches.front();
+        auto &batch = batches[batchIndex];
+        if (!isBatchComplete(batch))
+            break;
+
+        stagingUsed -= batch.stagingBytes;
+        stagingTail = batch.stagingEnd;
+
+        if (batch.lastTicket)
+            completedTicket = batch.lastTicket;
+        completedHandoffs.insert(completedHandoffs.end(), batch.handoffs.begin(), batch.handoffs.end());
+
+        submittedBatches.pop_front();
+        freeBatches.push_back(batchIndex);
+    }
+
+    if (stagingUsed == 0)
+    {
+        stagingHead = 0;
+        stagingTail = 0;
+    }
+}
+
+VkDeviceSize UploadScheduler::allocateStaging(VkDeviceSize size, Batch &batch, VkDeviceSize &offset)
+{
+    if (stagingUsed == stagingSize)
+        return 0;
+
+    VkDeviceSize available;
+    if (stagingHead >= stagingTail)
+    {
+        // The free space is the end of the ring followed by its start.
+        available = stagingSize - stagingHead;
+        if (available < size && available < minStagingChunk && stagingTail > 0)
+        {
+            batch.stagingBytes += available;
+            stagingUsed += available;
+            stagingHead = 0;
+            available = stagingTail;
+        }
+    }
+    else
+    {
+        available = stagingTail - stagingHead;
+    }
+
+    auto reserved = std::min(size, available);
+    if (reserved == 0)
+        return 0;
+
+    // Positions stay aligned, so the aligned size always fits into available.
+    auto consumed = alignStaging(reserved);
+    offset = stagingHead;
+    stagingHead += consumed;
+    stagingUsed += consumed;
+    batch.stagingBytes += consumed;
+    batch.stagingEnd = stagingHead;
+
+    return reserved;
+}
+
+void UploadScheduler::flush()
+{
+    retireBatches();
+
+    if (requests.empty() || freeBatches.empty())
+        return;
+
+    auto batchIndex = freeBatches.back();
+    auto &batch = batches[batchIndex];
+    batch.stagingBytes = 0;
+    batch.stagingEnd = stagingHead;
+    batch.lastTicket = 0;
+    batch.handoffs.clear();
+
+    auto stagingBuffer = stagingBufferManager.getBuffer(stagingBufferId).buffer;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+    auto budget = frameBudget;
+    while (!requests.empty() && budget > 0)
+    {
+        auto &request = requests.front();
+
+        VkDeviceSize stagingOffset = 0;
+        auto size = allocateStaging(std::min(request.size - request.copied, budget), batch, stagingOffset);
+        if (size == 0)
+            break;
+
+        if (commandBuffer == VK_NULL_HANDLE)
+        {
+            batch.commandManager->beginFrame();
+            commandBuffer = batch.commandManager->requestCommandBuffer();
+
+            VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        }
+
+        // The staging memory is host coherent, the submission makes the write visible.
+        memcpy(pStagingData + stagingOffset, request.pData + request.copied, size);
+
+        VkBufferCopy region = {};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = request.copied;
+        region.size = size;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, request.buffer, 1, &region);
+
+        request.copied += size;
+        budget -= size;
+        pendingBytes -= size;
+
+        if (request.copied == request.size)
+        {
+            batch.lastTicket = request.ticket;
+            batch.handoffs.push_back({request.buffer, request.stage, request.access});
+            requests.pop_front();
+        }
+    }
+
+    // The staging ring is full until earlier batches complete.
+    if (commandBuffer == VK_NULL_HANDLE)
+        return;
+
+    // Buffers which are only partially copied stay with the transfer queue.
+    if (queueFamilyIndex != graphicsQueueFamilyIndex && !batch.handoffs.empty())
+    {
+        std::vector<VkBuffer> buffers;
+        for (const auto &handoff : batch.handoffs)
+            buffers.push_back(handoff.buffer);
+
+        ComputeScheduler::recordOwnershipTransfer(commandBuffer,
+                                                  buffers.data(),
+                                                  static_cast<uint32_t>(buffers.size()),
+                                                  queueFamilyIndex,
+                                                  graphicsQueueFamilyIndex,
+                                                  true,
+                                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                                  VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    VkFence fence = VK_NULL_HANDLE;
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    if (timeline)
+    {
+        batch.serial = ++serial;
+
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &batch.serial;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &timeline->getSemaphore();
+    }
+    else
+    {
+        fence = batch.fence;
+        VK_CHECK(vkResetFences(platform->getDevice(), 1, &fence));
+    }
+
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+
+    freeBatches.pop_back();
+    submittedBatches.push_back(batchIndex);
+}
+
+void UploadScheduler::acquireCompleted(VkCommandBuffer commandBuffer)
+{
+    if (!completedHandoffs.empty())
+    {
+        // The transfer has been seen to complete on the host, which orders the
+        // copies and releases before this command buffer without a semaphore.
+        if (queueFamilyIndex != graphicsQueueFamilyIndex)
+        {
+            for (const auto &handoff : completedHandoffs)
+            {
+                ComputeScheduler::recordOwnershipTransfer(commandBuffer,
+                                                          &handoff.buffer,
+                                                          1,
+                                                          queueFamilyIndex,
+                                                          graphicsQueueFamilyIndex,
+                                                          false,
+                                                          handoff.stage,
+                                                          handoff.access);
+            }
+        }
+        else
+        {
+            VkPipelineStageFlags dstStage = 0;
+            VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            for (const auto &handoff : completedHandoffs)
+            {
+                dstStage |= handoff.stage;
+                barrier.dstAccessMask |= handoff.access;
+            }
+
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 dstStage,
+                                 0,
+                                 1, &barrier,
+                                 0, nullptr,
+                                 0, nullptr);
+        }
+
+        completedHandoffs.clear();
+    }
+
+    acquiredTicket = completedTicket;
+}
+
+} // namespace Tobi
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "VkCommon.hpp"
+#include "CommandBufferManager.hpp"
+#include "TimelineSemaphore.hpp"
+#include "buffers/BufferManager.hpp"
+
+namespace Tobi
+{
+class Platform;
+
+/// @brief Streams data into device local buffers on the transfer queue.
+///
+/// Uploads are copied through a ring of staging memory in batches, at most a
+/// fixed number of bytes per frame, so large loads are spread over several
+/// frames instead of stalling one. Completion is polled on a timeline
+/// semaphore, or on a fence per batch without timeline support, and never
+/// waited on. Only finished uploads are handed to the graphics queue, so
+/// rendering does not wait for the transfer queue either.
+///
+/// When the transfer queue belongs to another family than graphics, the
+/// buffers are released by the transfer queue and acquired by graphics in
+/// @ref acquireCompleted.
+class UploadScheduler
+{
+  public:
+    /// @brief Constructor
+    /// @param platform The platform, has to be initialized.
+    /// @param stagingSize Size of the staging ring in bytes.
+    /// @param frameBudget Bytes copied per call to @ref flush at most.
+    UploadScheduler(std::shared_ptr<Platform> platform,
+                    VkDeviceSize stagingSize = defaultStagingSize,
+                    VkDeviceSize frameBudget = defaultFrameBudget);
+
+    UploadScheduler(const UploadScheduler &) = delete;
+    UploadScheduler(UploadScheduler &&) = delete;
+    UploadScheduler &operator=(const UploadScheduler &) & = delete;
+    UploadScheduler &operator=(UploadScheduler &&) & = delete;
+
+    /// @brief Destructor. The GPU must be idle.
+    ~UploadScheduler();
+
+    /// @brief Queues a copy of data into the start of a buffer.
+    /// @param buffer A buffer with transfer destination usage which has not been used by graphics yet.
+    /// @param pData Has to stay valid until @ref isComplete returns true for the ticket.
+    /// @param stage The graphics stages which will read the buffer.
+    /// @param access The accesses matching stage.
+    /// @returns A ticket for @ref isComplete.
+    uint64_t enqueue(VkBuffer buffer,
+                     const void *pData,
+                     VkDeviceSize size,
+                     VkPipelineStageFlags stage,
+                     VkAccessFlags access);
+
+    /// @brief Drops the uploads into a buffer which is about to be destroyed,
+    /// including the copies not submitted yet. Copies already submitted have to
+    /// be complete, the caller waits for the device to be idle.
+    void cancel(VkBuffer buffer);
+
+    /// @brief Retires finished batches and submits the next one, within the
+    /// frame budget. Never blocks. Called once per frame.
+    void flush();
+
+    /// @brief Records the barriers making finished uploads available to graphics.
+    /// Has to be recorded before the buffers are used, outside of a render pass.
+    void acquireCompleted(VkCommandBuffer commandBuffer);
+
+    /// @brief True once the upload can be used by commands recorded after @ref acquireCompleted.
+    bool isComplete(uint64_t ticket) const { return ticket <= acquiredTicket; }
+
+    /// @brief Bytes queued but not yet submitted.
+    VkDeviceSize getPendingBytes() const { return pendingBytes; }
+
+    static const VkDeviceSize defaultStagingSize = 32 * 1024 * 1024;
+    static const VkDeviceSize defaultFrameBudget = 8 * 1024 * 1024;
+
+  private:
+    struct Request
+    {
+        uint64_t ticket;
+        VkBuffer buffer;
+        const uint8_t *pData;
+        VkDeviceSize size;
+        // Bytes already copied in earlier batches.
+        VkDeviceSize copied;
+        VkPipelineStageFlags stage;
+        VkAccessFlags access;
+    };
+
+    /// @brief A buffer whose last copy is in a batch, to be handed to graphics.
+    struct Handoff
+    {
+        VkBuffer buffer;
+        VkPipelineStageFlags stage;
+        VkAccessFlags access;
+    };
+
+    struct Batch
+    {
+        std::unique_ptr<CommandBufferManager> commandManager;
+        // Used without timeline semaphores.
+        VkFence fence;
+        uint64_t serial;
+        // Staging bytes held by the batch, including padding, and the ring
+        // position after its last copy.
+        VkDeviceSize stagingBytes;
+        VkDeviceSize stagingEnd;
+        uint64_t lastTicket;
+        std::vector<Handoff> handoffs;
+    };
+
+    std::shared_ptr<Platform> platform;
+
+    VkQueue queue;
+    uint32_t queueFamilyIndex;
+    uint32_t graphicsQueueFamilyIndex;
+
+    BufferManager stagingBufferManager;
+    uint32_t stagingBufferId;
+    uint8_t *pStagingData;
+    VkDeviceSize stagingSize;
+    VkDeviceSize stagingHead;
+    VkDeviceSize stagingTail;
+    VkDeviceSize stagingUsed;
+
+    VkDeviceSize frameBudget;
+
+    std::vector<Batch> batches;
+    // Indices into batches of the submitted ones, oldest first.
+    std::deque<uint32_t> submittedBatches;
+    std::vector<uint32_t> freeBatches;
+
+    std::unique_ptr<TimelineSemaphore> timeline;
+    uint64_t serial;
+
+    std::deque<Request> requests;
+    VkDeviceSize pendingBytes;
+    uint64_t ticketCounter;
+
+    // Uploads finished on the transfer queue but not yet acquired by graphics.
+    std::vector<Handoff> completedHandoffs;
+    uint64_t completedTicket;
+    uint64_t acquiredTicket;
+
+    bool isBatchComplete(const Batch &batch) const;
+    void retireBatches();
+
+    /// @brief Reserves contiguous staging memory for up to size bytes.
+    /// @returns The number of bytes reserved, 0 if the ring is full.
+    VkDeviceSize allocateStaging(VkDeviceSize size, Batch &batch, VkDeviceSize &offset);
+};
+
+} // namespace Tobi
@@ -9,5 +9,7 @@ struct Buffer
     VkBuffer buffer;
     VkDeviceMemory memory;
     VkDescriptorBufferInfo bufferInfo;
+    // Host pointer to the buffer memory, only set once the buffer has been mapped.
+    void *mappedData;
 };
 } // namespace Tobi
\ No newline at end of file
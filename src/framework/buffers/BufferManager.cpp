@@ -24,13 +24,12 @@ BufferManager::~BufferManager()
     }
 }
 
-const uint32_t BufferManager::createBuffer(
+uint32_t BufferManager::createBuffer(
     const void *data,
     const uint32_t dataSize,
-    VkFlags usageFlags)
+    VkFlags usageFlags,
+    VkMemoryPropertyFlags memoryFlags)
 {
-    auto result = VK_SUCCESS;
-
     Buffer buffer;
 
     VkBufferCreateInfo bufferCreateInfo = {};
@@ -54,9 +53,15 @@ const uint32_t BufferManager::createBuffer(
     memoryAllocationInfo.memoryTypeIndex = 0;
     memoryAllocationInfo.allocationSize = memoryRequirements.size;
 
-    memoryAllocationInfo.memoryTypeIndex = platform->findMemoryTypeFromRequirements(
-        memoryRequirements.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    // Host visible memory is required for mapping, other properties are only preferred.
+    if (memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        memoryAllocationInfo.memoryTypeIndex = platform->findMemoryTypeFromRequirements(
+            memoryRequirements.memoryTypeBits,
+            memoryFlags);
+    else
+        memoryAllocationInfo.memoryTypeIndex = platform->findMemoryTypeFromRequirementsWithFallback(
+            memoryRequirements.memoryTypeBits,
+            memoryFlags);
 
     VK_CHECK(vkAllocateMemory(platform->getDevice(), &memoryAllocationInfo, nullptr, &(buffer.memory)));
 
@@ -73,10 +78,34 @@ const uint32_t BufferManager::createBuffer(
     buffer.bufferInfo.buffer = buffer.buffer;
     buffer.bufferInfo.offset = 0;
     buffer.bufferInfo.range = dataSize;
+    buffer.mappedData = nullptr;
 
     buffers.insert({idCounter, buffer});
 
     return idCounter++;
 }
 
+void *BufferManager::mapBuffer(uint32_t index)
+{
+    auto &buffer = buffers[index];
+    if (!buffer.mappedData)
+    {
+        VK_CHECK(vkMapMemory(platform->getDevice(), buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mappedData));
+    }
+
+    return buffer.mappedData;
+}
+
+void BufferManager::destroyBuffer(uint32_t index)
+{
+    auto iter = buffers.find(index);
+    if (iter == buffers.end())
+        return;
+
+    // Freeing the memory implicitly unmaps it.
+    vkDestroyBuffer(platform->getDevice(), (*iter).second.buffer, nullptr);
+    vkFreeMemory(platform->getDevice(), (*iter).second.memory, nullptr);
+    buffers.erase(iter);
+}
+
 } // namespace Tobi
\ No newline at end of file
@@ -20,11 +20,20 @@ class BufferManager
     BufferManager &operator=(BufferManager &&) & = delete;
     virtual ~BufferManager();
 
-    /// Creates a buffer and returns the id
-    const uint32_t createBuffer(
+    /// Creates a buffer and returns the id. data has to be null unless the
+    /// memory is host visible, device local buffers are filled by the UploadScheduler.
+    uint32_t createBuffer(
         const void *data,
         const uint32_t dataSize,
-        VkFlags usageFlags);
+        VkFlags usageFlags,
+        VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    /// Maps the buffer the first time it is called. The memory stays mapped
+    /// until the buffer is destroyed.
+    void *mapBuffer(uint32_t index);
+
+    /// Destroys the buffer. The caller has to make sure the GPU is done with it.
+    void destroyBuffer(uint32_t index);
 
     const Buffer &getBuffer(uint32_t index)
     {
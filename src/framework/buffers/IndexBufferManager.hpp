@@ -15,9 +15,12 @@ class IndexBufferManager : public BufferManager
     IndexBufferManager &operator=(IndexBufferManager &&) & = delete;
     ~IndexBufferManager() = default;
 
-    const uint32_t createBuffer(
+    uint32_t createBuffer(
         const void *data,
         const uint32_t dataSize);
+
+    /// Creates a device local buffer which can be filled through the UploadScheduler.
+    uint32_t createDeviceLocalBuffer(const uint32_t dataSize);
 };
 
 } // namespace Tobi
\ No newline at end of file
@@ -0,0 +1,23 @@
+#include "InstanceBufferManager.hpp"
+
+namespace Tobi
+{
+
+InstanceBufferManager::InstanceBufferManager(
+    std::shared_ptr<Platform> platform)
+    : BufferManager(platform)
+{
+    LOGI("CONSTRUCTING InstanceBufferManager\n");
+}
+
+uint32_t InstanceBufferManager::createBuffer(
+    const void *data,
+    const uint32_t dataSize)
+{
+    return BufferManager::createBuffer(
+        data,
+        dataSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+}
+
+} // namespace Tobi
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "BufferManager.hpp"
+
+namespace Tobi
+{
+
+/// @brief Manages host visible storage buffers holding per-instance data,
+/// which are rewritten by the CPU every frame and indexed by the vertex shaders
+/// with gl_InstanceIndex.
+class InstanceBufferManager : public BufferManager
+{
+  public:
+    InstanceBufferManager(std::shared_ptr<Platform> platform);
+    InstanceBufferManager(const InstanceBufferManager &) = delete;
+    InstanceBufferManager(InstanceBufferManager &&) = delete;
+    InstanceBufferManager &operator=(const InstanceBufferManager &) & = delete;
+    InstanceBufferManager &operator=(InstanceBufferManager &&) & = delete;
+    ~InstanceBufferManager() = default;
+
+    uint32_t createBuffer(
+        const void *data,
+        const uint32_t dataSize);
+};
+
+} // namespace Tobi
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "StorageBufferManager.hpp"
+
+namespace Tobi
+{
+
+StorageBufferManager::StorageBufferManager(
+    std::shared_ptr<Platform> platform)
+    : BufferManager(platform)
+{
+    LOGI("CONSTRUCTING StorageBufferManager\n");
+}
+
+uint32_t StorageBufferManager::createBuffer(
+    const void *data,
+    const uint32_t dataSize,
+    VkFlags additionalUsageFlags)
+{
+    return BufferManager::createBuffer(
+        data,
+        dataSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | additionalUsageFlags);
+}
+
+} // namespace Tobi
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "BufferManager.hpp"
+
+namespace Tobi
+{
+
+/// @brief Manages host visible storage buffers which are read or written by
+/// shaders, optionally also used as vertex or indirect buffers.
+class StorageBufferManager : public BufferManager
+{
+  public:
+    StorageBufferManager(std::shared_ptr<Platform> platform);
+    StorageBufferManager(const StorageBufferManager &) = delete;
+    StorageBufferManager(StorageBufferManager &&) = delete;
+    StorageBufferManager &operator=(const StorageBufferManager &) & = delete;
+    StorageBufferManager &operator=(StorageBufferManager &&) & = delete;
+    ~StorageBufferManager() = default;
+
+    /// @param additionalUsageFlags Usages besides `VK_BUFFER_USAGE_STORAGE_BUFFER_BIT`.
+    uint32_t createBuffer(
+        const void *data,
+        const uint32_t dataSize,
+        VkFlags additionalUsageFlags = 0);
+};
+
+} // namespace Tobi
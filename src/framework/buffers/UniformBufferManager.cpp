@@ -10,7 +10,7 @@ UniformBufferManager::UniformBufferManager(
     LOGI("CONSTRUCTING UniformBufferManager\n");
 }
 
-const uint32_t UniformBufferManager::createBuffer(
+uint32_t UniformBufferManager::createBuffer(
     const void *data,
     const uint32_t dataSize)
 {
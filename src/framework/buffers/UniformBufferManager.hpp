@@ -15,7 +15,7 @@ class UniformBufferManager : public BufferManager
     UniformBufferManager &operator=(UniformBufferManager &&) & = delete;
     ~UniformBufferManager() = default;
 
-    const uint32_t createBuffer(
+    uint32_t createBuffer(
         const void *data,
         const uint32_t dataSize);
 };
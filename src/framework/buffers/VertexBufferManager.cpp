@@ -10,7 +10,7 @@ VertexBufferManager::VertexBufferManager(
     LOGI("CONSTRUCTING VertexBufferManager\n");
 }
 
-const uint32_t VertexBufferManager::createBuffer(
+uint32_t VertexBufferManager::createBuffer(
     const void *data,
     const uint32_t dataSize)
 {
@@ -20,4 +20,13 @@ const uint32_t VertexBufferManager::createBuffer(
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 }
 
+uint32_t VertexBufferManager::createDeviceLocalBuffer(const uint32_t dataSize)
+{
+    return BufferManager::createBuffer(
+        nullptr,
+        dataSize,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
 } // namespace Tobi
\ No newline at end of file
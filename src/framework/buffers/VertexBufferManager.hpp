@@ -15,9 +15,12 @@ class VertexBufferManager : public BufferManager
     VertexBufferManager &operator=(VertexBufferManager &&) & = delete;
     ~VertexBufferManager() = default;
 
-    const uint32_t createBuffer(
+    uint32_t createBuffer(
         const void *data,
         const uint32_t dataSize);
+
+    /// Creates a device local buffer which can be filled through the UploadScheduler.
+    uint32_t createDeviceLocalBuffer(const uint32_t dataSize);
 };
 
 } // namespace Tobi
\ No newline at end of file
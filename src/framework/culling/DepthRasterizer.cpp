@@ -0,0 +1,282 @@
+#include "DepthRasterizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TOBI_RASTER_SSE 1
+#endif
+
+#include "framework/Common.hpp"
+#include "../jobs/JobSystem.hpp"
+
+namespace Tobi
+{
+
+const uint32_t DepthRasterizer::width;
+const uint32_t DepthRasterizer::height;
+const uint32_t DepthRasterizer::tileWidth;
+const uint32_t DepthRasterizer::tileHeight;
+const uint32_t DepthRasterizer::tilesX;
+const uint32_t DepthRasterizer::tilesY;
+const uint32_t DepthRasterizer::blockSize;
+const uint32_t DepthRasterizer::blocksX;
+const uint32_t DepthRasterizer::blocksY;
+
+// Rectangles larger than this are only tested against the coarse level.
+static const uint32_t maxFineTestPixels = 32 * 32;
+
+DepthRasterizer::DepthRasterizer(std::shared_ptr<JobSystem> jobSystem)
+    : jobSystem(jobSystem),
+      depth(std::vector<float>(width * height, 1.f)),
+      blockMaxDepth(std::vector<float>(blocksX * blocksY, 1.f)),
+      triangles(std::vector<std::vector<ScreenTriangle>>()),
+      triangleCount(0)
+{
+    LOGI("CONSTRUCTING DepthRasterizer\n");
+}
+
+void DepthRasterizer::rasterize(const std::vector<OccluderMesh> &occluders)
+{
+    auto occluderCount = static_cast<uint32_t>(occluders.size());
+    if (triangles.size() < occluderCount)
+        triangles.resize(occluderCount);
+
+    jobSystem->parallelFor(occluderCount, 1, [this, &occluders](uint32_t begin, uint32_t end) {
+        for (auto i = begin; i < end; i++)
+        {
+            triangles[i].clear();
+            setupTriangles(occluders[i], triangles[i]);
+        }
+    });
+
+    // Lists past the current occluder count hold stale triangles from earlier frames.
+    for (auto i = occluderCount; i < triangles.size(); i++)
+    {
+        triangles[i].clear();
+    }
+
+    triangleCount = 0;
+    for (const auto &list : triangles)
+    {
+        triangleCount += static_cast<uint32_t>(list.size());
+    }
+
+    jobSystem->parallelFor(tilesX * tilesY, 1, [this](uint32_t begin, uint32_t end) {
+        for (auto tile = begin; tile < end; tile++)
+        {
+            rasterizeTile(tile % tilesX, tile / tilesX);
+        }
+    });
+}
+
+void DepthRasterizer::setupTriangles(const OccluderMesh &occluder, std::vector<ScreenTriangle> &output) const
+{
+    std::vector<glm::vec4> clip(occluder.vertexCount);
+    for (uint32_t i = 0; i < occluder.vertexCount; i++)
+    {
+        clip[i] = occluder.modelViewProjectionMatrix * glm::vec4(occluder.vertices[i].position, 1.f);
+    }
+
+    for (uint32_t i = 0; i + 2 < occluder.indexCount; i += 3)
+    {
+        const auto &clipA = clip[occluder.indices[i]];
+        const auto &clipB = clip[occluder.indices[i + 1]];
+        const auto &clipC = clip[occluder.indices[i + 2]];
+
+        // Triangles crossing the near plane are dropped instead of clipped.
+        // This only makes the buffer less complete, never wrong.
+        if (clipA.z < 0.f || clipB.z < 0.f || clipC.z < 0.f ||
+            clipA.w <= 0.f || clipB.w <= 0.f || clipC.w <= 0.f)
+            continue;
+
+        glm::vec3 a(toScreen(clipA.x / clipA.w, clipA.y / clipA.w), clipA.z / clipA.w);
+        glm::vec3 b(toScreen(clipB.x / clipB.w, clipB.y / clipB.w), clipB.z / clipB.w);
+        glm::vec3 c(toScreen(clipC.x / clipC.w, clipC.y / clipC.w), clipC.z / clipC.w);
+
+        auto area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::fabs(area) < 1e-6f)
+            continue;
+
+        // Occluders are rasterized double sided, so just fix up the winding.
+        if (area < 0.f)
+        {
+            std::swap(b, c);
+            area = -area;
+        }
+
+        ScreenTriangle triangle;
+        triangle.minX = std::max(0, static_cast<int32_t>(std::floor(std::min(a.x, std::min(b.x, c.x)))));
+        triangle.minY = std::max(0, static_cast<int32_t>(std::floor(std::min(a.y, std::min(b.y, c.y)))));
+        triangle.maxX = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil(std::max(a.x, std::max(b.x, c.x)))));
+        triangle.maxY = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil(std::max(a.y, std::max(b.y, c.y)))));
+
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            continue;
+
+        const glm::vec3 *vertices[3] = {&a, &b, &c};
+        for (auto edge = 0; edge < 3; edge++)
+        {
+            const auto &v0 = *vertices[edge];
+            const auto &v1 = *vertices[(edge + 1) % 3];
+            triangle.edgeA[edge] = v0.y - v1.y;
+            triangle.edgeB[edge] = v1.x - v0.x;
+            triangle.edgeC[edge] = v0.x * v1.y - v0.y * v1.x;
+        }
+
+        triangle.depthA = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+        triangle.depthB = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+        triangle.depthC = a.z - triangle.depthA * a.x - triangle.depthB * a.y;
+
+        output.push_back(triangle);
+    }
+}
+
+void DepthRasterizer::rasterizeTile(uint32_t tileX, uint32_t tileY)
+{
+    const auto tileMinX = static_cast<int32_t>(tileX * tileWidth);
+    const auto tileMinY = static_cast<int32_t>(tileY * tileHeight);
+    const auto tileMaxX = tileMinX + static_cast<int32_t>(tileWidth) - 1;
+    const auto tileMaxY = tileMinY + static_cast<int32_t>(tileHeight) - 1;
+
+    for (auto y = tileMinY; y <= tileMaxY; y++)
+    {
+        std::fill_n(&depth[y * width + tileMinX], tileWidth, 1.f);
+    }
+
+    for (const auto &list : triangles)
+    {
+        for (const auto &triangle : list)
+        {
+            if (triangle.maxX < tileMinX || triangle.minX > tileMaxX ||
+                triangle.maxY < tileMinY || triangle.minY > tileMaxY)
+                continue;
+
+            // Tiles are a multiple of four pixels wide, so aligning the start keeps
+            // every group of four inside the tile.
+            auto startX = std::max(triangle.minX, tileMinX) & ~3;
+            auto endX = std::min(triangle.maxX, tileMaxX);
+            auto startY = std::max(triangle.minY, tileMinY);
+            auto endY = std::min(triangle.maxY, tileMaxY);
+
+#if TOBI_RASTER_SSE
+            const auto laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const auto zero = _mm_setzero_ps();
+            const auto edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+            const auto edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+            const auto edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+            const auto depthA = _mm_set1_ps(triangle.depthA);
+
+            for (auto y = startY; y <= endY; y++)
+            {
+                auto pixelY = y + 0.5f;
+                auto row0 = _mm_set1_ps(triangle.edgeB[0] * pixelY + triangle.edgeC[0]);
+                auto row1 = _mm_set1_ps(triangle.edgeB[1] * pixelY + triangle.edgeC[1]);
+                auto row2 = _mm_set1_ps(triangle.edgeB[2] * pixelY + triangle.edgeC[2]);
+                auto rowDepth = _mm_set1_ps(triangle.depthB * pixelY + triangle.depthC);
+
+                for (auto x = startX; x <= endX; x += 4)
+                {
+                    auto pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+
+                    auto inside = _mm_and_ps(
+                        _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, pixelX), row0), zero),
+                                   _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, pixelX), row1), zero)),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, pixelX), row2), zero));
+
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    auto *pDepth = &depth[y * width + x];
+                    auto oldDepth = _mm_loadu_ps(pDepth);
+                    auto newDepth = _mm_min_ps(oldDepth, _mm_add_ps(_mm_mul_ps(depthA, pixelX), rowDepth));
+                    _mm_storeu_ps(pDepth, _mm_or_ps(_mm_and_ps(inside, newDepth), _mm_andnot_ps(inside, oldDepth)));
+                }
+            }
+#else
+            for (auto y = startY; y <= endY; y++)
+            {
+                auto pixelY = y + 0.5f;
+                for (auto x = startX; x <= endX; x++)
+                {
+                    auto pixelX = x + 0.5f;
+                    auto inside = true;
+                    for (auto edge = 0; edge < 3 && inside; edge++)
+                    {
+                        inside = triangle.edgeA[edge] * pixelX + triangle.edgeB[edge] * pixelY + triangle.edgeC[edge] >= 0.f;
+                    }
+
+                    if (!inside)
+                        continue;
+
+                    auto &pixel = depth[y * width + x];
+                    pixel = std::min(pixel, triangle.depthA * pixelX + triangle.depthB * pixelY + triangle.depthC);
+                }
+            }
+#endif
+        }
+    }
+
+    // Reduce the tile to the coarse level. Blocks never straddle tiles.
+    for (auto blockY = tileMinY / blockSize; blockY <= tileMaxY / blockSize; blockY++)
+    {
+        for (auto blockX = tileMinX / blockSize; blockX <= tileMaxX / blockSize; blockX++)
+        {
+            auto maxDepth = 0.f;
+            for (uint32_t y = 0; y < blockSize; y++)
+            {
+                const auto *pRow = &depth[(blockY * blockSize + y) * width + blockX * blockSize];
+                for (uint32_t x = 0; x < blockSize; x++)
+                {
+                    maxDepth = std::max(maxDepth, pRow[x]);
+                }
+            }
+            blockMaxDepth[blockY * blocksX + blockX] = maxDepth;
+        }
+    }
+}
+
+bool DepthRasterizer::isOccluded(float minX, float minY, float maxX, float maxY, float minDepth) const
+{
+    auto x0 = std::max(0, static_cast<int32_t>(std::floor(minX)));
+    auto y0 = std::max(0, static_cast<int32_t>(std::floor(minY)));
+    auto x1 = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil(maxX)));
+    auto y1 = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil(maxY)));
+
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    auto coarseOccluded = true;
+    for (auto blockY = y0 / static_cast<int32_t>(blockSize); blockY <= y1 / static_cast<int32_t>(blockSize) && coarseOccluded; blockY++)
+    {
+        for (auto blockX = x0 / static_cast<int32_t>(blockSize); blockX <= x1 / static_cast<int32_t>(blockSize); blockX++)
+        {
+            if (blockMaxDepth[blockY * blocksX + blockX] >= minDepth)
+            {
+                coarseOccluded = false;
+                break;
+            }
+        }
+    }
+
+    if (coarseOccluded)
+        return true;
+
+    // The blocks are conservative, small rectangles get a second chance per pixel.
+    if (static_cast<uint32_t>((x1 - x0 + 1) * (y1 - y0 + 1)) > maxFineTestPixels)
+        return false;
+
+    for (auto y = y0; y <= y1; y++)
+    {
+        for (auto x = x0; x <= x1; x++)
+        {
+            if (depth[y * width + x] >= minDepth)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace Tobi
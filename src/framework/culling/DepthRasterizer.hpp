@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "../model/Vertex.hpp"
+
+namespace Tobi
+{
+
+class JobSystem;
+
+/// @brief Geometry of one occluder, referenced rather than copied.
+struct OccluderMesh
+{
+    glm::mat4 modelViewProjectionMatrix;
+    const Vertex *vertices;
+    uint32_t vertexCount;
+    const uint32_t *indices;
+    uint32_t indexCount;
+};
+
+/// @brief Low resolution CPU depth buffer used for occlusion culling.
+///
+/// Occluder triangles are transformed on the job system and then rasterized
+/// one screen tile per job, four pixels at a time. Every tile also reduces its
+/// pixels to a coarse level holding the farthest depth of each block, which
+/// lets most occludees be rejected with a handful of comparisons.
+class DepthRasterizer
+{
+  public:
+    static const uint32_t width = 256;
+    static const uint32_t height = 128;
+
+    static const uint32_t tileWidth = 64;
+    static const uint32_t tileHeight = 32;
+    static const uint32_t tilesX = width / tileWidth;
+    static const uint32_t tilesY = height / tileHeight;
+
+    static const uint32_t blockSize = 8;
+    static const uint32_t blocksX = width / blockSize;
+    static const uint32_t blocksY = height / blockSize;
+
+    explicit DepthRasterizer(std::shared_ptr<JobSystem> jobSystem);
+    DepthRasterizer(const DepthRasterizer &) = delete;
+    DepthRasterizer(DepthRasterizer &&) = delete;
+    DepthRasterizer &operator=(const DepthRasterizer &) & = delete;
+    DepthRasterizer &operator=(DepthRasterizer &&) & = delete;
+    ~DepthRasterizer() = default;
+
+    /// @brief Clears the depth buffer and rasterizes the occluders into it.
+    void rasterize(const std::vector<OccluderMesh> &occluders);
+
+    /// @brief Tests a screen space rectangle against the depth buffer.
+    /// @param minX, minY, maxX, maxY The rectangle in pixels.
+    /// @param minDepth The depth of the closest point of the occludee.
+    /// @returns true if every covered pixel holds an occluder closer than minDepth.
+    bool isOccluded(float minX, float minY, float maxX, float maxY, float minDepth) const;
+
+    /// @brief Converts normalized device coordinates to pixel coordinates.
+    static glm::vec2 toScreen(float x, float y)
+    {
+        return glm::vec2((x * 0.5f + 0.5f) * width, (y * 0.5f + 0.5f) * height);
+    }
+
+    /// Number of triangles which survived setup in the last call to rasterize.
+    uint32_t getTriangleCount() const { return triangleCount; }
+
+  private:
+    struct ScreenTriangle
+    {
+        // Edge functions e(x, y) = a * x + b * y + c, positive inside.
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        // Depth plane z(x, y) = a * x + b * y + c.
+        float depthA;
+        float depthB;
+        float depthC;
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+    };
+
+    std::shared_ptr<JobSystem> jobSystem;
+
+    std::vector<float> depth;
+    std::vector<float> blockMaxDepth;
+
+    // One list per occluder so setup can run in parallel without locking.
+    std::vector<std::vector<ScreenTriangle>> triangles;
+    uint32_t triangleCount;
+
+    void setupTriangles(const OccluderMesh &occluder, std::vector<ScreenTriangle> &output) const;
+    void rasterizeTile(uint32_t tileX, uint32_t tileY);
+};
+
+} // namespace Tobi
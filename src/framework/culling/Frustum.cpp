@@ -0,0 +1,49 @@
+#include "Frustum.hpp"
+
+namespace Tobi
+{
+
+Frustum::Frustum(const glm::mat4 &viewProjectionMatrix)
+{
+    // glm is column major, so the rows of the matrix are gathered across the columns.
+    const auto &m = viewProjectionMatrix;
+    glm::vec4 rows[4];
+    for (auto i = 0; i < 4; i++)
+    {
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+
+    // Gribb/Hartmann plane extraction. Vulkan clip space has 0 <= z <= w,
+    // so the near plane is the third row on its own.
+    planes[PLANE_LEFT] = rows[3] + rows[0];
+    planes[PLANE_RIGHT] = rows[3] - rows[0];
+    planes[PLANE_BOTTOM] = rows[3] + rows[1];
+    planes[PLANE_TOP] = rows[3] - rows[1];
+    planes[PLANE_NEAR] = rows[2];
+    planes[PLANE_FAR] = rows[3] - rows[2];
+
+    // Normalize so that the plane distance is in world units and can be
+    // compared directly against a sphere radius.
+    for (auto &plane : planes)
+    {
+        auto length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+        plane = plane / length;
+    }
+}
+
+bool Frustum::intersectsBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+{
+    for (const auto &plane : planes)
+    {
+        // The corner furthest along the normal is the last one to leave the plane.
+        glm::vec3 corner(plane.x >= 0.f ? boxMax.x : boxMin.x,
+                         plane.y >= 0.f ? boxMax.y : boxMin.y,
+                         plane.z >= 0.f ? boxMax.z : boxMin.z);
+        if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.f)
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace Tobi
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace Tobi
+{
+
+/// @brief The six planes of a view frustum.
+///
+/// Each plane is stored as (normal, distance) with the normal pointing into the
+/// frustum, so a point p is inside a plane when dot(normal, p) + distance >= 0.
+struct Frustum
+{
+    enum Plane
+    {
+        PLANE_LEFT = 0,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP,
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_COUNT
+    };
+
+    /// @brief Extracts the planes from a view projection matrix.
+    /// The matrix is expected to map depth to the Vulkan [0, 1] range.
+    /// @param viewProjectionMatrix The combined view and projection matrix.
+    explicit Frustum(const glm::mat4 &viewProjectionMatrix);
+
+    /// @brief Conservative test of an axis aligned box, which is only rejected
+    /// when it is entirely behind one of the planes.
+    bool intersectsBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+
+    glm::vec4 planes[PLANE_COUNT];
+};
+
+} // namespace Tobi
@@ -0,0 +1,142 @@
+#include "FrustumCuller.hpp"
+
+#include "framework/Common.hpp"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TOBI_CULL_SSE 1
+#endif
+
+#include "../model/ModelManager.hpp"
+#include "../model/ObjectManager.hpp"
+
+namespace Tobi
+{
+
+static const uint32_t simdWidth = 4;
+
+FrustumCuller::FrustumCuller()
+    : centerX(std::vector<float>()),
+      centerY(std::vector<float>()),
+      centerZ(std::vector<float>()),
+      radius(std::vector<float>()),
+      objectIds(std::vector<uint32_t>()),
+      objectCount(0),
+      boundsVersion(0),
+      hasBounds(false)
+{
+    LOGI("CONSTRUCTING FrustumCuller\n");
+}
+
+void FrustumCuller::updateBounds(ObjectManager &objectManager, ModelManager &modelManager)
+{
+    if (hasBounds && boundsVersion == objectManager.getVersion())
+        return;
+
+    const auto &ids = objectManager.getObjectIds();
+    const auto &modelMatrices = objectManager.getModelMatrices();
+    const auto &meshIndices = objectManager.getMeshIndices();
+    objectCount = objectManager.getObjectCount();
+
+    auto paddedCount = (objectCount + simdWidth - 1) & ~(simdWidth - 1);
+    centerX.assign(paddedCount, 0.f);
+    centerY.assign(paddedCount, 0.f);
+    centerZ.assign(paddedCount, 0.f);
+    radius.assign(paddedCount, 0.f);
+    objectIds.assign(paddedCount, 0);
+
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        const auto &modelMatrix = modelMatrices[i];
+        const auto &sphere = modelManager.getModel(meshIndices[i])->getBoundingSphere();
+
+        auto center = modelMatrix * glm::vec4(sphere.x, sphere.y, sphere.z, 1.f);
+
+        // Non uniform scale stretches the sphere, so use the largest axis.
+        auto scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+                              glm::max(glm::length(glm::vec3(modelMatrix[1])),
+                                       glm::length(glm::vec3(modelMatrix[2]))));
+
+        centerX[i] = center.x;
+        centerY[i] = center.y;
+        centerZ[i] = center.z;
+        radius[i] = sphere.w * scale;
+        objectIds[i] = ids[i];
+    }
+
+    boundsVersion = objectManager.getVersion();
+    hasBounds = true;
+}
+
+void FrustumCuller::cull(const Frustum &frustum, std::vector<uint32_t> &visibleObjects) const
+{
+    // Write straight into the output and shrink it afterwards,
+    // instead of growing it one id at a time.
+    visibleObjects.resize(objectCount);
+    uint32_t visibleCount = 0;
+
+#if TOBI_CULL_SSE
+    __m128 planeX[Frustum::PLANE_COUNT];
+    __m128 planeY[Frustum::PLANE_COUNT];
+    __m128 planeZ[Frustum::PLANE_COUNT];
+    __m128 planeW[Frustum::PLANE_COUNT];
+    for (auto p = 0; p < Frustum::PLANE_COUNT; p++)
+    {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    const auto zero = _mm_setzero_ps();
+
+    for (uint32_t i = 0; i < objectCount; i += simdWidth)
+    {
+        auto x = _mm_loadu_ps(&centerX[i]);
+        auto y = _mm_loadu_ps(&centerY[i]);
+        auto z = _mm_loadu_ps(&centerZ[i]);
+        auto r = _mm_loadu_ps(&radius[i]);
+
+        // A sphere is outside if it is entirely behind any of the planes,
+        // so it is visible if distance + radius >= 0 for all six of them.
+        auto inside = _mm_cmpeq_ps(zero, zero);
+        for (auto p = 0; p < Frustum::PLANE_COUNT; p++)
+        {
+            auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                                       _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+        }
+
+        auto mask = _mm_movemask_ps(inside);
+
+        // Ignore the padding lanes of the last group.
+        auto remaining = objectCount - i;
+        if (remaining < simdWidth)
+            mask &= (1 << remaining) - 1;
+
+        while (mask)
+        {
+            auto lane = __builtin_ctz(mask);
+            visibleObjects[visibleCount++] = objectIds[i + lane];
+            mask &= mask - 1;
+        }
+    }
+#else
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        auto visible = true;
+        for (auto p = 0; p < Frustum::PLANE_COUNT && visible; p++)
+        {
+            const auto &plane = frustum.planes[p];
+            auto distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+            visible = distance + radius[i] >= 0.f;
+        }
+
+        if (visible)
+            visibleObjects[visibleCount++] = objectIds[i];
+    }
+#endif
+
+    visibleObjects.resize(visibleCount);
+}
+
+} // namespace Tobi
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "Frustum.hpp"
+
+namespace Tobi
+{
+
+class ObjectManager;
+class ModelManager;
+
+/// @brief Culls object bounding spheres against a view frustum.
+///
+/// The world space bounding spheres are kept as a structure of arrays so the
+/// kernel can test four spheres against a plane with one SSE instruction
+/// sequence. The arrays are only rebuilt when the ObjectManager reports a change.
+class FrustumCuller
+{
+  public:
+    FrustumCuller();
+    FrustumCuller(const FrustumCuller &) = delete;
+    FrustumCuller(FrustumCuller &&) = delete;
+    FrustumCuller &operator=(const FrustumCuller &) & = delete;
+    FrustumCuller &operator=(FrustumCuller &&) & = delete;
+    ~FrustumCuller() = default;
+
+    /// @brief Rebuilds the world space bounding spheres if objects have changed
+    /// since the last call.
+    void updateBounds(ObjectManager &objectManager, ModelManager &modelManager);
+
+    /// @brief Tests all objects against the frustum.
+    /// @param frustum The frustum to test against.
+    /// @param[out] visibleObjects Compact list with the ids of all objects
+    /// intersecting the frustum, in the order of the ObjectManager arrays.
+    void cull(const Frustum &frustum, std::vector<uint32_t> &visibleObjects) const;
+
+    uint32_t getObjectCount() const { return objectCount; }
+
+  private:
+    // Each array is padded to a multiple of the SIMD width.
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    std::vector<uint32_t> objectIds;
+
+    uint32_t objectCount;
+    uint32_t boundsVersion;
+    bool hasBounds;
+};
+
+} // namespace Tobi
@@ -0,0 +1,416 @@
+#include "GpuCuller.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Frustum.hpp"
+#include "../ComputeScheduler.hpp"
+#include "../buffers/StorageBufferManager.hpp"
+#include "../model/ModelManager.hpp"
+#include "../model/ObjectManager.hpp"
+#include "../../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+// Must match local_size_x in cull.comp.
+static const uint32_t cullWorkGroupSize = 64;
+
+// Objects whose radius is smaller than this fraction of their distance to the
+// camera cover well under a pixel and are skipped.
+static const float minimumRadiusToDistance = 0.0005f;
+
+static const uint32_t minimumObjectCapacity = 64;
+static const uint32_t minimumMeshCapacity = 16;
+
+GpuCuller::GpuCuller(std::shared_ptr<Platform> platform,
+                     std::shared_ptr<StorageBufferManager> storageBufferManager)
+    : platform(platform),
+      storageBufferManager(storageBufferManager),
+      descriptorSetLayout(VK_NULL_HANDLE),
+      descriptorPool(VK_NULL_HANDLE),
+      pipelineLayout(VK_NULL_HANDLE),
+      pipeline(VK_NULL_HANDLE),
+      frames(std::vector<FrameResources>()),
+      computeQueueFamilyIndex(0),
+      graphicsQueueFamilyIndex(0),
+      visibleObjectCount(0)
+{
+    LOGI("CONSTRUCTING GpuCuller\n");
+}
+
+GpuCuller::~GpuCuller()
+{
+    LOGI("DECONSTRUCTING GpuCuller\n");
+    auto device = platform->getDevice();
+
+    destroyFrameResources();
+
+    if (pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, pipeline, nullptr);
+    if (pipelineLayout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    if (descriptorSetLayout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+Result GpuCuller::initialize(VkShaderModule shaderModule, VkPipelineCache pipelineCache)
+{
+    if (!platform->getEnabledFeatures().drawIndirectFirstInstance)
+    {
+        LOGW("drawIndirectFirstInstance is not supported, culling on the CPU.\n");
+        return RESULT_ERROR_GENERIC;
+    }
+
+    if (shaderModule == VK_NULL_HANDLE)
+    {
+        LOGW("Culling shader is not available, culling on the CPU.\n");
+        return RESULT_ERROR_GENERIC;
+    }
+
+    auto device = platform->getDevice();
+
+    // Objects, draw commands and instances.
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    descriptorSetLayoutInfo.bindingCount = 3;
+    descriptorSetLayoutInfo.pBindings = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout));
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullParameters);
+
+    VkPipelineLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout));
+
+    VkComputePipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
+
+    return RESULT_SUCCESS;
+}
+
+void GpuCuller::destroyFrameResources()
+{
+    for (auto &frame : frames)
+    {
+        if (frame.objectBufferId)
+            storageBufferManager->destroyBuffer(frame.objectBufferId);
+        if (frame.drawBufferId)
+            storageBufferManager->destroyBuffer(frame.drawBufferId);
+        if (frame.instanceBufferId)
+            storageBufferManager->destroyBuffer(frame.instanceBufferId);
+    }
+    frames.clear();
+
+    // Destroying the pool frees its descriptor sets.
+    if (descriptorPool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(platform->getDevice(), descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+}
+
+void GpuCuller::setFrameCount(uint32_t frameCount)
+{
+    destroyFrameResources();
+
+    if (!isInitialized() || frameCount == 0)
+        return;
+
+    auto device = platform->getDevice();
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 3 * frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = frameCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool));
+
+    frames.resize(frameCount);
+    for (auto &frame : frames)
+    {
+        frame.objectBufferId = 0;
+        frame.drawBufferId = 0;
+        frame.instanceBufferId = 0;
+        frame.objectCapacity = 0;
+        frame.meshCapacity = 0;
+        frame.objectCount = 0;
+        frame.meshCount = 0;
+        frame.objectsVersion = 0;
+        frame.drawBufferReleased = false;
+        frame.instanceBufferReleased = false;
+        frame.clearedDrawCommands.clear();
+
+        VkDescriptorSetAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        allocateInfo.descriptorPool = descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &descriptorSetLayout;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &frame.descriptorSet));
+    }
+}
+
+void GpuCuller::setQueueFamilies(uint32_t computeQueueFamilyIndex, uint32_t graphicsQueueFamilyIndex)
+{
+    this->computeQueueFamilyIndex = computeQueueFamilyIndex;
+    this->graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
+}
+
+void GpuCuller::updateObjects(FrameResources &frame, ObjectManager &objectManager, ModelManager &modelManager)
+{
+    auto objectCount = objectManager.getObjectCount();
+    auto meshCount = modelManager.getModelCount();
+
+    if (frame.objectBufferId && frame.objectsVersion == objectManager.getVersion() && frame.meshCount == meshCount)
+        return;
+
+    // Grow the buffers geometrically, the descriptor set has to follow.
+    auto buffersChanged = false;
+    if (objectCount > frame.objectCapacity || !frame.objectBufferId)
+    {
+        if (frame.objectBufferId)
+        {
+            storageBufferManager->destroyBuffer(frame.objectBufferId);
+            storageBufferManager->destroyBuffer(frame.instanceBufferId);
+        }
+
+        frame.objectCapacity = std::max(std::max(objectCount, frame.objectCapacity * 2), minimumObjectCapacity);
+        frame.objectBufferId = storageBufferManager->createBuffer(nullptr, frame.objectCapacity * sizeof(GpuObject));
+        frame.instanceBufferId = storageBufferManager->createBuffer(nullptr, frame.objectCapacity * sizeof(glm::mat4));
+        frame.instanceBufferReleased = false;
+        buffersChanged = true;
+    }
+
+    if (meshCount > frame.meshCapacity || !frame.drawBufferId)
+    {
+        if (frame.drawBufferId)
+            storageBufferManager->destroyBuffer(frame.drawBufferId);
+
+        frame.meshCapacity = std::max(std::max(meshCount, frame.meshCapacity * 2), minimumMeshCapacity);
+        frame.drawBufferId = storageBufferManager->createBuffer(nullptr,
+                                                                frame.meshCapacity * sizeof(VkDrawIndexedIndirectCommand),
+                                                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        frame.drawBufferReleased = false;
+        buffersChanged = true;
+    }
+
+    if (buffersChanged)
+    {
+        VkDescriptorBufferInfo bufferInfos[3] = {
+            storageBufferManager->getBufferInfo(frame.objectBufferId),
+            storageBufferManager->getBufferInfo(frame.drawBufferId),
+            storageBufferManager->getBufferInfo(frame.instanceBufferId)};
+
+        VkWriteDescriptorSet writes[3] = {};
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = frame.descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(platform->getDevice(), 3, writes, 0, nullptr);
+    }
+
+    const auto &modelMatrices = objectManager.getModelMatrices();
+    const auto &meshIndices = objectManager.getMeshIndices();
+
+    // Every mesh gets a range of the instance buffer large enough for all its objects.
+    frame.clearedDrawCommands.assign(meshCount, VkDrawIndexedIndirectCommand{});
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        frame.clearedDrawCommands[meshIndices[i]].firstInstance++;
+    }
+
+    uint32_t firstInstance = 0;
+    for (uint32_t meshIndex = 0; meshIndex < meshCount; meshIndex++)
+    {
+        auto &command = frame.clearedDrawCommands[meshIndex];
+        auto count = command.firstInstance;
+        command.indexCount = modelManager.getModel(meshIndex)->getIndexCount();
+        command.firstInstance = firstInstance;
+        firstInstance += count;
+    }
+
+    auto *pObjects = static_cast<GpuObject *>(storageBufferManager->mapBuffer(frame.objectBufferId));
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        const auto &modelMatrix = modelMatrices[i];
+        const auto &sphere = modelManager.getModel(meshIndices[i])->getBoundingSphere();
+
+        auto center = modelMatrix * glm::vec4(sphere.x, sphere.y, sphere.z, 1.f);
+
+        // Non uniform scale stretches the sphere, so use the largest axis.
+        auto scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+                              glm::max(glm::length(glm::vec3(modelMatrix[1])),
+                                       glm::length(glm::vec3(modelMatrix[2]))));
+
+        auto &object = pObjects[i];
+        object.modelMatrix = modelMatrix;
+        object.boundingSphere = glm::vec4(center.x, center.y, center.z, sphere.w * scale);
+        object.meshIndex = meshIndices[i];
+    }
+
+    frame.objectCount = objectCount;
+    frame.meshCount = meshCount;
+    frame.objectsVersion = objectManager.getVersion();
+}
+
+void GpuCuller::cull(VkCommandBuffer commandBuffer,
+                     uint32_t frameIndex,
+                     const glm::mat4 &viewProjectionMatrix,
+                     const glm::vec3 &cameraPosition,
+                     ObjectManager &objectManager,
+                     ModelManager &modelManager)
+{
+    auto &frame = frames[frameIndex];
+
+    // The draw buffer still holds the result of the last dispatch of this frame.
+    if (frame.drawBufferId)
+    {
+        const auto *pDraws = static_cast<const VkDrawIndexedIndirectCommand *>(
+            storageBufferManager->mapBuffer(frame.drawBufferId));
+
+        visibleObjectCount = 0;
+        for (uint32_t i = 0; i < frame.meshCount; i++)
+        {
+            visibleObjectCount += pDraws[i].instanceCount;
+        }
+    }
+
+    updateObjects(frame, objectManager, modelManager);
+
+    // Host writes are made visible to the device by the queue submission.
+    auto *pDraws = storageBufferManager->mapBuffer(frame.drawBufferId);
+    memcpy(pDraws, frame.clearedDrawCommands.data(), frame.meshCount * sizeof(VkDrawIndexedIndirectCommand));
+
+    // Take back the buffers the graphics queue released after drawing them.
+    if (computeQueueFamilyIndex != graphicsQueueFamilyIndex)
+    {
+        VkBuffer buffers[2];
+        uint32_t bufferCount = 0;
+        if (frame.drawBufferReleased)
+            buffers[bufferCount++] = getDrawBuffer(frameIndex);
+        if (frame.instanceBufferReleased)
+            buffers[bufferCount++] = getInstanceBuffer(frameIndex);
+
+        ComputeScheduler::recordOwnershipTransfer(commandBuffer,
+                                                  buffers,
+                                                  bufferCount,
+                                                  graphicsQueueFamilyIndex,
+                                                  computeQueueFamilyIndex,
+                                                  false,
+                                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    if (frame.objectCount != 0)
+        dispatch(commandBuffer, frame, viewProjectionMatrix, cameraPosition);
+
+    // The semaphore the graphics submission waits on makes the results visible
+    // to it, only a transfer to another queue family needs a barrier.
+    if (computeQueueFamilyIndex != graphicsQueueFamilyIndex)
+    {
+        VkBuffer buffers[2] = {getDrawBuffer(frameIndex), getInstanceBuffer(frameIndex)};
+        ComputeScheduler::recordOwnershipTransfer(commandBuffer,
+                                                  buffers,
+                                                  2,
+                                                  computeQueueFamilyIndex,
+                                                  graphicsQueueFamilyIndex,
+                                                  true,
+                                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                  VK_ACCESS_SHADER_WRITE_BIT);
+    }
+}
+
+void GpuCuller::dispatch(VkCommandBuffer commandBuffer,
+                         const FrameResources &frame,
+                         const glm::mat4 &viewProjectionMatrix,
+                         const glm::vec3 &cameraPosition)
+{
+    Frustum frustum(viewProjectionMatrix);
+
+    CullParameters parameters = {};
+    for (uint32_t i = 0; i < Frustum::PLANE_COUNT; i++)
+    {
+        parameters.planes[i] = frustum.planes[i];
+    }
+    parameters.cameraPosition = glm::vec4(cameraPosition, minimumRadiusToDistance);
+    parameters.objectCount = frame.objectCount;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParameters), &parameters);
+    vkCmdDispatch(commandBuffer, (frame.objectCount + cullWorkGroupSize - 1) / cullWorkGroupSize, 1, 1);
+}
+
+void GpuCuller::acquireForGraphics(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (computeQueueFamilyIndex == graphicsQueueFamilyIndex)
+        return;
+
+    VkBuffer buffers[2] = {getDrawBuffer(frameIndex), getInstanceBuffer(frameIndex)};
+    ComputeScheduler::recordOwnershipTransfer(commandBuffer,
+                                              buffers,
+                                              2,
+                                              computeQueueFamilyIndex,
+                                              graphicsQueueFamilyIndex,
+                                              false,
+                                              VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                                              VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void GpuCuller::releaseFromGraphics(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (computeQueueFamilyIndex == graphicsQueueFamilyIndex)
+        return;
+
+    // Graphics only reads the buffers, there are no writes to make available.
+    VkBuffer buffers[2] = {getDrawBuffer(frameIndex), getInstanceBuffer(frameIndex)};
+    ComputeScheduler::recordOwnershipTransfer(commandBuffer,
+                                              buffers,
+                                              2,
+                                              graphicsQueueFamilyIndex,
+                                              computeQueueFamilyIndex,
+                                              true,
+                                              VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                                              0);
+
+    frames[frameIndex].drawBufferReleased = true;
+    frames[frameIndex].instanceBufferReleased = true;
+}
+
+VkBuffer GpuCuller::getDrawBuffer(uint32_t frameIndex) const
+{
+    return storageBufferManager->getBuffer(frames[frameIndex].drawBufferId).buffer;
+}
+
+VkBuffer GpuCuller::getInstanceBuffer(uint32_t frameIndex) const
+{
+    return storageBufferManager->getBuffer(frames[frameIndex].instanceBufferId).buffer;
+}
+
+} // namespace Tobi
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+
+namespace Tobi
+{
+
+class Platform;
+class StorageBufferManager;
+class ObjectManager;
+class ModelManager;
+
+/// @brief Culls objects in a compute shader and generates one indirect draw
+/// command per mesh.
+///
+/// Every object's world space bounding sphere is tested against the frustum and
+/// against a minimum size on screen. Visible objects append their model matrix
+/// to their mesh's range in the instance buffer and increment the instance count
+/// of the mesh's `VkDrawIndexedIndirectCommand`. Object data is only uploaded
+/// when the ObjectManager changes, so the CPU cost per frame depends on the
+/// number of meshes, not on the number of objects.
+///
+/// There is no occlusion culling on the GPU, objects hidden behind occluders
+/// or terrain are drawn.
+class GpuCuller
+{
+  public:
+    GpuCuller(std::shared_ptr<Platform> platform,
+              std::shared_ptr<StorageBufferManager> storageBufferManager);
+    GpuCuller(const GpuCuller &) = delete;
+    GpuCuller(GpuCuller &&) = delete;
+    GpuCuller &operator=(const GpuCuller &) & = delete;
+    GpuCuller &operator=(GpuCuller &&) & = delete;
+    ~GpuCuller();
+
+    /// @brief Creates the compute pipeline.
+    /// @param shaderModule The compiled cull.comp, may be `VK_NULL_HANDLE` if it failed to load.
+    /// @returns RESULT_ERROR_GENERIC when GPU culling is not supported, culling then
+    /// has to stay on the CPU.
+    Result initialize(VkShaderModule shaderModule, VkPipelineCache pipelineCache);
+
+    bool isInitialized() const { return pipeline != VK_NULL_HANDLE; }
+
+    /// @brief Recreates the per frame resources. The GPU must be idle.
+    void setFrameCount(uint32_t frameCount);
+
+    /// @brief Sets the queue families recording @ref cull and the draws. When they
+    /// differ the draw and instance buffers are transferred between them.
+    void setQueueFamilies(uint32_t computeQueueFamilyIndex, uint32_t graphicsQueueFamilyIndex);
+
+    /// @brief Resets the draw commands and records the culling dispatch into a
+    /// command buffer of the compute queue family. The graphics submission has to
+    /// wait on it. The GPU must be done with the previous use of this frame's resources.
+    void cull(VkCommandBuffer commandBuffer,
+              uint32_t frameIndex,
+              const glm::mat4 &viewProjectionMatrix,
+              const glm::vec3 &cameraPosition,
+              ObjectManager &objectManager,
+              ModelManager &modelManager);
+
+    /// @brief Records the acquire of this frame's results on the graphics queue,
+    /// before they are drawn.
+    void acquireForGraphics(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    /// @brief Records the release of this frame's buffers back to the compute
+    /// queue, after they have been drawn.
+    void releaseFromGraphics(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    /// Buffer holding one `VkDrawIndexedIndirectCommand` per mesh.
+    VkBuffer getDrawBuffer(uint32_t frameIndex) const;
+    /// Storage buffer holding the model matrices of the visible objects, the
+    /// transform buffer of the draws.
+    VkBuffer getInstanceBuffer(uint32_t frameIndex) const;
+    uint32_t getMeshCount(uint32_t frameIndex) const { return frames[frameIndex].meshCount; }
+
+    static VkDeviceSize getDrawCommandOffset(uint32_t meshIndex)
+    {
+        return meshIndex * sizeof(VkDrawIndexedIndirectCommand);
+    }
+
+    /// Number of visible objects found by the last completed dispatch of the
+    /// frame passed to @ref cull, so it lags a few frames behind.
+    uint32_t getVisibleObjectCount() const { return visibleObjectCount; }
+
+  private:
+    /// Matches Object in cull.comp.
+    struct GpuObject
+    {
+        glm::mat4 modelMatrix;
+        glm::vec4 boundingSphere;
+        uint32_t meshIndex;
+        uint32_t padding[3];
+    };
+
+    /// Matches param_block in cull.comp.
+    struct CullParameters
+    {
+        glm::vec4 planes[6];
+        glm::vec4 cameraPosition;
+        uint32_t objectCount;
+    };
+
+    struct FrameResources
+    {
+        uint32_t objectBufferId;
+        uint32_t drawBufferId;
+        uint32_t instanceBufferId;
+        uint32_t objectCapacity;
+        uint32_t meshCapacity;
+        uint32_t objectCount;
+        uint32_t meshCount;
+        uint32_t objectsVersion;
+        VkDescriptorSet descriptorSet;
+        // Set when graphics released the buffer to compute, which then has to acquire it.
+        bool drawBufferReleased;
+        bool instanceBufferReleased;
+        // Draw commands with zero instances, copied into the draw buffer every frame.
+        std::vector<VkDrawIndexedIndirectCommand> clearedDrawCommands;
+    };
+
+    std::shared_ptr<Platform> platform;
+    std::shared_ptr<StorageBufferManager> storageBufferManager;
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+
+    std::vector<FrameResources> frames;
+
+    uint32_t computeQueueFamilyIndex;
+    uint32_t graphicsQueueFamilyIndex;
+
+    uint32_t visibleObjectCount;
+
+    void destroyFrameResources();
+
+    void dispatch(VkCommandBuffer commandBuffer,
+                  const FrameResources &frame,
+                  const glm::mat4 &viewProjectionMatrix,
+                  const glm::vec3 &cameraPosition);
+
+    /// @brief Uploads the objects if they changed since this frame last saw them.
+    void updateObjects(FrameResources &frame, ObjectManager &objectManager, ModelManager &modelManager);
+};
+
+} // namespace Tobi
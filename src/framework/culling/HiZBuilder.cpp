@@ -0,0 +1,269 @@
+#include "HiZBuilder.hpp"
+
+#include <algorithm>
+
+#include "../../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+const VkFormat HiZBuilder::format;
+
+// Must match local_size_x and local_size_y in hiz.comp.
+static const uint32_t hizWorkGroupSize = 8;
+
+HiZBuilder::HiZBuilder(std::shared_ptr<Platform> platform)
+    : platform(platform),
+      descriptorSetLayout(VK_NULL_HANDLE),
+      descriptorPool(VK_NULL_HANDLE),
+      pipelineLayout(VK_NULL_HANDLE),
+      pipeline(VK_NULL_HANDLE),
+      sampler(VK_NULL_HANDLE),
+      pyramid(VK_NULL_HANDLE),
+      pyramidView(VK_NULL_HANDLE),
+      levels(std::vector<Level>())
+{
+    LOGI("CONSTRUCTING HiZBuilder\n");
+}
+
+HiZBuilder::~HiZBuilder()
+{
+    LOGI("DECONSTRUCTING HiZBuilder\n");
+    auto device = platform->getDevice();
+
+    releaseImages();
+
+    if (pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, pipeline, nullptr);
+    if (pipelineLayout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    if (descriptorSetLayout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    if (sampler != VK_NULL_HANDLE)
+        vkDestroySampler(device, sampler, nullptr);
+}
+
+Result HiZBuilder::initialize(VkShaderModule shaderModule, VkPipelineCache pipelineCache)
+{
+    if (shaderModule == VK_NULL_HANDLE)
+    {
+        LOGW("Hierarchical depth shader is not available, no depth pyramid is built.\n");
+        return RESULT_ERROR_GENERIC;
+    }
+
+    auto device = platform->getDevice();
+
+    VkSamplerCreateInfo samplerInfo = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sampler));
+
+    // The level read from and the level written to.
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    descriptorSetLayoutInfo.bindingCount = 2;
+    descriptorSetLayoutInfo.pBindings = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout));
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(HiZParameters);
+
+    VkPipelineLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout));
+
+    VkComputePipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
+
+    return RESULT_SUCCESS;
+}
+
+VkExtent2D HiZBuilder::getBaseExtent(uint32_t depthWidth, uint32_t depthHeight)
+{
+    return {std::max(depthWidth / 2, 1u), std::max(depthHeight / 2, 1u)};
+}
+
+uint32_t HiZBuilder::getMipLevelCount(VkExtent2D baseExtent)
+{
+    uint32_t mipLevels = 1;
+    for (auto size = std::max(baseExtent.width, baseExtent.height); size > 1; size /= 2)
+    {
+        mipLevels++;
+    }
+    return mipLevels;
+}
+
+void HiZBuilder::releaseImages()
+{
+    auto device = platform->getDevice();
+
+    for (auto &level : levels)
+        vkDestroyImageView(device, level.view, nullptr);
+    levels.clear();
+
+    // Destroying the pool frees its descriptor sets.
+    if (descriptorPool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+
+    pyramid = VK_NULL_HANDLE;
+    pyramidView = VK_NULL_HANDLE;
+}
+
+void HiZBuilder::setImages(VkImageView depthView,
+                           VkExtent2D depthExtent,
+                           VkImage pyramid,
+                           VkImageView pyramidView,
+                           VkExtent2D baseExtent,
+                           uint32_t mipLevels)
+{
+    releaseImages();
+
+    if (!isInitialized())
+        return;
+
+    auto device = platform->getDevice();
+    this->pyramid = pyramid;
+    this->pyramidView = pyramidView;
+
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = mipLevels;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = mipLevels;
+
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = mipLevels;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool));
+
+    levels.resize(mipLevels);
+    for (uint32_t i = 0; i < mipLevels; i++)
+    {
+        auto &level = levels[i];
+        level.sourceExtent = i == 0 ? depthExtent : levels[i - 1].extent;
+        level.extent = i == 0 ? baseExtent
+                              : VkExtent2D{std::max(levels[i - 1].extent.width / 2, 1u),
+                                           std::max(levels[i - 1].extent.height / 2, 1u)};
+
+        VkImageViewCreateInfo viewInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = pyramid;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
+        viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
+        viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
+        viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = i;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &level.view));
+
+        VkDescriptorSetAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        allocateInfo.descriptorPool = descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &descriptorSetLayout;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &level.descriptorSet));
+
+        // The pyramid stays in the general layout while it is built.
+        VkDescriptorImageInfo imageInfos[2] = {};
+        imageInfos[0].sampler = sampler;
+        imageInfos[0].imageView = i == 0 ? depthView : levels[i - 1].view;
+        imageInfos[0].imageLayout = i == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        imageInfos[1].imageView = level.view;
+        imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[2] = {};
+        for (uint32_t j = 0; j < 2; j++)
+        {
+            writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[j].dstSet = level.descriptorSet;
+            writes[j].dstBinding = j;
+            writes[j].descriptorCount = 1;
+            writes[j].descriptorType = j == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[j].pImageInfo = &imageInfos[j];
+        }
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+}
+
+void HiZBuilder::record(VkCommandBuffer commandBuffer)
+{
+    if (levels.empty())
+        return;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    for (uint32_t i = 0; i < levels.size(); i++)
+    {
+        const auto &level = levels[i];
+
+        // Every level reads the one written before it.
+        if (i > 0)
+        {
+            VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = pyramid;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = i - 1;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0,
+                                 0, nullptr,
+                                 0, nullptr,
+                                 1, &barrier);
+        }
+
+        HiZParameters parameters = {};
+        parameters.sourceWidth = static_cast<int32_t>(level.sourceExtent.width);
+        parameters.sourceHeight = static_cast<int32_t>(level.sourceExtent.height);
+        parameters.destinationWidth = static_cast<int32_t>(level.extent.width);
+        parameters.destinationHeight = static_cast<int32_t>(level.extent.height);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &level.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZParameters), &parameters);
+        vkCmdDispatch(commandBuffer,
+                      (level.extent.width + hizWorkGroupSize - 1) / hizWorkGroupSize,
+                      (level.extent.height + hizWorkGroupSize - 1) / hizWorkGroupSize,
+                      1);
+    }
+}
+
+} // namespace Tobi
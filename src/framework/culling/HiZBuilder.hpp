@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+
+namespace Tobi
+{
+
+class Platform;
+
+/// @brief Builds a hierarchical depth pyramid from the depth buffer in compute.
+///
+/// Every level holds the farthest depth of the texels it covers, the first
+/// level is half the size of the depth buffer. An object is hidden when its
+/// nearest depth is farther than the texels covering its screen bounds, which
+/// takes a few reads in the level where the bounds span a few texels. A culler
+/// testing against the previous frame's depth has to keep the pyramid as a
+/// render graph output, no culler does so yet.
+class HiZBuilder
+{
+  public:
+    static const VkFormat format = VK_FORMAT_R32_SFLOAT;
+
+    HiZBuilder(std::shared_ptr<Platform> platform);
+    HiZBuilder(const HiZBuilder &) = delete;
+    HiZBuilder(HiZBuilder &&) = delete;
+    HiZBuilder &operator=(const HiZBuilder &) & = delete;
+    HiZBuilder &operator=(HiZBuilder &&) & = delete;
+    ~HiZBuilder();
+
+    /// @brief Creates the compute pipeline.
+    /// @param shaderModule The compiled hiz.comp, may be `VK_NULL_HANDLE` if it failed to load.
+    /// @returns RESULT_ERROR_GENERIC when the shader is not available, no pyramid is built then.
+    Result initialize(VkShaderModule shaderModule, VkPipelineCache pipelineCache);
+
+    bool isInitialized() const { return pipeline != VK_NULL_HANDLE; }
+
+    /// @brief Size of the first level of the pyramid for a depth buffer.
+    static VkExtent2D getBaseExtent(uint32_t depthWidth, uint32_t depthHeight);
+
+    /// @brief Number of levels down to 1x1.
+    static uint32_t getMipLevelCount(VkExtent2D baseExtent);
+
+    /// @brief Creates the views and descriptor sets for the images of a compiled graph.
+    /// @param depthView A view of the depth aspect, in shader read only layout while building.
+    /// @param pyramid An image of @ref format with sampled and storage usage, in general layout while building.
+    void setImages(VkImageView depthView,
+                   VkExtent2D depthExtent,
+                   VkImage pyramid,
+                   VkImageView pyramidView,
+                   VkExtent2D baseExtent,
+                   uint32_t mipLevels);
+
+    /// @brief Destroys the views and descriptor sets. Has to be called before
+    /// the images are destroyed. The GPU must be done with them.
+    void releaseImages();
+
+    /// @brief Records the dispatches building all levels, with barriers between them.
+    void record(VkCommandBuffer commandBuffer);
+
+    /// A view of all levels of the pyramid.
+    VkImageView getPyramidView() const { return pyramidView; }
+    /// Nearest filtering sampler clamping to the edge, for texelFetch and textureLod.
+    VkSampler getSampler() const { return sampler; }
+    uint32_t getMipLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+
+  private:
+    /// Matches param_block in hiz.comp.
+    struct HiZParameters
+    {
+        int32_t sourceWidth;
+        int32_t sourceHeight;
+        int32_t destinationWidth;
+        int32_t destinationHeight;
+    };
+
+    struct Level
+    {
+        // A view of only this level, for storing and for reading by the next level.
+        VkImageView view;
+        VkDescriptorSet descriptorSet;
+        VkExtent2D sourceExtent;
+        VkExtent2D extent;
+    };
+
+    std::shared_ptr<Platform> platform;
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkSampler sampler;
+
+    VkImage pyramid;
+    VkImageView pyramidView;
+    std::vector<Level> levels;
+};
+
+} // namespace Tobi
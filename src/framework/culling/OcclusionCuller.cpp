@@ -0,0 +1,134 @@
+#include "OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "framework/Common.hpp"
+#include "../jobs/JobSystem.hpp"
+#include "../model/ModelManager.hpp"
+#include "../model/ObjectManager.hpp"
+#include "../../platform/AssetManager.hpp"
+
+namespace Tobi
+{
+
+// Occludees are tested in batches of this size on the job system.
+static const uint32_t occludeeGrainSize = 64;
+
+OcclusionCuller::OcclusionCuller(std::shared_ptr<JobSystem> jobSystem)
+    : jobSystem(jobSystem),
+      depthRasterizer(std::make_unique<DepthRasterizer>(jobSystem)),
+      occluders(std::vector<OccluderMesh>()),
+      occludees(std::vector<Occludee>()),
+      occluded(std::vector<uint8_t>()),
+      occluderCount(0),
+      occludeeCount(0),
+      occludedCount(0),
+      rasterizationTime(0.0),
+      testTime(0.0)
+{
+    LOGI("CONSTRUCTING OcclusionCuller\n");
+}
+
+void OcclusionCuller::cull(const glm::mat4 &viewProjectionMatrix,
+                           ObjectManager &objectManager,
+                           ModelManager &modelManager,
+                           const std::vector<OccluderMesh> &additionalOccluders,
+                           std::vector<uint32_t> &visibleObjects)
+{
+    auto startTime = OS::getCurrentTime();
+
+    // Gather everything on this thread, the managers are not safe to read concurrently.
+    occluders.assign(additionalOccluders.begin(), additionalOccluders.end());
+    occludees.clear();
+    for (auto id : visibleObjects)
+    {
+        const auto &modelMatrix = objectManager.getModelMatrix(id);
+        const auto &model = modelManager.getModel(objectManager.getMeshIndex(id));
+
+        if (objectManager.isOccluder(id))
+        {
+            OccluderMesh occluder;
+            occluder.modelViewProjectionMatrix = viewProjectionMatrix * modelMatrix;
+            occluder.vertices = model->getVertices().data();
+            occluder.vertexCount = model->getVertexCount();
+            occluder.indices = model->getIndices().data();
+            occluder.indexCount = model->getIndexCount();
+            occluders.push_back(occluder);
+        }
+
+        occludees.push_back({&modelMatrix, model->getBoundsMin(), model->getBoundsMax()});
+    }
+
+    occluderCount = 0;
+    occludeeCount = 0;
+    occludedCount = 0;
+    rasterizationTime = 0.0;
+    testTime = 0.0;
+
+    // Nothing can be hidden without occluders, or with nothing to hide.
+    if (occluders.empty() || occludees.empty())
+        return;
+
+    occluderCount = static_cast<uint32_t>(occluders.size());
+
+    depthRasterizer->rasterize(occluders);
+
+    auto rasterizedTime = OS::getCurrentTime();
+    rasterizationTime = rasterizedTime - startTime;
+
+    occludeeCount = static_cast<uint32_t>(occludees.size());
+    occluded.resize(occludeeCount);
+    jobSystem->parallelFor(occludeeCount, occludeeGrainSize, [this, &viewProjectionMatrix](uint32_t begin, uint32_t end) {
+        for (auto i = begin; i < end; i++)
+        {
+            occluded[i] = isOccluded(viewProjectionMatrix, occludees[i]) ? 1 : 0;
+        }
+    });
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < occludeeCount; i++)
+    {
+        if (!occluded[i])
+            visibleObjects[visibleCount++] = visibleObjects[i];
+    }
+    occludedCount = occludeeCount - visibleCount;
+    visibleObjects.resize(visibleCount);
+
+    testTime = OS::getCurrentTime() - rasterizedTime;
+}
+
+bool OcclusionCuller::isOccluded(const glm::mat4 &viewProjectionMatrix, const Occludee &occludee) const
+{
+    auto modelViewProjectionMatrix = viewProjectionMatrix * *occludee.modelMatrix;
+
+    auto minX = std::numeric_limits<float>::max();
+    auto minY = std::numeric_limits<float>::max();
+    auto maxX = -std::numeric_limits<float>::max();
+    auto maxY = -std::numeric_limits<float>::max();
+    auto minDepth = 1.f;
+
+    for (auto corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 position((corner & 1) ? occludee.boundsMax.x : occludee.boundsMin.x,
+                           (corner & 2) ? occludee.boundsMax.y : occludee.boundsMin.y,
+                           (corner & 4) ? occludee.boundsMax.z : occludee.boundsMin.z,
+                           1.f);
+        auto clip = modelViewProjectionMatrix * position;
+
+        // Boxes reaching behind the near plane can cover the whole screen.
+        if (clip.z < 0.f || clip.w <= 0.f)
+            return false;
+
+        auto screen = DepthRasterizer::toScreen(clip.x / clip.w, clip.y / clip.w);
+        minX = std::min(minX, screen.x);
+        minY = std::min(minY, screen.y);
+        maxX = std::max(maxX, screen.x);
+        maxY = std::max(maxY, screen.y);
+        minDepth = std::min(minDepth, clip.z / clip.w);
+    }
+
+    return depthRasterizer->isOccluded(minX, minY, maxX, maxY, minDepth);
+}
+
+} // namespace Tobi
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "DepthRasterizer.hpp"
+
+namespace Tobi
+{
+
+class JobSystem;
+class ObjectManager;
+class ModelManager;
+
+/// @brief Removes objects hidden behind occluders from a list of visible objects.
+///
+/// Objects flagged as occluders in the ObjectManager, along with occluders
+/// which are not objects such as terrain chunks, are rasterized into a
+/// DepthRasterizer. Then the screen space bounding rectangle and closest depth
+/// of every object's bounding box is tested against it.
+class OcclusionCuller
+{
+  public:
+    explicit OcclusionCuller(std::shared_ptr<JobSystem> jobSystem);
+    OcclusionCuller(const OcclusionCuller &) = delete;
+    OcclusionCuller(OcclusionCuller &&) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller &) & = delete;
+    OcclusionCuller &operator=(OcclusionCuller &&) & = delete;
+    ~OcclusionCuller() = default;
+
+    /// @brief Culls occluded objects.
+    /// @param viewProjectionMatrix The camera view projection matrix.
+    /// @param additionalOccluders Rasterized before the objects, they only occlude.
+    /// @param[in,out] visibleObjects Objects which passed frustum culling. Occluded
+    /// objects are removed, the order of the others is kept.
+    void cull(const glm::mat4 &viewProjectionMatrix,
+              ObjectManager &objectManager,
+              ModelManager &modelManager,
+              const std::vector<OccluderMesh> &additionalOccluders,
+              std::vector<uint32_t> &visibleObjects);
+
+    uint32_t getOccluderCount() const { return occluderCount; }
+    uint32_t getOccludeeCount() const { return occludeeCount; }
+    uint32_t getOccludedCount() const { return occludedCount; }
+
+    /// Time spent setting up and rasterizing occluders, in seconds.
+    double getRasterizationTime() const { return rasterizationTime; }
+    /// Time spent testing occludees, in seconds.
+    double getTestTime() const { return testTime; }
+
+  private:
+    struct Occludee
+    {
+        const glm::mat4 *modelMatrix;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    std::shared_ptr<JobSystem> jobSystem;
+    std::unique_ptr<DepthRasterizer> depthRasterizer;
+
+    std::vector<OccluderMesh> occluders;
+    std::vector<Occludee> occludees;
+    std::vector<uint8_t> occluded;
+
+    uint32_t occluderCount;
+    uint32_t occludeeCount;
+    uint32_t occludedCount;
+    double rasterizationTime;
+    double testTime;
+
+    bool isOccluded(const glm::mat4 &viewProjectionMatrix, const Occludee &occludee) const;
+};
+
+} // namespace Tobi
@@ -0,0 +1,153 @@
+#include "JobSystem.hpp"
+
+#include <atomic>
+#include <memory>
+
+#include "framework/Common.hpp"
+
+namespace Tobi
+{
+
+namespace
+{
+// Shared between the caller of parallelFor and the helper jobs. Helpers may
+// start after the caller has returned, so it is kept alive by reference count.
+struct ParallelForState
+{
+    std::atomic<uint32_t> nextRange;
+    std::atomic<uint32_t> finishedRanges;
+    uint32_t rangeCount;
+    uint32_t count;
+    uint32_t grainSize;
+    const std::function<void(uint32_t, uint32_t)> *function;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+void runRanges(ParallelForState &state)
+{
+    for (;;)
+    {
+        auto range = state.nextRange.fetch_add(1);
+        if (range >= state.rangeCount)
+            return;
+
+        auto begin = range * state.grainSize;
+        auto end = begin + state.grainSize < state.count ? begin + state.grainSize : state.count;
+        (*state.function)(begin, end);
+
+        if (state.finishedRanges.fetch_add(1) + 1 == state.rangeCount)
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.finished.notify_all();
+        }
+    }
+}
+} // namespace
+
+JobSystem::JobSystem(uint32_t workerCount)
+    : workers(std::vector<std::thread>()),
+      jobs(std::deque<std::function<void()>>()),
+      running(true)
+{
+    LOGI("CONSTRUCTING JobSystem with %u workers\n", workerCount);
+
+    workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    LOGI("DECONSTRUCTING JobSystem\n");
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        running = false;
+    }
+    jobsCondition.notify_all();
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::schedule(std::function<void()> job)
+{
+    if (workers.empty())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        jobs.push_back(std::move(job));
+    }
+    jobsCondition.notify_one();
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)> &function)
+{
+    if (count == 0)
+        return;
+
+    if (grainSize == 0)
+        grainSize = 1;
+
+    auto rangeCount = (count + grainSize - 1) / grainSize;
+    if (rangeCount == 1 || workers.empty())
+    {
+        function(0, count);
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>();
+    state->nextRange = 0;
+    state->finishedRanges = 0;
+    state->rangeCount = rangeCount;
+    state->count = count;
+    state->grainSize = grainSize;
+    state->function = &function;
+
+    // One helper per worker at most, each of them keeps pulling ranges until none are left.
+    auto helperCount = rangeCount - 1 < getWorkerCount() ? rangeCount - 1 : getWorkerCount();
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        for (uint32_t i = 0; i < helperCount; i++)
+        {
+            jobs.push_back([state]() { runRanges(*state); });
+        }
+    }
+    jobsCondition.notify_all();
+
+    runRanges(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state]() { return state->finishedRanges.load() == state->rangeCount; });
+}
+
+void JobSystem::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobsCondition.wait(lock, [this]() { return !running || !jobs.empty(); });
+
+            if (jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+} // namespace Tobi
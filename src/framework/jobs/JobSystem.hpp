@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Tobi
+{
+
+/// @brief A fixed pool of worker threads executing jobs from a shared queue.
+///
+/// The thread calling @ref parallelFor takes part in the work, so nested calls
+/// from inside a job can not deadlock and a pool without workers simply runs
+/// everything on the calling thread.
+class JobSystem
+{
+  public:
+    /// @brief Constructor
+    /// @param workerCount The number of threads to spawn besides the calling thread.
+    explicit JobSystem(uint32_t workerCount);
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem(JobSystem &&) = delete;
+    JobSystem &operator=(const JobSystem &) & = delete;
+    JobSystem &operator=(JobSystem &&) & = delete;
+
+    /// @brief Destructor. Waits for the queued jobs to finish before joining the workers.
+    ~JobSystem();
+
+    /// @brief Queues a job and returns immediately.
+    void schedule(std::function<void()> job);
+
+    /// @brief Splits [0, count) into ranges of at most grainSize elements and runs
+    /// function(begin, end) for each of them. Returns when all ranges are done.
+    void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)> &function);
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+  private:
+    std::vector<std::thread> workers;
+
+    std::deque<std::function<void()>> jobs;
+    std::mutex jobsMutex;
+    std::condition_variable jobsCondition;
+
+    bool running;
+
+    void workerLoop();
+};
+
+} // namespace Tobi
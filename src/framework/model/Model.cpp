@@ -16,9 +16,16 @@ namespace Tobi
 
 Model::Model(const char *filename)
     : vertices(std::vector<Vertex>()),
-      filename(filename)
+      positions(std::vector<glm::vec3>()),
+      indices(std::vector<uint32_t>()),
+      filename(filename),
+      boundsMin(glm::vec3(0.f)),
+      boundsMax(glm::vec3(0.f)),
+      boundingSphere(glm::vec4(0.f))
 {
     initialize();
+    calculateBounds();
+    extractPositions();
 }
 
 static const std::vector<Vertex> triangleMesh = {
@@ -184,12 +191,12 @@ static const std::vector<uint32_t> cubeIndices = {
 
 void Model::initialize()
 {
-    if (strcmp(filename, "triangle") == 0)
+    if (filename == "triangle")
     {
         vertices = triangleMesh;
         indices = triangleIndices;
     }
-    else if (strcmp(filename, "cube") == 0)
+    else if (filename == "cube")
     {
         vertices = cubeMesh;
         indices = cubeIndices;
@@ -205,7 +212,7 @@ void Model::initialize()
         }
         else
         {
-            LOGE("Couldn't open file: %s \n", filename);
+            LOGE("Couldn't open file: %s \n", filename.c_str());
             LOGE("%s\n", importer.GetErrorString());
             vertices = triangleMesh;
             return;
@@ -263,4 +270,38 @@ void Model::initialize()
     }
 }
 
+void Model::extractPositions()
+{
+    positions.reserve(vertices.size());
+    for (const auto &vertex : vertices)
+    {
+        positions.push_back(vertex.position);
+    }
+}
+
+void Model::calculateBounds()
+{
+    if (vertices.empty())
+        return;
+
+    boundsMin = vertices.front().position;
+    boundsMax = vertices.front().position;
+    for (const auto &vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+
+    // Centre the sphere in the box, then grow it to the farthest vertex.
+    // This is tighter than using half the box diagonal.
+    auto centre = (boundsMin + boundsMax) * 0.5f;
+    auto radius = 0.f;
+    for (const auto &vertex : vertices)
+    {
+        radius = glm::max(radius, glm::length(vertex.position - centre));
+    }
+
+    boundingSphere = glm::vec4(centre, radius);
+}
+
 } // namespace Tobi
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "Vertex.hpp"
@@ -17,22 +18,42 @@ class Model
     Model &operator=(Model &&) & = delete;
     ~Model() = default;
 
+    const std::vector<Vertex> &getVertices() const { return vertices; }
+    const std::vector<uint32_t> &getIndices() const { return indices; }
+
     const void *getVertexData() const { return vertices.data(); }
-    const uint32_t getVertexCount() const { return vertices.size(); }
-    const uint32_t getVertexDataSize() const { return sizeof(Vertex) * vertices.size(); }
+    uint32_t getVertexCount() const { return vertices.size(); }
+    uint32_t getVertexDataSize() const { return sizeof(Vertex) * vertices.size(); }
+
+    /// Positions only, for passes which do not need the other attributes.
+    const void *getPositionData() const { return positions.data(); }
+    uint32_t getPositionDataSize() const { return sizeof(glm::vec3) * positions.size(); }
 
     const void *getIndexData() const { return indices.data(); }
-    const uint32_t getIndexCount() const { return indices.size(); }
-    const uint32_t getIndexDataSize() const { return sizeof(uint32_t) * indices.size(); }
+    uint32_t getIndexCount() const { return indices.size(); }
+    uint32_t getIndexDataSize() const { return sizeof(uint32_t) * indices.size(); }
+
+    const glm::vec3 &getBoundsMin() const { return boundsMin; }
+    const glm::vec3 &getBoundsMax() const { return boundsMax; }
+
+    /// Bounding sphere in model space. xyz is the centre and w is the radius.
+    const glm::vec4 &getBoundingSphere() const { return boundingSphere; }
 
   private:
     std::vector<Vertex> vertices;
+    std::vector<glm::vec3> positions;
     std::vector<uint32_t> indices;
-    const char *filename;
+    std::string filename;
+
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec4 boundingSphere;
 
     // have the buffer managers here ? and the buffer ids ?
 
     void initialize();
+    void calculateBounds();
+    void extractPositions();
 };
 
 } // namespace Tobi
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "ModelManager.hpp"
 
+#include <algorithm>
+
 #include "framework/Common.hpp"
 
 namespace Tobi
@@ -9,34 +11,71 @@ ModelManager::ModelManager(std::shared_ptr<VertexBufferManager> vertexBufferMana
                            std::shared_ptr<IndexBufferManager> indexBufferManager)
     : vertexBufferManager(vertexBufferManager),
       indexBufferManager(indexBufferManager),
+      uploadScheduler(nullptr),
       models(std::vector<std::shared_ptr<Model>>()),
-      modelFileNames(std::vector<const char *>()),
+      modelIndexByFileName(std::unordered_map<std::string, uint32_t>()),
       vertexBufferIndices(std::vector<uint32_t>()),
-      indexBufferIndices(std::vector<uint32_t>())
+      indexBufferIndices(std::vector<uint32_t>()),
+      positionBufferIndices(std::vector<uint32_t>()),
+      uploadTickets(std::vector<uint64_t>())
 {
 }
 
 uint32_t ModelManager::loadModel(const char *filename)
 {
-    auto it = std::find(modelFileNames.begin(), modelFileNames.end(), filename);
-
-    if (it != modelFileNames.end())
+    auto it = modelIndexByFileName.find(filename);
+    if (it != modelIndexByFileName.end())
     {
-        LOGW("Model already loaded\n");
-        return (it - modelFileNames.begin());
+        return it->second;
     }
 
     models.push_back(std::make_shared<Model>(filename));
-    modelFileNames.push_back(filename);
+    modelIndexByFileName.emplace(filename, static_cast<uint32_t>(models.size() - 1));
 
     // TODO: this should be refactored. it is pretty ugly. find a more elegant way to connect buffer with model
-    auto vertexBufferIndex = vertexBufferManager->createBuffer(models.back()->getVertexData(),
-                                                               models.back()->getVertexDataSize());
-    auto indexBufferIndex = indexBufferManager->createBuffer(models.back()->getIndexData(),
-                                                             models.back()->getIndexDataSize());
+    const auto &model = models.back();
+    uint32_t vertexBufferIndex;
+    uint32_t indexBufferIndex;
+    uint32_t positionBufferIndex;
+    uint64_t uploadTicket = 0;
+    if (uploadScheduler)
+    {
+        // The model keeps its data alive until the uploads are done. Uploads
+        // complete in order, so the last ticket covers all of them.
+        vertexBufferIndex = vertexBufferManager->createDeviceLocalBuffer(model->getVertexDataSize());
+        indexBufferIndex = indexBufferManager->createDeviceLocalBuffer(model->getIndexDataSize());
+        auto vertexTicket = uploadScheduler->enqueue(vertexBufferManager->getBuffer(vertexBufferIndex).buffer,
+                                 model->getVertexData(),
+                                 model->getVertexDataSize(),
+                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                 VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        auto indexTicket = uploadScheduler->enqueue(indexBufferManager->getBuffer(indexBufferIndex).buffer,
+                                                    model->getIndexData(),
+                                                    model->getIndexDataSize(),
+                                                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                                    VK_ACCESS_INDEX_READ_BIT);
+        positionBufferIndex = vertexBufferManager->createDeviceLocalBuffer(model->getPositionDataSize());
+        auto positionTicket = uploadScheduler->enqueue(vertexBufferManager->getBuffer(positionBufferIndex).buffer,
+                                                       model->getPositionData(),
+                                                       model->getPositionDataSize(),
+                                                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                                       VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        uploadTicket = std::max(std::max(vertexTicket, indexTicket), positionTicket);
+    }
+    else
+    {
+        vertexBufferIndex = vertexBufferManager->createBuffer(model->getVertexData(),
+                                                              model->getVertexDataSize());
+        indexBufferIndex = indexBufferManager->createBuffer(model->getIndexData(),
+                                                            model->getIndexDataSize());
+        positionBufferIndex = vertexBufferManager->createBuffer(model->getPositionData(),
+                                                                model->getPositionDataSize());
+    }
 
     vertexBufferIndices.push_back(vertexBufferIndex);
     indexBufferIndices.push_back(indexBufferIndex);
+    positionBufferIndices.push_back(positionBufferIndex);
+    uploadTickets.push_back(uploadTicket);
 
     return models.size() - 1;
 }
@@ -1,11 +1,13 @@
 #pragma once
 
-#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "Model.hpp"
 #include "../buffers/VertexBufferManager.hpp"
 #include "../buffers/IndexBufferManager.hpp"
+#include "../UploadScheduler.hpp"
 
 namespace Tobi
 {
@@ -21,22 +23,39 @@ class ModelManager
     ModelManager &operator=(ModelManager &&) & = delete;
     ~ModelManager() = default;
 
+    /// @brief Models loaded from now on are streamed into device local memory.
+    /// Without a scheduler they are written into host visible buffers directly.
+    void setUploadScheduler(std::shared_ptr<UploadScheduler> uploadScheduler) { this->uploadScheduler = uploadScheduler; }
+
     uint32_t loadModel(const char *filename);
 
+    /// @brief True once the vertex, position and index data of the model can be drawn.
+    bool isModelResident(uint32_t index) const
+    {
+        return uploadTickets[index] == 0 || uploadScheduler->isComplete(uploadTickets[index]);
+    }
+
     const auto &getModel(uint32_t index) { return models[index]; }
+    uint32_t getModelCount() const { return static_cast<uint32_t>(models.size()); }
     const auto &getVertexBufferIndex(uint32_t index) { return vertexBufferIndices[index]; }
     const auto &getIndexBufferIndex(uint32_t index) { return indexBufferIndices[index]; }
+    /// Vertex buffer holding only the positions, used by the depth prepass.
+    const auto &getPositionBufferIndex(uint32_t index) { return positionBufferIndices[index]; }
     //const auto &getModel(const char *modelName) { return modelMap[modelNameMap[modelName]]; }
 
   private:
     std::shared_ptr<VertexBufferManager> vertexBufferManager;
     std::shared_ptr<IndexBufferManager> indexBufferManager;
+    std::shared_ptr<UploadScheduler> uploadScheduler;
 
     std::vector<std::shared_ptr<Model>> models;
-    std::vector<const char *> modelFileNames;
+    std::unordered_map<std::string, uint32_t> modelIndexByFileName;
 
     std::vector<uint32_t> vertexBufferIndices;
     std::vector<uint32_t> indexBufferIndices;
+    std::vector<uint32_t> positionBufferIndices;
+    // Ticket of the last upload of each model, 0 when it was not streamed.
+    std::vector<uint64_t> uploadTickets;
 };
 
 } // namespace Tobi
\ No newline at end of file
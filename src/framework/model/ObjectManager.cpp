@@ -1,29 +1,143 @@
 #include "ObjectManager.hpp"
 
+#include <algorithm>
+
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "../jobs/JobSystem.hpp"
+
 namespace Tobi
 {
 
-ObjectManager::ObjectManager()
-    : position(std::map<uint32_t, glm::vec3>()),
-      rotation(std::map<uint32_t, glm::vec3>()),
-      scale(std::map<uint32_t, glm::vec3>()),
-      modelMatrix(std::map<uint32_t, glm::mat4>()),
-      meshIndex(std::map<uint32_t, uint32_t>()),
-      idCounter(1)
+const uint32_t ObjectManager::invalidIndex;
+
+// Number of model matrices calculated per job.
+static const uint32_t matrixGrainSize = 4096;
+
+ObjectManager::ObjectManager(std::shared_ptr<JobSystem> jobSystem)
+    : jobSystem(jobSystem),
+      positions(std::vector<glm::vec3>()),
+      rotations(std::vector<glm::vec3>()),
+      scales(std::vector<glm::vec3>()),
+      modelMatrices(std::vector<glm::mat4>()),
+      meshIndices(std::vector<uint32_t>()),
+      occluders(std::vector<uint8_t>()),
+      objectIds(std::vector<uint32_t>()),
+      indexById(std::vector<uint32_t>(1, invalidIndex)),
+      idCounter(1),
+      version(0)
+{
+}
+
+void ObjectManager::reserve(uint32_t objectCount)
 {
+    positions.reserve(objectCount);
+    rotations.reserve(objectCount);
+    scales.reserve(objectCount);
+    modelMatrices.reserve(objectCount);
+    meshIndices.reserve(objectCount);
+    occluders.reserve(objectCount);
+    objectIds.reserve(objectCount);
 }
 
-uint32_t ObjectManager::addObject(uint32_t meshIndex, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
+ObjectIdRange ObjectManager::addObjects(uint32_t count,
+                                        const uint32_t *meshIndices,
+                                        const glm::vec3 *positions,
+                                        const glm::vec3 *rotations,
+                                        const glm::vec3 *scales)
 {
-    this->position[idCounter] = position;
-    this->rotation[idCounter] = rotation;
-    this->scale[idCounter] = scale;
-    this->modelMatrix[idCounter] = calculateMatrix(position, rotation, scale);
-    this->meshIndex[idCounter] = meshIndex;
+    ObjectIdRange range = {idCounter, count};
+    if (count == 0)
+        return range;
 
-    return idCounter++;
+    auto firstIndex = getObjectCount();
+    auto newCount = firstIndex + count;
+    // Grow geometrically, adding objects one at a time would otherwise copy
+    // all arrays on every add.
+    if (newCount > objectIds.capacity())
+        reserve(std::max(newCount, 2 * static_cast<uint32_t>(objectIds.capacity())));
+
+    this->positions.insert(this->positions.end(), positions, positions + count);
+    this->rotations.insert(this->rotations.end(), rotations, rotations + count);
+    this->scales.insert(this->scales.end(), scales, scales + count);
+    this->meshIndices.insert(this->meshIndices.end(), meshIndices, meshIndices + count);
+    occluders.resize(newCount, 0);
+    modelMatrices.resize(newCount);
+
+    if (indexById.size() + count > indexById.capacity())
+        indexById.reserve(std::max(indexById.size() + count, 2 * indexById.capacity()));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        objectIds.push_back(idCounter + i);
+        indexById.push_back(firstIndex + i);
+    }
+    idCounter += count;
+
+    jobSystem->parallelFor(count, matrixGrainSize, [this, firstIndex](uint32_t begin, uint32_t end) {
+        for (auto i = firstIndex + begin; i < firstIndex + end; i++)
+        {
+            modelMatrices[i] = calculateMatrix(this->positions[i], this->rotations[i], this->scales[i]);
+        }
+    });
+
+    version++;
+
+    return range;
+}
+
+void ObjectManager::removeObjects(const uint32_t *ids, uint32_t count)
+{
+    auto removed = false;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        auto id = ids[i];
+        if (!isAlive(id))
+            continue;
+
+        // Move the last object into the freed slot.
+        auto index = indexById[id];
+        auto lastIndex = getObjectCount() - 1;
+        if (index != lastIndex)
+        {
+            positions[index] = positions[lastIndex];
+            rotations[index] = rotations[lastIndex];
+            scales[index] = scales[lastIndex];
+            modelMatrices[index] = modelMatrices[lastIndex];
+            meshIndices[index] = meshIndices[lastIndex];
+            occluders[index] = occluders[lastIndex];
+            objectIds[index] = objectIds[lastIndex];
+            indexById[objectIds[index]] = index;
+        }
+
+        positions.pop_back();
+        rotations.pop_back();
+        scales.pop_back();
+        modelMatrices.pop_back();
+        meshIndices.pop_back();
+        occluders.pop_back();
+        objectIds.pop_back();
+        indexById[id] = invalidIndex;
+        removed = true;
+    }
+
+    if (removed)
+        version++;
+}
+
+void ObjectManager::removeObjects(const ObjectIdRange &range)
+{
+    std::vector<uint32_t> ids(range.count);
+    for (uint32_t i = 0; i < range.count; i++)
+    {
+        ids[i] = range.firstId + i;
+    }
+
+    removeObjects(ids.data(), range.count);
+}
+
+uint32_t ObjectManager::addObject(uint32_t meshIndex, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
+{
+    return addObjects(1, &meshIndex, &position, &rotation, &scale).firstId;
 }
 
 uint32_t ObjectManager::addObject(uint32_t meshIndex, glm::vec3 position, glm::vec3 rotation)
@@ -41,6 +155,15 @@ uint32_t ObjectManager::addObject(uint32_t meshIndex)
     return addObject(meshIndex, glm::vec3(0.f), glm::vec3(0.f), glm::vec3(1.f));
 }
 
+void ObjectManager::setOccluder(uint32_t id, bool occluder)
+{
+    if (!isAlive(id))
+        return;
+
+    occluders[indexById[id]] = occluder ? 1 : 0;
+    version++;
+}
+
 glm::mat4 ObjectManager::calculateMatrix(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
 {
     auto identity = glm::mat4();
@@ -53,4 +176,4 @@ glm::mat4 ObjectManager::calculateMatrix(glm::vec3 position, glm::vec3 rotation,
     return translationMatrix * yawMatrix * pitchMatrix * rollMatrix * scaleMatrix;
 }
 
-} // namespace Tobi
\ No newline at end of file
+} // namespace Tobi
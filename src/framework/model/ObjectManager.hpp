@@ -4,15 +4,33 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
-#include <map>
+#include <memory>
+#include <vector>
 
 namespace Tobi
 {
 
+class JobSystem;
+
+/// @brief A range of consecutive object ids, as returned by ObjectManager::addObjects.
+struct ObjectIdRange
+{
+    uint32_t firstId;
+    uint32_t count;
+};
+
+/// @brief Owns the transforms and meshes of all objects.
+///
+/// Objects are stored densely as a structure of arrays. Ids are handed out
+/// in increasing order and never reused; a sparse table maps each id to its
+/// current slot. Removing an object moves the last object into its slot, so
+/// removal is constant time and the ids of the other objects stay valid.
 class ObjectManager
 {
   public:
-    ObjectManager();
+    static const uint32_t invalidIndex = 0xffffffff;
+
+    explicit ObjectManager(std::shared_ptr<JobSystem> jobSystem);
     ObjectManager(const ObjectManager &) = delete;
     ObjectManager(ObjectManager &&) = delete;
     ObjectManager &operator=(const ObjectManager &) & = delete;
@@ -24,19 +42,62 @@ class ObjectManager
     uint32_t addObject(uint32_t meshIndex, glm::vec3 position, glm::vec3 rotation);
     uint32_t addObject(uint32_t meshIndex, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
 
-    const auto &getModelMatrix(uint32_t index) { return modelMatrix[index]; }
-    const auto &getMeshIndex(uint32_t index) { return meshIndex[index]; }
+    /// Adds count objects at once. Storage grows at most once, at least
+    /// doubling, and the model matrices are calculated in parallel on the job
+    /// system.
+    /// @returns The consecutive ids of the new objects.
+    ObjectIdRange addObjects(uint32_t count,
+                             const uint32_t *meshIndices,
+                             const glm::vec3 *positions,
+                             const glm::vec3 *rotations,
+                             const glm::vec3 *scales);
+
+    /// Removes count objects in O(count). Ids which are not alive are ignored.
+    void removeObjects(const uint32_t *ids, uint32_t count);
+    void removeObjects(const ObjectIdRange &range);
+
+    /// Reserves room for objectCount objects in total.
+    void reserve(uint32_t objectCount);
+
+    bool isAlive(uint32_t id) const { return id < indexById.size() && indexById[id] != invalidIndex; }
+
+    const glm::mat4 &getModelMatrix(uint32_t id) const { return modelMatrices[indexById[id]]; }
+    uint32_t getMeshIndex(uint32_t id) const { return meshIndices[indexById[id]]; }
+
+    /// Occluders are rasterized by the occlusion culler to hide the objects behind them.
+    /// Only large, solid objects like terrain or buildings make good occluders.
+    void setOccluder(uint32_t id, bool occluder);
+    bool isOccluder(uint32_t id) const { return occluders[indexById[id]] != 0; }
+
+    /// The dense arrays, all indexed the same way. Their order changes when objects are removed.
+    const std::vector<uint32_t> &getObjectIds() const { return objectIds; }
+    const std::vector<glm::mat4> &getModelMatrices() const { return modelMatrices; }
+    const std::vector<uint32_t> &getMeshIndices() const { return meshIndices; }
+
+    uint32_t getObjectCount() const { return static_cast<uint32_t>(objectIds.size()); }
+
+    /// Incremented whenever objects are added or removed, so systems caching
+    /// per-object data (like the culling bounds) know when to rebuild.
+    uint32_t getVersion() const { return version; }
 
   private:
-    std::map<uint32_t, glm::vec3> position;
-    std::map<uint32_t, glm::vec3> rotation;
-    std::map<uint32_t, glm::vec3> scale;
-    std::map<uint32_t, glm::mat4> modelMatrix;
-    std::map<uint32_t, uint32_t> meshIndex;
+    std::shared_ptr<JobSystem> jobSystem;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> modelMatrices;
+    std::vector<uint32_t> meshIndices;
+    std::vector<uint8_t> occluders;
+    std::vector<uint32_t> objectIds;
+
+    // Maps ids to slots in the dense arrays. Grows by one entry per id ever handed out.
+    std::vector<uint32_t> indexById;
 
     uint32_t idCounter;
+    uint32_t version;
 
-    glm::mat4 calculateMatrix(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
+    static glm::mat4 calculateMatrix(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
 };
 
-} // namespace Tobi
\ No newline at end of file
+} // namespace Tobi
@@ -0,0 +1,177 @@
+#include "BindlessResources.hpp"
+
+#include <algorithm>
+
+#include "../../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+// Sizes of the arrays, unless the device allows fewer descriptors.
+static const uint32_t maxTextureCount = 16384;
+static const uint32_t maxStorageBufferCount = 4096;
+
+static uint32_t getTextureSlotCount(const Platform &platform)
+{
+    // Combined image samplers count as both a sampler and a sampled image.
+    const auto &limits = platform.getDescriptorIndexingProperties();
+    return std::min({maxTextureCount,
+                     limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                     limits.maxDescriptorSetUpdateAfterBindSamplers,
+                     limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                     limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+}
+
+static uint32_t getStorageBufferSlotCount(const Platform &platform)
+{
+    const auto &limits = platform.getDescriptorIndexingProperties();
+    return std::min({maxStorageBufferCount,
+                     limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                     limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+}
+
+BindlessResources::BindlessResources(std::shared_ptr<Platform> platform)
+    : platform(platform),
+      descriptorSetLayout(VK_NULL_HANDLE),
+      descriptorPool(VK_NULL_HANDLE),
+      descriptorSet(VK_NULL_HANDLE),
+      textureSlots(getTextureSlotCount(*platform)),
+      storageBufferSlots(getStorageBufferSlotCount(*platform))
+{
+    LOGI("CONSTRUCTING BindlessResources\n");
+
+    auto device = platform->getDevice();
+    auto stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = textureBinding;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = textureSlots.getCapacity();
+    bindings[0].stageFlags = stages;
+    bindings[1].binding = storageBufferBinding;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = storageBufferSlots.getCapacity();
+    bindings[1].stageFlags = stages;
+
+    // Unused slots are never read, and slots are written while the set is bound
+    // by command buffers in flight which use other slots.
+    VkDescriptorBindingFlags bindingFlags[2];
+    bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    bindingFlags[1] = bindingFlags[0];
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    bindingFlagsInfo.bindingCount = 2;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout));
+
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = textureSlots.getCapacity();
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = storageBufferSlots.getCapacity();
+
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &descriptorSetLayout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet));
+
+    LOGI("Bindless arrays of %u textures and %u storage buffers.\n",
+         textureSlots.getCapacity(),
+         storageBufferSlots.getCapacity());
+}
+
+BindlessResources::~BindlessResources()
+{
+    LOGI("DECONSTRUCTING BindlessResources\n");
+
+    // Destroying the pool frees the set.
+    auto device = platform->getDevice();
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+void BindlessResources::write(uint32_t binding,
+                              uint32_t slot,
+                              const VkDescriptorImageInfo *pImageInfo,
+                              const VkDescriptorBufferInfo *pBufferInfo)
+{
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = descriptorSet;
+    write.dstBinding = binding;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = pImageInfo ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pImageInfo = pImageInfo;
+    write.pBufferInfo = pBufferInfo;
+    vkUpdateDescriptorSets(platform->getDevice(), 1, &write, 0, nullptr);
+}
+
+uint32_t BindlessResources::addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto slot = textureSlots.allocate();
+    if (slot == invalidSlot)
+    {
+        LOGE("All %u bindless texture slots are in use.\n", textureSlots.getCapacity());
+        return invalidSlot;
+    }
+
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = imageLayout;
+    write(textureBinding, slot, &imageInfo, nullptr);
+    return slot;
+}
+
+void BindlessResources::removeTexture(uint32_t slot)
+{
+    // The descriptor stays written, partially bound arrays don't require it to be valid.
+    std::lock_guard<std::mutex> lock(mutex);
+    textureSlots.free(slot);
+}
+
+uint32_t BindlessResources::addStorageBuffer(const VkDescriptorBufferInfo &bufferInfo)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto slot = storageBufferSlots.allocate();
+    if (slot == invalidSlot)
+    {
+        LOGE("All %u bindless storage buffer slots are in use.\n", storageBufferSlots.getCapacity());
+        return invalidSlot;
+    }
+
+    write(storageBufferBinding, slot, nullptr, &bufferInfo);
+    return slot;
+}
+
+void BindlessResources::removeStorageBuffer(uint32_t slot)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    storageBufferSlots.free(slot);
+}
+
+void BindlessResources::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout) const
+{
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, setIndex, 1, &descriptorSet, 0, nullptr);
+}
+
+} // namespace Tobi
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+#include "SlotAllocator.hpp"
+
+namespace Tobi
+{
+class Platform;
+
+/// @brief One descriptor set holding every texture and storage buffer, which
+/// stays bound while the draws select resources by slot.
+///
+/// Shaders declare the arrays in set @ref setIndex:
+///
+///     layout(set = 1, binding = 0) uniform sampler2D textures[];
+///     layout(set = 1, binding = 1) buffer Buffers { ... } buffers[];
+///
+/// and index them with slots from the per-draw data, using nonuniformEXT when
+/// the slot differs within a draw. Draws using different textures don't need
+/// a bind in between and can be merged into one instanced or indirect draw.
+///
+/// The arrays are partially bound and update after bind, so adding a resource
+/// doesn't disturb frames in flight. Slots still read by a frame in flight
+/// must not be removed, the caller defers the removal until the frame is done.
+/// Requires descriptor indexing, see @ref Platform::supportsDescriptorIndexing.
+class BindlessResources
+{
+  public:
+    static const uint32_t setIndex = 1;
+    static const uint32_t textureBinding = 0;
+    static const uint32_t storageBufferBinding = 1;
+    static const uint32_t invalidSlot = SlotAllocator::invalidSlot;
+
+    BindlessResources(std::shared_ptr<Platform> platform);
+    BindlessResources(const BindlessResources &) = delete;
+    BindlessResources(BindlessResources &&) = delete;
+    BindlessResources &operator=(const BindlessResources &) & = delete;
+    BindlessResources &operator=(BindlessResources &&) & = delete;
+    ~BindlessResources();
+
+    /// @returns invalidSlot when the array is full.
+    uint32_t addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+    void removeTexture(uint32_t slot);
+
+    /// @returns invalidSlot when the array is full.
+    uint32_t addStorageBuffer(const VkDescriptorBufferInfo &bufferInfo);
+    void removeStorageBuffer(uint32_t slot);
+
+    /// @brief Pipelines using the arrays have this layout as set @ref setIndex.
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+    void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout) const;
+
+    uint32_t getTextureCapacity() const { return textureSlots.getCapacity(); }
+    uint32_t getStorageBufferCapacity() const { return storageBufferSlots.getCapacity(); }
+
+  private:
+    std::shared_ptr<Platform> platform;
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+
+    SlotAllocator textureSlots;
+    SlotAllocator storageBufferSlots;
+    std::mutex mutex;
+
+    void write(uint32_t binding, uint32_t slot, const VkDescriptorImageInfo *pImageInfo, const VkDescriptorBufferInfo *pBufferInfo);
+};
+
+} // namespace Tobi
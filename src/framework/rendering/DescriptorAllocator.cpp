@@ -0,0 +1,224 @@
+#include "DescriptorAllocator.hpp"
+
+#include "../buffers/BufferManager.hpp"
+
+namespace Tobi
+{
+
+// Every pool has room for this many sets, with enough descriptors of each type
+// for the sets of the frame to mix them freely.
+static const uint32_t setsPerPool = 256;
+static const VkDescriptorPoolSize poolSizes[] = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * setsPerPool},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, setsPerPool},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * setsPerPool},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, setsPerPool},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 * setsPerPool},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, setsPerPool},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setsPerPool},
+    {VK_DESCRIPTOR_TYPE_SAMPLER, setsPerPool},
+};
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device)
+    : device(device),
+      frames(std::vector<Frame>()),
+      frameIndex(0)
+{
+    LOGI("CONSTRUCTING DescriptorAllocator\n");
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    LOGI("DECONSTRUCTING DescriptorAllocator\n");
+    destroyPools();
+}
+
+void DescriptorAllocator::destroyPools()
+{
+    for (auto &frame : frames)
+    {
+        for (auto pool : frame.pools)
+            vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    frames.clear();
+}
+
+void DescriptorAllocator::setFrameCount(uint32_t frameCount)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    destroyPools();
+    frames.resize(frameCount);
+    for (auto &frame : frames)
+    {
+        frame.currentPool = 0;
+        frame.allocatedCount = 0;
+        frame.reusedCount = 0;
+    }
+    frameIndex = 0;
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->frameIndex = frameIndex;
+    auto &frame = frames[frameIndex];
+
+    // Resetting returns all sets of a pool at once.
+    for (uint32_t i = 0; i <= frame.currentPool && i < frame.pools.size(); i++)
+        VK_CHECK(vkResetDescriptorPool(device, frame.pools[i], 0));
+
+    frame.currentPool = 0;
+    frame.sets.clear();
+    frame.allocatedCount = 0;
+    frame.reusedCount = 0;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool()
+{
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = setsPerPool;
+    poolInfo.poolSizeCount = sizeof(poolSizes) / sizeof(poolSizes[0]);
+    poolInfo.pPoolSizes = poolSizes;
+
+    VkDescriptorPool pool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+    return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(Frame &frame, VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &layout;
+
+    // Full pools are skipped for the rest of the frame, a fresh pool always has room.
+    for (;;)
+    {
+        if (frame.currentPool == frame.pools.size())
+        {
+            frame.pools.push_back(createPool());
+            LOGI("Frame %u uses %u descriptor pools.\n", frameIndex, static_cast<uint32_t>(frame.pools.size()));
+        }
+
+        allocateInfo.descriptorPool = frame.pools[frame.currentPool];
+
+        VkDescriptorSet set;
+        auto result = vkAllocateDescriptorSets(device, &allocateInfo, &set);
+        if (result == VK_SUCCESS)
+            return set;
+
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+        {
+            VK_CHECK(result);
+            return VK_NULL_HANDLE;
+        }
+
+        frame.currentPool++;
+    }
+}
+
+VkDescriptorSet DescriptorAllocator::getDescriptorSet(VkDescriptorSetLayout layout,
+                                                      const DescriptorWrite *pWrites,
+                                                      uint32_t writeCount)
+{
+    std::vector<uint64_t> key;
+    key.reserve(1 + 7 * writeCount);
+    key.push_back(reinterpret_cast<uint64_t>(layout));
+    for (uint32_t i = 0; i < writeCount; i++)
+    {
+        const auto &write = pWrites[i];
+        key.push_back((static_cast<uint64_t>(write.binding) << 32) | write.descriptorType);
+        key.push_back(reinterpret_cast<uint64_t>(write.bufferInfo.buffer));
+        key.push_back(write.bufferInfo.offset);
+        key.push_back(write.bufferInfo.range);
+        key.push_back(reinterpret_cast<uint64_t>(write.imageInfo.imageView));
+        key.push_back(write.imageInfo.imageLayout);
+        key.push_back(reinterpret_cast<uint64_t>(write.imageInfo.sampler));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &frame = frames[frameIndex];
+
+    auto cached = frame.sets.find(key);
+    if (cached != frame.sets.end())
+    {
+        frame.reusedCount++;
+        return cached->second;
+    }
+
+    auto set = allocate(frame, layout);
+    frame.allocatedCount++;
+
+    std::vector<VkWriteDescriptorSet> writes(writeCount, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET});
+    for (uint32_t i = 0; i < writeCount; i++)
+    {
+        writes[i].dstSet = set;
+        writes[i].dstBinding = pWrites[i].binding;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = pWrites[i].descriptorType;
+        writes[i].pBufferInfo = &pWrites[i].bufferInfo;
+        writes[i].pImageInfo = &pWrites[i].imageInfo;
+    }
+    vkUpdateDescriptorSets(device, writeCount, writes.data(), 0, nullptr);
+
+    frame.sets[key] = set;
+    return set;
+}
+
+DescriptorWrite DescriptorAllocator::bufferWrite(uint32_t binding,
+                                                 VkDescriptorType descriptorType,
+                                                 BufferManager &manager,
+                                                 uint32_t bufferId)
+{
+    DescriptorWrite write = {};
+    write.binding = binding;
+    write.descriptorType = descriptorType;
+    write.bufferInfo = manager.getBufferInfo(bufferId);
+    return write;
+}
+
+DescriptorWrite DescriptorAllocator::bufferWrite(uint32_t binding,
+                                                 VkDescriptorType descriptorType,
+                                                 VkBuffer buffer,
+                                                 VkDeviceSize offset,
+                                                 VkDeviceSize range)
+{
+    DescriptorWrite write = {};
+    write.binding = binding;
+    write.descriptorType = descriptorType;
+    write.bufferInfo.buffer = buffer;
+    write.bufferInfo.offset = offset;
+    write.bufferInfo.range = range;
+    return write;
+}
+
+DescriptorWrite DescriptorAllocator::imageWrite(uint32_t binding,
+                                                VkDescriptorType descriptorType,
+                                                VkImageView imageView,
+                                                VkImageLayout imageLayout,
+                                                VkSampler sampler)
+{
+    DescriptorWrite write = {};
+    write.binding = binding;
+    write.descriptorType = descriptorType;
+    write.imageInfo.imageView = imageView;
+    write.imageInfo.imageLayout = imageLayout;
+    write.imageInfo.sampler = sampler;
+    return write;
+}
+
+uint32_t DescriptorAllocator::getAllocatedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return frames.empty() ? 0 : frames[frameIndex].allocatedCount;
+}
+
+uint32_t DescriptorAllocator::getReusedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return frames.empty() ? 0 : frames[frameIndex].reusedCount;
+}
+
+} // namespace Tobi
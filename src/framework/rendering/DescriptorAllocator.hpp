@@ -0,0 +1,104 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+
+namespace Tobi
+{
+class BufferManager;
+
+/// @brief One descriptor of a set.
+struct DescriptorWrite
+{
+    uint32_t binding;
+    VkDescriptorType descriptorType;
+    /// Used by buffer descriptors.
+    VkDescriptorBufferInfo bufferInfo;
+    /// Used by image and sampler descriptors.
+    VkDescriptorImageInfo imageInfo;
+};
+
+/// @brief Hands out descriptor sets which live for one frame.
+///
+/// Every frame in flight allocates from its own pools, which are reset as a
+/// whole once the GPU is done with the frame. Sets are never freed one by one,
+/// so the pools are created without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+/// and allocating is a pointer bump in the driver. A frame which runs out of
+/// space gets another pool, which it keeps for the following frames.
+///
+/// Asking twice in a frame for a set with the same layout and contents returns
+/// the set written the first time. It can be used from several threads.
+class DescriptorAllocator
+{
+  public:
+    DescriptorAllocator(VkDevice device);
+    DescriptorAllocator(const DescriptorAllocator &) = delete;
+    DescriptorAllocator(DescriptorAllocator &&) = delete;
+    DescriptorAllocator &operator=(const DescriptorAllocator &) & = delete;
+    DescriptorAllocator &operator=(DescriptorAllocator &&) & = delete;
+    ~DescriptorAllocator();
+
+    /// @brief Destroys all pools, the caller has to make sure no set is in use.
+    void setFrameCount(uint32_t frameCount);
+
+    /// @brief Resets the pools of a frame in flight, the GPU has to be done with it.
+    void beginFrame(uint32_t frameIndex);
+
+    /// @brief A set of the layout holding the descriptors, written if there is
+    /// no identical one in the current frame yet.
+    /// @param pWrites Sorted by binding, one per binding of the layout.
+    VkDescriptorSet getDescriptorSet(VkDescriptorSetLayout layout, const DescriptorWrite *pWrites, uint32_t writeCount);
+
+    VkDescriptorSet getDescriptorSet(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite> &writes)
+    {
+        return getDescriptorSet(layout, writes.data(), static_cast<uint32_t>(writes.size()));
+    }
+
+    /// @brief A whole buffer of a @ref BufferManager.
+    static DescriptorWrite bufferWrite(uint32_t binding, VkDescriptorType descriptorType, BufferManager &manager, uint32_t bufferId);
+
+    /// @brief A range of a buffer, for example one frame of a ring buffer.
+    static DescriptorWrite bufferWrite(uint32_t binding,
+                                       VkDescriptorType descriptorType,
+                                       VkBuffer buffer,
+                                       VkDeviceSize offset,
+                                       VkDeviceSize range);
+
+    static DescriptorWrite imageWrite(uint32_t binding,
+                                      VkDescriptorType descriptorType,
+                                      VkImageView imageView,
+                                      VkImageLayout imageLayout,
+                                      VkSampler sampler = VK_NULL_HANDLE);
+
+    /// @brief Sets allocated in the current frame.
+    uint32_t getAllocatedCount() const;
+    /// @brief Requests in the current frame answered with an already written set.
+    uint32_t getReusedCount() const;
+
+  private:
+    struct Frame
+    {
+        std::vector<VkDescriptorPool> pools;
+        // Pools before this one are full.
+        uint32_t currentPool;
+        // Keyed by the layout and the contents of the writes.
+        std::map<std::vector<uint64_t>, VkDescriptorSet> sets;
+        uint32_t allocatedCount;
+        uint32_t reusedCount;
+    };
+
+    VkDevice device;
+    std::vector<Frame> frames;
+    uint32_t frameIndex;
+    mutable std::mutex mutex;
+
+    VkDescriptorPool createPool();
+    VkDescriptorSet allocate(Frame &frame, VkDescriptorSetLayout layout);
+    void destroyPools();
+};
+
+} // namespace Tobi
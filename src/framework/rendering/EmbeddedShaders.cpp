@@ -0,0 +1,51 @@
+#include "EmbeddedShaders.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace Tobi
+{
+namespace EmbeddedShaders
+{
+
+// Assets replaced while running, such as shaders recompiled by the ShaderWatcher.
+static std::mutex staleMutex;
+static std::set<std::string> stalePaths;
+
+bool load(const char *pPath, std::vector<uint32_t> &code)
+{
+#ifdef TOBI_EMBED_SHADERS
+    {
+        std::lock_guard<std::mutex> lock(staleMutex);
+        if (stalePaths.count(pPath))
+            return false;
+    }
+
+    for (size_t i = 0; i < embeddedShaderCount; i++)
+    {
+        const auto &shader = embeddedShaders[i];
+        if (strcmp(shader.pPath, pPath) != 0)
+            continue;
+
+        code.resize(shader.size / sizeof(uint32_t));
+        memcpy(code.data(), shader.pData, code.size() * sizeof(uint32_t));
+        return true;
+    }
+#else
+    (void)pPath;
+    (void)code;
+#endif
+
+    return false;
+}
+
+void markStale(const char *pPath)
+{
+    std::lock_guard<std::mutex> lock(staleMutex);
+    stalePaths.insert(pPath);
+}
+
+} // namespace EmbeddedShaders
+} // namespace Tobi
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Tobi
+{
+
+/// @brief A SPIR-V module compiled into the library.
+struct EmbeddedShader
+{
+    /// Path relative to the assets directory, such as "shaders/triangle.vert.spv".
+    const char *pPath;
+    const unsigned char *pData;
+    size_t size;
+};
+
+/// Generated by the build when it is configured with TOBI_EMBED_SHADERS, see
+/// cmake/TobiShaders.cmake. Only defined in that case.
+extern const EmbeddedShader embeddedShaders[];
+extern const size_t embeddedShaderCount;
+
+namespace EmbeddedShaders
+{
+
+/// @brief Copies the embedded SPIR-V of an asset, so loading it needs no file I/O.
+/// Safe to call from several threads.
+/// @returns false if the shader is not embedded or has been marked stale.
+bool load(const char *pPath, std::vector<uint32_t> &code);
+
+/// @brief Loads of the asset read the file from now on, once a newer version of
+/// the shader has been written there.
+void markStale(const char *pPath);
+
+} // namespace EmbeddedShaders
+
+} // namespace Tobi
@@ -0,0 +1,181 @@
+#include "PipelineLayoutCache.hpp"
+
+#include <algorithm>
+
+namespace Tobi
+{
+
+PipelineLayoutCache::PipelineLayoutCache(VkDevice device)
+    : device(device),
+      descriptorSetLayouts(std::map<std::vector<uint32_t>, VkDescriptorSetLayout>()),
+      pipelineLayouts(std::map<std::vector<uint64_t>, VkPipelineLayout>()),
+      pipelineSetLayouts(std::map<VkPipelineLayout, std::vector<VkDescriptorSetLayout>>()),
+      externalSetLayouts(std::map<uint32_t, VkDescriptorSetLayout>())
+{
+    LOGI("CONSTRUCTING PipelineLayoutCache\n");
+}
+
+PipelineLayoutCache::~PipelineLayoutCache()
+{
+    LOGI("DECONSTRUCTING PipelineLayoutCache\n");
+
+    for (auto &layout : pipelineLayouts)
+        vkDestroyPipelineLayout(device, layout.second, nullptr);
+    for (auto &layout : descriptorSetLayouts)
+        vkDestroyDescriptorSetLayout(device, layout.second, nullptr);
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return getDescriptorSetLayoutLocked(bindings);
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::getDescriptorSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+{
+    std::vector<uint32_t> key;
+    for (const auto &binding : bindings)
+    {
+        key.insert(key.end(),
+                   {binding.binding,
+                    static_cast<uint32_t>(binding.descriptorType),
+                    binding.descriptorCount,
+                    binding.stageFlags});
+    }
+
+    auto cached = descriptorSetLayouts.find(key);
+    if (cached != descriptorSetLayouts.end())
+        return cached->second;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout));
+    descriptorSetLayouts[key] = layout;
+    return layout;
+}
+
+VkPipelineLayout PipelineLayoutCache::getPipelineLayout(const ShaderReflection *pStages, uint32_t stageCount)
+{
+    // Merge the bindings of all stages, per set and sorted by binding.
+    std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> sets;
+    VkPushConstantRange pushConstantRange = {};
+    for (uint32_t i = 0; i < stageCount; i++)
+    {
+        const auto &stage = pStages[i];
+        if (stage.pushConstantSize)
+        {
+            pushConstantRange.stageFlags |= stage.stage;
+            pushConstantRange.size = std::max(pushConstantRange.size, stage.pushConstantSize);
+        }
+
+        for (const auto &binding : stage.bindings)
+        {
+            auto &setBindings = sets[binding.set];
+            auto existing = std::find_if(setBindings.begin(), setBindings.end(), [&binding](const VkDescriptorSetLayoutBinding &b) {
+                return b.binding == binding.binding;
+            });
+
+            if (existing == setBindings.end())
+            {
+                VkDescriptorSetLayoutBinding layoutBinding = {};
+                layoutBinding.binding = binding.binding;
+                layoutBinding.descriptorType = binding.descriptorType;
+                layoutBinding.descriptorCount = binding.descriptorCount;
+                layoutBinding.stageFlags = stage.stage;
+                setBindings.push_back(layoutBinding);
+            }
+            else if (existing->descriptorType != binding.descriptorType || existing->descriptorCount != binding.descriptorCount)
+            {
+                LOGE("Set %u, binding %u is declared differently by the stages.\n", binding.set, binding.binding);
+                return VK_NULL_HANDLE;
+            }
+            else
+            {
+                existing->stageFlags |= stage.stage;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Sets without bindings in between still need a layout.
+    std::vector<VkDescriptorSetLayout> setLayouts(sets.empty() ? 0 : sets.rbegin()->first + 1, VK_NULL_HANDLE);
+    for (uint32_t set = 0; set < setLayouts.size(); set++)
+    {
+        auto external = externalSetLayouts.find(set);
+        if (external != externalSetLayouts.end())
+        {
+            setLayouts[set] = external->second;
+            continue;
+        }
+
+        auto &bindings = sets[set];
+        std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+            return a.binding < b.binding;
+        });
+        setLayouts[set] = getDescriptorSetLayoutLocked(bindings);
+    }
+
+    // Set layouts are unique per content, so their handles identify them.
+    std::vector<uint64_t> key;
+    for (auto setLayout : setLayouts)
+        key.push_back(reinterpret_cast<uint64_t>(setLayout));
+    key.push_back(pushConstantRange.stageFlags);
+    key.push_back(pushConstantRange.size);
+
+    auto cached = pipelineLayouts.find(key);
+    if (cached != pipelineLayouts.end())
+        return cached->second;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = pushConstantRange.size ? 1 : 0;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    VkPipelineLayout layout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &layout));
+    pipelineLayouts[key] = layout;
+    pipelineSetLayouts[layout] = setLayouts;
+    return layout;
+}
+
+void PipelineLayoutCache::setExternalSetLayout(uint32_t set, VkDescriptorSetLayout layout)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    externalSetLayouts[set] = layout;
+}
+
+uint32_t PipelineLayoutCache::getSetCount(VkPipelineLayout layout) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto setLayouts = pipelineSetLayouts.find(layout);
+    return setLayouts != pipelineSetLayouts.end() ? static_cast<uint32_t>(setLayouts->second.size()) : 0;
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::getSetLayout(VkPipelineLayout layout, uint32_t set) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto setLayouts = pipelineSetLayouts.find(layout);
+    if (setLayouts == pipelineSetLayouts.end() || set >= setLayouts->second.size())
+        return VK_NULL_HANDLE;
+
+    return setLayouts->second[set];
+}
+
+uint32_t PipelineLayoutCache::getDescriptorSetLayoutCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<uint32_t>(descriptorSetLayouts.size());
+}
+
+uint32_t PipelineLayoutCache::getPipelineLayoutCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<uint32_t>(pipelineLayouts.size());
+}
+
+} // namespace Tobi
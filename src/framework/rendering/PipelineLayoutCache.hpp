@@ -0,0 +1,70 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+#include "ShaderReflection.hpp"
+
+namespace Tobi
+{
+
+/// @brief Creates pipeline layouts and descriptor set layouts from reflected
+/// shaders, and shares equal ones.
+///
+/// Pipelines whose shaders declare the same resources get the same layout, so
+/// push constants and descriptor sets bound for one stay valid for the others.
+/// Layouts live as long as the cache. It can be used from several threads.
+class PipelineLayoutCache
+{
+  public:
+    PipelineLayoutCache(VkDevice device);
+    PipelineLayoutCache(const PipelineLayoutCache &) = delete;
+    PipelineLayoutCache(PipelineLayoutCache &&) = delete;
+    PipelineLayoutCache &operator=(const PipelineLayoutCache &) & = delete;
+    PipelineLayoutCache &operator=(PipelineLayoutCache &&) & = delete;
+    ~PipelineLayoutCache();
+
+    /// @brief The layout of one descriptor set.
+    /// @param bindings Sorted by binding.
+    VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+    /// @brief The layout of a pipeline made of the given stages. Push constant
+    /// blocks of all stages start at offset 0 and share one range, a binding
+    /// used by several stages is visible to all of them.
+    /// @returns VK_NULL_HANDLE if the stages declare a binding with different types.
+    VkPipelineLayout getPipelineLayout(const ShaderReflection *pStages, uint32_t stageCount);
+
+    /// @brief Uses a layout created elsewhere for a set number, for sets whose
+    /// layout needs flags which can't be reflected, such as update after bind.
+    /// Shaders declaring resources in the set have to match it. Only affects
+    /// pipeline layouts created afterwards.
+    void setExternalSetLayout(uint32_t set, VkDescriptorSetLayout layout);
+
+    /// @brief Number of descriptor sets of a pipeline layout created by the cache.
+    uint32_t getSetCount(VkPipelineLayout layout) const;
+
+    /// @brief The layout of one set of a pipeline layout created by the cache,
+    /// to allocate descriptor sets for it.
+    /// @returns VK_NULL_HANDLE if the pipeline layout has no such set.
+    VkDescriptorSetLayout getSetLayout(VkPipelineLayout layout, uint32_t set) const;
+
+    uint32_t getDescriptorSetLayoutCount() const;
+    uint32_t getPipelineLayoutCount() const;
+
+  private:
+    VkDevice device;
+
+    std::map<std::vector<uint32_t>, VkDescriptorSetLayout> descriptorSetLayouts;
+    std::map<std::vector<uint64_t>, VkPipelineLayout> pipelineLayouts;
+    std::map<VkPipelineLayout, std::vector<VkDescriptorSetLayout>> pipelineSetLayouts;
+    // Not owned by the cache.
+    std::map<uint32_t, VkDescriptorSetLayout> externalSetLayouts;
+    mutable std::mutex mutex;
+
+    VkDescriptorSetLayout getDescriptorSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+};
+
+} // namespace Tobi
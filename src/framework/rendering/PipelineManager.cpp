@@ -0,0 +1,589 @@
+#include "PipelineManager.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "EmbeddedShaders.hpp"
+#include "../jobs/JobSystem.hpp"
+#include "../model/Vertex.hpp"
+#include "../terrain/TerrainVertex.hpp"
+#include "../../platform/AssetManager.hpp"
+#include "../../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+static const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+static const uint64_t fnvPrime = 1099511628211ull;
+
+static uint64_t hashBytes(uint64_t hash, const void *pData, size_t size)
+{
+    auto pBytes = static_cast<const uint8_t *>(pData);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= pBytes[i];
+        hash *= fnvPrime;
+    }
+    return hash;
+}
+
+template <typename T>
+static uint64_t hashValue(uint64_t hash, const T &value)
+{
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+static uint64_t hashString(uint64_t hash, const char *pString)
+{
+    // The terminator separates consecutive strings, null hashes like an empty string.
+    if (pString)
+        hash = hashBytes(hash, pString, strlen(pString));
+    return hashValue(hash, '\0');
+}
+
+static bool isSameString(const char *a, const char *b)
+{
+    if (!a || !b)
+        return a == b;
+    return strcmp(a, b) == 0;
+}
+
+PipelineManager::PipelineManager(std::shared_ptr<Platform> platform,
+                                 std::shared_ptr<JobSystem> jobSystem,
+                                 VkPipelineCache pipelineCache)
+    : platform(platform),
+      jobSystem(jobSystem),
+      pipelineCache(pipelineCache),
+      layoutCache(std::make_unique<PipelineLayoutCache>(platform->getDevice())),
+      entries(std::deque<Entry>()),
+      handlesByHash(std::multimap<uint64_t, uint32_t>()),
+      pendingCount(0)
+{
+    LOGI("CONSTRUCTING PipelineManager\n");
+}
+
+PipelineManager::~PipelineManager()
+{
+    LOGI("DECONSTRUCTING PipelineManager\n");
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        compiled.wait(lock, [this]() { return pendingCount == 0; });
+    }
+
+    for (auto &entry : entries)
+    {
+        if (entry.pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(platform->getDevice(), entry.pipeline, nullptr);
+        if (entry.reloadedPipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(platform->getDevice(), entry.reloadedPipeline, nullptr);
+    }
+}
+
+uint64_t PipelineManager::hashDesc(const PipelineDesc &desc)
+{
+    auto hash = fnvOffsetBasis;
+    hash = hashString(hash, desc.vertexShader);
+    hash = hashString(hash, desc.fragmentShader);
+    hash = hashValue(hash, desc.shaderFeatures);
+    hash = hashValue(hash, desc.vertexLayout);
+    hash = hashValue(hash, desc.cullMode);
+    hash = hashValue(hash, desc.frontFace);
+    hash = hashValue(hash, desc.colorAttachmentCount);
+    hash = hashValue(hash, desc.blendEnable);
+    hash = hashValue(hash, desc.depthTestEnable);
+    hash = hashValue(hash, desc.depthWriteEnable);
+    hash = hashValue(hash, desc.depthCompareOp);
+    hash = hashValue(hash, desc.renderPass);
+    hash = hashValue(hash, desc.subpass);
+    return hash;
+}
+
+bool PipelineManager::isSameDesc(const PipelineDesc &a, const PipelineDesc &b)
+{
+    return isSameString(a.vertexShader, b.vertexShader) &&
+           isSameString(a.fragmentShader, b.fragmentShader) &&
+           a.shaderFeatures == b.shaderFeatures &&
+           a.vertexLayout == b.vertexLayout &&
+           a.cullMode == b.cullMode &&
+           a.frontFace == b.frontFace &&
+           a.colorAttachmentCount == b.colorAttachmentCount &&
+           a.blendEnable == b.blendEnable &&
+           a.depthTestEnable == b.depthTestEnable &&
+           a.depthWriteEnable == b.depthWriteEnable &&
+           a.depthCompareOp == b.depthCompareOp &&
+           a.renderPass == b.renderPass &&
+           a.subpass == b.subpass;
+}
+
+uint32_t PipelineManager::requestPipeline(const PipelineDesc &desc, uint32_t fallback)
+{
+    auto hash = hashDesc(desc);
+
+    uint32_t handle;
+    Entry *pEntry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto range = handlesByHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (isSameDesc(entries[it->second].desc, desc))
+                return it->second;
+        }
+
+        handle = static_cast<uint32_t>(entries.size());
+        entries.emplace_back();
+        auto &entry = entries.back();
+        entry.hash = hash;
+        entry.vertexShader = desc.vertexShader ? desc.vertexShader : "";
+        entry.fragmentShader = desc.fragmentShader ? desc.fragmentShader : "";
+        entry.desc = desc;
+        entry.desc.vertexShader = desc.vertexShader ? entry.vertexShader.c_str() : nullptr;
+        entry.desc.fragmentShader = desc.fragmentShader ? entry.fragmentShader.c_str() : nullptr;
+        entry.fallback = fallback;
+        entry.pipeline = VK_NULL_HANDLE;
+        entry.layout = VK_NULL_HANDLE;
+        entry.pending = true;
+        entry.reloadedPipeline = VK_NULL_HANDLE;
+        entry.reloadedLayout = VK_NULL_HANDLE;
+        entry.reloading = false;
+        entry.reloaded = false;
+        entry.reloadRequested = false;
+
+        handlesByHash.insert({hash, handle});
+        pendingCount++;
+        pEntry = &entry;
+    }
+
+    // The entry is not changed by anyone else until the job is done with it.
+    jobSystem->schedule([this, pEntry]() {
+        VkPipelineLayout layout;
+        auto pipeline = createPipeline(pEntry->desc, layout);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        pEntry->pipeline = pipeline;
+        pEntry->layout = layout;
+        pEntry->pending = false;
+        pendingCount--;
+        compiled.notify_all();
+    });
+
+    return handle;
+}
+
+void PipelineManager::scheduleReloads(const std::vector<Entry *> &reloads)
+{
+    // Jobs run inline without workers, so they are scheduled without holding the mutex.
+    for (auto pEntry : reloads)
+    {
+        // Only the reload fields are written, the pipeline in use stays
+        // untouched until applyReloads.
+        jobSystem->schedule([this, pEntry]() {
+            VkPipelineLayout layout;
+            auto pipeline = createPipeline(pEntry->desc, layout);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            pEntry->reloadedPipeline = pipeline;
+            pEntry->reloadedLayout = layout;
+            pEntry->reloading = false;
+            pEntry->reloaded = true;
+            pendingCount--;
+            compiled.notify_all();
+        });
+    }
+}
+
+uint32_t PipelineManager::reloadShader(const char *pPath)
+{
+    // The file is newer than the SPIR-V compiled into the library.
+    EmbeddedShaders::markStale(pPath);
+
+    uint32_t count = 0;
+    std::vector<Entry *> reloads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto &entry : entries)
+        {
+            if (!isSameString(entry.desc.vertexShader, pPath) && !isSameString(entry.desc.fragmentShader, pPath))
+                continue;
+
+            count++;
+
+            // A compile in flight might have read the previous SPIR-V, so the
+            // pipeline is compiled again once it is done.
+            if (entry.pending || entry.reloading || entry.reloaded)
+            {
+                entry.reloadRequested = true;
+                continue;
+            }
+
+            entry.reloading = true;
+            pendingCount++;
+            reloads.push_back(&entry);
+        }
+    }
+
+    scheduleReloads(reloads);
+    return count;
+}
+
+uint32_t PipelineManager::applyReloads(std::vector<VkPipeline> &retired)
+{
+    uint32_t count = 0;
+    std::vector<Entry *> reloads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto &entry : entries)
+        {
+            if (entry.reloaded)
+            {
+                entry.reloaded = false;
+                if (entry.reloadedPipeline != VK_NULL_HANDLE)
+                {
+                    if (entry.pipeline != VK_NULL_HANDLE)
+                        retired.push_back(entry.pipeline);
+                    entry.pipeline = entry.reloadedPipeline;
+                    entry.layout = entry.reloadedLayout;
+                    entry.reloadedPipeline = VK_NULL_HANDLE;
+                    entry.reloadedLayout = VK_NULL_HANDLE;
+                    count++;
+                }
+                else
+                {
+                    LOGW("Keeping the previous pipeline for %s.\n", entry.desc.vertexShader);
+                }
+            }
+
+            if (entry.reloadRequested && !entry.pending && !entry.reloading)
+            {
+                entry.reloadRequested = false;
+                entry.reloading = true;
+                pendingCount++;
+                reloads.push_back(&entry);
+            }
+        }
+    }
+
+    scheduleReloads(reloads);
+    return count;
+}
+
+VkPipeline PipelineManager::getPipeline(uint32_t handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Fallbacks can have fallbacks themselves, but never form a cycle as they
+    // have to be requested first.
+    while (handle != invalidHandle)
+    {
+        const auto &entry = entries[handle];
+        if (entry.pipeline != VK_NULL_HANDLE)
+            return entry.pipeline;
+        handle = entry.fallback;
+    }
+
+    return VK_NULL_HANDLE;
+}
+
+bool PipelineManager::isReady(uint32_t handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries[handle].pipeline != VK_NULL_HANDLE;
+}
+
+void PipelineManager::wait(uint32_t handle)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    compiled.wait(lock, [this, handle]() { return !entries[handle].pending; });
+}
+
+uint32_t PipelineManager::getPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pendingCount;
+}
+
+VkPipelineLayout PipelineManager::getPipelineLayout(uint32_t handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries[handle].layout;
+}
+
+Result PipelineManager::loadShaderCode(const char *pPath, std::vector<uint32_t> &code)
+{
+    if (EmbeddedShaders::load(pPath, code))
+        return RESULT_SUCCESS;
+
+    if (FAILED(OS::getAssetManager().readBinaryFile(&code, pPath)))
+    {
+        LOGE("Failed to read SPIR-V file: %s.\n", pPath);
+        return RESULT_ERROR_IO;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+VkShaderModule PipelineManager::createShaderModule(VkDevice device, const std::vector<uint32_t> &code)
+{
+    VkShaderModuleCreateInfo moduleInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    moduleInfo.codeSize = code.size() * sizeof(uint32_t);
+    moduleInfo.pCode = code.data();
+
+    VkShaderModule shaderModule;
+    VK_CHECK(vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule));
+    return shaderModule;
+}
+
+VkShaderModule PipelineManager::loadShaderModule(VkDevice device, const char *pPath)
+{
+    std::vector<uint32_t> code;
+    if (FAILED(loadShaderCode(pPath, code)))
+        return VK_NULL_HANDLE;
+
+    return createShaderModule(device, code);
+}
+
+Result PipelineManager::getVertexAttributes(PipelineVertexLayout vertexLayout,
+                                            const ShaderReflection &vertexShader,
+                                            std::vector<VkVertexInputAttributeDescription> &attributes)
+{
+    // Position, normal and colour of a Vertex.
+    static const uint32_t vertexOffsets[] = {offsetof(Vertex, position), offsetof(Vertex, normal), offsetof(Vertex, colour)};
+
+    for (const auto &input : vertexShader.inputs)
+    {
+        // A matrix takes one location per column.
+        for (uint32_t column = 0; column < input.locationCount; column++)
+        {
+            VkVertexInputAttributeDescription attribute = {};
+            attribute.location = input.location + column;
+            attribute.format = input.format;
+
+            if (vertexLayout == PIPELINE_VERTEX_LAYOUT_VERTEX && attribute.location < 3)
+            {
+                attribute.binding = 0;
+                attribute.offset = vertexOffsets[attribute.location];
+            }
+            else if (vertexLayout == PIPELINE_VERTEX_LAYOUT_POSITION && attribute.location == 0)
+            {
+                attribute.binding = 0;
+                attribute.offset = 0;
+            }
+            else if (vertexLayout == PIPELINE_VERTEX_LAYOUT_TERRAIN && attribute.location < 4)
+            {
+                // The shader reads floats, the vertex stores normalized integers.
+                static const VkFormat terrainFormats[] = {VK_FORMAT_R16_UNORM, VK_FORMAT_R8G8_SNORM};
+                static const uint32_t terrainOffsets[] = {offsetof(TerrainVertex, height),
+                                                          offsetof(TerrainVertex, normalX),
+                                                          offsetof(TerrainChunkData, origin),
+                                                          offsetof(TerrainChunkData, scale)};
+                attribute.binding = attribute.location < 2 ? 0 : 1;
+                attribute.offset = terrainOffsets[attribute.location];
+                if (attribute.location < 2)
+                    attribute.format = terrainFormats[attribute.location];
+            }
+            else
+            {
+                LOGE("The vertex layout has no data for the input at location %u.\n", attribute.location);
+                return RESULT_ERROR_GENERIC;
+            }
+
+            attributes.push_back(attribute);
+        }
+    }
+
+    return RESULT_SUCCESS;
+}
+
+VkPipeline PipelineManager::createPipeline(const PipelineDesc &desc, VkPipelineLayout &layout) const
+{
+    auto device = platform->getDevice();
+    auto startTime = OS::getCurrentTime();
+
+    // One boolean specialization constant per feature, constant_id is the bit index.
+    // Shaders may declare only some of them.
+    VkBool32 featureValues[shaderFeatureCount];
+    VkSpecializationMapEntry featureEntries[shaderFeatureCount];
+    for (uint32_t i = 0; i < shaderFeatureCount; i++)
+    {
+        featureValues[i] = (desc.shaderFeatures >> i) & 1;
+        featureEntries[i].constantID = i;
+        featureEntries[i].offset = i * sizeof(VkBool32);
+        featureEntries[i].size = sizeof(VkBool32);
+    }
+
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = shaderFeatureCount;
+    specialization.pMapEntries = featureEntries;
+    specialization.dataSize = sizeof(featureValues);
+    specialization.pData = featureValues;
+
+    // Load our SPIR-V shaders, the layouts and vertex inputs come from their reflection.
+    const char *shaderPaths[2] = {desc.vertexShader, desc.fragmentShader};
+    const VkShaderStageFlagBits expectedStages[2] = {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT};
+    uint32_t stageCount = desc.fragmentShader ? 2 : 1;
+
+    ShaderReflection reflections[2];
+    VkPipelineShaderStageCreateInfo shaderStages[2] = {
+        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO},
+        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO},
+    };
+
+    bool valid = true;
+    for (uint32_t i = 0; i < stageCount; i++)
+    {
+        std::vector<uint32_t> code;
+        if (FAILED(loadShaderCode(shaderPaths[i], code)) || FAILED(reflectShader(code, reflections[i])))
+        {
+            valid = false;
+            continue;
+        }
+
+        if (reflections[i].stage != expectedStages[i])
+        {
+            LOGE("%s is not a %s shader.\n", shaderPaths[i], i == 0 ? "vertex" : "fragment");
+            valid = false;
+            continue;
+        }
+
+        shaderStages[i].stage = expectedStages[i];
+        shaderStages[i].module = createShaderModule(device, code);
+        shaderStages[i].pName = "main";
+        shaderStages[i].pSpecializationInfo = &specialization;
+    }
+
+    layout = VK_NULL_HANDLE;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    if (valid)
+    {
+        layout = layoutCache->getPipelineLayout(reflections, stageCount);
+        valid = layout != VK_NULL_HANDLE && SUCCEEDED(getVertexAttributes(desc.vertexLayout, reflections[0], attributes));
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (valid)
+    {
+        // Specify we will use triangle lists to draw geometry.
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkVertexInputBindingDescription bindings[2] = {};
+        uint32_t bindingCount = 1;
+        bindings[0].binding = 0;
+        // We specify the buffer stride up front here.
+        bindings[0].stride = desc.vertexLayout == PIPELINE_VERTEX_LAYOUT_POSITION ? sizeof(glm::vec3) : sizeof(Vertex);
+        // The vertex buffer will step for every vertex (rather than per instance).
+        bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        if (desc.vertexLayout == PIPELINE_VERTEX_LAYOUT_TERRAIN)
+        {
+            bindings[0].stride = sizeof(TerrainVertex);
+            bindings[1].binding = 1;
+            bindings[1].stride = sizeof(TerrainChunkData);
+            bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+            bindingCount = 2;
+        }
+
+        VkPipelineVertexInputStateCreateInfo vertexInput = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+        vertexInput.vertexBindingDescriptionCount = bindingCount;
+        vertexInput.pVertexBindingDescriptions = bindings;
+        vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+        vertexInput.pVertexAttributeDescriptions = attributes.data();
+
+        // Specify rasterization state.
+        VkPipelineRasterizationStateCreateInfo raster = {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+        raster.polygonMode = VK_POLYGON_MODE_FILL;
+        raster.cullMode = desc.cullMode;
+        raster.frontFace = desc.frontFace;
+        raster.depthClampEnable = false;
+        raster.rasterizerDiscardEnable = false;
+        raster.depthBiasEnable = false;
+        raster.lineWidth = 1.0f;
+
+        // Every attachment writes all color channels, blended over the destination when enabled.
+        VkPipelineColorBlendAttachmentState blendAttachment = {0};
+        blendAttachment.blendEnable = desc.blendEnable;
+        blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.colorWriteMask = 0xf;
+        std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(desc.colorAttachmentCount, blendAttachment);
+
+        VkPipelineColorBlendStateCreateInfo blend = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+        blend.attachmentCount = desc.colorAttachmentCount;
+        blend.pAttachments = blendAttachments.data();
+
+        // We will have one viewport and scissor box.
+        VkPipelineViewportStateCreateInfo viewport = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        VkPipelineDepthStencilStateCreateInfo depthStencil = {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+        depthStencil.depthTestEnable = desc.depthTestEnable;
+        depthStencil.depthWriteEnable = desc.depthWriteEnable;
+        depthStencil.depthCompareOp = desc.depthCompareOp;
+        depthStencil.depthBoundsTestEnable = false;
+        depthStencil.stencilTestEnable = false;
+
+        // No multisampling.
+        VkPipelineMultisampleStateCreateInfo multisample = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        // Specify that these states will be dynamic, i.e. not part of pipeline state
+        // object.
+        static const VkDynamicState dynamics[] = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR,
+        };
+        VkPipelineDynamicStateCreateInfo dynamic = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+        dynamic.pDynamicStates = dynamics;
+        dynamic.dynamicStateCount = sizeof(dynamics) / sizeof(dynamics[0]);
+
+        VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+        graphicsPipelineCreateInfo.stageCount = stageCount;
+        graphicsPipelineCreateInfo.pStages = shaderStages;
+        graphicsPipelineCreateInfo.pVertexInputState = &vertexInput;
+        graphicsPipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+        graphicsPipelineCreateInfo.pRasterizationState = &raster;
+        graphicsPipelineCreateInfo.pColorBlendState = &blend;
+        graphicsPipelineCreateInfo.pMultisampleState = &multisample;
+        graphicsPipelineCreateInfo.pViewportState = &viewport;
+        graphicsPipelineCreateInfo.pDepthStencilState = &depthStencil;
+        graphicsPipelineCreateInfo.pDynamicState = &dynamic;
+        graphicsPipelineCreateInfo.renderPass = desc.renderPass;
+        graphicsPipelineCreateInfo.subpass = desc.subpass;
+        graphicsPipelineCreateInfo.layout = layout;
+
+        // The pipeline cache is internally synchronized, workers can compile at the same time.
+        VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline));
+
+        LOGI("Created pipeline %s + %s, variant 0x%x in %.2f ms\n",
+             desc.vertexShader,
+             desc.fragmentShader ? desc.fragmentShader : "no fragment shader",
+             desc.shaderFeatures,
+             (OS::getCurrentTime() - startTime) * 1000.0);
+    }
+    else
+    {
+        LOGE("Shaders for pipeline %s are missing or do not match, its draws are skipped.\n", desc.vertexShader);
+    }
+
+    // Pipeline is baked, we can delete the shader modules now.
+    for (uint32_t i = 0; i < stageCount; i++)
+    {
+        if (shaderStages[i].module != VK_NULL_HANDLE)
+            vkDestroyShaderModule(device, shaderStages[i].module, nullptr);
+    }
+
+    return pipeline;
+}
+
+} // namespace Tobi
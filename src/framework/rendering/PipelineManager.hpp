@@ -0,0 +1,188 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "framework/ShaderFeatures.hpp"
+#include "../VkCommon.hpp"
+#include "PipelineLayoutCache.hpp"
+
+namespace Tobi
+{
+class Platform;
+class JobSystem;
+
+/// @brief The vertex buffers a pipeline reads. Model matrices are not vertex
+/// inputs, shaders read them from the transform buffer with gl_InstanceIndex.
+/// Which inputs are read comes from the vertex shader, their formats too
+/// unless the layout stores them compressed.
+enum PipelineVertexLayout
+{
+    /// A @ref Vertex per vertex in binding 0.
+    PIPELINE_VERTEX_LAYOUT_VERTEX = 0,
+    /// Only the position per vertex in binding 0.
+    PIPELINE_VERTEX_LAYOUT_POSITION,
+    /// A @ref TerrainVertex per vertex in binding 0, height and normal at
+    /// locations 0 and 1, and a @ref TerrainChunkData per instance in binding 1
+    /// at locations 2 and 3.
+    PIPELINE_VERTEX_LAYOUT_TERRAIN,
+    PIPELINE_VERTEX_LAYOUT_COUNT
+};
+
+/// @brief Everything a graphics pipeline is created from. Viewport and scissor
+/// are dynamic and the pipelines draw triangle lists without multisampling.
+struct PipelineDesc
+{
+    /// Asset paths of the SPIR-V.
+    const char *vertexShader;
+    /// Null for pipelines which only write depth.
+    const char *fragmentShader;
+    /// Variant key, a combination of @ref ShaderFeature set as specialization
+    /// constants of both stages.
+    uint32_t shaderFeatures;
+
+    PipelineVertexLayout vertexLayout;
+
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+
+    /// Color attachments of the subpass, all written without blending unless blendEnable is set.
+    uint32_t colorAttachmentCount;
+    bool blendEnable;
+
+    bool depthTestEnable;
+    bool depthWriteEnable;
+    VkCompareOp depthCompareOp;
+
+    /// Render passes are cached by their description, so the handle identifies
+    /// the attachment formats and subpasses.
+    VkRenderPass renderPass;
+    uint32_t subpass;
+};
+
+/// @brief Creates graphics pipelines from descriptions and keeps them by a hash
+/// of the description.
+///
+/// The pipeline layout and the vertex input formats are taken from the
+/// reflected shaders. Layouts are shared by all pipelines declaring the same
+/// push constants and descriptors.
+///
+/// Requesting a pipeline which is not cached yet schedules its compilation on
+/// the job system and returns right away, so a new combination of shaders and
+/// state never stalls a frame. Until it is compiled @ref getPipeline returns
+/// the fallback given with the request, or nothing and the draws are skipped.
+class PipelineManager
+{
+  public:
+    static const uint32_t invalidHandle = ~0u;
+
+    PipelineManager(std::shared_ptr<Platform> platform, std::shared_ptr<JobSystem> jobSystem, VkPipelineCache pipelineCache);
+    PipelineManager(const PipelineManager &) = delete;
+    PipelineManager(PipelineManager &&) = delete;
+    PipelineManager &operator=(const PipelineManager &) & = delete;
+    PipelineManager &operator=(PipelineManager &&) & = delete;
+
+    /// @brief Destructor. Waits for the compilations in flight and destroys all pipelines.
+    ~PipelineManager();
+
+    /// @brief Returns the handle of the pipeline for a description, and
+    /// schedules its compilation if it has not been requested before.
+    /// @param fallback Used while the pipeline is compiled, should be compatible with the same render pass.
+    /// @returns A handle which stays valid for the lifetime of the manager.
+    uint32_t requestPipeline(const PipelineDesc &desc, uint32_t fallback = invalidHandle);
+
+    /// @brief The pipeline, if compiled, otherwise the compiled fallback.
+    /// @returns VK_NULL_HANDLE when neither is available, draws using it are skipped then.
+    VkPipeline getPipeline(uint32_t handle) const;
+
+    bool isReady(uint32_t handle) const;
+
+    /// @brief The layout reflected from the shaders, VK_NULL_HANDLE until the pipeline is compiled.
+    VkPipelineLayout getPipelineLayout(uint32_t handle) const;
+
+    /// @brief Layouts for other pipelines and for allocating descriptor sets.
+    PipelineLayoutCache &getLayoutCache() { return *layoutCache; }
+
+    /// @brief Blocks until the pipeline is compiled or failed to compile.
+    void wait(uint32_t handle);
+
+    /// @brief Number of pipelines waiting for or being compiled.
+    uint32_t getPendingCount() const;
+
+    /// @brief Recompiles every pipeline using a shader after its SPIR-V changed
+    /// on disk. The pipelines keep drawing with the previous version until
+    /// @ref applyReloads.
+    /// @param pPath Asset path of the SPIR-V, as in the descriptions.
+    /// @returns The number of pipelines using the shader.
+    uint32_t reloadShader(const char *pPath);
+
+    /// @brief Swaps in the recompiled pipelines. A pipeline which failed to
+    /// compile keeps the previous one. Call between frames.
+    /// @param[out] retired The replaced pipelines, to be destroyed once no frame in flight uses them.
+    /// @returns The number of pipelines swapped.
+    uint32_t applyReloads(std::vector<VkPipeline> &retired);
+
+    /// @brief Reads a SPIR-V asset, from the library when the build embedded it.
+    static Result loadShaderCode(const char *pPath, std::vector<uint32_t> &code);
+
+    static VkShaderModule createShaderModule(VkDevice device, const std::vector<uint32_t> &code);
+
+    /// @brief Loads a SPIR-V asset.
+    /// @returns VK_NULL_HANDLE if the file could not be read.
+    static VkShaderModule loadShaderModule(VkDevice device, const char *pPath);
+
+  private:
+    struct Entry
+    {
+        uint64_t hash;
+        PipelineDesc desc;
+        // The desc points into these.
+        std::string vertexShader;
+        std::string fragmentShader;
+        uint32_t fallback;
+        VkPipeline pipeline;
+        VkPipelineLayout layout;
+        bool pending;
+        // Compiled after the shaders changed, swapped in by applyReloads.
+        VkPipeline reloadedPipeline;
+        VkPipelineLayout reloadedLayout;
+        bool reloading;
+        bool reloaded;
+        // The shaders changed again while reloading.
+        bool reloadRequested;
+    };
+
+    std::shared_ptr<Platform> platform;
+    std::shared_ptr<JobSystem> jobSystem;
+    VkPipelineCache pipelineCache;
+    std::unique_ptr<PipelineLayoutCache> layoutCache;
+
+    // Entries never move, so a compile job can fill in its entry while others are added.
+    std::deque<Entry> entries;
+    std::multimap<uint64_t, uint32_t> handlesByHash;
+    uint32_t pendingCount;
+    mutable std::mutex mutex;
+    std::condition_variable compiled;
+
+    static uint64_t hashDesc(const PipelineDesc &desc);
+    static bool isSameDesc(const PipelineDesc &a, const PipelineDesc &b);
+
+    /// @brief Schedules the recompiles of entries marked as reloading.
+    void scheduleReloads(const std::vector<Entry *> &reloads);
+
+    /// @brief Builds the vertex attributes of the inputs of a vertex shader.
+    static Result getVertexAttributes(PipelineVertexLayout vertexLayout,
+                                      const ShaderReflection &vertexShader,
+                                      std::vector<VkVertexInputAttributeDescription> &attributes);
+
+    /// @brief Compiles the pipeline of an entry, runs on a worker thread.
+    VkPipeline createPipeline(const PipelineDesc &desc, VkPipelineLayout &layout) const;
+};
+
+} // namespace Tobi
@@ -0,0 +1,1377 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "../../platform/Platform.hpp"
+
+namespace Tobi
+{
+
+/// @brief What a usage means for synchronization.
+struct RenderGraphUsageInfo
+{
+    const char *name;
+    VkImageLayout layout;
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkImageUsageFlags imageUsage;
+    bool attachment;
+};
+
+static const RenderGraphUsageInfo usageInfos[RENDER_GRAPH_USAGE_COUNT] = {
+    {"color attachment",
+     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+     true},
+    {"depth attachment",
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+     true},
+    {"depth read",
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+     true},
+    {"input attachment",
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+     VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+     VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+     true},
+    {"sampled fragment",
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+     VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_USAGE_SAMPLED_BIT,
+     false},
+    {"sampled compute",
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+     VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_USAGE_SAMPLED_BIT,
+     false},
+    {"storage compute",
+     VK_IMAGE_LAYOUT_GENERAL,
+     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+     VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+     VK_IMAGE_USAGE_STORAGE_BIT,
+     false}};
+
+static const VkAccessFlags writeAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                             VK_ACCESS_SHADER_WRITE_BIT |
+                                             VK_ACCESS_TRANSFER_WRITE_BIT;
+
+static bool isWrite(RenderGraphUsage usage)
+{
+    return (usageInfos[usage].access & writeAccessMask) != 0;
+}
+
+static bool isComputeUsage(RenderGraphUsage usage)
+{
+    return usage == RENDER_GRAPH_USAGE_SAMPLED_COMPUTE || usage == RENDER_GRAPH_USAGE_STORAGE_COMPUTE;
+}
+
+static bool isDepthUsage(RenderGraphUsage usage)
+{
+    return usage == RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT || usage == RENDER_GRAPH_USAGE_DEPTH_READ;
+}
+
+static bool isDepthFormat(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool hasStencil(VkFormat format)
+{
+    return format == VK_FORMAT_D16_UNORM_S8_UINT ||
+           format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+static const char *getLayoutName(VkImageLayout layout)
+{
+    switch (layout)
+    {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+        return "undefined";
+    case VK_IMAGE_LAYOUT_GENERAL:
+        return "general";
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+        return "color attachment";
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+        return "depth attachment";
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+        return "depth read only";
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        return "shader read only";
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+        return "present";
+    default:
+        return "other";
+    }
+}
+
+static const char *getLoadOpName(VkAttachmentLoadOp loadOp)
+{
+    switch (loadOp)
+    {
+    case VK_ATTACHMENT_LOAD_OP_LOAD:
+        return "load";
+    case VK_ATTACHMENT_LOAD_OP_CLEAR:
+        return "clear";
+    default:
+        return "dont care";
+    }
+}
+
+static std::string toHex(uint32_t value)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "0x%x", value);
+    return buffer;
+}
+
+RenderGraph::RenderGraph(std::shared_ptr<Platform> platform)
+    : platform(platform),
+      width(0),
+      height(0),
+      subpassMergingEnabled(true),
+      images(std::vector<Image>()),
+      passes(std::vector<Pass>()),
+      compiled(false),
+      passOrder(std::vector<uint32_t>()),
+      groups(std::vector<Group>()),
+      memorySlots(std::vector<MemorySlot>()),
+      finalBarriers(std::vector<Barrier>()),
+      initialBarriers(std::vector<Barrier>()),
+      initialBarriersRecorded(false),
+      renderPassCache(std::map<std::vector<uint32_t>, VkRenderPass>())
+{
+    LOGI("CONSTRUCTING RenderGraph\n");
+}
+
+RenderGraph::~RenderGraph()
+{
+    LOGI("DECONSTRUCTING RenderGraph\n");
+    destroyCompiled();
+
+    for (auto &renderPass : renderPassCache)
+        vkDestroyRenderPass(platform->getDevice(), renderPass.second, nullptr);
+}
+
+void RenderGraph::destroyCompiled()
+{
+    auto device = platform->getDevice();
+
+    for (auto &group : groups)
+    {
+        // The render passes stay in the cache.
+        for (auto &framebuffer : group.framebuffers)
+            vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+    }
+    groups.clear();
+
+    for (auto &image : images)
+    {
+        if (image.imported)
+            continue;
+
+        if (image.view != VK_NULL_HANDLE)
+            vkDestroyImageView(device, image.view, nullptr);
+        if (image.image != VK_NULL_HANDLE)
+            vkDestroyImage(device, image.image, nullptr);
+        image.view = VK_NULL_HANDLE;
+        image.image = VK_NULL_HANDLE;
+    }
+
+    for (auto &slot : memorySlots)
+        vkFreeMemory(device, slot.memory, nullptr);
+    memorySlots.clear();
+
+    passOrder.clear();
+    finalBarriers.clear();
+    initialBarriers.clear();
+    compiled = false;
+}
+
+void RenderGraph::reset(uint32_t width, uint32_t height)
+{
+    destroyCompiled();
+    images.clear();
+    passes.clear();
+
+    this->width = width;
+    this->height = height;
+}
+
+uint32_t RenderGraph::createImage(const char *name, const RenderGraphImageDesc &desc)
+{
+    Image image = {};
+    image.name = name;
+    image.desc = desc;
+    image.desc.mipLevels = std::max(desc.mipLevels, 1u);
+    image.imported = false;
+    image.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image.image = VK_NULL_HANDLE;
+    image.view = VK_NULL_HANDLE;
+    images.push_back(image);
+
+    return static_cast<uint32_t>(images.size() - 1);
+}
+
+uint32_t RenderGraph::importImage(const char *name,
+                                  VkFormat format,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  VkImageLayout initialLayout,
+                                  VkPipelineStageFlags initialStage,
+                                  VkImageLayout finalLayout)
+{
+    Image image = {};
+    image.name = name;
+    image.desc = {format, width, height, 1, 0};
+    image.imported = true;
+    image.initialLayout = initialLayout;
+    image.initialStage = initialStage;
+    image.finalLayout = finalLayout;
+    image.image = VK_NULL_HANDLE;
+    image.view = VK_NULL_HANDLE;
+    images.push_back(image);
+
+    return static_cast<uint32_t>(images.size() - 1);
+}
+
+void RenderGraph::setImportedImage(uint32_t image, VkImage handle, VkImageView view)
+{
+    images[image].image = handle;
+    images[image].view = view;
+}
+
+void RenderGraph::setClearValue(uint32_t image, const VkClearValue &clearValue)
+{
+    images[image].hasClearValue = true;
+    images[image].clearValue = clearValue;
+}
+
+void RenderGraph::markOutput(uint32_t image)
+{
+    images[image].output = true;
+}
+
+uint32_t RenderGraph::addPass(const char *name, bool compute, RenderGraphRecordFunction record)
+{
+    Pass pass = {};
+    pass.name = name;
+    pass.compute = compute;
+    pass.record = record;
+    pass.culled = false;
+    pass.group = invalidHandle;
+    pass.subpass = 0;
+    passes.push_back(pass);
+
+    return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void RenderGraph::setPrepareFunction(uint32_t pass, RenderGraphPrepareFunction prepare)
+{
+    passes[pass].prepare = prepare;
+}
+
+void RenderGraph::use(uint32_t pass, uint32_t image, RenderGraphUsage usage)
+{
+    passes[pass].uses.push_back({image, usage});
+}
+
+VkRenderPass RenderGraph::getRenderPass(uint32_t pass) const
+{
+    const auto &graphPass = passes[pass];
+    if (graphPass.culled || graphPass.group == invalidHandle)
+        return VK_NULL_HANDLE;
+
+    return groups[graphPass.group].renderPass;
+}
+
+Result RenderGraph::compile()
+{
+    destroyCompiled();
+
+    for (auto &image : images)
+    {
+        image.usage = image.desc.usage;
+        image.aspect = isDepthFormat(image.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        if (hasStencil(image.desc.format))
+            image.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        if (!image.imported && image.desc.width == 0)
+        {
+            image.desc.width = width;
+            image.desc.height = height;
+        }
+        image.firstUse = invalidHandle;
+        image.lastUse = 0;
+        image.aliasable = false;
+        image.transient = false;
+        image.lastStages = 0;
+        image.lastWrites = 0;
+        image.memorySlot = invalidHandle;
+    }
+
+    for (const auto &pass : passes)
+    {
+        uint32_t depthAttachmentCount = 0;
+        for (size_t i = 0; i < pass.uses.size(); i++)
+        {
+            const auto &use = pass.uses[i];
+            const auto &image = images[use.image];
+            if (pass.compute != isComputeUsage(use.usage))
+            {
+                LOGE("Pass %s uses %s as %s.\n", pass.name.c_str(), image.name.c_str(), usageInfos[use.usage].name);
+                return RESULT_ERROR_GENERIC;
+            }
+            auto depth = isDepthFormat(image.desc.format);
+            if ((isDepthUsage(use.usage) && !depth) ||
+                (depth && (use.usage == RENDER_GRAPH_USAGE_COLOR_ATTACHMENT ||
+                           use.usage == RENDER_GRAPH_USAGE_STORAGE_COMPUTE)))
+            {
+                LOGE("Pass %s uses %s as %s, which does not match its format.\n",
+                     pass.name.c_str(), image.name.c_str(), usageInfos[use.usage].name);
+                return RESULT_ERROR_GENERIC;
+            }
+            depthAttachmentCount += isDepthUsage(use.usage) ? 1 : 0;
+
+            // An image can only be in one layout during a subpass. Compute passes
+            // use the general layout for images they both sample and store to.
+            for (size_t j = 0; j < i && !pass.compute; j++)
+            {
+                if (pass.uses[j].image == use.image)
+                {
+                    LOGE("Pass %s uses %s more than once.\n", pass.name.c_str(), image.name.c_str());
+                    return RESULT_ERROR_GENERIC;
+                }
+            }
+        }
+
+        if (depthAttachmentCount > 1)
+        {
+            LOGE("Pass %s has more than one depth attachment.\n", pass.name.c_str());
+            return RESULT_ERROR_GENERIC;
+        }
+    }
+
+    cullPasses();
+    computeLifetimes();
+    buildGroups();
+    createImages();
+    allocateMemory();
+    createImageViews();
+
+    // The first run finds the states the images end the frame in. Persistent
+    // images start the next frame in them.
+    std::vector<ImageState> states(images.size());
+    for (uint32_t i = 0; i < images.size(); i++)
+    {
+        const auto &image = images[i];
+        auto &state = states[i];
+        state = {};
+        state.layout = image.imported ? image.initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+        state.undefined = !image.imported || image.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED;
+        if (image.imported)
+        {
+            state.writeStages = image.initialStage;
+        }
+        else if (image.memorySlot != invalidHandle)
+        {
+            // The previous frame, or an earlier image in the same memory, may
+            // still use the memory.
+            for (auto other : memorySlots[image.memorySlot].images)
+            {
+                state.writeStages |= images[other].lastStages;
+                state.writeAccess |= images[other].lastWrites;
+            }
+        }
+    }
+
+    auto endStates = states;
+    deriveBarriers(endStates);
+
+    initialBarriers.clear();
+    for (uint32_t i = 0; i < images.size(); i++)
+    {
+        const auto &image = images[i];
+        if (image.imported || image.aliasable || image.firstUse == invalidHandle)
+            continue;
+
+        auto &state = states[i];
+        state = endStates[i];
+        state.undefined = false;
+        state.writtenThisFrame = false;
+
+        Barrier barrier = {};
+        barrier.image = i;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = state.layout;
+        barrier.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        barrier.dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        initialBarriers.push_back(barrier);
+    }
+    initialBarriersRecorded = false;
+
+    deriveBarriers(states);
+
+    for (auto &group : groups)
+    {
+        if (!group.compute)
+            createRenderPass(group);
+    }
+
+    compiled = true;
+    return RESULT_SUCCESS;
+}
+
+void RenderGraph::cullPasses()
+{
+    // Walk backwards from the outputs. A pass is needed when it writes an image
+    // used later, then every image it uses is needed as well, since writes may
+    // only update parts of an image.
+    std::vector<bool> needed(images.size(), false);
+    for (uint32_t i = 0; i < images.size(); i++)
+        needed[i] = images[i].output;
+
+    for (auto i = passes.size(); i-- > 0;)
+    {
+        auto &pass = passes[i];
+
+        bool writes = false;
+        bool keep = false;
+        for (const auto &use : pass.uses)
+        {
+            if (isWrite(use.usage))
+            {
+                writes = true;
+                keep = keep || needed[use.image];
+            }
+        }
+
+        // A pass without image writes is kept for its other effects.
+        pass.culled = writes && !keep;
+        if (pass.culled)
+            continue;
+
+        for (const auto &use : pass.uses)
+            needed[use.image] = true;
+    }
+
+    passOrder.clear();
+    for (uint32_t i = 0; i < passes.size(); i++)
+    {
+        if (!passes[i].culled)
+            passOrder.push_back(i);
+        else
+            passes[i].group = invalidHandle;
+    }
+}
+
+void RenderGraph::computeLifetimes()
+{
+    std::vector<bool> firstUseIsWrite(images.size(), false);
+
+    for (uint32_t position = 0; position < passOrder.size(); position++)
+    {
+        for (const auto &use : passes[passOrder[position]].uses)
+        {
+            auto &image = images[use.image];
+            image.usage |= usageInfos[use.usage].imageUsage;
+
+            if (image.firstUse == invalidHandle)
+            {
+                image.firstUse = position;
+                firstUseIsWrite[use.image] = isWrite(use.usage);
+            }
+
+            if (image.lastUse != position)
+            {
+                image.lastStages = 0;
+                image.lastWrites = 0;
+            }
+            image.lastUse = position;
+            image.lastStages |= usageInfos[use.usage].stage;
+            image.lastWrites |= usageInfos[use.usage].access & writeAccessMask;
+        }
+    }
+
+    for (uint32_t i = 0; i < images.size(); i++)
+    {
+        auto &image = images[i];
+        image.aliasable = !image.imported && !image.output && firstUseIsWrite[i];
+    }
+}
+
+bool RenderGraph::canMerge(const Group &group, const Pass &pass) const
+{
+    if (group.compute || pass.compute)
+        return false;
+
+    // An image can not be sampled in one subpass and an attachment in another.
+    for (const auto &use : pass.uses)
+    {
+        const auto &image = images[use.image];
+        if (image.desc.width != group.extent.width || image.desc.height != group.extent.height)
+        {
+            if (usageInfos[use.usage].attachment)
+                return false;
+        }
+
+        for (auto passIndex : group.passes)
+        {
+            for (const auto &groupUse : passes[passIndex].uses)
+            {
+                if (groupUse.image == use.image &&
+                    usageInfos[groupUse.usage].attachment != usageInfos[use.usage].attachment)
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void RenderGraph::buildGroups()
+{
+    groups.clear();
+
+    for (auto passIndex : passOrder)
+    {
+        auto &pass = passes[passIndex];
+
+        // Attachments decide the render area, the default size is used without them.
+        VkExtent2D extent = {width, height};
+        for (const auto &use : pass.uses)
+        {
+            if (usageInfos[use.usage].attachment)
+            {
+                extent = {images[use.image].desc.width, images[use.image].desc.height};
+                break;
+            }
+        }
+
+        if (subpassMergingEnabled && !groups.empty() &&
+            groups.back().extent.width == extent.width && groups.back().extent.height == extent.height &&
+            canMerge(groups.back(), pass))
+        {
+            pass.group = static_cast<uint32_t>(groups.size() - 1);
+            pass.subpass = static_cast<uint32_t>(groups.back().passes.size());
+            groups.back().passes.push_back(passIndex);
+            continue;
+        }
+
+        Group group = {};
+        group.compute = pass.compute;
+        group.passes.push_back(passIndex);
+        group.extent = extent;
+        group.renderPass = VK_NULL_HANDLE;
+        groups.push_back(group);
+
+        pass.group = static_cast<uint32_t>(groups.size() - 1);
+        pass.subpass = 0;
+    }
+
+    // Images only used as attachments of a single render pass never need memory
+    // outside of it.
+    for (uint32_t i = 0; i < images.size(); i++)
+    {
+        auto &image = images[i];
+        // Transient images can only be used as attachments.
+        if (!image.aliasable || image.firstUse == invalidHandle || image.desc.usage != 0)
+            continue;
+
+        auto group = passes[passOrder[image.firstUse]].group;
+        bool transient = !groups[group].compute && passes[passOrder[image.lastUse]].group == group;
+        for (auto position = image.firstUse; transient && position <= image.lastUse; position++)
+        {
+            for (const auto &use : passes[passOrder[position]].uses)
+            {
+                if (use.image == i && !usageInfos[use.usage].attachment)
+                    transient = false;
+            }
+        }
+
+        image.transient = transient;
+        if (transient)
+            image.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+}
+
+void RenderGraph::createImages()
+{
+    auto device = platform->getDevice();
+
+    for (auto &image : images)
+    {
+        if (image.imported || image.firstUse == invalidHandle)
+            continue;
+
+        VkImageCreateInfo imageInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = image.desc.format;
+        imageInfo.extent.width = image.desc.width;
+        imageInfo.extent.height = image.desc.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = image.desc.mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = image.usage;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &image.image));
+    }
+}
+
+void RenderGraph::allocateMemory()
+{
+    auto device = platform->getDevice();
+    const auto &memoryProperties = platform->getMemoryProperties();
+
+    std::vector<uint32_t> order;
+    std::vector<VkMemoryRequirements> requirements(images.size());
+    for (uint32_t i = 0; i < images.size(); i++)
+    {
+        if (images[i].image == VK_NULL_HANDLE || images[i].imported)
+            continue;
+
+        vkGetImageMemoryRequirements(device, images[i].image, &requirements[i]);
+        order.push_back(i);
+    }
+
+    auto getGroup = [&](uint32_t position) { return passes[passOrder[position]].group; };
+
+    // Placing the largest images first lets the smaller ones fit into their memory.
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return requirements[a].size > requirements[b].size;
+    });
+
+    for (auto imageIndex : order)
+    {
+        auto &image = images[imageIndex];
+        const auto &requirement = requirements[imageIndex];
+
+        uint32_t lazyTypeIndex = invalidHandle;
+        if (image.transient)
+        {
+            for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+            {
+                if ((requirement.memoryTypeBits & (1u << i)) &&
+                    (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+                {
+                    lazyTypeIndex = i;
+                    break;
+                }
+            }
+        }
+
+        // Lazily allocated memory takes no space, there is nothing to share.
+        auto slotIndex = invalidHandle;
+        for (uint32_t i = 0; i < memorySlots.size() && image.aliasable && lazyTypeIndex == invalidHandle; i++)
+        {
+            const auto &slot = memorySlots[i];
+            if (slot.lazilyAllocated || !images[slot.images[0]].aliasable ||
+                !(requirement.memoryTypeBits & (1u << slot.memoryTypeIndex)) || requirement.size > slot.size)
+                continue;
+
+            // Lifetimes are compared in groups, barriers can not be placed inside a render pass.
+            bool overlaps = false;
+            for (auto other : slot.images)
+            {
+                overlaps = overlaps || !(getGroup(images[other].lastUse) < getGroup(image.firstUse) ||
+                                         getGroup(image.lastUse) < getGroup(images[other].firstUse));
+            }
+
+            if (!overlaps)
+            {
+                slotIndex = i;
+                break;
+            }
+        }
+
+        if (slotIndex == invalidHandle)
+        {
+            MemorySlot slot = {};
+            slot.size = requirement.size;
+            slot.lazilyAllocated = lazyTypeIndex != invalidHandle;
+            slot.memoryTypeIndex = slot.lazilyAllocated
+                                       ? lazyTypeIndex
+                                       : platform->findMemoryTypeFromRequirementsWithFallback(requirement.memoryTypeBits,
+                                                                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+            allocateInfo.allocationSize = slot.size;
+            allocateInfo.memoryTypeIndex = slot.memoryTypeIndex;
+            VK_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &slot.memory));
+
+            memorySlots.push_back(slot);
+            slotIndex = static_cast<uint32_t>(memorySlots.size() - 1);
+        }
+
+        memorySlots[slotIndex].images.push_back(imageIndex);
+        image.memorySlot = slotIndex;
+        VK_CHECK(vkBindImageMemory(device, image.image, memorySlots[slotIndex].memory, 0));
+    }
+}
+
+void RenderGraph::createImageViews()
+{
+    auto device = platform->getDevice();
+
+    for (auto &image : images)
+    {
+        if (image.imported || image.image == VK_NULL_HANDLE)
+            continue;
+
+        VkImageViewCreateInfo viewInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = image.desc.format;
+        viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
+        viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
+        viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
+        viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
+        // Depth is what passes sample, stencil would need a view of its own.
+        viewInfo.subresourceRange.aspectMask = image.aspect & ~VK_IMAGE_ASPECT_STENCIL_BIT;
+        viewInfo.subresourceRange.levelCount = image.desc.mipLevels;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &image.view));
+    }
+}
+
+void RenderGraph::addBarrier(std::vector<Barrier> &barriers,
+                             uint32_t image,
+                             ImageState &state,
+                             VkImageLayout layout,
+                             VkPipelineStageFlags stage,
+                             VkAccessFlags access,
+                             bool discard)
+{
+    auto write = (access & writeAccessMask) != 0;
+    auto oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+    auto layoutChange = oldLayout != layout;
+
+    // Reads of the same layout only wait when they can not see the last write yet.
+    auto needed = layoutChange || write || (state.writeAccess != 0 && (stage & ~state.visibleStages) != 0);
+    if (needed)
+    {
+        Barrier barrier = {};
+        barrier.image = image;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = layout;
+        // Layout transitions and writes have to wait for the reads as well.
+        barrier.srcStage = state.writeStages | ((layoutChange || write) ? state.readStages : 0);
+        barrier.srcAccess = state.writeAccess;
+        barrier.dstStage = stage;
+        barrier.dstAccess = access;
+        if (barrier.srcStage == 0)
+            barrier.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        barriers.push_back(barrier);
+    }
+
+    state.layout = layout;
+    state.undefined = false;
+    if (write)
+    {
+        state.writtenThisFrame = true;
+        state.writeStages = stage;
+        state.writeAccess = access & writeAccessMask;
+        state.readStages = 0;
+        state.visibleStages = 0;
+    }
+    else
+    {
+        state.readStages |= stage;
+        if (needed)
+            state.visibleStages |= stage;
+    }
+}
+
+void RenderGraph::deriveBarriers(std::vector<ImageState> &states)
+{
+    // Position in the pass order of the first pass of the group.
+    uint32_t position = 0;
+
+    for (auto &group : groups)
+    {
+        group.barriers.clear();
+        group.attachments.clear();
+        group.attachmentDescriptions.clear();
+        group.clearValues.clear();
+        group.dependencies.clear();
+
+        auto groupEnd = position + static_cast<uint32_t>(group.passes.size()) - 1;
+
+        if (group.compute)
+        {
+            const auto &pass = passes[group.passes[0]];
+
+            // Images both sampled and stored to in a compute pass stay in the general layout.
+            std::vector<uint32_t> handled;
+            for (const auto &use : pass.uses)
+            {
+                if (std::find(handled.begin(), handled.end(), use.image) != handled.end())
+                    continue;
+                handled.push_back(use.image);
+
+                auto layout = usageInfos[use.usage].layout;
+                VkAccessFlags access = 0;
+                for (const auto &other : pass.uses)
+                {
+                    if (other.image != use.image)
+                        continue;
+                    access |= usageInfos[other.usage].access;
+                    if (other.usage == RENDER_GRAPH_USAGE_STORAGE_COMPUTE)
+                        layout = VK_IMAGE_LAYOUT_GENERAL;
+                }
+
+                auto &state = states[use.image];
+                auto discard = state.undefined && (access & writeAccessMask);
+                addBarrier(group.barriers, use.image, state, layout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, access, discard);
+            }
+
+            position = groupEnd + 1;
+            continue;
+        }
+
+        // Subpass and usage of the latest use of every image inside the render pass.
+        std::map<uint32_t, std::pair<uint32_t, RenderGraphUsage>> latestUses;
+
+        for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++)
+        {
+            const auto &pass = passes[group.passes[subpass]];
+            for (const auto &use : pass.uses)
+            {
+                const auto &info = usageInfos[use.usage];
+                const auto &image = images[use.image];
+                auto &state = states[use.image];
+
+                auto latest = latestUses.find(use.image);
+                if (latest == latestUses.end())
+                {
+                    // First use in the render pass, synchronized by a barrier before it.
+                    auto loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+                    if (isWrite(use.usage) && !state.writtenThisFrame && image.hasClearValue)
+                        loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                    else if (state.undefined)
+                        loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+                    auto discard = info.attachment && loadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+                    addBarrier(group.barriers, use.image, state, info.layout, info.stage, info.access, discard);
+
+                    if (info.attachment)
+                    {
+                        group.attachments.push_back(use.image);
+
+                        VkAttachmentDescription description = {};
+                        description.format = image.desc.format;
+                        description.samples = VK_SAMPLE_COUNT_1_BIT;
+                        description.loadOp = loadOp;
+                        description.stencilLoadOp = hasStencil(image.desc.format) ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                        description.initialLayout = info.layout;
+                        group.attachmentDescriptions.push_back(description);
+
+                        VkClearValue clearValue = {};
+                        if (image.hasClearValue)
+                            clearValue = image.clearValue;
+                        group.clearValues.push_back(clearValue);
+                    }
+                }
+                else
+                {
+                    // Later uses are synchronized by subpass dependencies, the render
+                    // pass does the layout transitions.
+                    auto previousSubpass = latest->second.first;
+                    const auto &previousInfo = usageInfos[latest->second.second];
+                    if (isWrite(latest->second.second) || isWrite(use.usage) || previousInfo.layout != info.layout)
+                    {
+                        auto dependency = std::find_if(group.dependencies.begin(), group.dependencies.end(),
+                                                       [&](const VkSubpassDependency &d) {
+                                                           return d.srcSubpass == previousSubpass && d.dstSubpass == subpass;
+                                                       });
+                        if (dependency == group.dependencies.end())
+                        {
+                            VkSubpassDependency newDependency = {};
+                            newDependency.srcSubpass = previousSubpass;
+                            newDependency.dstSubpass = subpass;
+                            newDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+                            group.dependencies.push_back(newDependency);
+                            dependency = group.dependencies.end() - 1;
+                        }
+                        dependency->srcStageMask |= previousInfo.stage;
+                        dependency->srcAccessMask |= previousInfo.access & writeAccessMask;
+                        dependency->dstStageMask |= info.stage;
+                        dependency->dstAccessMask |= info.access;
+                    }
+
+                    state.layout = info.layout;
+                    if (isWrite(use.usage))
+                    {
+                        state.writtenThisFrame = true;
+                        state.writeStages = info.stage;
+                        state.writeAccess = info.access & writeAccessMask;
+                        state.readStages = 0;
+                        state.visibleStages = 0;
+                    }
+                    else
+                    {
+                        state.readStages |= info.stage;
+                        state.visibleStages |= info.stage;
+                    }
+                }
+
+                latestUses[use.image] = std::make_pair(subpass, use.usage);
+            }
+        }
+
+        // Attachments are stored when anything after the render pass needs them.
+        for (uint32_t i = 0; i < group.attachments.size(); i++)
+        {
+            auto imageIndex = group.attachments[i];
+            const auto &image = images[imageIndex];
+            auto &description = group.attachmentDescriptions[i];
+            auto &state = states[imageIndex];
+
+            auto store = image.lastUse > groupEnd || image.imported || !image.aliasable;
+            description.storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            description.stencilStoreOp = store && hasStencil(image.desc.format) ? VK_ATTACHMENT_STORE_OP_STORE
+                                                                               : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            description.finalLayout = state.layout;
+
+            // The render pass leaves imported images in their final layout when
+            // this is their last use, which saves a barrier.
+            if (image.imported && image.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED && image.lastUse <= groupEnd)
+            {
+                description.finalLayout = image.finalLayout;
+                state.layout = image.finalLayout;
+            }
+        }
+
+        position = groupEnd + 1;
+    }
+
+    finalBarriers.clear();
+    for (uint32_t i = 0; i < images.size(); i++)
+    {
+        const auto &image = images[i];
+        auto &state = states[i];
+        if (!image.imported || image.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || state.layout == image.finalLayout)
+            continue;
+
+        Barrier barrier = {};
+        barrier.image = i;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = image.finalLayout;
+        barrier.srcStage = state.writeStages | state.readStages;
+        barrier.srcAccess = state.writeAccess;
+        barrier.dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        barrier.dstAccess = 0;
+        if (barrier.srcStage == 0)
+            barrier.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        finalBarriers.push_back(barrier);
+
+        state.layout = image.finalLayout;
+    }
+}
+
+void RenderGraph::createRenderPass(Group &group)
+{
+    std::map<uint32_t, uint32_t> attachmentIndices;
+    for (uint32_t i = 0; i < group.attachments.size(); i++)
+        attachmentIndices[group.attachments[i]] = i;
+
+    // The references have to stay alive until the render pass is created.
+    std::vector<std::vector<VkAttachmentReference>> colorReferences(group.passes.size());
+    std::vector<std::vector<VkAttachmentReference>> inputReferences(group.passes.size());
+    std::vector<VkAttachmentReference> depthReferences(group.passes.size());
+    std::vector<std::vector<uint32_t>> preserveAttachments(group.passes.size());
+    std::vector<VkSubpassDescription> subpasses(group.passes.size());
+
+    // Subpasses using each attachment.
+    std::vector<std::vector<uint32_t>> attachmentSubpasses(group.attachments.size());
+
+    for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++)
+    {
+        const auto &pass = passes[group.passes[subpass]];
+        auto &description = subpasses[subpass];
+        description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+        bool hasDepth = false;
+        for (const auto &use : pass.uses)
+        {
+            const auto &info = usageInfos[use.usage];
+            if (!info.attachment)
+                continue;
+
+            auto attachment = attachmentIndices[use.image];
+            attachmentSubpasses[attachment].push_back(subpass);
+
+            VkAttachmentReference reference = {attachment, info.layout};
+            if (use.usage == RENDER_GRAPH_USAGE_COLOR_ATTACHMENT)
+                colorReferences[subpass].push_back(reference);
+            else if (use.usage == RENDER_GRAPH_USAGE_INPUT_ATTACHMENT)
+                inputReferences[subpass].push_back(reference);
+            else
+            {
+                depthReferences[subpass] = reference;
+                hasDepth = true;
+            }
+        }
+
+        description.colorAttachmentCount = static_cast<uint32_t>(colorReferences[subpass].size());
+        description.pColorAttachments = colorReferences[subpass].data();
+        description.inputAttachmentCount = static_cast<uint32_t>(inputReferences[subpass].size());
+        description.pInputAttachments = inputReferences[subpass].data();
+        description.pDepthStencilAttachment = hasDepth ? &depthReferences[subpass] : nullptr;
+    }
+
+    // Attachments used before and after a subpass have to be preserved across it.
+    for (uint32_t attachment = 0; attachment < group.attachments.size(); attachment++)
+    {
+        const auto &used = attachmentSubpasses[attachment];
+        for (auto subpass = used.front() + 1; subpass < used.back(); subpass++)
+        {
+            if (std::find(used.begin(), used.end(), subpass) == used.end())
+                preserveAttachments[subpass].push_back(attachment);
+        }
+    }
+    for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++)
+    {
+        subpasses[subpass].preserveAttachmentCount = static_cast<uint32_t>(preserveAttachments[subpass].size());
+        subpasses[subpass].pPreserveAttachments = preserveAttachments[subpass].data();
+    }
+
+    // Work outside of the render pass is synchronized by the barriers recorded
+    // before it, and layouts only change between subpasses, so no external
+    // dependencies are needed.
+    VkRenderPassCreateInfo renderPassInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(group.attachmentDescriptions.size());
+    renderPassInfo.pAttachments = group.attachmentDescriptions.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(group.dependencies.size());
+    renderPassInfo.pDependencies = group.dependencies.data();
+
+    // The size is not part of a render pass, so the same graph compiled for
+    // another size gets the same render pass and pipelines created for it stay valid.
+    auto key = getRenderPassKey(renderPassInfo);
+    auto cached = renderPassCache.find(key);
+    if (cached != renderPassCache.end())
+    {
+        group.renderPass = cached->second;
+        return;
+    }
+
+    VK_CHECK(vkCreateRenderPass(platform->getDevice(), &renderPassInfo, nullptr, &group.renderPass));
+    renderPassCache[key] = group.renderPass;
+}
+
+std::vector<uint32_t> RenderGraph::getRenderPassKey(const VkRenderPassCreateInfo &info)
+{
+    std::vector<uint32_t> key;
+
+    key.push_back(info.attachmentCount);
+    for (uint32_t i = 0; i < info.attachmentCount; i++)
+    {
+        const auto &attachment = info.pAttachments[i];
+        key.insert(key.end(),
+                   {attachment.flags,
+                    static_cast<uint32_t>(attachment.format),
+                    static_cast<uint32_t>(attachment.samples),
+                    static_cast<uint32_t>(attachment.loadOp),
+                    static_cast<uint32_t>(attachment.storeOp),
+                    static_cast<uint32_t>(attachment.stencilLoadOp),
+                    static_cast<uint32_t>(attachment.stencilStoreOp),
+                    static_cast<uint32_t>(attachment.initialLayout),
+                    static_cast<uint32_t>(attachment.finalLayout)});
+    }
+
+    auto addReferences = [&key](const VkAttachmentReference *pReferences, uint32_t count) {
+        key.push_back(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            key.push_back(pReferences[i].attachment);
+            key.push_back(static_cast<uint32_t>(pReferences[i].layout));
+        }
+    };
+
+    key.push_back(info.subpassCount);
+    for (uint32_t i = 0; i < info.subpassCount; i++)
+    {
+        const auto &subpass = info.pSubpasses[i];
+        addReferences(subpass.pColorAttachments, subpass.colorAttachmentCount);
+        addReferences(subpass.pInputAttachments, subpass.inputAttachmentCount);
+        addReferences(subpass.pDepthStencilAttachment, subpass.pDepthStencilAttachment ? 1 : 0);
+        key.push_back(subpass.preserveAttachmentCount);
+        key.insert(key.end(), subpass.pPreserveAttachments, subpass.pPreserveAttachments + subpass.preserveAttachmentCount);
+    }
+
+    key.push_back(info.dependencyCount);
+    for (uint32_t i = 0; i < info.dependencyCount; i++)
+    {
+        const auto &dependency = info.pDependencies[i];
+        key.insert(key.end(),
+                   {dependency.srcSubpass,
+                    dependency.dstSubpass,
+                    dependency.srcStageMask,
+                    dependency.dstStageMask,
+                    dependency.srcAccessMask,
+                    dependency.dstAccessMask,
+                    dependency.dependencyFlags});
+    }
+
+    return key;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(Group &group)
+{
+    std::vector<VkImageView> views;
+    for (auto image : group.attachments)
+        views.push_back(images[image].view);
+
+    auto framebuffer = group.framebuffers.find(views);
+    if (framebuffer != group.framebuffers.end())
+        return framebuffer->second;
+
+    VkFramebufferCreateInfo framebufferInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    framebufferInfo.renderPass = group.renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = group.extent.width;
+    framebufferInfo.height = group.extent.height;
+    framebufferInfo.layers = 1;
+
+    VkFramebuffer newFramebuffer;
+    VK_CHECK(vkCreateFramebuffer(platform->getDevice(), &framebufferInfo, nullptr, &newFramebuffer));
+    group.framebuffers.emplace(views, newFramebuffer);
+
+    return newFramebuffer;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier> &barriers) const
+{
+    if (barriers.empty())
+        return;
+
+    VkPipelineStageFlags srcStage = 0;
+    VkPipelineStageFlags dstStage = 0;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    for (const auto &barrier : barriers)
+    {
+        const auto &image = images[barrier.image];
+
+        VkImageMemoryBarrier imageBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        imageBarrier.srcAccessMask = barrier.srcAccess;
+        imageBarrier.dstAccessMask = barrier.dstAccess;
+        imageBarrier.oldLayout = barrier.oldLayout;
+        imageBarrier.newLayout = barrier.newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = image.image;
+        imageBarrier.subresourceRange.aspectMask = image.aspect;
+        imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        imageBarriers.push_back(imageBarrier);
+
+        srcStage |= barrier.srcStage;
+        dstStage |= barrier.dstStage;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStage,
+                         dstStage,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    if (!compiled)
+    {
+        LOGE("Executing a render graph which is not compiled.\n");
+        return;
+    }
+
+    if (!initialBarriersRecorded)
+    {
+        recordBarriers(commandBuffer, initialBarriers);
+        initialBarriersRecorded = true;
+    }
+
+    for (auto &group : groups)
+    {
+        recordBarriers(commandBuffer, group.barriers);
+
+        if (group.compute)
+        {
+            const auto &pass = passes[group.passes[0]];
+            RenderGraphPassContext context = {VK_NULL_HANDLE, 0, VK_NULL_HANDLE, group.extent};
+            if (pass.record)
+                pass.record(commandBuffer, context);
+            continue;
+        }
+
+        RenderGraphPassContext context = {group.renderPass, 0, getFramebuffer(group), group.extent};
+
+        for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++)
+        {
+            const auto &pass = passes[group.passes[subpass]];
+            context.subpass = subpass;
+
+            auto contents = pass.prepare ? pass.prepare(context) : VK_SUBPASS_CONTENTS_INLINE;
+            if (subpass == 0)
+            {
+                VkRenderPassBeginInfo beginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+                beginInfo.renderPass = group.renderPass;
+                beginInfo.framebuffer = context.framebuffer;
+                beginInfo.renderArea.extent = group.extent;
+                beginInfo.clearValueCount = static_cast<uint32_t>(group.clearValues.size());
+                beginInfo.pClearValues = group.clearValues.data();
+                vkCmdBeginRenderPass(commandBuffer, &beginInfo, contents);
+            }
+            else
+            {
+                vkCmdNextSubpass(commandBuffer, contents);
+            }
+
+            if (pass.record)
+                pass.record(commandBuffer, context);
+        }
+
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    recordBarriers(commandBuffer, finalBarriers);
+}
+
+std::string RenderGraph::dump() const
+{
+    std::string text = "Render graph: " + std::to_string(passes.size()) + " passes, " +
+                       std::to_string(passes.size() - passOrder.size()) + " culled, " +
+                       std::to_string(groups.size()) + " groups\n";
+
+    text += "Images:\n";
+    for (uint32_t i = 0; i < images.size(); i++)
+    {
+        const auto &image = images[i];
+        text += "  " + std::to_string(i) + " " + image.name + " " +
+                std::to_string(image.desc.width) + "x" + std::to_string(image.desc.height) +
+                " format " + std::to_string(image.desc.format);
+        if (image.firstUse == invalidHandle)
+        {
+            text += " unused\n";
+            continue;
+        }
+        text += " passes " + std::to_string(image.firstUse) + "-" + std::to_string(image.lastUse);
+        if (image.imported)
+            text += " imported";
+        if (image.output)
+            text += " output";
+        if (image.transient)
+            text += " transient";
+        if (image.memorySlot != invalidHandle)
+            text += " memory " + std::to_string(image.memorySlot);
+        text += "\n";
+    }
+
+    text += "Memory:\n";
+    for (uint32_t i = 0; i < memorySlots.size(); i++)
+    {
+        const auto &slot = memorySlots[i];
+        text += "  " + std::to_string(i) + " " + std::to_string(slot.size) + " bytes, type " +
+                std::to_string(slot.memoryTypeIndex) + (slot.lazilyAllocated ? " lazily allocated" : "") + ":";
+        for (auto image : slot.images)
+            text += " " + images[image].name;
+        text += "\n";
+    }
+
+    auto dumpBarriers = [&](const std::vector<Barrier> &barriers) {
+        for (const auto &barrier : barriers)
+        {
+            text += "    barrier " + images[barrier.image].name + " " + getLayoutName(barrier.oldLayout) + " -> " +
+                    getLayoutName(barrier.newLayout) + ", stages " + toHex(barrier.srcStage) + " -> " +
+                    toHex(barrier.dstStage) + ", access " + toHex(barrier.srcAccess) + " -> " +
+                    toHex(barrier.dstAccess) + "\n";
+        }
+    };
+
+    if (!initialBarriers.empty())
+    {
+        text += "  first frame\n";
+        dumpBarriers(initialBarriers);
+    }
+
+    for (uint32_t i = 0; i < groups.size(); i++)
+    {
+        const auto &group = groups[i];
+        text += std::string("  ") + (group.compute ? "compute " : "render pass ") + std::to_string(i) + " " +
+                std::to_string(group.extent.width) + "x" + std::to_string(group.extent.height) + "\n";
+        dumpBarriers(group.barriers);
+
+        for (uint32_t j = 0; j < group.attachments.size(); j++)
+        {
+            const auto &description = group.attachmentDescriptions[j];
+            text += "    attachment " + images[group.attachments[j]].name + " " + getLoadOpName(description.loadOp) +
+                    (description.storeOp == VK_ATTACHMENT_STORE_OP_STORE ? "/store " : "/dont care ") +
+                    getLayoutName(description.initialLayout) + " -> " + getLayoutName(description.finalLayout) + "\n";
+        }
+
+        for (uint32_t j = 0; j < group.passes.size(); j++)
+        {
+            const auto &pass = passes[group.passes[j]];
+            text += "    subpass " + std::to_string(j) + " " + pass.name + ":";
+            for (const auto &use : pass.uses)
+                text += " " + images[use.image].name + " (" + usageInfos[use.usage].name + ")";
+            text += "\n";
+        }
+
+        for (const auto &dependency : group.dependencies)
+        {
+            text += "    dependency " + std::to_string(dependency.srcSubpass) + " -> " +
+                    std::to_string(dependency.dstSubpass) + ", stages " + toHex(dependency.srcStageMask) + " -> " +
+                    toHex(dependency.dstStageMask) + "\n";
+        }
+    }
+
+    if (!finalBarriers.empty())
+    {
+        text += "  end of frame\n";
+        dumpBarriers(finalBarriers);
+    }
+
+    for (const auto &pass : passes)
+    {
+        if (pass.culled)
+            text += "  culled " + pass.name + "\n";
+    }
+
+    return text;
+}
+
+} // namespace Tobi
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+
+namespace Tobi
+{
+class Platform;
+
+/// @brief How a pass uses an image. Decides the layout, stages and accesses the
+/// graph synchronizes.
+enum RenderGraphUsage
+{
+    /// Written as a color attachment.
+    RENDER_GRAPH_USAGE_COLOR_ATTACHMENT = 0,
+    /// Depth tested and written.
+    RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT,
+    /// Depth tested without writes.
+    RENDER_GRAPH_USAGE_DEPTH_READ,
+    /// Read as an input attachment in the fragment shader.
+    RENDER_GRAPH_USAGE_INPUT_ATTACHMENT,
+    /// Sampled in the fragment shader.
+    RENDER_GRAPH_USAGE_SAMPLED_FRAGMENT,
+    /// Sampled in a compute shader.
+    RENDER_GRAPH_USAGE_SAMPLED_COMPUTE,
+    /// Read and written as a storage image in a compute shader.
+    RENDER_GRAPH_USAGE_STORAGE_COMPUTE,
+    RENDER_GRAPH_USAGE_COUNT
+};
+
+/// @brief Description of an image owned by the graph.
+struct RenderGraphImageDesc
+{
+    VkFormat format;
+    /// 0 uses the size given to @ref RenderGraph::reset.
+    uint32_t width;
+    uint32_t height;
+    /// 0 is treated as 1.
+    uint32_t mipLevels;
+    /// Usage on top of what the passes need, for access outside of the graph.
+    VkImageUsageFlags usage;
+};
+
+/// @brief Handed to the callbacks of a pass while the graph is executed.
+struct RenderGraphPassContext
+{
+    /// Null for compute passes.
+    VkRenderPass renderPass;
+    uint32_t subpass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+};
+
+/// @brief Records the commands of a pass. Graphics passes are recorded inside
+/// their subpass.
+using RenderGraphRecordFunction = std::function<void(VkCommandBuffer, const RenderGraphPassContext &)>;
+
+/// @brief Called before the subpass of a graphics pass begins.
+/// Can record secondary command buffers for the subpass.
+/// @returns How the subpass contents are recorded.
+using RenderGraphPrepareFunction = std::function<VkSubpassContents(const RenderGraphPassContext &)>;
+
+/// @brief A frame described as passes declaring which images they use and how.
+///
+/// @ref compile turns the declarations into render passes and barriers:
+/// - Passes whose results are never used by an output are culled.
+/// - Layout transitions and barriers are derived from the usages, including
+///   the ones between frames and between images sharing memory.
+/// - Images whose lifetimes do not overlap share memory. Images which only
+///   live inside one render pass use lazily allocated memory when the device
+///   has it, so a tiler never writes them to memory.
+/// - Consecutive graphics passes of the same size are merged into subpasses of
+///   one render pass, unless one samples an attachment of the other.
+///
+/// Passes run in the order they were added, every use of an image has to come
+/// after the pass writing it.
+/// The graph is built and compiled once, then executed every frame. Imported
+/// images, like the swapchain image, are set before every execution.
+class RenderGraph
+{
+  public:
+    static const uint32_t invalidHandle = ~0u;
+
+    RenderGraph(std::shared_ptr<Platform> platform);
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph(RenderGraph &&) = delete;
+    RenderGraph &operator=(const RenderGraph &) & = delete;
+    RenderGraph &operator=(RenderGraph &&) & = delete;
+    ~RenderGraph();
+
+    /// @brief Clears all passes and images. The GPU must be done with the compiled graph.
+    /// @param width, height The default image size, usually the swapchain size.
+    void reset(uint32_t width, uint32_t height);
+
+    /// @brief Declares an image created and owned by the graph.
+    /// @returns The handle of the image.
+    uint32_t createImage(const char *name, const RenderGraphImageDesc &desc);
+
+    /// @brief Declares an image owned by someone else, set with @ref setImportedImage.
+    /// @param initialLayout The layout when the frame starts.
+    /// @param initialStage The stages which have to wait for the image to be ready, e.g. for a semaphore.
+    /// @param finalLayout The layout the image is left in.
+    /// @returns The handle of the image.
+    uint32_t importImage(const char *name,
+                         VkFormat format,
+                         uint32_t width,
+                         uint32_t height,
+                         VkImageLayout initialLayout,
+                         VkPipelineStageFlags initialStage,
+                         VkImageLayout finalLayout);
+
+    /// @brief Sets the image used for an imported image by the following executions.
+    void setImportedImage(uint32_t image, VkImage handle, VkImageView view);
+
+    /// @brief The image is cleared by the first pass writing it each frame.
+    /// Otherwise it is loaded, or undefined for images without previous contents.
+    void setClearValue(uint32_t image, const VkClearValue &clearValue);
+
+    /// @brief The image is needed after the frame. Passes it depends on are never culled.
+    void markOutput(uint32_t image);
+
+    /// @brief Declares a pass.
+    /// @returns The handle of the pass.
+    uint32_t addPass(const char *name, bool compute, RenderGraphRecordFunction record);
+
+    void setPrepareFunction(uint32_t pass, RenderGraphPrepareFunction prepare);
+
+    /// @brief Declares the use of an image by a pass. The uses of a pass are
+    /// in the order they happen.
+    void use(uint32_t pass, uint32_t image, RenderGraphUsage usage);
+
+    /// @brief Turns merging of graphics passes into subpasses on or off. On by default.
+    void setSubpassMerging(bool enabled) { subpassMergingEnabled = enabled; }
+
+    /// @brief Culls passes, creates the images, render passes and barriers.
+    Result compile();
+
+    /// @brief Records the compiled graph. Has to be called outside of a render pass.
+    void execute(VkCommandBuffer commandBuffer);
+
+    bool isPassCulled(uint32_t pass) const { return passes[pass].culled; }
+
+    /// @brief The render pass a graphics pass is recorded in, for pipeline creation.
+    /// Render passes are cached, compiling an unchanged graph for another size
+    /// returns the same render pass.
+    VkRenderPass getRenderPass(uint32_t pass) const;
+
+    uint32_t getSubpass(uint32_t pass) const { return passes[pass].subpass; }
+
+    VkImage getImage(uint32_t image) const { return images[image].image; }
+
+    /// @brief A view of all mip levels of the image.
+    VkImageView getImageView(uint32_t image) const { return images[image].view; }
+
+    /// @brief Describes the compiled graph, passes, render passes, barriers and memory.
+    std::string dump() const;
+
+  private:
+    struct Image
+    {
+        std::string name;
+        RenderGraphImageDesc desc;
+        bool imported;
+        VkImageLayout initialLayout;
+        VkPipelineStageFlags initialStage;
+        VkImageLayout finalLayout;
+        bool output;
+        bool hasClearValue;
+        VkClearValue clearValue;
+
+        // Set by compile.
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspect;
+        // Positions in the pass order of the first and last pass using the image.
+        uint32_t firstUse;
+        uint32_t lastUse;
+        // Contents do not survive the frame, the memory can be shared.
+        bool aliasable;
+        // Only used as attachment inside one render pass.
+        bool transient;
+        // Stages and writes of the last use in the frame.
+        VkPipelineStageFlags lastStages;
+        VkAccessFlags lastWrites;
+        uint32_t memorySlot;
+
+        VkImage image;
+        VkImageView view;
+    };
+
+    struct Use
+    {
+        uint32_t image;
+        RenderGraphUsage usage;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        bool compute;
+        std::vector<Use> uses;
+        RenderGraphRecordFunction record;
+        RenderGraphPrepareFunction prepare;
+
+        // Set by compile.
+        bool culled;
+        uint32_t group;
+        uint32_t subpass;
+    };
+
+    struct Barrier
+    {
+        uint32_t image;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        VkPipelineStageFlags srcStage;
+        VkPipelineStageFlags dstStage;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+    };
+
+    /// @brief Passes recorded together, either one render pass or one compute pass.
+    struct Group
+    {
+        bool compute;
+        std::vector<uint32_t> passes;
+        VkExtent2D extent;
+        // Barriers recorded before the group.
+        std::vector<Barrier> barriers;
+
+        VkRenderPass renderPass;
+        // Image of every attachment of the render pass.
+        std::vector<uint32_t> attachments;
+        std::vector<VkAttachmentDescription> attachmentDescriptions;
+        std::vector<VkClearValue> clearValues;
+        std::vector<VkSubpassDependency> dependencies;
+        // Created on first use, keyed by the attachment views.
+        std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+    };
+
+    struct MemorySlot
+    {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        uint32_t memoryTypeIndex;
+        bool lazilyAllocated;
+        std::vector<uint32_t> images;
+    };
+
+    /// @brief State of an image while the barriers are derived.
+    struct ImageState
+    {
+        VkImageLayout layout;
+        // Contents are undefined, the next write may discard them.
+        bool undefined;
+        bool writtenThisFrame;
+        VkPipelineStageFlags writeStages;
+        VkAccessFlags writeAccess;
+        VkPipelineStageFlags readStages;
+        // Stages the last write has been made visible to.
+        VkPipelineStageFlags visibleStages;
+    };
+
+    std::shared_ptr<Platform> platform;
+
+    uint32_t width;
+    uint32_t height;
+    bool subpassMergingEnabled;
+
+    std::vector<Image> images;
+    std::vector<Pass> passes;
+
+    bool compiled;
+    std::vector<uint32_t> passOrder;
+    std::vector<Group> groups;
+    std::vector<MemorySlot> memorySlots;
+    // Transitions to the final layouts of imported images.
+    std::vector<Barrier> finalBarriers;
+    // Transitions of persistent images from their undefined layout on the first execution.
+    std::vector<Barrier> initialBarriers;
+    bool initialBarriersRecorded;
+    // Render passes by their description, kept across resets until the graph is destroyed.
+    std::map<std::vector<uint32_t>, VkRenderPass> renderPassCache;
+
+    void destroyCompiled();
+
+    void cullPasses();
+    void computeLifetimes();
+    void buildGroups();
+    bool canMerge(const Group &group, const Pass &pass) const;
+    void createImages();
+    void allocateMemory();
+    void createImageViews();
+
+    /// @brief Derives the barriers and render pass parameters of one frame,
+    /// starting from the given states, which are left as the frame ends.
+    void deriveBarriers(std::vector<ImageState> &states);
+    /// @brief Adds a barrier when the use needs one and updates the state.
+    /// @param discard The previous contents are not needed.
+    void addBarrier(std::vector<Barrier> &barriers,
+                    uint32_t image,
+                    ImageState &state,
+                    VkImageLayout layout,
+                    VkPipelineStageFlags stage,
+                    VkAccessFlags access,
+                    bool discard);
+    void createRenderPass(Group &group);
+    static std::vector<uint32_t> getRenderPassKey(const VkRenderPassCreateInfo &info);
+
+    VkFramebuffer getFramebuffer(Group &group);
+    void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier> &barriers) const;
+};
+
+} // namespace Tobi
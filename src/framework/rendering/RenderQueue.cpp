@@ -0,0 +1,167 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+
+#include "framework/Common.hpp"
+
+namespace Tobi
+{
+
+const uint32_t RenderQueue::passBits;
+const uint32_t RenderQueue::pipelineBits;
+const uint32_t RenderQueue::meshBits;
+const uint32_t RenderQueue::materialBits;
+const uint32_t RenderQueue::depthBits;
+
+static_assert(RenderQueue::passBits + RenderQueue::pipelineBits + RenderQueue::meshBits +
+                      RenderQueue::materialBits + RenderQueue::depthBits == 64,
+              "The sort key fields must fill 64 bits");
+
+RenderQueue::RenderQueue()
+    : packets(std::vector<DrawPacket>()),
+      entries(std::vector<SortEntry>()),
+      scratch(std::vector<SortEntry>())
+{
+    LOGI("CONSTRUCTING RenderQueue\n");
+}
+
+uint64_t RenderQueue::makeSortKey(uint32_t pass, uint32_t pipeline, uint32_t mesh, uint32_t material, float depth)
+{
+    const auto maxDepth = (1u << depthBits) - 1;
+    auto quantizedDepth = static_cast<uint32_t>(std::min(std::max(depth, 0.f), 1.f) * maxDepth);
+
+    auto key = static_cast<uint64_t>(pass & ((1u << passBits) - 1));
+    key = (key << pipelineBits) | (pipeline & ((1u << pipelineBits) - 1));
+    key = (key << meshBits) | (mesh & ((1u << meshBits) - 1));
+    key = (key << materialBits) | (material & ((1u << materialBits) - 1));
+    key = (key << depthBits) | quantizedDepth;
+    return key;
+}
+
+void RenderQueue::clear()
+{
+    packets.clear();
+}
+
+void RenderQueue::sort()
+{
+    auto count = static_cast<uint32_t>(packets.size());
+    entries.resize(count);
+    scratch.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        entries[i] = {packets[i].sortKey, i};
+    }
+
+    // One pass per byte, least significant first. Passes where every key has
+    // the same byte would not move anything and are skipped.
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        uint32_t histogram[256] = {};
+        for (const auto &entry : entries)
+        {
+            histogram[(entry.key >> shift) & 0xff]++;
+        }
+
+        if (count == 0 || histogram[(entries[0].key >> shift) & 0xff] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (auto &bucket : histogram)
+        {
+            auto bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        for (const auto &entry : entries)
+        {
+            scratch[histogram[(entry.key >> shift) & 0xff]++] = entry;
+        }
+
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::getPassRange(uint32_t pass, uint32_t &firstPacket, uint32_t &packetCount) const
+{
+    // The pass is in the most significant bits, so the packets of a pass are contiguous.
+    const auto passShift = 64 - passBits;
+    auto begin = std::lower_bound(entries.begin(), entries.end(), pass, [passShift](const SortEntry &entry, uint32_t value) {
+        return (entry.key >> passShift) < value;
+    });
+    auto end = std::upper_bound(begin, entries.end(), pass, [passShift](uint32_t value, const SortEntry &entry) {
+        return value < (entry.key >> passShift);
+    });
+
+    firstPacket = static_cast<uint32_t>(begin - entries.begin());
+    packetCount = static_cast<uint32_t>(end - begin);
+}
+
+RenderQueueStatistics RenderQueue::execute(VkCommandBuffer commandBuffer, uint32_t firstPacket, uint32_t packetCount) const
+{
+    RenderQueueStatistics statistics = {};
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundInstanceBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    const VkDeviceSize offset = 0;
+
+    for (uint32_t i = firstPacket; i < firstPacket + packetCount; i++)
+    {
+        const auto &packet = packets[entries[i].packetIndex];
+
+        if (packet.pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+            boundPipeline = packet.pipeline;
+            statistics.pipelineBindCount++;
+        }
+
+        if (packet.vertexBuffer != boundVertexBuffer)
+        {
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &packet.vertexBuffer, &offset);
+            boundVertexBuffer = packet.vertexBuffer;
+            statistics.vertexBufferBindCount++;
+        }
+
+        // Pipelines without an instance binding ignore whatever stays bound there.
+        if (packet.instanceBuffer != VK_NULL_HANDLE && packet.instanceBuffer != boundInstanceBuffer)
+        {
+            vkCmdBindVertexBuffers(commandBuffer, 1, 1, &packet.instanceBuffer, &offset);
+            boundInstanceBuffer = packet.instanceBuffer;
+            statistics.vertexBufferBindCount++;
+        }
+
+        if (packet.indexBuffer != boundIndexBuffer)
+        {
+            vkCmdBindIndexBuffer(commandBuffer, packet.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            boundIndexBuffer = packet.indexBuffer;
+            statistics.indexBufferBindCount++;
+        }
+
+        if (packet.indirectBuffer != VK_NULL_HANDLE)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer,
+                                     packet.indirectBuffer,
+                                     packet.indirectOffset,
+                                     1,
+                                     sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else
+        {
+            vkCmdDrawIndexed(commandBuffer,
+                             packet.indexCount,
+                             packet.instanceCount,
+                             packet.firstIndex,
+                             packet.vertexOffset,
+                             packet.firstInstance);
+        }
+        statistics.drawCount++;
+    }
+
+    return statistics;
+}
+
+} // namespace Tobi
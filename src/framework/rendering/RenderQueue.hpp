@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+
+#include "../VkCommon.hpp"
+
+namespace Tobi
+{
+
+/// @brief Everything needed to record one indexed draw.
+struct DrawPacket
+{
+    /// Built with @ref RenderQueue::makeSortKey.
+    uint64_t sortKey;
+
+    VkPipeline pipeline;
+    VkBuffer vertexBuffer;
+    VkBuffer indexBuffer;
+    /// Per-instance vertex data bound to binding 1, VK_NULL_HANDLE for pipelines
+    /// reading everything but the vertices from descriptors.
+    VkBuffer instanceBuffer;
+
+    /// When set, the draw parameters are read from a `VkDrawIndexedIndirectCommand`
+    /// at indirectOffset in this buffer and the ones below are ignored.
+    VkBuffer indirectBuffer;
+    VkDeviceSize indirectOffset;
+
+    uint32_t indexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+};
+
+/// @brief State changes and draws recorded by @ref RenderQueue::execute.
+struct RenderQueueStatistics
+{
+    uint32_t drawCount;
+    uint32_t pipelineBindCount;
+    uint32_t vertexBufferBindCount;
+    uint32_t indexBufferBindCount;
+};
+
+/// @brief Collects draw packets for a frame, sorts them by key and records them
+/// while skipping binds of state which is already bound.
+///
+/// The key packs, from the most significant bits down, the pass, the pipeline,
+/// the mesh, the material and the quantized depth. Sorting by it groups
+/// packets sharing state, so walking the sorted queue changes state as
+/// rarely as possible.
+class RenderQueue
+{
+  public:
+    static const uint32_t passBits = 4;
+    static const uint32_t pipelineBits = 12;
+    static const uint32_t meshBits = 16;
+    static const uint32_t materialBits = 8;
+    static const uint32_t depthBits = 24;
+
+    RenderQueue();
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue(RenderQueue &&) = delete;
+    RenderQueue &operator=(const RenderQueue &) & = delete;
+    RenderQueue &operator=(RenderQueue &&) & = delete;
+    ~RenderQueue() = default;
+
+    /// @brief Builds a sort key. Values are truncated to their number of bits.
+    /// @param depth Depth in [0, 1], smaller values are sorted first.
+    static uint64_t makeSortKey(uint32_t pass, uint32_t pipeline, uint32_t mesh, uint32_t material, float depth);
+
+    /// @brief Removes all packets, keeping the storage.
+    void clear();
+
+    void submit(const DrawPacket &packet) { packets.push_back(packet); }
+
+    /// @brief Sorts the submitted packets by key with an LSD radix sort.
+    void sort();
+
+    /// @brief Records a range of the sorted packets into the command buffer.
+    /// Bound state is tracked per call, so ranges can be recorded into different
+    /// command buffers from different threads.
+    /// The caller is responsible for the render pass, dynamic state and descriptor sets.
+    /// @returns The draws and binds recorded.
+    RenderQueueStatistics execute(VkCommandBuffer commandBuffer, uint32_t firstPacket, uint32_t packetCount) const;
+
+    uint32_t getPacketCount() const { return static_cast<uint32_t>(packets.size()); }
+
+    /// @brief Finds the sorted packets of one pass, to be passed to @ref execute.
+    void getPassRange(uint32_t pass, uint32_t &firstPacket, uint32_t &packetCount) const;
+
+  private:
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t packetIndex;
+    };
+
+    std::vector<DrawPacket> packets;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+};
+
+} // namespace Tobi
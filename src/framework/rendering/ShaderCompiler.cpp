@@ -0,0 +1,223 @@
+#include "ShaderCompiler.hpp"
+
+#ifdef TOBI_HAVE_GLSLANG
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+#endif
+
+namespace Tobi
+{
+
+#ifdef TOBI_HAVE_GLSLANG
+// The limits glslang checks the shaders against, the same as glslangValidator uses.
+static void initResources(TBuiltInResource &resources)
+{
+    resources.maxLights = 32;
+    resources.maxClipPlanes = 6;
+    resources.maxTextureUnits = 32;
+    resources.maxTextureCoords = 32;
+    resources.maxVertexAttribs = 64;
+    resources.maxVertexUniformComponents = 4096;
+    resources.maxVaryingFloats = 64;
+    resources.maxVertexTextureImageUnits = 32;
+    resources.maxCombinedTextureImageUnits = 80;
+    resources.maxTextureImageUnits = 32;
+    resources.maxFragmentUniformComponents = 4096;
+    resources.maxDrawBuffers = 32;
+    resources.maxVertexUniformVectors = 128;
+    resources.maxVaryingVectors = 8;
+    resources.maxFragmentUniformVectors = 16;
+    resources.maxVertexOutputVectors = 16;
+    resources.maxFragmentInputVectors = 15;
+    resources.minProgramTexelOffset = -8;
+    resources.maxProgramTexelOffset = 7;
+    resources.maxClipDistances = 8;
+    resources.maxComputeWorkGroupCountX = 65535;
+    resources.maxComputeWorkGroupCountY = 65535;
+    resources.maxComputeWorkGroupCountZ = 65535;
+    resources.maxComputeWorkGroupSizeX = 1024;
+    resources.maxComputeWorkGroupSizeY = 1024;
+    resources.maxComputeWorkGroupSizeZ = 64;
+    resources.maxComputeUniformComponents = 1024;
+    resources.maxComputeTextureImageUnits = 16;
+    resources.maxComputeImageUniforms = 8;
+    resources.maxComputeAtomicCounters = 8;
+    resources.maxComputeAtomicCounterBuffers = 1;
+    resources.maxVaryingComponents = 60;
+    resources.maxVertexOutputComponents = 64;
+    resources.maxGeometryInputComponents = 64;
+    resources.maxGeometryOutputComponents = 128;
+    resources.maxFragmentInputComponents = 128;
+    resources.maxImageUnits = 8;
+    resources.maxCombinedImageUnitsAndFragmentOutputs = 8;
+    resources.maxCombinedShaderOutputResources = 8;
+    resources.maxImageSamples = 0;
+    resources.maxVertexImageUniforms = 0;
+    resources.maxTessControlImageUniforms = 0;
+    resources.maxTessEvaluationImageUniforms = 0;
+    resources.maxGeometryImageUniforms = 0;
+    resources.maxFragmentImageUniforms = 8;
+    resources.maxCombinedImageUniforms = 8;
+    resources.maxGeometryTextureImageUnits = 16;
+    resources.maxGeometryOutputVertices = 256;
+    resources.maxGeometryTotalOutputComponents = 1024;
+    resources.maxGeometryUniformComponents = 1024;
+    resources.maxGeometryVaryingComponents = 64;
+    resources.maxTessControlInputComponents = 128;
+    resources.maxTessControlOutputComponents = 128;
+    resources.maxTessControlTextureImageUnits = 16;
+    resources.maxTessControlUniformComponents = 1024;
+    resources.maxTessControlTotalOutputComponents = 4096;
+    resources.maxTessEvaluationInputComponents = 128;
+    resources.maxTessEvaluationOutputComponents = 128;
+    resources.maxTessEvaluationTextureImageUnits = 16;
+    resources.maxTessEvaluationUniformComponents = 1024;
+    resources.maxTessPatchComponents = 120;
+    resources.maxPatchVertices = 32;
+    resources.maxTessGenLevel = 64;
+    resources.maxViewports = 16;
+    resources.maxVertexAtomicCounters = 0;
+    resources.maxTessControlAtomicCounters = 0;
+    resources.maxTessEvaluationAtomicCounters = 0;
+    resources.maxGeometryAtomicCounters = 0;
+    resources.maxFragmentAtomicCounters = 8;
+    resources.maxCombinedAtomicCounters = 8;
+    resources.maxAtomicCounterBindings = 1;
+    resources.maxVertexAtomicCounterBuffers = 0;
+    resources.maxTessControlAtomicCounterBuffers = 0;
+    resources.maxTessEvaluationAtomicCounterBuffers = 0;
+    resources.maxGeometryAtomicCounterBuffers = 0;
+    resources.maxFragmentAtomicCounterBuffers = 1;
+    resources.maxCombinedAtomicCounterBuffers = 1;
+    resources.maxAtomicCounterBufferSize = 16384;
+    resources.maxTransformFeedbackBuffers = 4;
+    resources.maxTransformFeedbackInterleavedComponents = 64;
+    resources.maxCullDistances = 8;
+    resources.maxCombinedClipAndCullDistances = 8;
+    resources.maxSamples = 4;
+    resources.limits.nonInductiveForLoops = 1;
+    resources.limits.whileLoops = 1;
+    resources.limits.doWhileLoops = 1;
+    resources.limits.generalUniformIndexing = 1;
+    resources.limits.generalAttributeMatrixVectorIndexing = 1;
+    resources.limits.generalVaryingIndexing = 1;
+    resources.limits.generalSamplerIndexing = 1;
+    resources.limits.generalVariableIndexing = 1;
+    resources.limits.generalConstantMatrixVectorIndexing = 1;
+}
+
+static EShLanguage getLanguage(VkShaderStageFlagBits stage)
+{
+    switch (stage)
+    {
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+        return EShLangFragment;
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        return EShLangCompute;
+    default:
+        return EShLangVertex;
+    }
+}
+#endif
+
+ShaderCompiler::ShaderCompiler()
+{
+    LOGI("CONSTRUCTING ShaderCompiler\n");
+
+#ifdef TOBI_HAVE_GLSLANG
+    glslang::InitializeProcess();
+#endif
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+    LOGI("DECONSTRUCTING ShaderCompiler\n");
+
+#ifdef TOBI_HAVE_GLSLANG
+    glslang::FinalizeProcess();
+#endif
+}
+
+bool ShaderCompiler::isAvailable()
+{
+#ifdef TOBI_HAVE_GLSLANG
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ShaderCompiler::getStage(const std::string &path, VkShaderStageFlagBits &stage)
+{
+    static const struct
+    {
+        const char *pExtension;
+        VkShaderStageFlagBits stage;
+    } extensions[] = {
+        {".vert", VK_SHADER_STAGE_VERTEX_BIT},
+        {".frag", VK_SHADER_STAGE_FRAGMENT_BIT},
+        {".comp", VK_SHADER_STAGE_COMPUTE_BIT},
+    };
+
+    auto dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+
+    for (const auto &extension : extensions)
+    {
+        if (path.compare(dot, std::string::npos, extension.pExtension) == 0)
+        {
+            stage = extension.stage;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Result ShaderCompiler::compile(VkShaderStageFlagBits stage,
+                               const std::string &source,
+                               std::vector<uint32_t> &spirv,
+                               std::string &log) const
+{
+#ifdef TOBI_HAVE_GLSLANG
+    auto language = getLanguage(stage);
+    glslang::TShader shader(language);
+    glslang::TProgram program;
+
+    TBuiltInResource resources = {};
+    initResources(resources);
+
+    // Enable SPIR-V and Vulkan rules when parsing GLSL.
+    auto messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+
+    const char *pSource = source.c_str();
+    shader.setStrings(&pSource, 1);
+
+    if (!shader.parse(&resources, 100, false, messages))
+    {
+        log = shader.getInfoLog();
+        return RESULT_ERROR_GENERIC;
+    }
+
+    program.addShader(&shader);
+    if (!program.link(messages))
+    {
+        log = program.getInfoLog();
+        return RESULT_ERROR_GENERIC;
+    }
+
+    log = shader.getInfoLog();
+    spirv.clear();
+    glslang::GlslangToSpv(*program.getIntermediate(language), spirv);
+    return RESULT_SUCCESS;
+#else
+    (void)stage;
+    (void)source;
+    spirv.clear();
+    log = "Built without glslang.";
+    return RESULT_ERROR_GENERIC;
+#endif
+}
+
+} // namespace Tobi
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+
+namespace Tobi
+{
+
+/// @brief Compiles GLSL to SPIR-V at runtime with glslang.
+///
+/// Only available when glslang was found at build time, see @ref isAvailable.
+/// Several threads can compile at the same time.
+class ShaderCompiler
+{
+  public:
+    ShaderCompiler();
+    ShaderCompiler(const ShaderCompiler &) = delete;
+    ShaderCompiler(ShaderCompiler &&) = delete;
+    ShaderCompiler &operator=(const ShaderCompiler &) & = delete;
+    ShaderCompiler &operator=(ShaderCompiler &&) & = delete;
+    ~ShaderCompiler();
+
+    /// @returns false if the library was built without glslang.
+    static bool isAvailable();
+
+    /// @brief The stage of a GLSL file by its extension: .vert, .frag or .comp.
+    /// @returns false for other files.
+    static bool getStage(const std::string &path, VkShaderStageFlagBits &stage);
+
+    /// @brief Compiles the source of one stage with Vulkan semantics.
+    /// @param[out] log The errors and warnings of the compiler.
+    /// @returns RESULT_ERROR_GENERIC if the source does not compile.
+    Result compile(VkShaderStageFlagBits stage,
+                   const std::string &source,
+                   std::vector<uint32_t> &spirv,
+                   std::string &log) const;
+};
+
+} // namespace Tobi
@@ -0,0 +1,440 @@
+#include "ShaderReflection.hpp"
+
+#include <algorithm>
+#include <map>
+
+namespace Tobi
+{
+
+namespace
+{
+// From the SPIR-V specification, only what the reflection reads.
+const uint32_t spirvMagic = 0x07230203;
+const uint32_t spirvHeaderWords = 5;
+
+enum SpirvOp
+{
+    SPIRV_OP_ENTRY_POINT = 15,
+    SPIRV_OP_TYPE_BOOL = 20,
+    SPIRV_OP_TYPE_INT = 21,
+    SPIRV_OP_TYPE_FLOAT = 22,
+    SPIRV_OP_TYPE_VECTOR = 23,
+    SPIRV_OP_TYPE_MATRIX = 24,
+    SPIRV_OP_TYPE_IMAGE = 25,
+    SPIRV_OP_TYPE_SAMPLER = 26,
+    SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+    SPIRV_OP_TYPE_ARRAY = 28,
+    SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+    SPIRV_OP_TYPE_STRUCT = 30,
+    SPIRV_OP_TYPE_POINTER = 32,
+    SPIRV_OP_CONSTANT = 43,
+    SPIRV_OP_VARIABLE = 59,
+    SPIRV_OP_DECORATE = 71,
+    SPIRV_OP_MEMBER_DECORATE = 72
+};
+
+enum SpirvDecoration
+{
+    SPIRV_DECORATION_BLOCK = 2,
+    SPIRV_DECORATION_BUFFER_BLOCK = 3,
+    SPIRV_DECORATION_ARRAY_STRIDE = 6,
+    SPIRV_DECORATION_MATRIX_STRIDE = 7,
+    SPIRV_DECORATION_BUILT_IN = 11,
+    SPIRV_DECORATION_LOCATION = 30,
+    SPIRV_DECORATION_BINDING = 33,
+    SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+    SPIRV_DECORATION_OFFSET = 35
+};
+
+enum SpirvStorageClass
+{
+    SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+    SPIRV_STORAGE_CLASS_INPUT = 1,
+    SPIRV_STORAGE_CLASS_UNIFORM = 2,
+    SPIRV_STORAGE_CLASS_PUSH_CONSTANT = 9,
+    SPIRV_STORAGE_CLASS_STORAGE_BUFFER = 12
+};
+
+enum SpirvDim
+{
+    SPIRV_DIM_BUFFER = 5,
+    SPIRV_DIM_SUBPASS_DATA = 6
+};
+
+struct Type
+{
+    uint32_t op;
+    // Scalar width in bits, or number of components, columns or array elements.
+    uint32_t width;
+    uint32_t count;
+    bool isSigned;
+    // Component, column, element or pointee type.
+    uint32_t elementType;
+    uint32_t storageClass;
+    // Image dim and sampled operand.
+    uint32_t dim;
+    uint32_t sampled;
+    std::vector<uint32_t> members;
+};
+
+struct Decorations
+{
+    bool block;
+    bool bufferBlock;
+    bool builtIn;
+    uint32_t location;
+    uint32_t binding;
+    uint32_t set;
+    uint32_t arrayStride;
+    std::map<uint32_t, uint32_t> memberOffsets;
+    std::map<uint32_t, uint32_t> memberMatrixStrides;
+};
+
+struct Module
+{
+    std::map<uint32_t, Type> types;
+    std::map<uint32_t, uint32_t> constants;
+    std::map<uint32_t, Decorations> decorations;
+};
+
+VkFormat getInputFormat(const Module &module, const Type &type)
+{
+    // A single location holds a scalar or a vector of 32 bit components.
+    auto components = type.op == SPIRV_OP_TYPE_VECTOR ? type.count : 1;
+    const auto &scalar = type.op == SPIRV_OP_TYPE_VECTOR ? module.types.at(type.elementType) : type;
+    if (scalar.width != 32)
+        return VK_FORMAT_UNDEFINED;
+
+    static const VkFormat floatFormats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+    static const VkFormat intFormats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+    static const VkFormat uintFormats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+
+    if (components < 1 || components > 4)
+        return VK_FORMAT_UNDEFINED;
+    if (scalar.op == SPIRV_OP_TYPE_FLOAT)
+        return floatFormats[components - 1];
+    if (scalar.op == SPIRV_OP_TYPE_INT)
+        return scalar.isSigned ? intFormats[components - 1] : uintFormats[components - 1];
+    return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t getTypeSize(const Module &module, uint32_t typeId, uint32_t matrixStride)
+{
+    const auto &type = module.types.at(typeId);
+    switch (type.op)
+    {
+    case SPIRV_OP_TYPE_BOOL:
+        return 4;
+    case SPIRV_OP_TYPE_INT:
+    case SPIRV_OP_TYPE_FLOAT:
+        return type.width / 8;
+    case SPIRV_OP_TYPE_VECTOR:
+        return type.count * getTypeSize(module, type.elementType, 0);
+    case SPIRV_OP_TYPE_MATRIX:
+        return type.count * (matrixStride ? matrixStride : getTypeSize(module, type.elementType, 0));
+    case SPIRV_OP_TYPE_ARRAY:
+    {
+        auto decorations = module.decorations.find(typeId);
+        auto stride = decorations != module.decorations.end() ? decorations->second.arrayStride : 0;
+        return type.count * (stride ? stride : getTypeSize(module, type.elementType, matrixStride));
+    }
+    case SPIRV_OP_TYPE_STRUCT:
+    {
+        // The members are placed by their offsets, the last one ends the struct.
+        auto decorations = module.decorations.find(typeId);
+        uint32_t size = 0;
+        for (uint32_t member = 0; member < type.members.size(); member++)
+        {
+            uint32_t offset = 0;
+            uint32_t memberMatrixStride = 0;
+            if (decorations != module.decorations.end())
+            {
+                auto offsetIt = decorations->second.memberOffsets.find(member);
+                if (offsetIt != decorations->second.memberOffsets.end())
+                    offset = offsetIt->second;
+                auto strideIt = decorations->second.memberMatrixStrides.find(member);
+                if (strideIt != decorations->second.memberMatrixStrides.end())
+                    memberMatrixStride = strideIt->second;
+            }
+            size = std::max(size, offset + getTypeSize(module, type.members[member], memberMatrixStride));
+        }
+        return size;
+    }
+    default:
+        // Runtime arrays have no size of their own.
+        return 0;
+    }
+}
+
+Result getDescriptorType(const Module &module, uint32_t storageClass, uint32_t typeId, const Decorations &decorations, VkDescriptorType &descriptorType)
+{
+    const auto &type = module.types.at(typeId);
+
+    if (storageClass == SPIRV_STORAGE_CLASS_STORAGE_BUFFER)
+    {
+        descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        return RESULT_SUCCESS;
+    }
+
+    if (storageClass == SPIRV_STORAGE_CLASS_UNIFORM)
+    {
+        // Before SPIR-V 1.3 storage buffers are uniform blocks decorated as BufferBlock.
+        descriptorType = decorations.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        return RESULT_SUCCESS;
+    }
+
+    switch (type.op)
+    {
+    case SPIRV_OP_TYPE_SAMPLER:
+        descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        return RESULT_SUCCESS;
+    case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+        descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        return RESULT_SUCCESS;
+    case SPIRV_OP_TYPE_IMAGE:
+        if (type.dim == SPIRV_DIM_SUBPASS_DATA)
+            descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        else if (type.dim == SPIRV_DIM_BUFFER)
+            descriptorType = type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        else
+            descriptorType = type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        return RESULT_SUCCESS;
+    default:
+        return RESULT_ERROR_GENERIC;
+    }
+}
+
+VkShaderStageFlagBits getStage(uint32_t executionModel)
+{
+    switch (executionModel)
+    {
+    case 0:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+        return VK_SHADER_STAGE_ALL;
+    }
+}
+} // namespace
+
+Result reflectShader(const std::vector<uint32_t> &code, ShaderReflection &reflection)
+{
+    reflection.stage = VK_SHADER_STAGE_ALL;
+    reflection.inputs.clear();
+    reflection.pushConstantSize = 0;
+    reflection.bindings.clear();
+
+    if (code.size() < spirvHeaderWords || code[0] != spirvMagic)
+    {
+        LOGE("Not SPIR-V, the magic number is missing.\n");
+        return RESULT_ERROR_GENERIC;
+    }
+
+    Module module;
+    // Result type, storage class, in declaration order.
+    std::vector<std::pair<uint32_t, uint32_t>> variables;
+    std::vector<uint32_t> variableIds;
+
+    for (size_t offset = spirvHeaderWords; offset < code.size();)
+    {
+        auto wordCount = code[offset] >> 16;
+        auto op = code[offset] & 0xffff;
+        if (wordCount == 0 || offset + wordCount > code.size())
+        {
+            LOGE("Malformed SPIR-V instruction at word %zu.\n", offset);
+            return RESULT_ERROR_GENERIC;
+        }
+        const auto *pOperands = &code[offset + 1];
+        auto operandCount = wordCount - 1;
+
+        switch (op)
+        {
+        case SPIRV_OP_ENTRY_POINT:
+            // A module may hold several entry points, the first one is used.
+            if (reflection.stage == VK_SHADER_STAGE_ALL)
+                reflection.stage = getStage(pOperands[0]);
+            break;
+        case SPIRV_OP_TYPE_BOOL:
+        case SPIRV_OP_TYPE_INT:
+        case SPIRV_OP_TYPE_FLOAT:
+        case SPIRV_OP_TYPE_VECTOR:
+        case SPIRV_OP_TYPE_MATRIX:
+        case SPIRV_OP_TYPE_IMAGE:
+        case SPIRV_OP_TYPE_SAMPLER:
+        case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+        case SPIRV_OP_TYPE_ARRAY:
+        case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+        case SPIRV_OP_TYPE_STRUCT:
+        case SPIRV_OP_TYPE_POINTER:
+        {
+            Type type = {};
+            type.op = op;
+            if (op == SPIRV_OP_TYPE_INT || op == SPIRV_OP_TYPE_FLOAT)
+            {
+                type.width = pOperands[1];
+                type.isSigned = op == SPIRV_OP_TYPE_INT && pOperands[2] != 0;
+            }
+            else if (op == SPIRV_OP_TYPE_VECTOR || op == SPIRV_OP_TYPE_MATRIX)
+            {
+                type.elementType = pOperands[1];
+                type.count = pOperands[2];
+            }
+            else if (op == SPIRV_OP_TYPE_IMAGE)
+            {
+                type.dim = pOperands[2];
+                type.sampled = pOperands[6];
+            }
+            else if (op == SPIRV_OP_TYPE_SAMPLED_IMAGE || op == SPIRV_OP_TYPE_RUNTIME_ARRAY)
+            {
+                type.elementType = pOperands[1];
+            }
+            else if (op == SPIRV_OP_TYPE_ARRAY)
+            {
+                // The length is a constant declared before the array.
+                type.elementType = pOperands[1];
+                type.count = module.constants[pOperands[2]];
+            }
+            else if (op == SPIRV_OP_TYPE_STRUCT)
+            {
+                type.members.assign(pOperands + 1, pOperands + operandCount);
+            }
+            else if (op == SPIRV_OP_TYPE_POINTER)
+            {
+                type.storageClass = pOperands[1];
+                type.elementType = pOperands[2];
+            }
+            module.types[pOperands[0]] = type;
+            break;
+        }
+        case SPIRV_OP_CONSTANT:
+            // Only the low word matters for array lengths.
+            module.constants[pOperands[1]] = pOperands[2];
+            break;
+        case SPIRV_OP_VARIABLE:
+            variables.push_back({pOperands[0], pOperands[2]});
+            variableIds.push_back(pOperands[1]);
+            break;
+        case SPIRV_OP_DECORATE:
+        {
+            auto &decorations = module.decorations[pOperands[0]];
+            auto value = operandCount > 2 ? pOperands[2] : 0;
+            switch (pOperands[1])
+            {
+            case SPIRV_DECORATION_BLOCK:
+                decorations.block = true;
+                break;
+            case SPIRV_DECORATION_BUFFER_BLOCK:
+                decorations.bufferBlock = true;
+                break;
+            case SPIRV_DECORATION_ARRAY_STRIDE:
+                decorations.arrayStride = value;
+                break;
+            case SPIRV_DECORATION_BUILT_IN:
+                decorations.builtIn = true;
+                break;
+            case SPIRV_DECORATION_LOCATION:
+                decorations.location = value;
+                break;
+            case SPIRV_DECORATION_BINDING:
+                decorations.binding = value;
+                break;
+            case SPIRV_DECORATION_DESCRIPTOR_SET:
+                decorations.set = value;
+                break;
+            }
+            break;
+        }
+        case SPIRV_OP_MEMBER_DECORATE:
+        {
+            auto &decorations = module.decorations[pOperands[0]];
+            auto value = operandCount > 3 ? pOperands[3] : 0;
+            if (pOperands[2] == SPIRV_DECORATION_OFFSET)
+                decorations.memberOffsets[pOperands[1]] = value;
+            else if (pOperands[2] == SPIRV_DECORATION_MATRIX_STRIDE)
+                decorations.memberMatrixStrides[pOperands[1]] = value;
+            break;
+        }
+        }
+
+        offset += wordCount;
+    }
+
+    for (uint32_t i = 0; i < variables.size(); i++)
+    {
+        auto pointerIt = module.types.find(variables[i].first);
+        if (pointerIt == module.types.end())
+            return RESULT_ERROR_GENERIC;
+
+        auto storageClass = variables[i].second;
+        auto typeId = pointerIt->second.elementType;
+        const auto &decorations = module.decorations[variableIds[i]];
+
+        if (storageClass == SPIRV_STORAGE_CLASS_INPUT)
+        {
+            if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT || decorations.builtIn)
+                continue;
+
+            const auto &type = module.types.at(typeId);
+            ShaderInput input = {};
+            input.location = decorations.location;
+            input.locationCount = type.op == SPIRV_OP_TYPE_MATRIX ? type.count : 1;
+            input.format = getInputFormat(module, type.op == SPIRV_OP_TYPE_MATRIX ? module.types.at(type.elementType) : type);
+            if (input.format == VK_FORMAT_UNDEFINED)
+            {
+                LOGE("Unsupported type of the vertex input at location %u.\n", input.location);
+                return RESULT_ERROR_GENERIC;
+            }
+            reflection.inputs.push_back(input);
+        }
+        else if (storageClass == SPIRV_STORAGE_CLASS_PUSH_CONSTANT)
+        {
+            reflection.pushConstantSize = getTypeSize(module, typeId, 0);
+        }
+        else if (storageClass == SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT ||
+                 storageClass == SPIRV_STORAGE_CLASS_UNIFORM ||
+                 storageClass == SPIRV_STORAGE_CLASS_STORAGE_BUFFER)
+        {
+            ShaderBinding binding = {};
+            binding.set = decorations.set;
+            binding.binding = decorations.binding;
+            binding.descriptorCount = 1;
+
+            // Arrays of descriptors, runtime sized ones count as one.
+            const auto *pType = &module.types.at(typeId);
+            if (pType->op == SPIRV_OP_TYPE_ARRAY || pType->op == SPIRV_OP_TYPE_RUNTIME_ARRAY)
+            {
+                binding.descriptorCount = pType->op == SPIRV_OP_TYPE_ARRAY ? pType->count : 1;
+                typeId = pType->elementType;
+            }
+
+            // The block decoration is on the struct type, not on the variable.
+            const auto &typeDecorations = module.decorations[typeId];
+            if (FAILED(getDescriptorType(module, storageClass, typeId, typeDecorations, binding.descriptorType)))
+            {
+                LOGE("Unsupported resource at set %u, binding %u.\n", binding.set, binding.binding);
+                return RESULT_ERROR_GENERIC;
+            }
+            reflection.bindings.push_back(binding);
+        }
+    }
+
+    std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const ShaderInput &a, const ShaderInput &b) {
+        return a.location < b.location;
+    });
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ShaderBinding &a, const ShaderBinding &b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+
+    return RESULT_SUCCESS;
+}
+
+} // namespace Tobi
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+
+namespace Tobi
+{
+
+/// @brief A vertex shader input.
+struct ShaderInput
+{
+    uint32_t location;
+    /// Format of one location, a matrix takes one location per column.
+    VkFormat format;
+    uint32_t locationCount;
+};
+
+/// @brief A descriptor used by a shader.
+struct ShaderBinding
+{
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType descriptorType;
+    /// Number of array elements, 1 for a single descriptor.
+    uint32_t descriptorCount;
+};
+
+/// @brief What a pipeline needs to know about the interface of a shader stage.
+struct ShaderReflection
+{
+    VkShaderStageFlagBits stage;
+    /// Sorted by location. Only filled for vertex shaders.
+    std::vector<ShaderInput> inputs;
+    /// Size of the push constant block, 0 without one.
+    uint32_t pushConstantSize;
+    /// Sorted by set and binding.
+    std::vector<ShaderBinding> bindings;
+};
+
+/// @brief Reads the stage, the vertex inputs, the push constant block and the
+/// descriptor bindings from SPIR-V.
+///
+/// Only the instructions declaring types, variables and decorations are read,
+/// which is fast enough to do every time a shader is loaded.
+/// @returns RESULT_ERROR_GENERIC if the code is not valid SPIR-V or uses a
+/// resource which can't be expressed as a Vulkan descriptor.
+Result reflectShader(const std::vector<uint32_t> &code, ShaderReflection &reflection);
+
+} // namespace Tobi
@@ -0,0 +1,194 @@
+#include "ShaderWatcher.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "../jobs/JobSystem.hpp"
+#include "../../platform/AssetManager.hpp"
+
+namespace Tobi
+{
+
+// Editors either write the file in place or rename a new file over it.
+static const uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+static Result readSource(const std::string &path, std::string &source)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return RESULT_ERROR_IO;
+
+    source.clear();
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        source.append(buffer, length);
+
+    auto ok = !ferror(file);
+    fclose(file);
+    return ok ? RESULT_SUCCESS : RESULT_ERROR_IO;
+}
+
+ShaderWatcher::ShaderWatcher(std::shared_ptr<JobSystem> jobSystem, const char *pDirectory)
+    : jobSystem(jobSystem),
+      compiler(),
+      directory(pDirectory),
+      sourceDirectory(),
+      fd(-1),
+      compiling(std::set<std::string>()),
+      dirty(std::set<std::string>()),
+      compiled(std::vector<std::string>())
+{
+    LOGI("CONSTRUCTING ShaderWatcher\n");
+
+    if (!ShaderCompiler::isAvailable())
+    {
+        LOGW("Built without glslang, shaders are not reloaded.\n");
+        return;
+    }
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        LOGE("inotify_init1() failed, shaders are not reloaded.\n");
+        return;
+    }
+
+#ifdef TOBI_SHADER_SOURCE_DIR
+    if (inotify_add_watch(fd, TOBI_SHADER_SOURCE_DIR, watchMask) >= 0)
+        sourceDirectory = TOBI_SHADER_SOURCE_DIR;
+#endif
+
+    if (sourceDirectory.empty())
+    {
+        auto fullpath = OS::getAssetManager().getAssetPath(pDirectory);
+        if (inotify_add_watch(fd, fullpath.c_str(), watchMask) < 0)
+        {
+            LOGE("Can't watch %s, shaders are not reloaded.\n", fullpath.c_str());
+            close(fd);
+            fd = -1;
+            return;
+        }
+        sourceDirectory = fullpath;
+    }
+
+    LOGI("Watching %s for shader changes.\n", sourceDirectory.c_str());
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    LOGI("DECONSTRUCTING ShaderWatcher\n");
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        compileDone.wait(lock, [this]() { return compiling.empty(); });
+    }
+
+    if (fd >= 0)
+        close(fd);
+}
+
+void ShaderWatcher::poll()
+{
+    if (fd < 0)
+        return;
+
+    // One save usually gives several events, they are merged per file.
+    std::set<std::string> changed;
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+        auto length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            if (length < 0 && errno != EAGAIN)
+                LOGE("Reading the shader changes failed.\n");
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length;)
+        {
+            auto pEvent = reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + pEvent->len;
+
+            // The written SPIR-V and temporary files are skipped here.
+            VkShaderStageFlagBits stage;
+            if (pEvent->len && ShaderCompiler::getStage(pEvent->name, stage))
+                changed.insert(directory + "/" + pEvent->name);
+        }
+    }
+
+    std::vector<std::string> schedule;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed.insert(dirty.begin(), dirty.end());
+        dirty.clear();
+
+        for (const auto &sourcePath : changed)
+        {
+            if (compiling.count(sourcePath))
+            {
+                dirty.insert(sourcePath);
+                continue;
+            }
+
+            compiling.insert(sourcePath);
+            schedule.push_back(sourcePath);
+        }
+    }
+
+    // Jobs run inline without workers, so they are scheduled without holding the mutex.
+    for (const auto &sourcePath : schedule)
+    {
+        LOGI("%s changed, compiling.\n", sourcePath.c_str());
+        jobSystem->schedule([this, sourcePath]() { compile(sourcePath); });
+    }
+}
+
+std::vector<std::string> ShaderWatcher::takeCompiledShaders()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> shaders;
+    shaders.swap(compiled);
+    return shaders;
+}
+
+void ShaderWatcher::compile(const std::string &sourcePath)
+{
+    auto startTime = OS::getCurrentTime();
+    auto spirvPath = sourcePath + ".spv";
+    // The source path is relative to the assets, the file is read from the watched directory.
+    auto fullpath = sourceDirectory + sourcePath.substr(directory.size());
+
+    std::string source;
+    std::vector<uint32_t> spirv;
+    std::string log;
+    VkShaderStageFlagBits stage;
+
+    auto result = RESULT_ERROR_GENERIC;
+    if (FAILED(readSource(fullpath, source)))
+    {
+        LOGE("Failed to read %s.\n", fullpath.c_str());
+    }
+    else if (!ShaderCompiler::getStage(sourcePath, stage) ||
+             FAILED(compiler.compile(stage, source, spirv, log)))
+    {
+        LOGE("%s failed to compile, keeping the previous version:\n%s\n", sourcePath.c_str(), log.c_str());
+    }
+    else
+    {
+        result = OS::getAssetManager().writeAssetFile(spirvPath.c_str(), spirv.data(), spirv.size() * sizeof(uint32_t));
+        if (SUCCEEDED(result))
+            LOGI("Compiled %s in %.2f ms\n", sourcePath.c_str(), (OS::getCurrentTime() - startTime) * 1000.0);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (SUCCEEDED(result))
+        compiled.push_back(spirvPath);
+    compiling.erase(sourcePath);
+    compileDone.notify_all();
+}
+
+} // namespace Tobi
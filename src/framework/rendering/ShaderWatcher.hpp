@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "framework/Common.hpp"
+#include "ShaderCompiler.hpp"
+
+namespace Tobi
+{
+class JobSystem;
+
+/// @brief Watches the GLSL sources of the shaders and recompiles them to
+/// SPIR-V when they are saved.
+///
+/// Builds define TOBI_SHADER_SOURCE_DIR as the shader directory of the source
+/// tree, so the files developers edit are watched. Where that directory does
+/// not exist, as for an installed build, the sources in the asset directory
+/// are watched instead.
+///
+/// Changes are picked up with inotify by @ref poll, which never blocks. The
+/// compiles run on the job system, a successful one replaces the SPIR-V in the
+/// asset directory the shaders are loaded from and is reported by @ref
+/// takeCompiledShaders. A source which fails to compile leaves the previous
+/// SPIR-V in place.
+class ShaderWatcher
+{
+  public:
+    /// @param pDirectory The directory the SPIR-V is loaded from, relative to the assets directory.
+    ShaderWatcher(std::shared_ptr<JobSystem> jobSystem, const char *pDirectory);
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher(ShaderWatcher &&) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) & = delete;
+    ShaderWatcher &operator=(ShaderWatcher &&) & = delete;
+
+    /// @brief Destructor. Waits for the compiles in flight.
+    ~ShaderWatcher();
+
+    /// @returns false if the directory can't be watched or there is no compiler.
+    bool isWatching() const { return fd >= 0; }
+
+    /// @brief Reads the changes since the last call and schedules the compiles.
+    /// Call once per frame.
+    void poll();
+
+    /// @brief The SPIR-V assets rewritten since the last call, e.g. "shaders/triangle.vert.spv".
+    std::vector<std::string> takeCompiledShaders();
+
+  private:
+    std::shared_ptr<JobSystem> jobSystem;
+    ShaderCompiler compiler;
+    std::string directory;
+    // Full path of the watched directory.
+    std::string sourceDirectory;
+    int fd;
+
+    // Sources by asset path. A source saved again while compiling is compiled
+    // once more after, so the last save always wins.
+    std::set<std::string> compiling;
+    std::set<std::string> dirty;
+    std::vector<std::string> compiled;
+    std::mutex mutex;
+    std::condition_variable compileDone;
+
+    void compile(const std::string &sourcePath);
+};
+
+} // namespace Tobi
@@ -0,0 +1,41 @@
+#include "SlotAllocator.hpp"
+
+#include "framework/Common.hpp"
+
+namespace Tobi
+{
+
+SlotAllocator::SlotAllocator(uint32_t capacity)
+    : capacity(capacity),
+      nextSlot(0),
+      freeSlots(std::vector<uint32_t>())
+{
+}
+
+uint32_t SlotAllocator::allocate()
+{
+    if (!freeSlots.empty())
+    {
+        auto slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    if (nextSlot == capacity)
+        return invalidSlot;
+
+    return nextSlot++;
+}
+
+void SlotAllocator::free(uint32_t slot)
+{
+    if (slot >= nextSlot)
+    {
+        LOGE("Slot %u was never allocated.\n", slot);
+        return;
+    }
+
+    freeSlots.push_back(slot);
+}
+
+} // namespace Tobi
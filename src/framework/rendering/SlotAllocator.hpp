@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace Tobi
+{
+
+/// @brief Hands out the indices of a fixed size array and reuses freed ones,
+/// the most recently freed first. Not thread safe.
+class SlotAllocator
+{
+  public:
+    static const uint32_t invalidSlot = ~0u;
+
+    explicit SlotAllocator(uint32_t capacity);
+
+    /// @returns invalidSlot when all slots are in use.
+    uint32_t allocate();
+
+    void free(uint32_t slot);
+
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getUsedCount() const { return nextSlot - static_cast<uint32_t>(freeSlots.size()); }
+
+  private:
+    uint32_t capacity;
+    // Slots from here on have never been handed out.
+    uint32_t nextSlot;
+    std::vector<uint32_t> freeSlots;
+};
+
+} // namespace Tobi
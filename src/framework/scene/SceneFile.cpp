@@ -0,0 +1,307 @@
+#include "SceneFile.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+
+namespace Tobi
+{
+
+static const char sceneMagic[4] = {'T', 'S', 'C', 'N'};
+
+// Guards against reading a corrupt model table into a huge allocation.
+static const uint32_t maxModelNameLength = 4096;
+
+const uint32_t SceneReader::version;
+
+// Bytes between the read position and the end of an open file.
+static bool getRemainingSize(FILE *file, uint64_t &size)
+{
+    auto position = ftell(file);
+    if (position < 0 || fseek(file, 0, SEEK_END) != 0)
+        return false;
+
+    auto end = ftell(file);
+    if (end < 0 || fseek(file, position, SEEK_SET) != 0)
+        return false;
+
+    size = static_cast<uint64_t>(end - position);
+    return true;
+}
+
+SceneReader::SceneReader()
+    : file(nullptr),
+      models(std::vector<std::string>()),
+      objectCount(0),
+      objectsRead(0),
+      textObjects(std::vector<SceneObject>())
+{
+}
+
+SceneReader::~SceneReader()
+{
+    close();
+}
+
+void SceneReader::close()
+{
+    if (file)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+Result SceneReader::open(const char *pPath)
+{
+    close();
+    models.clear();
+    textObjects.clear();
+    objectCount = 0;
+    objectsRead = 0;
+
+    file = fopen(pPath, "rb");
+    if (!file)
+    {
+        LOGE("Couldn't open scene: %s\n", pPath);
+        return RESULT_ERROR_IO;
+    }
+
+    char magic[4] = {};
+    auto isBinary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                    memcmp(magic, sceneMagic, sizeof(magic)) == 0;
+
+    auto result = RESULT_SUCCESS;
+    if (isBinary)
+    {
+        result = readBinaryHeader();
+    }
+    else
+    {
+        rewind(file);
+        result = parseText();
+        close();
+    }
+
+    if (FAILED(result))
+    {
+        LOGE("Failed to read scene: %s\n", pPath);
+        close();
+        models.clear();
+        textObjects.clear();
+        objectCount = 0;
+    }
+
+    return result;
+}
+
+Result SceneReader::readBinaryHeader()
+{
+    uint32_t header[3];
+    if (fread(header, sizeof(uint32_t), 3, file) != 3)
+        return RESULT_ERROR_IO;
+
+    if (header[0] != version)
+    {
+        LOGE("Unsupported scene version %u, expected %u\n", header[0], version);
+        return RESULT_ERROR_GENERIC;
+    }
+
+    // The counts size allocations, so a corrupt header must not claim more
+    // than the rest of the file can hold.
+    uint64_t remainingSize;
+    if (!getRemainingSize(file, remainingSize))
+        return RESULT_ERROR_IO;
+
+    auto modelCount = header[1];
+    if (static_cast<uint64_t>(modelCount) * sizeof(uint32_t) > remainingSize)
+    {
+        LOGE("Scene claims %u models, more than the file can hold\n", modelCount);
+        return RESULT_ERROR_IO;
+    }
+
+    models.reserve(modelCount);
+    for (uint32_t i = 0; i < modelCount; i++)
+    {
+        uint32_t length;
+        if (fread(&length, sizeof(length), 1, file) != 1 || length > maxModelNameLength)
+            return RESULT_ERROR_IO;
+
+        std::string name(length, '\0');
+        if (length && fread(&name[0], 1, length, file) != length)
+            return RESULT_ERROR_IO;
+
+        models.push_back(std::move(name));
+    }
+
+    if (!getRemainingSize(file, remainingSize))
+        return RESULT_ERROR_IO;
+
+    if (static_cast<uint64_t>(header[2]) * sizeof(SceneObject) > remainingSize)
+    {
+        LOGE("Scene claims %u objects, more than the file can hold\n", header[2]);
+        return RESULT_ERROR_IO;
+    }
+    objectCount = header[2];
+
+    return RESULT_SUCCESS;
+}
+
+Result SceneReader::parseText()
+{
+    std::unordered_map<std::string, uint32_t> modelIndices;
+
+    char line[1024];
+    uint32_t lineNumber = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        lineNumber++;
+
+        std::istringstream stream(line);
+        std::string keyword;
+        if (!(stream >> keyword) || keyword[0] == '#')
+            continue;
+
+        if (keyword == "model")
+        {
+            std::string name;
+            std::string filename;
+            if (!(stream >> name >> filename))
+            {
+                LOGE("Scene line %u: expected 'model <name> <file>'\n", lineNumber);
+                return RESULT_ERROR_GENERIC;
+            }
+
+            modelIndices[name] = static_cast<uint32_t>(models.size());
+            models.push_back(filename);
+        }
+        else if (keyword == "object")
+        {
+            std::string name;
+            SceneObject object = {};
+            object.scale = glm::vec3(1.f);
+
+            if (!(stream >> name >> object.position.x >> object.position.y >> object.position.z))
+            {
+                LOGE("Scene line %u: expected 'object <model> <x> <y> <z>'\n", lineNumber);
+                return RESULT_ERROR_GENERIC;
+            }
+
+            auto model = modelIndices.find(name);
+            if (model == modelIndices.end())
+            {
+                LOGE("Scene line %u: unknown model '%s'\n", lineNumber, name.c_str());
+                return RESULT_ERROR_GENERIC;
+            }
+            object.modelIndex = model->second;
+
+            // The remaining values are optional, rotation first, then scale, then flags.
+            float values[6];
+            uint32_t valueCount = 0;
+            std::string token;
+            while (stream >> token)
+            {
+                if (token == "occluder")
+                {
+                    object.flags |= SCENE_OBJECT_OCCLUDER;
+                    continue;
+                }
+
+                char *pEnd = nullptr;
+                auto value = strtof(token.c_str(), &pEnd);
+                if (*pEnd != '\0' || valueCount == 6)
+                {
+                    LOGE("Scene line %u: unexpected '%s'\n", lineNumber, token.c_str());
+                    return RESULT_ERROR_GENERIC;
+                }
+                values[valueCount++] = value;
+            }
+
+            if (valueCount != 0 && valueCount != 3 && valueCount != 6)
+            {
+                LOGE("Scene line %u: rotation and scale need three values each\n", lineNumber);
+                return RESULT_ERROR_GENERIC;
+            }
+            if (valueCount >= 3)
+                object.rotation = glm::vec3(values[0], values[1], values[2]);
+            if (valueCount == 6)
+                object.scale = glm::vec3(values[3], values[4], values[5]);
+
+            textObjects.push_back(object);
+        }
+        else
+        {
+            LOGE("Scene line %u: unknown keyword '%s'\n", lineNumber, keyword.c_str());
+            return RESULT_ERROR_GENERIC;
+        }
+    }
+
+    objectCount = static_cast<uint32_t>(textObjects.size());
+    return RESULT_SUCCESS;
+}
+
+uint32_t SceneReader::readObjects(SceneObject *pObjects, uint32_t maxCount)
+{
+    auto count = std::min(maxCount, objectCount - objectsRead);
+    if (count == 0)
+        return 0;
+
+    if (!file)
+    {
+        if (textObjects.empty())
+            return 0;
+
+        memcpy(pObjects, textObjects.data() + objectsRead, count * sizeof(SceneObject));
+    }
+    else if (fread(pObjects, sizeof(SceneObject), count, file) != count)
+    {
+        LOGE("Scene ended after %u of %u objects\n", objectsRead, objectCount);
+        close();
+        objectsRead = objectCount;
+        return 0;
+    }
+
+    objectsRead += count;
+    return count;
+}
+
+Result writeBinaryScene(const char *pPath,
+                        const std::vector<std::string> &models,
+                        const std::vector<SceneObject> &objects)
+{
+    FILE *file = fopen(pPath, "wb");
+    if (!file)
+    {
+        LOGE("Couldn't open %s for writing\n", pPath);
+        return RESULT_ERROR_IO;
+    }
+
+    uint32_t header[3] = {SceneReader::version,
+                          static_cast<uint32_t>(models.size()),
+                          static_cast<uint32_t>(objects.size())};
+
+    auto ok = fwrite(sceneMagic, 1, sizeof(sceneMagic), file) == sizeof(sceneMagic) &&
+              fwrite(header, sizeof(uint32_t), 3, file) == 3;
+
+    for (const auto &model : models)
+    {
+        auto length = static_cast<uint32_t>(model.size());
+        ok = ok && fwrite(&length, sizeof(length), 1, file) == 1 &&
+             fwrite(model.data(), 1, length, file) == length;
+    }
+
+    ok = ok && fwrite(objects.data(), sizeof(SceneObject), objects.size(), file) == objects.size();
+
+    if (fclose(file) != 0 || !ok)
+    {
+        LOGE("Failed to write scene: %s\n", pPath);
+        return RESULT_ERROR_IO;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+} // namespace Tobi
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "framework/Common.hpp"
+
+namespace Tobi
+{
+
+/// @brief Flags stored with every scene object.
+enum SceneObjectFlags
+{
+    /// The object is rasterized by the occlusion culler.
+    SCENE_OBJECT_OCCLUDER = 1 << 0
+};
+
+/// @brief One object record. The binary scene stores these back to back,
+/// so the layout must not change without bumping the scene version.
+struct SceneObject
+{
+    /// Index into the scene's model table.
+    uint32_t modelIndex;
+    glm::vec3 position;
+    /// Euler angles in radians, in the order used by ObjectManager.
+    glm::vec3 rotation;
+    glm::vec3 scale;
+    uint32_t flags;
+};
+
+static_assert(sizeof(SceneObject) == 44, "SceneObject must match the binary scene record size");
+
+/// @brief Reads scenes in either the binary or the text form.
+///
+/// The binary form is
+///     char     magic[4] = "TSCN"
+///     uint32_t version
+///     uint32_t modelCount
+///     uint32_t objectCount
+///     modelCount times: uint32_t length, followed by length chars
+///     objectCount times: SceneObject
+/// with all values little endian. The header and model table are read by
+/// @ref open, object records are streamed with @ref readObjects.
+///
+/// The text form is line based and meant for authoring:
+///     # comment
+///     model <name> <file>
+///     object <model name> <x> <y> <z> [<yaw> <pitch> <roll> [<sx> <sy> <sz>]] [occluder]
+/// Models must be declared before they are used. Text scenes are parsed
+/// completely by @ref open and then handed out the same way.
+class SceneReader
+{
+  public:
+    static const uint32_t version = 1;
+
+    SceneReader();
+    SceneReader(const SceneReader &) = delete;
+    SceneReader(SceneReader &&) = delete;
+    SceneReader &operator=(const SceneReader &) & = delete;
+    SceneReader &operator=(SceneReader &&) & = delete;
+    ~SceneReader();
+
+    /// @brief Opens a scene file and reads its model table.
+    /// The form is detected from the first four bytes.
+    Result open(const char *pPath);
+
+    /// The model files referenced by the scene, in table order.
+    const std::vector<std::string> &getModels() const { return models; }
+
+    uint32_t getObjectCount() const { return objectCount; }
+
+    /// @brief Reads the next object records.
+    /// @param[out] pObjects Output array with room for maxCount objects.
+    /// @returns The number of objects read, 0 once all objects have been read or on error.
+    uint32_t readObjects(SceneObject *pObjects, uint32_t maxCount);
+
+  private:
+    FILE *file;
+
+    std::vector<std::string> models;
+    uint32_t objectCount;
+    uint32_t objectsRead;
+
+    // Only used for text scenes.
+    std::vector<SceneObject> textObjects;
+
+    Result readBinaryHeader();
+    Result parseText();
+    void close();
+};
+
+/// @brief Writes a scene in the binary form.
+Result writeBinaryScene(const char *pPath,
+                        const std::vector<std::string> &models,
+                        const std::vector<SceneObject> &objects);
+
+} // namespace Tobi
@@ -0,0 +1,93 @@
+#include "SceneLoader.hpp"
+
+#include <vector>
+
+#include "SceneFile.hpp"
+#include "../model/ModelManager.hpp"
+#include "../model/ObjectManager.hpp"
+#include "../../platform/AssetManager.hpp"
+
+namespace Tobi
+{
+
+// Number of object records read and inserted per batch.
+static const uint32_t objectChunkSize = 16384;
+
+SceneLoader::SceneLoader(ModelManager &modelManager, ObjectManager &objectManager)
+    : modelManager(modelManager),
+      objectManager(objectManager)
+{
+}
+
+Result SceneLoader::load(const char *pPath)
+{
+    auto startTime = OS::getCurrentTime();
+
+    SceneReader reader;
+    auto result = reader.open(pPath);
+    if (FAILED(result))
+        return result;
+
+    const auto &models = reader.getModels();
+    std::vector<uint32_t> meshIndexByModel;
+    meshIndexByModel.reserve(models.size());
+    for (const auto &model : models)
+    {
+        meshIndexByModel.push_back(modelManager.loadModel(model.c_str()));
+    }
+
+    auto modelTime = OS::getCurrentTime();
+
+    std::vector<SceneObject> chunk(objectChunkSize);
+    std::vector<uint32_t> meshIndices(objectChunkSize);
+    std::vector<glm::vec3> positions(objectChunkSize);
+    std::vector<glm::vec3> rotations(objectChunkSize);
+    std::vector<glm::vec3> scales(objectChunkSize);
+
+    objectManager.reserve(objectManager.getObjectCount() + reader.getObjectCount());
+
+    uint32_t objectCount = 0;
+    while (auto count = reader.readObjects(chunk.data(), objectChunkSize))
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const auto &object = chunk[i];
+            if (object.modelIndex >= meshIndexByModel.size())
+            {
+                LOGE("Scene object %u uses model %u, but the scene only has %u models\n",
+                     objectCount + i, object.modelIndex, static_cast<uint32_t>(meshIndexByModel.size()));
+                return RESULT_ERROR_GENERIC;
+            }
+
+            meshIndices[i] = meshIndexByModel[object.modelIndex];
+            positions[i] = object.position;
+            rotations[i] = object.rotation;
+            scales[i] = object.scale;
+        }
+
+        auto range = objectManager.addObjects(count, meshIndices.data(), positions.data(), rotations.data(), scales.data());
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (chunk[i].flags & SCENE_OBJECT_OCCLUDER)
+                objectManager.setOccluder(range.firstId + i, true);
+        }
+
+        objectCount += count;
+    }
+
+    if (objectCount != reader.getObjectCount())
+        return RESULT_ERROR_IO;
+
+    auto endTime = OS::getCurrentTime();
+    LOGI("Loaded scene %s: %u models in %.3f s, %u objects in %.3f s\n",
+         pPath,
+         static_cast<uint32_t>(models.size()),
+         modelTime - startTime,
+         objectCount,
+         endTime - modelTime);
+
+    return RESULT_SUCCESS;
+}
+
+} // namespace Tobi
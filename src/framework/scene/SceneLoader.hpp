@@ -0,0 +1,36 @@
+#pragma once
+
+#include "framework/Common.hpp"
+
+namespace Tobi
+{
+
+class ModelManager;
+class ObjectManager;
+
+/// @brief Loads a scene file into the model and object managers.
+///
+/// Models are loaded once each through the ModelManager, which shares them
+/// with earlier scenes. Objects are streamed from the file in fixed size
+/// chunks and added to the ObjectManager one chunk at a time.
+class SceneLoader
+{
+  public:
+    SceneLoader(ModelManager &modelManager, ObjectManager &objectManager);
+    SceneLoader(const SceneLoader &) = delete;
+    SceneLoader(SceneLoader &&) = delete;
+    SceneLoader &operator=(const SceneLoader &) & = delete;
+    SceneLoader &operator=(SceneLoader &&) & = delete;
+    ~SceneLoader() = default;
+
+    /// @brief Loads a binary or text scene.
+    /// @param pPath Path to the scene file.
+    /// @returns Error code
+    Result load(const char *pPath);
+
+  private:
+    ModelManager &modelManager;
+    ObjectManager &objectManager;
+};
+
+} // namespace Tobi
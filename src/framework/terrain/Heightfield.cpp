@@ -0,0 +1,154 @@
+#include "Heightfield.hpp"
+
+#include <stdio.h>
+
+#include "../jobs/JobSystem.hpp"
+
+namespace Tobi
+{
+
+// Displacement of the corners, later levels shrink it by the roughness. The
+// sum over all levels stays within half the sample range for roughness 0.5.
+static const float initialAmplitude = 16000.f;
+
+// Samples written per job of a generation level.
+static const uint32_t generationGrainSamples = 65536;
+
+// Deterministic random value in [-1, 1] for a sample.
+static float getRandom(uint32_t x, uint32_t z, uint32_t seed)
+{
+    auto hash = (x * 0x8da6b343u) ^ (z * 0xd8163841u) ^ (seed * 0xcb1ab31fu);
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+    return (hash & 0xffffff) / 8388607.5f - 1.f;
+}
+
+static uint16_t toSample(float value)
+{
+    return static_cast<uint16_t>(std::min(std::max(value, 0.f), 65535.f) + 0.5f);
+}
+
+Heightfield::Heightfield(uint32_t width, uint32_t depth, float spacing, float heightScale)
+    : width(width),
+      depth(depth),
+      spacing(spacing),
+      heightScale(heightScale),
+      samples(std::vector<uint16_t>())
+{
+}
+
+Result Heightfield::loadRaw(const char *pPath)
+{
+    // Read straight into the samples, a large heightfield would otherwise be
+    // held twice while it is copied.
+    auto *file = fopen(pPath, "rb");
+    if (!file)
+    {
+        LOGE("Failed to open heightfield %s\n", pPath);
+        return RESULT_ERROR_IO;
+    }
+
+    samples.resize(static_cast<size_t>(width) * depth);
+    auto readCount = fread(samples.data(), sizeof(uint16_t), samples.size(), file);
+    fclose(file);
+
+    if (readCount != samples.size())
+    {
+        LOGE("Heightfield %s holds %zu of %ux%u samples.\n", pPath, readCount, width, depth);
+        samples.clear();
+        return RESULT_ERROR_IO;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+Result Heightfield::generate(uint32_t seed, float roughness, JobSystem &jobSystem)
+{
+    if (width != depth || width < 3 || ((width - 1) & (width - 2)) != 0)
+    {
+        LOGE("Generated heightfields must be square with a size of a power of two plus one, not %ux%u.\n", width, depth);
+        return RESULT_ERROR_GENERIC;
+    }
+
+    const auto size = width;
+    samples.assign(static_cast<size_t>(size) * size, 0);
+
+    auto *pSamples = samples.data();
+    auto at = [pSamples, size](uint32_t x, uint32_t z) -> uint16_t & {
+        return pSamples[static_cast<size_t>(z) * size + x];
+    };
+
+    auto amplitude = initialAmplitude;
+    for (auto z : {0u, size - 1})
+    {
+        for (auto x : {0u, size - 1})
+            at(x, z) = toSample(32768.f + getRandom(x, z, seed) * amplitude);
+    }
+
+    // Every level halves the step. Within a step the samples only read samples
+    // of earlier steps, so the rows can be written in parallel.
+    for (auto step = size - 1; step > 1; step /= 2)
+    {
+        const auto half = step / 2;
+
+        // Diamond step: the centre of every square from its four corners.
+        const auto cellCount = (size - 1) / step;
+        jobSystem.parallelFor(cellCount, std::max(1u, generationGrainSamples / cellCount), [&](uint32_t begin, uint32_t end) {
+            for (auto cellZ = begin; cellZ < end; cellZ++)
+            {
+                auto z = cellZ * step + half;
+                for (auto x = half; x < size; x += step)
+                {
+                    auto average = (at(x - half, z - half) + at(x + half, z - half) +
+                                    at(x - half, z + half) + at(x + half, z + half)) * 0.25f;
+                    at(x, z) = toSample(average + getRandom(x, z, seed) * amplitude);
+                }
+            }
+        });
+
+        // Square step: the middle of every edge from the corners and centres
+        // around it, fewer at the border.
+        const auto rowCount = (size - 1) / half + 1;
+        jobSystem.parallelFor(rowCount, std::max(1u, 2 * generationGrainSamples / rowCount), [&](uint32_t begin, uint32_t end) {
+            for (auto row = begin; row < end; row++)
+            {
+                auto z = row * half;
+                for (auto x = (row % 2) ? 0 : half; x < size; x += step)
+                {
+                    float sum = 0.f;
+                    uint32_t count = 0;
+                    if (x >= half)
+                    {
+                        sum += at(x - half, z);
+                        count++;
+                    }
+                    if (x + half < size)
+                    {
+                        sum += at(x + half, z);
+                        count++;
+                    }
+                    if (z >= half)
+                    {
+                        sum += at(x, z - half);
+                        count++;
+                    }
+                    if (z + half < size)
+                    {
+                        sum += at(x, z + half);
+                        count++;
+                    }
+                    at(x, z) = toSample(sum / count + getRandom(x, z, seed) * amplitude);
+                }
+            }
+        });
+
+        amplitude *= roughness;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+} // namespace Tobi
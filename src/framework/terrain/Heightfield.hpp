@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "framework/Common.hpp"
+
+namespace Tobi
+{
+class JobSystem;
+
+/// @brief A grid of 16-bit height samples, width samples along x and depth
+/// samples along z. Sample (x, z) lies at (x * spacing, z * spacing) in world
+/// space, a sample of 65535 at heightScale.
+class Heightfield
+{
+  public:
+    Heightfield(uint32_t width, uint32_t depth, float spacing, float heightScale);
+    Heightfield(const Heightfield &) = delete;
+    Heightfield(Heightfield &&) = delete;
+    Heightfield &operator=(const Heightfield &) & = delete;
+    Heightfield &operator=(Heightfield &&) & = delete;
+    ~Heightfield() = default;
+
+    /// @brief Reads width * depth samples, row by row along x, from a raw file
+    /// of unsigned 16-bit values in the byte order of the host.
+    Result loadRaw(const char *pPath);
+
+    /// @brief Fills the samples with fractal terrain using the diamond-square
+    /// algorithm, one level at a time with the rows spread over the jobs.
+    /// Width and depth must be equal and one more than a power of two.
+    /// @param roughness Factor by which the displacement shrinks per level, in (0, 1).
+    Result generate(uint32_t seed, float roughness, JobSystem &jobSystem);
+
+    /// @brief The sample at (x, z), coordinates outside are clamped to the edge.
+    uint16_t getSample(int32_t x, int32_t z) const
+    {
+        x = std::min(std::max(x, 0), static_cast<int32_t>(width) - 1);
+        z = std::min(std::max(z, 0), static_cast<int32_t>(depth) - 1);
+        return samples[static_cast<size_t>(z) * width + x];
+    }
+
+    /// @brief World space height of a sample.
+    float getHeight(int32_t x, int32_t z) const { return getSample(x, z) * heightScale / 65535.f; }
+
+    uint32_t getWidth() const { return width; }
+    uint32_t getDepth() const { return depth; }
+    float getSpacing() const { return spacing; }
+    float getHeightScale() const { return heightScale; }
+
+  private:
+    uint32_t width;
+    uint32_t depth;
+    float spacing;
+    float heightScale;
+
+    std::vector<uint16_t> samples;
+};
+
+} // namespace Tobi
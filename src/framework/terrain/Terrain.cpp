@@ -0,0 +1,581 @@
+#include "Terrain.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "../UploadScheduler.hpp"
+#include "../buffers/IndexBufferManager.hpp"
+#include "../buffers/VertexBufferManager.hpp"
+#include "../culling/Frustum.hpp"
+#include "../jobs/JobSystem.hpp"
+#include "../../platform/AssetManager.hpp"
+
+namespace Tobi
+{
+
+const uint32_t Terrain::chunkQuads;
+const uint32_t Terrain::chunkSamples;
+const uint32_t Terrain::lodCount;
+const uint32_t Terrain::defaultMaxResidentChunks;
+const uint32_t Terrain::occluderQuads;
+const uint32_t Terrain::occluderSamples;
+const uint32_t Terrain::maxOccluderChunks;
+
+// The grid of a chunk, followed by one row of skirt vertices per edge.
+static const uint32_t skirtFirstVertex = Terrain::chunkSamples * Terrain::chunkSamples;
+static const uint32_t chunkVertexCount = skirtFirstVertex + 4 * Terrain::chunkSamples;
+
+// An occluder cell covers one quad of the coarsest level of detail, every
+// level draws the cell from its own samples only.
+static const uint32_t occluderStep = Terrain::chunkQuads / Terrain::occluderQuads;
+static const uint32_t occluderVertexCount = Terrain::occluderSamples * Terrain::occluderSamples;
+
+// Blocks of this many chunks squared are culled before their chunks.
+static const uint32_t blockChunks = 8;
+
+// Chunks closer than this many chunk widths are drawn with every sample, each
+// further doubling of the distance drops a level of detail.
+static const float lodDistanceChunks = 1.f;
+
+// Limits of the streaming, the uploads of one frame are built in parallel.
+static const uint32_t maxUploadsPerFrame = 32;
+static const uint32_t maxPendingUploads = 128;
+
+// Vertex of the grid at step t along one of the chunk edges, in the order of
+// the skirt rows: near and far row, then left and right column.
+static uint32_t getEdgeVertex(uint32_t edge, uint32_t t)
+{
+    switch (edge)
+    {
+    case 0:
+        return t;
+    case 1:
+        return Terrain::chunkQuads * Terrain::chunkSamples + t;
+    case 2:
+        return t * Terrain::chunkSamples;
+    default:
+        return t * Terrain::chunkSamples + Terrain::chunkQuads;
+    }
+}
+
+// Level of detail of a chunk at a distance from the camera.
+static uint32_t getLod(float distance, float lodBaseDistance)
+{
+    uint32_t lod = 0;
+    auto lodDistance = lodBaseDistance;
+    while (lod + 1 < Terrain::lodCount && distance > lodDistance)
+    {
+        lod++;
+        lodDistance *= 2.f;
+    }
+    return lod;
+}
+
+Terrain::Terrain(std::unique_ptr<Heightfield> heightfield,
+                 const glm::vec3 &origin,
+                 std::shared_ptr<VertexBufferManager> vertexBufferManager,
+                 std::shared_ptr<IndexBufferManager> indexBufferManager,
+                 std::shared_ptr<UploadScheduler> uploadScheduler,
+                 std::shared_ptr<JobSystem> jobSystem,
+                 uint32_t maxResidentChunks)
+    : heightfield(std::move(heightfield)),
+      origin(origin),
+      vertexBufferManager(vertexBufferManager),
+      indexBufferManager(indexBufferManager),
+      uploadScheduler(uploadScheduler),
+      jobSystem(jobSystem),
+      maxResidentChunks(maxResidentChunks),
+      chunkCountX(0),
+      chunkCountZ(0),
+      chunks(std::vector<Chunk>()),
+      blockCountX(0),
+      blockCountZ(0),
+      blocks(std::vector<Block>()),
+      indexBufferId(0),
+      chunkDataBufferId(0),
+      lodFirstIndex(),
+      lodIndexCount(),
+      residentChunks(std::vector<uint32_t>()),
+      pendingUploads(std::vector<PendingUpload>()),
+      loadRequests(std::vector<ChunkDistance>()),
+      draws(std::vector<Draw>()),
+      occluderHeights(std::vector<uint16_t>()),
+      occluderIndices(std::vector<uint32_t>()),
+      occluderVertices(std::vector<Vertex>(maxOccluderChunks * occluderVertexCount)),
+      drawnChunks(std::vector<ChunkDistance>()),
+      occluders(std::vector<OccluderMesh>()),
+      frameCounter(0),
+      visibleChunkCount(0)
+{
+    LOGI("CONSTRUCTING Terrain\n");
+
+    auto startTime = OS::getCurrentTime();
+
+    computeBounds();
+    createIndexBuffer();
+    createChunkDataBuffer();
+    createOccluderIndices();
+
+    LOGI("Terrain of %ux%u samples in %ux%u chunks, prepared in %.2f ms.\n",
+         this->heightfield->getWidth(),
+         this->heightfield->getDepth(),
+         chunkCountX,
+         chunkCountZ,
+         (OS::getCurrentTime() - startTime) * 1000.0);
+}
+
+Terrain::~Terrain()
+{
+    LOGI("DECONSTRUCTING Terrain\n");
+
+    for (const auto &upload : pendingUploads)
+        uploadScheduler->cancel(vertexBufferManager->getBuffer(chunks[upload.chunk].bufferId).buffer);
+
+    for (auto chunk : residentChunks)
+        vertexBufferManager->destroyBuffer(chunks[chunk].bufferId);
+
+    indexBufferManager->destroyBuffer(indexBufferId);
+    vertexBufferManager->destroyBuffer(chunkDataBufferId);
+}
+
+VkBuffer Terrain::getIndexBuffer() const
+{
+    return indexBufferManager->getBuffer(indexBufferId).buffer;
+}
+
+VkBuffer Terrain::getChunkDataBuffer() const
+{
+    return vertexBufferManager->getBuffer(chunkDataBufferId).buffer;
+}
+
+void Terrain::computeBounds()
+{
+    chunkCountX = std::max(1u, (heightfield->getWidth() - 1 + chunkQuads - 1) / chunkQuads);
+    chunkCountZ = std::max(1u, (heightfield->getDepth() - 1 + chunkQuads - 1) / chunkQuads);
+    chunks.assign(chunkCountX * chunkCountZ, Chunk{});
+    occluderHeights.resize(chunks.size() * occluderVertexCount);
+
+    const auto spacing = heightfield->getSpacing();
+    const auto sampleScale = heightfield->getHeightScale() / 65535.f;
+
+    jobSystem->parallelFor(chunkCountZ, 1, [&](uint32_t begin, uint32_t end) {
+        for (auto chunkZ = begin; chunkZ < end; chunkZ++)
+        {
+            for (uint32_t chunkX = 0; chunkX < chunkCountX; chunkX++)
+            {
+                auto firstX = static_cast<int32_t>(chunkX * chunkQuads);
+                auto firstZ = static_cast<int32_t>(chunkZ * chunkQuads);
+
+                // Lowest sample of every occluder cell, the samples on a border
+                // belong to both cells.
+                uint16_t cellMinSamples[occluderQuads * occluderQuads];
+                uint16_t minSample = 0xffff;
+                uint16_t maxSample = 0;
+                for (uint32_t cellZ = 0; cellZ < occluderQuads; cellZ++)
+                {
+                    for (uint32_t cellX = 0; cellX < occluderQuads; cellX++)
+                    {
+                        auto cellFirstX = firstX + static_cast<int32_t>(cellX * occluderStep);
+                        auto cellFirstZ = firstZ + static_cast<int32_t>(cellZ * occluderStep);
+                        uint16_t cellMinSample = 0xffff;
+                        for (int32_t z = 0; z <= static_cast<int32_t>(occluderStep); z++)
+                        {
+                            for (int32_t x = 0; x <= static_cast<int32_t>(occluderStep); x++)
+                            {
+                                auto sample = heightfield->getSample(cellFirstX + x, cellFirstZ + z);
+                                cellMinSample = std::min(cellMinSample, sample);
+                                maxSample = std::max(maxSample, sample);
+                            }
+                        }
+                        cellMinSamples[cellZ * occluderQuads + cellX] = cellMinSample;
+                        minSample = std::min(minSample, cellMinSample);
+                    }
+                }
+
+                // An occluder vertex takes the lowest sample of the cells around it,
+                // so every occluder triangle stays below the samples of its cell.
+                auto *pOccluderHeights = &occluderHeights[(chunkZ * chunkCountX + chunkX) * occluderVertexCount];
+                for (uint32_t z = 0; z < occluderSamples; z++)
+                {
+                    for (uint32_t x = 0; x < occluderSamples; x++)
+                    {
+                        uint16_t height = 0xffff;
+                        for (auto cellZ = z > 0 ? z - 1 : 0; cellZ <= std::min(z, occluderQuads - 1); cellZ++)
+                        {
+                            for (auto cellX = x > 0 ? x - 1 : 0; cellX <= std::min(x, occluderQuads - 1); cellX++)
+                                height = std::min(height, cellMinSamples[cellZ * occluderQuads + cellX]);
+                        }
+                        pOccluderHeights[z * occluderSamples + x] = height;
+                    }
+                }
+
+                // The skirts hang below the lowest sample by the height range of
+                // the chunk, which is as deep as a crack to a neighbour can get.
+                auto minHeight = origin.y + minSample * sampleScale;
+                auto maxHeight = origin.y + maxSample * sampleScale;
+                auto skirtDepth = maxHeight - minHeight + spacing;
+
+                auto &chunk = chunks[chunkZ * chunkCountX + chunkX];
+                chunk.boundsMin = glm::vec3(origin.x + firstX * spacing, minHeight - skirtDepth, origin.z + firstZ * spacing);
+                chunk.boundsMax = glm::vec3(origin.x + (firstX + chunkQuads) * spacing, maxHeight, origin.z + (firstZ + chunkQuads) * spacing);
+                chunk.minSample = minSample;
+                chunk.maxSample = maxSample;
+            }
+        }
+    });
+
+    blockCountX = (chunkCountX + blockChunks - 1) / blockChunks;
+    blockCountZ = (chunkCountZ + blockChunks - 1) / blockChunks;
+    blocks.assign(blockCountX * blockCountZ, {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)});
+    for (uint32_t chunkZ = 0; chunkZ < chunkCountZ; chunkZ++)
+    {
+        for (uint32_t chunkX = 0; chunkX < chunkCountX; chunkX++)
+        {
+            const auto &chunk = chunks[chunkZ * chunkCountX + chunkX];
+            auto &block = blocks[(chunkZ / blockChunks) * blockCountX + chunkX / blockChunks];
+            block.boundsMin = glm::min(block.boundsMin, chunk.boundsMin);
+            block.boundsMax = glm::max(block.boundsMax, chunk.boundsMax);
+        }
+    }
+}
+
+void Terrain::createIndexBuffer()
+{
+    std::vector<uint32_t> indices;
+    for (uint32_t lod = 0; lod < lodCount; lod++)
+    {
+        const auto step = 1u << lod;
+        lodFirstIndex[lod] = static_cast<uint32_t>(indices.size());
+
+        for (uint32_t z = 0; z < chunkQuads; z += step)
+        {
+            for (uint32_t x = 0; x < chunkQuads; x += step)
+            {
+                auto i0 = z * chunkSamples + x;
+                auto i1 = i0 + step;
+                auto i2 = i0 + step * chunkSamples;
+                auto i3 = i2 + step;
+                indices.insert(indices.end(), {i0, i2, i1, i1, i2, i3});
+            }
+        }
+
+        // A skirt quad hangs from every edge segment of the level.
+        for (uint32_t edge = 0; edge < 4; edge++)
+        {
+            for (uint32_t t = 0; t < chunkQuads; t += step)
+            {
+                auto top0 = getEdgeVertex(edge, t);
+                auto top1 = getEdgeVertex(edge, t + step);
+                auto bottom0 = skirtFirstVertex + edge * chunkSamples + t;
+                auto bottom1 = bottom0 + step;
+                indices.insert(indices.end(), {top0, bottom0, top1, top1, bottom0, bottom1});
+            }
+        }
+
+        lodIndexCount[lod] = static_cast<uint32_t>(indices.size()) - lodFirstIndex[lod];
+    }
+
+    indexBufferId = indexBufferManager->createBuffer(indices.data(),
+                                                     static_cast<uint32_t>(indices.size() * sizeof(uint32_t)));
+}
+
+void Terrain::createChunkDataBuffer()
+{
+    const auto spacing = heightfield->getSpacing();
+    const auto sampleScale = heightfield->getHeightScale() / 65535.f;
+
+    std::vector<TerrainChunkData> chunkData(chunks.size());
+    for (uint32_t i = 0; i < chunks.size(); i++)
+    {
+        const auto &chunk = chunks[i];
+        auto minHeight = origin.y + chunk.minSample * sampleScale;
+        auto heightRange = (chunk.maxSample - chunk.minSample) * sampleScale;
+
+        chunkData[i].origin = glm::vec4(chunk.boundsMin.x, chunk.boundsMin.z, minHeight, heightRange);
+        chunkData[i].scale = glm::vec4(spacing, minHeight - chunk.boundsMin.y, heightfield->getHeightScale(), origin.y);
+    }
+
+    chunkDataBufferId = vertexBufferManager->createBuffer(chunkData.data(),
+                                                          static_cast<uint32_t>(chunkData.size() * sizeof(TerrainChunkData)));
+}
+
+void Terrain::createOccluderIndices()
+{
+    occluderIndices.clear();
+    for (uint32_t z = 0; z < occluderQuads; z++)
+    {
+        for (uint32_t x = 0; x < occluderQuads; x++)
+        {
+            auto i0 = z * occluderSamples + x;
+            auto i1 = i0 + 1;
+            auto i2 = i0 + occluderSamples;
+            auto i3 = i2 + 1;
+            occluderIndices.insert(occluderIndices.end(), {i0, i2, i1, i1, i2, i3});
+        }
+    }
+}
+
+void Terrain::buildVertices(uint32_t chunkIndex, std::vector<TerrainVertex> &vertices) const
+{
+    const auto &chunk = chunks[chunkIndex];
+    auto firstX = static_cast<int32_t>((chunkIndex % chunkCountX) * chunkQuads);
+    auto firstZ = static_cast<int32_t>((chunkIndex / chunkCountX) * chunkQuads);
+
+    // Heights are stretched over the range of the chunk to keep their precision.
+    auto sampleRange = chunk.maxSample - chunk.minSample;
+    auto toHeight = sampleRange > 0 ? 65535.f / sampleRange : 0.f;
+    auto sampleScale = heightfield->getHeightScale() / 65535.f;
+    auto spacing = heightfield->getSpacing();
+
+    vertices.resize(chunkVertexCount);
+    for (int32_t z = 0; z < static_cast<int32_t>(chunkSamples); z++)
+    {
+        for (int32_t x = 0; x < static_cast<int32_t>(chunkSamples); x++)
+        {
+            auto sampleX = firstX + x;
+            auto sampleZ = firstZ + z;
+            auto &vertex = vertices[z * chunkSamples + x];
+            vertex.height = static_cast<uint16_t>((heightfield->getSample(sampleX, sampleZ) - chunk.minSample) * toHeight + 0.5f);
+
+            // Central differences over the whole heightfield, so neighbouring
+            // chunks agree on the normals of their shared edge.
+            auto dx = (heightfield->getSample(sampleX + 1, sampleZ) - heightfield->getSample(sampleX - 1, sampleZ)) * sampleScale;
+            auto dz = (heightfield->getSample(sampleX, sampleZ + 1) - heightfield->getSample(sampleX, sampleZ - 1)) * sampleScale;
+            auto normal = glm::normalize(glm::vec3(-dx, 2.f * spacing, -dz));
+            vertex.normalX = static_cast<int8_t>(std::round(normal.x * 127.f));
+            vertex.normalZ = static_cast<int8_t>(std::round(normal.z * 127.f));
+        }
+    }
+
+    // The skirts repeat the edges, the shader lowers them.
+    for (uint32_t edge = 0; edge < 4; edge++)
+    {
+        for (uint32_t t = 0; t < chunkSamples; t++)
+            vertices[skirtFirstVertex + edge * chunkSamples + t] = vertices[getEdgeVertex(edge, t)];
+    }
+}
+
+void Terrain::update(const glm::mat4 &viewProjectionMatrix,
+                     const glm::vec3 &cameraPosition,
+                     bool withOccluders,
+                     std::vector<uint32_t> &releasedBufferIds)
+{
+    frameCounter++;
+    draws.clear();
+    loadRequests.clear();
+    drawnChunks.clear();
+    occluders.clear();
+    visibleChunkCount = 0;
+
+    // Finished uploads no longer need their vertices.
+    pendingUploads.erase(std::remove_if(pendingUploads.begin(),
+                                        pendingUploads.end(),
+                                        [this](const PendingUpload &upload) {
+                                            return uploadScheduler->isComplete(chunks[upload.chunk].uploadTicket);
+                                        }),
+                         pendingUploads.end());
+
+    Frustum frustum(viewProjectionMatrix);
+    const auto lodBaseDistance = chunkQuads * heightfield->getSpacing() * lodDistanceChunks;
+
+    for (uint32_t blockZ = 0; blockZ < blockCountZ; blockZ++)
+    {
+        for (uint32_t blockX = 0; blockX < blockCountX; blockX++)
+        {
+            const auto &block = blocks[blockZ * blockCountX + blockX];
+            if (!frustum.intersectsBox(block.boundsMin, block.boundsMax))
+                continue;
+
+            auto lastChunkZ = std::min((blockZ + 1) * blockChunks, chunkCountZ);
+            auto lastChunkX = std::min((blockX + 1) * blockChunks, chunkCountX);
+            for (auto chunkZ = blockZ * blockChunks; chunkZ < lastChunkZ; chunkZ++)
+            {
+                for (auto chunkX = blockX * blockChunks; chunkX < lastChunkX; chunkX++)
+                {
+                    auto chunkIndex = chunkZ * chunkCountX + chunkX;
+                    auto &chunk = chunks[chunkIndex];
+                    if (!frustum.intersectsBox(chunk.boundsMin, chunk.boundsMax))
+                        continue;
+
+                    visibleChunkCount++;
+                    chunk.lastVisibleFrame = frameCounter;
+
+                    auto closest = glm::clamp(cameraPosition, chunk.boundsMin, chunk.boundsMax);
+                    auto distance = glm::length(closest - cameraPosition);
+
+                    if (chunk.bufferId == 0)
+                    {
+                        loadRequests.push_back({distance, chunkIndex});
+                        continue;
+                    }
+
+                    if (!uploadScheduler->isComplete(chunk.uploadTicket))
+                        continue;
+
+                    auto lod = getLod(distance, lodBaseDistance);
+                    auto clip = viewProjectionMatrix * glm::vec4((chunk.boundsMin + chunk.boundsMax) * 0.5f, 1.f);
+                    auto depth = clip.w > 0.f ? clip.z / clip.w : 0.f;
+
+                    Draw draw = {};
+                    draw.vertexBuffer = vertexBufferManager->getBuffer(chunk.bufferId).buffer;
+                    draw.chunk = chunkIndex;
+                    draw.firstIndex = lodFirstIndex[lod];
+                    draw.indexCount = lodIndexCount[lod];
+                    draw.depth = depth;
+                    draws.push_back(draw);
+                    drawnChunks.push_back({distance, chunkIndex});
+                }
+            }
+        }
+    }
+
+    if (withOccluders)
+        buildOccluders(viewProjectionMatrix, cameraPosition);
+    streamChunks(releasedBufferIds);
+}
+
+void Terrain::buildOccluders(const glm::mat4 &viewProjectionMatrix, const glm::vec3 &cameraPosition)
+{
+    const auto spacing = heightfield->getSpacing();
+    const auto sampleScale = heightfield->getHeightScale() / 65535.f;
+
+    // The occluders only stay behind the drawn surface for a camera above it.
+    // Outside of the terrain a view ray can also enter it from the side.
+    auto cameraX = (cameraPosition.x - origin.x) / spacing;
+    auto cameraZ = (cameraPosition.z - origin.z) / spacing;
+    if (!(cameraX >= 0.f && cameraZ >= 0.f &&
+          cameraX <= heightfield->getWidth() - 1 && cameraZ <= heightfield->getDepth() - 1))
+        return;
+
+    // The chunk below the camera interpolates the samples of one quad of its
+    // level of detail there, the surface is never above the highest of them.
+    auto cameraSampleX = std::min(static_cast<uint32_t>(cameraX), heightfield->getWidth() - 2);
+    auto cameraSampleZ = std::min(static_cast<uint32_t>(cameraZ), heightfield->getDepth() - 2);
+    const auto &cameraChunk = chunks[(cameraSampleZ / chunkQuads) * chunkCountX + cameraSampleX / chunkQuads];
+    auto closest = glm::clamp(cameraPosition, cameraChunk.boundsMin, cameraChunk.boundsMax);
+    auto step = 1u << getLod(glm::length(closest - cameraPosition), chunkQuads * spacing * lodDistanceChunks);
+    auto quadFirstX = static_cast<int32_t>(cameraSampleX / step * step);
+    auto quadFirstZ = static_cast<int32_t>(cameraSampleZ / step * step);
+    uint16_t maxSample = 0;
+    for (int32_t z = 0; z <= static_cast<int32_t>(step); z++)
+    {
+        for (int32_t x = 0; x <= static_cast<int32_t>(step); x++)
+            maxSample = std::max(maxSample, heightfield->getSample(quadFirstX + x, quadFirstZ + z));
+    }
+    if (cameraPosition.y <= origin.y + maxSample * sampleScale)
+        return;
+
+    auto occluderCount = std::min<size_t>(drawnChunks.size(), maxOccluderChunks);
+    std::partial_sort(drawnChunks.begin(),
+                      drawnChunks.begin() + occluderCount,
+                      drawnChunks.end(),
+                      [](const ChunkDistance &a, const ChunkDistance &b) { return a.distance < b.distance; });
+
+    for (size_t i = 0; i < occluderCount; i++)
+    {
+        auto chunkIndex = drawnChunks[i].chunk;
+        auto firstX = (chunkIndex % chunkCountX) * chunkQuads;
+        auto firstZ = (chunkIndex / chunkCountX) * chunkQuads;
+        const auto *pHeights = &occluderHeights[chunkIndex * occluderVertexCount];
+        auto *pVertices = &occluderVertices[i * occluderVertexCount];
+
+        for (uint32_t z = 0; z < occluderSamples; z++)
+        {
+            for (uint32_t x = 0; x < occluderSamples; x++)
+            {
+                pVertices[z * occluderSamples + x].position = glm::vec3(origin.x + (firstX + x * occluderStep) * spacing,
+                                                                        origin.y + pHeights[z * occluderSamples + x] * sampleScale,
+                                                                        origin.z + (firstZ + z * occluderStep) * spacing);
+            }
+        }
+
+        OccluderMesh occluder;
+        occluder.modelViewProjectionMatrix = viewProjectionMatrix;
+        occluder.vertices = pVertices;
+        occluder.vertexCount = occluderVertexCount;
+        occluder.indices = occluderIndices.data();
+        occluder.indexCount = static_cast<uint32_t>(occluderIndices.size());
+        occluders.push_back(occluder);
+    }
+}
+
+void Terrain::streamChunks(std::vector<uint32_t> &releasedBufferIds)
+{
+    // Nearest first, the rest is requested again in later frames.
+    std::sort(loadRequests.begin(), loadRequests.end(), [](const ChunkDistance &a, const ChunkDistance &b) {
+        return a.distance < b.distance;
+    });
+
+    auto uploadBudget = pendingUploads.size() < maxPendingUploads
+                            ? std::min<size_t>(maxUploadsPerFrame, maxPendingUploads - pendingUploads.size())
+                            : 0;
+    if (loadRequests.size() > uploadBudget)
+        loadRequests.resize(uploadBudget);
+
+    if (loadRequests.empty())
+        return;
+
+    // Evict the least recently visible chunks. Chunks visible this frame and
+    // chunks still being uploaded stay.
+    auto freeCount = residentChunks.size() < maxResidentChunks ? maxResidentChunks - residentChunks.size() : 0;
+    if (loadRequests.size() > freeCount)
+    {
+        auto evictCount = loadRequests.size() - freeCount;
+        std::sort(residentChunks.begin(), residentChunks.end(), [this](uint32_t a, uint32_t b) {
+            return chunks[a].lastVisibleFrame < chunks[b].lastVisibleFrame;
+        });
+
+        size_t keptCount = 0;
+        for (auto chunkIndex : residentChunks)
+        {
+            auto &chunk = chunks[chunkIndex];
+            if (evictCount > 0 && chunk.lastVisibleFrame != frameCounter && uploadScheduler->isComplete(chunk.uploadTicket))
+            {
+                releasedBufferIds.push_back(chunk.bufferId);
+                chunk.bufferId = 0;
+                evictCount--;
+            }
+            else
+            {
+                residentChunks[keptCount++] = chunkIndex;
+            }
+        }
+        residentChunks.resize(keptCount);
+
+        // More chunks are visible than can be resident, the furthest are not drawn.
+        loadRequests.resize(loadRequests.size() - evictCount);
+    }
+
+    // Moving the pending uploads keeps the storage of their vertices, which the
+    // upload scheduler reads.
+    auto firstUpload = pendingUploads.size();
+    auto uploadCount = static_cast<uint32_t>(loadRequests.size());
+    pendingUploads.resize(firstUpload + uploadCount);
+    jobSystem->parallelFor(uploadCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (auto i = begin; i < end; i++)
+        {
+            auto &upload = pendingUploads[firstUpload + i];
+            upload.chunk = loadRequests[i].chunk;
+            buildVertices(upload.chunk, upload.vertices);
+        }
+    });
+
+    // The buffer managers are not thread safe.
+    for (auto i = firstUpload; i < pendingUploads.size(); i++)
+    {
+        const auto &upload = pendingUploads[i];
+        auto &chunk = chunks[upload.chunk];
+        auto size = static_cast<uint32_t>(upload.vertices.size() * sizeof(TerrainVertex));
+
+        chunk.bufferId = vertexBufferManager->createDeviceLocalBuffer(size);
+        chunk.uploadTicket = uploadScheduler->enqueue(vertexBufferManager->getBuffer(chunk.bufferId).buffer,
+                                                      upload.vertices.data(),
+                                                      size,
+                                                      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                                      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        residentChunks.push_back(upload.chunk);
+    }
+}
+
+} // namespace Tobi
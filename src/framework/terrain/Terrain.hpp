@@ -0,0 +1,194 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "framework/Common.hpp"
+#include "../VkCommon.hpp"
+#include "../culling/DepthRasterizer.hpp"
+#include "Heightfield.hpp"
+#include "TerrainVertex.hpp"
+
+namespace Tobi
+{
+class VertexBufferManager;
+class IndexBufferManager;
+class UploadScheduler;
+class JobSystem;
+
+/// @brief Draws a heightfield split into chunks of chunkQuads x chunkQuads quads.
+///
+/// All chunks share one index buffer holding a grid per level of detail, each
+/// coarser level skipping every other sample. A chunk's vertex buffer holds its
+/// samples as @ref TerrainVertex, the shader derives x and z from the vertex
+/// index and reads the chunk's placement from the chunk data buffer at
+/// instance rate. Skirts hanging from the chunk edges hide the cracks between
+/// neighbours drawn with different levels.
+///
+/// Only chunks which were seen recently are resident. Visible chunks are
+/// streamed through the upload scheduler, nearest first and a few per frame,
+/// and the least recently visible chunks are evicted to make room.
+///
+/// The nearest drawn chunks are also handed to the CPU occlusion culler as
+/// coarse occluders. Every vertex of an occluder takes the lowest
+/// sample around it, so the occluder stays below the drawn surface and never
+/// hides anything the terrain does not.
+class Terrain
+{
+  public:
+    static const uint32_t chunkQuads = 64;
+    static const uint32_t chunkSamples = chunkQuads + 1;
+    static const uint32_t lodCount = 5;
+    static const uint32_t defaultMaxResidentChunks = 1024;
+    /// The occluder grid has a vertex per quad of the coarsest level of detail.
+    static const uint32_t occluderQuads = chunkQuads >> (lodCount - 1);
+    static const uint32_t occluderSamples = occluderQuads + 1;
+    static const uint32_t maxOccluderChunks = 128;
+
+    /// @brief A visible chunk which is resident.
+    struct Draw
+    {
+        VkBuffer vertexBuffer;
+        /// Index into the chunk data buffer, drawn as firstInstance.
+        uint32_t chunk;
+        /// Range of the level of detail in the shared index buffer.
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        /// Depth of the chunk centre in [0, 1].
+        float depth;
+    };
+
+    /// @brief Splits the heightfield into chunks and creates the shared buffers.
+    /// Samples past the edge of a heightfield which is not a whole number of
+    /// chunks repeat the last sample.
+    /// @param origin World position of sample (0, 0) at a sample value of 0.
+    Terrain(std::unique_ptr<Heightfield> heightfield,
+            const glm::vec3 &origin,
+            std::shared_ptr<VertexBufferManager> vertexBufferManager,
+            std::shared_ptr<IndexBufferManager> indexBufferManager,
+            std::shared_ptr<UploadScheduler> uploadScheduler,
+            std::shared_ptr<JobSystem> jobSystem,
+            uint32_t maxResidentChunks = defaultMaxResidentChunks);
+    Terrain(const Terrain &) = delete;
+    Terrain(Terrain &&) = delete;
+    Terrain &operator=(const Terrain &) & = delete;
+    Terrain &operator=(Terrain &&) & = delete;
+
+    /// @brief Destructor. The GPU must be idle.
+    ~Terrain();
+
+    /// @brief Culls the chunks against the camera, picks their levels of detail
+    /// and queues the uploads of visible chunks which are not resident.
+    /// @param withOccluders Fills @ref getOccluders, left empty otherwise.
+    /// @param[out] releasedBufferIds Vertex buffers of evicted chunks are added,
+    /// the caller destroys them once the frames in flight are done with them.
+    void update(const glm::mat4 &viewProjectionMatrix,
+                const glm::vec3 &cameraPosition,
+                bool withOccluders,
+                std::vector<uint32_t> &releasedBufferIds);
+
+    /// @brief The chunks to draw this frame, filled by @ref update.
+    const std::vector<Draw> &getDraws() const { return draws; }
+
+    /// @brief Occluders of the nearest chunks drawn this frame, filled by @ref
+    /// update. Empty while the camera is below the terrain or outside of it.
+    const std::vector<OccluderMesh> &getOccluders() const { return occluders; }
+
+    VkBuffer getIndexBuffer() const;
+    VkBuffer getChunkDataBuffer() const;
+
+    uint32_t getChunkCount() const { return static_cast<uint32_t>(chunks.size()); }
+    /// @brief Chunks inside the frustum this frame, including those still streaming in.
+    uint32_t getVisibleChunkCount() const { return visibleChunkCount; }
+    uint32_t getResidentChunkCount() const { return static_cast<uint32_t>(residentChunks.size()); }
+
+  private:
+    struct Chunk
+    {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        uint16_t minSample;
+        uint16_t maxSample;
+        // 0 while the chunk is not resident.
+        uint32_t bufferId;
+        uint64_t uploadTicket;
+        // Frame in which the chunk was last inside the frustum.
+        uint64_t lastVisibleFrame;
+    };
+
+    /// @brief Bounds of a square group of chunks, culled before its chunks.
+    struct Block
+    {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    struct ChunkDistance
+    {
+        float distance;
+        uint32_t chunk;
+    };
+
+    struct PendingUpload
+    {
+        uint32_t chunk;
+        // Read by the upload scheduler until the upload is complete.
+        std::vector<TerrainVertex> vertices;
+    };
+
+    std::unique_ptr<Heightfield> heightfield;
+    glm::vec3 origin;
+    std::shared_ptr<VertexBufferManager> vertexBufferManager;
+    std::shared_ptr<IndexBufferManager> indexBufferManager;
+    std::shared_ptr<UploadScheduler> uploadScheduler;
+    std::shared_ptr<JobSystem> jobSystem;
+
+    uint32_t maxResidentChunks;
+
+    uint32_t chunkCountX;
+    uint32_t chunkCountZ;
+    std::vector<Chunk> chunks;
+    uint32_t blockCountX;
+    uint32_t blockCountZ;
+    std::vector<Block> blocks;
+
+    uint32_t indexBufferId;
+    uint32_t chunkDataBufferId;
+    // First index and index count of every level of detail.
+    uint32_t lodFirstIndex[lodCount];
+    uint32_t lodIndexCount[lodCount];
+
+    std::vector<uint32_t> residentChunks;
+    std::vector<PendingUpload> pendingUploads;
+    std::vector<ChunkDistance> loadRequests;
+    std::vector<Draw> draws;
+
+    // Lowest sample around every vertex of the occluder grids, occluderSamples
+    // squared per chunk.
+    std::vector<uint16_t> occluderHeights;
+    std::vector<uint32_t> occluderIndices;
+    // Room for maxOccluderChunks grids, so the meshes can point into it.
+    std::vector<Vertex> occluderVertices;
+    std::vector<ChunkDistance> drawnChunks;
+    std::vector<OccluderMesh> occluders;
+    uint64_t frameCounter;
+    uint32_t visibleChunkCount;
+
+    void computeBounds();
+    void createIndexBuffer();
+    void createChunkDataBuffer();
+    void createOccluderIndices();
+
+    /// @brief Evicts chunks to make room and queues the uploads of the nearest load requests.
+    void streamChunks(std::vector<uint32_t> &releasedBufferIds);
+
+    /// @brief Fills the vertices of a chunk from the heightfield, safe to call from several threads.
+    void buildVertices(uint32_t chunk, std::vector<TerrainVertex> &vertices) const;
+
+    /// @brief Fills the occluders from the nearest drawn chunks.
+    void buildOccluders(const glm::mat4 &viewProjectionMatrix, const glm::vec3 &cameraPosition);
+};
+
+} // namespace Tobi
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+namespace Tobi
+{
+
+/// @brief One sample of a terrain chunk. The position in the chunk follows from
+/// the vertex index, so only the height and the normal are stored.
+struct TerrainVertex
+{
+    /// Height within the range of the chunk, read as R16_UNORM.
+    uint16_t height;
+    /// x and z of the unit normal, read as R8G8_SNORM. y is positive and
+    /// reconstructed in the shader.
+    int8_t normalX;
+    int8_t normalZ;
+};
+
+static_assert(sizeof(TerrainVertex) == 4, "TerrainVertex must stay 4 bytes");
+
+/// @brief Per-chunk values read by the terrain vertex shader at instance rate,
+/// selected with the chunk index as firstInstance.
+struct TerrainChunkData
+{
+    /// x and z of the chunk's first sample, its lowest height and its height range.
+    glm::vec4 origin;
+    /// Distance between samples, depth of the skirts below the edges, and the
+    /// heights spanned by the sample values and of a sample value of 0.
+    glm::vec4 scale;
+};
+
+} // namespace Tobi
@@ -28,6 +28,13 @@ class Camera
         return viewProjectionMatrix;
     }
 
+    const glm::mat4 &getViewMatrix() const { return viewMatrix; }
+
+    /// Includes the flip to Vulkan clip space.
+    glm::mat4 getProjectionMatrix() const { return clipMatrix * projectionMatrix; }
+
+    const glm::vec3 &getPosition() const { return position; }
+
   private:
     void initialize();
 
@@ -17,10 +17,12 @@ class KeyStates : public Dispatcher<KeyPressEvent>::Listener,
 
     virtual void onEvent(KeyPressEvent &event, Dispatcher<KeyPressEvent> &sender)
     {
+        (void)sender;
         keyStates[event.key] = true;
     }
     virtual void onEvent(KeyReleaseEvent &event, Dispatcher<KeyReleaseEvent> &sender)
     {
+        (void)sender;
         keyStates[event.key] = false;
     }
 };
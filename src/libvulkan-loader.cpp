@@ -165,6 +165,10 @@ PFN_vkCmdDebugMarkerInsertEXT vulkanSymbolWrapper_vkCmdDebugMarkerInsertEXT;
 PFN_vkCmdDrawIndirectCountAMD vulkanSymbolWrapper_vkCmdDrawIndirectCountAMD;
 PFN_vkCmdDrawIndexedIndirectCountAMD vulkanSymbolWrapper_vkCmdDrawIndexedIndirectCountAMD;
 PFN_vkGetPhysicalDeviceExternalImageFormatPropertiesNV vulkanSymbolWrapper_vkGetPhysicalDeviceExternalImageFormatPropertiesNV;
+PFN_vkGetPhysicalDeviceFeatures2 vulkanSymbolWrapper_vkGetPhysicalDeviceFeatures2;
+PFN_vkGetPhysicalDeviceProperties2 vulkanSymbolWrapper_vkGetPhysicalDeviceProperties2;
+PFN_vkGetSemaphoreCounterValue vulkanSymbolWrapper_vkGetSemaphoreCounterValue;
+PFN_vkWaitSemaphores vulkanSymbolWrapper_vkWaitSemaphores;
 
 #ifndef _WIN32
 #include <dlfcn.h>
@@ -335,6 +335,14 @@ extern "C"
 #define vkCmdDrawIndexedIndirectCountAMD vulkanSymbolWrapper_vkCmdDrawIndexedIndirectCountAMD
     extern PFN_vkGetPhysicalDeviceExternalImageFormatPropertiesNV vulkanSymbolWrapper_vkGetPhysicalDeviceExternalImageFormatPropertiesNV;
 #define vkGetPhysicalDeviceExternalImageFormatPropertiesNV vulkanSymbolWrapper_vkGetPhysicalDeviceExternalImageFormatPropertiesNV
+    extern PFN_vkGetPhysicalDeviceFeatures2 vulkanSymbolWrapper_vkGetPhysicalDeviceFeatures2;
+#define vkGetPhysicalDeviceFeatures2 vulkanSymbolWrapper_vkGetPhysicalDeviceFeatures2
+    extern PFN_vkGetPhysicalDeviceProperties2 vulkanSymbolWrapper_vkGetPhysicalDeviceProperties2;
+#define vkGetPhysicalDeviceProperties2 vulkanSymbolWrapper_vkGetPhysicalDeviceProperties2
+    extern PFN_vkGetSemaphoreCounterValue vulkanSymbolWrapper_vkGetSemaphoreCounterValue;
+#define vkGetSemaphoreCounterValue vulkanSymbolWrapper_vkGetSemaphoreCounterValue
+    extern PFN_vkWaitSemaphores vulkanSymbolWrapper_vkWaitSemaphores;
+#define vkWaitSemaphores vulkanSymbolWrapper_vkWaitSemaphores
 
 #ifdef __cplusplus
 }
@@ -21,8 +21,11 @@
 #include "AssetManager.hpp"
 
 #include <stdio.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 namespace Tobi
@@ -98,7 +101,7 @@ AssetManager::AssetManager()
 
 Result AssetManager::readBinaryFile(const char *pPath, void **pData, size_t *pSize)
 {
-    auto fullpath = basePath + "/assets/" + pPath;
+    auto fullpath = getAssetPath(pPath);
 
     FILE *file = fopen(fullpath.c_str(), "rb");
     if (!file)
@@ -127,4 +130,83 @@ Result AssetManager::readBinaryFile(const char *pPath, void **pData, size_t *pSi
     return RESULT_SUCCESS;
 }
 
+Result AssetManager::readCacheFile(const char *pPath, std::vector<uint8_t> *pOutput)
+{
+    auto fullpath = getCachePath(pPath);
+
+    FILE *file = fopen(fullpath.c_str(), "rb");
+    if (!file)
+        return RESULT_ERROR_IO;
+
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    rewind(file);
+
+    if (len < 0)
+    {
+        fclose(file);
+        return RESULT_ERROR_IO;
+    }
+
+    pOutput->resize(static_cast<size_t>(len));
+    auto read = fread(pOutput->data(), 1, pOutput->size(), file);
+    fclose(file);
+
+    if (read != pOutput->size())
+    {
+        pOutput->clear();
+        return RESULT_ERROR_IO;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+Result AssetManager::writeCacheFile(const char *pPath, const void *pData, size_t size)
+{
+    auto directory = basePath + "/cache";
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        LOGE("Couldn't create the cache directory %s\n", directory.c_str());
+        return RESULT_ERROR_IO;
+    }
+
+    return writeFile(getCachePath(pPath), pData, size);
+}
+
+Result AssetManager::writeAssetFile(const char *pPath, const void *pData, size_t size)
+{
+    return writeFile(getAssetPath(pPath), pData, size);
+}
+
+Result AssetManager::writeFile(const std::string &fullpath, const void *pData, size_t size)
+{
+    auto temporaryPath = fullpath + ".tmp";
+
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+    {
+        LOGE("Couldn't open %s for writing\n", temporaryPath.c_str());
+        return RESULT_ERROR_IO;
+    }
+
+    auto ok = fwrite(pData, 1, size, file) == size && fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+    if (fclose(file) != 0 || !ok)
+    {
+        LOGE("Failed to write %s\n", temporaryPath.c_str());
+        remove(temporaryPath.c_str());
+        return RESULT_ERROR_IO;
+    }
+
+    // Replacing the file is atomic, readers see either the old or the new contents.
+    if (rename(temporaryPath.c_str(), fullpath.c_str()) != 0)
+    {
+        LOGE("Failed to replace %s\n", fullpath.c_str());
+        remove(temporaryPath.c_str());
+        return RESULT_ERROR_IO;
+    }
+
+    return RESULT_SUCCESS;
+}
+
 } // namespace Tobi
@@ -70,8 +70,41 @@ class AssetManager
     /// @returns Error code
     Result readBinaryFile(const char *pPath, void **ppData, size_t *pSize);
 
+    /// @brief Gets the full path of an asset.
+    /// @param pPath The path of the asset, relative to the assets directory.
+    /// @returns The path to open.
+    std::string getAssetPath(const char *pPath) const { return basePath + "/assets/" + pPath; }
+
+    /// @brief Gets the full path of a file in the cache directory, which holds
+    /// data the application writes itself and can always regenerate.
+    /// @param pPath The path of the file, relative to the cache directory.
+    /// @returns The path to open.
+    std::string getCachePath(const char *pPath) const { return basePath + "/cache/" + pPath; }
+
+    /// @brief Reads a file from the cache directory.
+    /// @param pPath The path of the file, relative to the cache directory.
+    /// @param[out] pOutput The contents of the file.
+    /// @returns RESULT_ERROR_IO if the file does not exist or can't be read.
+    Result readCacheFile(const char *pPath, std::vector<uint8_t> *pOutput);
+
+    /// @brief Writes a file to the cache directory, creating the directory if needed.
+    /// The data is written to a temporary file which then replaces the file, so
+    /// a crash never leaves a partially written file behind.
+    /// @param pPath The path of the file, relative to the cache directory.
+    /// @returns Error code
+    Result writeCacheFile(const char *pPath, const void *pData, size_t size);
+
+    /// @brief Replaces an asset the same way as @ref writeCacheFile, for assets
+    /// generated while running such as recompiled shaders.
+    /// @param pPath The path of the asset, relative to the assets directory.
+    /// @returns Error code
+    Result writeAssetFile(const char *pPath, const void *pData, size_t size);
+
   private:
     std::string basePath;
+
+    /// @brief Writes a temporary file next to the path and renames it over the path.
+    static Result writeFile(const std::string &fullpath, const void *pData, size_t size);
 };
 
 namespace OS
@@ -73,6 +73,11 @@ Platform::Platform()
     : instance(VK_NULL_HANDLE),
       surface(VK_NULL_HANDLE),
       physicalDevice(VK_NULL_HANDLE),
+      enabledFeatures({}),
+      apiVersion(0),
+      timelineSemaphoreSupported(false),
+      descriptorIndexingSupported(false),
+      descriptorIndexingProperties({}),
       queueFamilyProperties(std::vector<VkQueueFamilyProperties>()),
       graphicsQueueFamilyIndex(-1),
       presentQueueFamilyIndex(-1),
@@ -89,12 +94,12 @@ Platform::Platform()
       useInstanceExtensions(true),
       useDeviceExtensions(true),
       haveDebugReport(true),
+      vsync(false),
       externalLayers(std::vector<std::string>()),
       activeInstanceExtensions(std::vector<const char *>()),
       activeInstanceLayers(std::vector<const char *>()),
       activeDeviceLayers(std::vector<const char *>()),
-      debugReportCallback(VK_NULL_HANDLE),
-      vsync(false)
+      debugReportCallback(VK_NULL_HANDLE)
 {
     LOGI("CONSTRUCTING Platform\n");
 }
@@ -320,7 +325,7 @@ Result Platform::initInstance(
     VkApplicationInfo applicationCreateInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
     applicationCreateInfo.pApplicationName = "Tobi Engine";
     applicationCreateInfo.pEngineName = "Tobi Engine";
-    applicationCreateInfo.apiVersion = VK_MAKE_VERSION(1, 1, 92);
+    applicationCreateInfo.apiVersion = VK_MAKE_VERSION(1, 2, 0);
 
     VkInstanceCreateInfo instanceCreateInfo = {VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
     instanceCreateInfo.pApplicationInfo = &applicationCreateInfo;
@@ -343,6 +348,7 @@ Result Platform::initInstance(
 
     // Try to fall back to compatible Vulkan versions if the driver is using
     // older, but compatible API versions.
+    // Features newer than the version in use are disabled, see initDevice.
     if (result == VK_ERROR_INCOMPATIBLE_DRIVER)
     {
         applicationCreateInfo.apiVersion = VK_MAKE_VERSION(1, 1, 0);
@@ -365,6 +371,8 @@ Result Platform::initInstance(
         return RESULT_ERROR_GENERIC;
     }
 
+    apiVersion = applicationCreateInfo.apiVersion;
+
     if (!vulkanSymbolWrapperLoadCoreInstanceSymbols(instance))
     {
         LOGE("Failed to load instance symbols.");
@@ -454,7 +462,7 @@ int rateDeviceSuitability(VkPhysicalDevice physicalDevice)
     return score;
 }
 
-const VkPhysicalDevice Platform::pickPhysicalDevice() const
+VkPhysicalDevice Platform::pickPhysicalDevice() const
 {
     uint32_t physicalDeviceCount = 0;
     VK_CHECK(vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr));
@@ -598,7 +606,7 @@ Result Platform::initDevice(const std::vector<const char *> &requiredDeviceExten
         // no graphics queue, no application?
         return RESULT_ERROR_GENERIC;
     }
-    if (computeQueueFamilyIndex = ! - 1 && computeQueueFamilyIndex != graphicsQueueFamilyIndex)
+    if (computeQueueFamilyIndex != -1 && computeQueueFamilyIndex != graphicsQueueFamilyIndex)
     {
         VkDeviceQueueCreateInfo computeQueueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
         computeQueueCreateInfo.queueFamilyIndex = computeQueueFamilyIndex;
@@ -611,7 +619,7 @@ Result Platform::initDevice(const std::vector<const char *> &requiredDeviceExten
         // TODO: remove?
         computeQueueFamilyIndex = graphicsQueueFamilyIndex;
     }
-    if (transferQueueFamilyIndex = ! - 1 && transferQueueFamilyIndex != graphicsQueueFamilyIndex && transferQueueFamilyIndex != computeQueueFamilyIndex)
+    if (transferQueueFamilyIndex != -1 && transferQueueFamilyIndex != graphicsQueueFamilyIndex && transferQueueFamilyIndex != computeQueueFamilyIndex)
     {
         VkDeviceQueueCreateInfo transferQueueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
         transferQueueCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
@@ -619,14 +627,81 @@ Result Platform::initDevice(const std::vector<const char *> &requiredDeviceExten
         transferQueueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.emplace_back(transferQueueCreateInfo);
     }
-    else
+    else if (transferQueueFamilyIndex != computeQueueFamilyIndex)
     {
-        // TODO: remove?
+        // No transfer only family, uploads go through the graphics queue.
         transferQueueFamilyIndex = graphicsQueueFamilyIndex;
     }
 
-    VkPhysicalDeviceFeatures features = {};
+    // Only enable the optional features the renderer can make use of.
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+    enabledFeatures = {};
+    // Indirect draws with a non zero firstInstance, used by GPU culling.
+    enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    // Fragment shader invocations in the frame statistics.
+    enabledFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    // The statistics query stays active while the main pass runs its secondary command buffers.
+    enabledFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+
+    // Timeline semaphores and descriptor indexing are core in Vulkan 1.2,
+    // both the instance and the device have to support that version.
+    // Otherwise fences and binary semaphores are used, and no bindless resources.
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+    timelineSemaphoreSupported = false;
+    descriptorIndexingSupported = false;
+    descriptorIndexingProperties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES};
+    if (apiVersion >= VK_MAKE_VERSION(1, 2, 0) &&
+        physicalDeviceProperties.apiVersion >= VK_MAKE_VERSION(1, 2, 0) &&
+        VULKAN_SYMBOL_WRAPPER_LOAD_INSTANCE_EXTENSION_SYMBOL(instance, vkGetPhysicalDeviceFeatures2))
+    {
+        VkPhysicalDeviceFeatures2 supportedFeatures2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        supportedFeatures2.pNext = &timelineSemaphoreFeatures;
+        timelineSemaphoreFeatures.pNext = &descriptorIndexingFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+        timelineSemaphoreSupported = timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+
+        // Large arrays of textures and storage buffers, indexed with ids which
+        // differ between draws, and written while command buffers using other
+        // elements are in flight.
+        descriptorIndexingSupported = descriptorIndexingFeatures.runtimeDescriptorArray &&
+                                      descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+                                      descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+                                      descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                                      descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+                                      descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+                                      descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing &&
+                                      VULKAN_SYMBOL_WRAPPER_LOAD_INSTANCE_EXTENSION_SYMBOL(instance, vkGetPhysicalDeviceProperties2);
+    }
+
+    if (descriptorIndexingSupported)
+    {
+        VkPhysicalDeviceProperties2 properties2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+        properties2.pNext = &descriptorIndexingProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        descriptorIndexingProperties.pNext = nullptr;
+    }
+
+    // Only the features in use are enabled.
+    descriptorIndexingFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+    descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+
+    timelineSemaphoreFeatures.pNext = descriptorIndexingSupported ? &descriptorIndexingFeatures : nullptr;
+    timelineSemaphoreFeatures.timelineSemaphore = timelineSemaphoreSupported ? VK_TRUE : VK_FALSE;
+
     VkDeviceCreateInfo deviceCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    if (timelineSemaphoreSupported)
+        deviceCreateInfo.pNext = &timelineSemaphoreFeatures;
+    else if (descriptorIndexingSupported)
+        deviceCreateInfo.pNext = &descriptorIndexingFeatures;
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     if (useDeviceExtensions)
@@ -644,7 +719,7 @@ Result Platform::initDevice(const std::vector<const char *> &requiredDeviceExten
     }
 #endif
 
-    deviceCreateInfo.pEnabledFeatures = &features;
+    deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
 
     VK_CHECK(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice));
 
@@ -660,6 +735,14 @@ Result Platform::initDevice(const std::vector<const char *> &requiredDeviceExten
         return RESULT_ERROR_GENERIC;
     }
 
+    if (timelineSemaphoreSupported && FAILED(loadTimelineSemaphoreSymbols()))
+    {
+        LOGW("Failed to load timeline semaphore symbols, using fences.\n");
+        timelineSemaphoreSupported = false;
+    }
+    LOGI("Timeline semaphores are %s.\n", timelineSemaphoreSupported ? "used" : "not supported");
+    LOGI("Descriptor indexing is %s.\n", descriptorIndexingSupported ? "used" : "not supported");
+
     vkGetDeviceQueue(logicalDevice, graphicsQueueFamilyIndex, 0, &graphicsQueue);
     if (graphicsQueueFamilyIndex == presentQueueFamilyIndex)
         presentQueue = graphicsQueue;
@@ -671,8 +754,12 @@ Result Platform::initDevice(const std::vector<const char *> &requiredDeviceExten
         vkGetDeviceQueue(logicalDevice, computeQueueFamilyIndex, 0, &computeQueue);
     if (graphicsQueueFamilyIndex == transferQueueFamilyIndex)
         transferQueue = graphicsQueue;
+    else if (computeQueueFamilyIndex == transferQueueFamilyIndex)
+        transferQueue = computeQueue;
     else
         vkGetDeviceQueue(logicalDevice, transferQueueFamilyIndex, 0, &transferQueue);
+    LOGI("Queue families: graphics %d, compute %d, transfer %d.\n",
+         graphicsQueueFamilyIndex, computeQueueFamilyIndex, transferQueueFamilyIndex);
 
     return RESULT_SUCCESS;
 }
@@ -995,4 +1082,13 @@ Result Platform::loadDeviceSymbols()
     return RESULT_SUCCESS;
 }
 
+Result Platform::loadTimelineSemaphoreSymbols()
+{
+    if (!VULKAN_SYMBOL_WRAPPER_LOAD_DEVICE_EXTENSION_SYMBOL(logicalDevice, vkGetSemaphoreCounterValue))
+        return RESULT_ERROR_GENERIC;
+    if (!VULKAN_SYMBOL_WRAPPER_LOAD_DEVICE_EXTENSION_SYMBOL(logicalDevice, vkWaitSemaphores))
+        return RESULT_ERROR_GENERIC;
+    return RESULT_SUCCESS;
+}
+
 } // namespace Tobi
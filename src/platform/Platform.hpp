@@ -46,6 +46,39 @@ class Platform
 
     inline const auto getGraphicsQueue() const { return graphicsQueue; }
 
+    inline const auto getComputeQueueFamilyIndex() const { return computeQueueFamilyIndex; }
+
+    /// @brief Returns the compute queue, which is the graphics queue when the
+    /// device has no separate compute queue family.
+    inline const auto getComputeQueue() const { return computeQueue; }
+
+    inline const auto getTransferQueueFamilyIndex() const { return transferQueueFamilyIndex; }
+
+    /// @brief Returns the transfer queue. A transfer only queue when the device
+    /// has one, otherwise the compute or graphics queue.
+    inline const auto getTransferQueue() const { return transferQueue; }
+
+    inline const VkPhysicalDeviceProperties &getPhysicalDeviceProperties() const { return physicalDeviceProperties; }
+
+    inline const VkPhysicalDeviceMemoryProperties &getMemoryProperties() const { return physicalDeviceMemoryProperties; }
+
+    /// @brief Returns the optional device features which were enabled on the logical device.
+    inline const VkPhysicalDeviceFeatures &getEnabledFeatures() const { return enabledFeatures; }
+
+    /// @brief Returns true when the device was created with timeline semaphores enabled.
+    inline bool supportsTimelineSemaphores() const { return timelineSemaphoreSupported; }
+
+    /// @brief Returns true when the device was created with the descriptor
+    /// indexing features needed for bindless resources.
+    inline bool supportsDescriptorIndexing() const { return descriptorIndexingSupported; }
+
+    /// @brief The limits of update after bind descriptor sets, only filled when
+    /// descriptor indexing is supported.
+    inline const VkPhysicalDeviceDescriptorIndexingProperties &getDescriptorIndexingProperties() const
+    {
+        return descriptorIndexingProperties;
+    }
+
     inline const auto &getSwapChainDimensions() const { return swapChainDimensions; }
 
     inline const auto &getSwapChainImages() const { return swapChainImages; }
@@ -187,6 +220,12 @@ class Platform
     VkPhysicalDevice physicalDevice;
     VkPhysicalDeviceProperties physicalDeviceProperties;
     VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
+    VkPhysicalDeviceFeatures enabledFeatures;
+    /// The API version the instance was created with.
+    uint32_t apiVersion;
+    bool timelineSemaphoreSupported;
+    bool descriptorIndexingSupported;
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties;
 
     // present graphics, transfer and compute queues. If the gpu supports it, they will be separate queues
     std::vector<VkQueueFamilyProperties> queueFamilyProperties;
@@ -251,7 +290,7 @@ class Platform
     Result initPhysicalDevice(
         const std::vector<const char *> &requiredDeviceExtensions);
 
-    const VkPhysicalDevice pickPhysicalDevice() const;
+    VkPhysicalDevice pickPhysicalDevice() const;
 
     virtual Result initSurface() = 0;
 
@@ -273,6 +312,7 @@ class Platform
 
     Result loadInstanceSymbols();
     Result loadDeviceSymbols();
+    Result loadTimelineSemaphoreSymbols();
 };
 
 } // namespace Tobi
@@ -1,4 +1,5 @@
-
 #define CATCH_CONFIG_MAIN
+// The alternate signal stack of the bundled Catch does not build with glibc 2.34 and later.
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
 
 #include <catch.hpp>